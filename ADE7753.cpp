@@ -58,18 +58,35 @@ figure out when an an interrupt flag has be set.
 #include <avr/pgmspace.h>
 #include "SPI.h"
 #include "ADE7753.h"
-#include <avr/wdt.h> // Watchdog timer
+#include "GridTrace.h"
+#include "GridCapture.h"
+#include "GridLog.h"
 
 
+/** === ADE7753 ===
+* Class constructor, only keeps the chip select pin, the SPI is set by setSPI()
+* @param csPin: digital pin wired to the CS of this ADE7753, CS (10) on the Olimex Energy Shield
+*/
+ADE7753::ADE7753(byte csPin) {
+	cs = csPin;
+}
+
+/** === getCS ===
+* @return byte with the chip select pin of this ADE7753
+*/
+byte ADE7753::getCS(void) {
+	return cs;
+}
+
 /** === setSPI ===
-* Class constructor, sets chip select pin (CS define) and SPI communication with arduino.
+* Sets chip select pin and SPI communication with arduino.
 * @param none
 * @return void
 */
 
 void ADE7753::setSPI(void) {
-	pinMode(CS,OUTPUT);  // Chip select by digital output on pin nbs CS
-	digitalWrite(CS, HIGH);//is disabled by default, so need to set
+	pinMode(cs,OUTPUT);  // Chip select by digital output on pin nbs cs
+	digitalWrite(cs, HIGH);//is disabled by default, so need to set
 	// SPI Init
 	SPI.setDataMode(SPI_MODE2);
 	SPI.setClockDivider(SPI_CLOCK_DIV32);
@@ -90,22 +107,22 @@ void ADE7753::closeSPI(void) {
 *****************************/
 
 /** === enableChip ===
-* Enable chip, setting low ChipSelect pin (CS)
+* Enable chip, setting low ChipSelect pin (cs)
 * @param none
 *
 */
 void ADE7753::enableChip(void){
-	digitalWrite(CS,LOW);
+	digitalWrite(cs,LOW);
 }
 
 
 /** === disableChip ===
-* Disable chip, setting high ChipSelect pin (CS)
+* Disable chip, setting high ChipSelect pin (cs)
 * @param none
 *
 */
 void ADE7753::disableChip(void){
-	digitalWrite(CS,HIGH);  
+	digitalWrite(cs,HIGH);  
 }
 
 
@@ -116,6 +133,7 @@ void ADE7753::disableChip(void){
 *
 */
 unsigned char ADE7753::read8(char reg){
+	TRACE_COUNT(TRACE_READ8);
 	enableChip();
 	unsigned char b0;
 	delayMicroseconds(50);
@@ -124,6 +142,7 @@ unsigned char ADE7753::read8(char reg){
 	b0=SPI.transfer(0x00);
 	delayMicroseconds(50);
 	disableChip();
+	CAPTURE(cs, reg, b0);
 	//    return (unsigned long)SPI.transfer(0x00);
 	return b0;
 }
@@ -136,6 +155,7 @@ unsigned char ADE7753::read8(char reg){
 *
 */
 unsigned int ADE7753::read16(char reg){
+	TRACE_COUNT(TRACE_READ16);
 	enableChip();
 	unsigned char b1,b0;
 	delayMicroseconds(50);
@@ -146,6 +166,7 @@ unsigned int ADE7753::read16(char reg){
 	b0=SPI.transfer(0x00);
 	delayMicroseconds(50);
 	disableChip();
+	CAPTURE(cs, reg, (unsigned int)b1<<8 | (unsigned int)b0);
 	return (unsigned int)b1<<8 | (unsigned int)b0;
 }
 
@@ -157,6 +178,7 @@ unsigned int ADE7753::read16(char reg){
 *
 */
 unsigned long ADE7753::read24(char reg){
+	TRACE_COUNT(TRACE_READ24);
 	enableChip();
 	unsigned char b2,b1,b0;
 	delayMicroseconds(50);
@@ -169,6 +191,7 @@ unsigned long ADE7753::read24(char reg){
 	b0=SPI.transfer(0x00);
 	delayMicroseconds(50);
 	disableChip();
+	CAPTURE(cs, reg, (unsigned long)b2<<16 | (unsigned long)b1<<8 | (unsigned long)b0);
 	return (unsigned long)b2<<16 | (unsigned long)b1<<8 | (unsigned long)b0;
 }
 
@@ -195,6 +218,7 @@ void ADE7753::write8(char reg, unsigned char data){
 	SPI.transfer((unsigned char)data0);
 	delayMicroseconds(50);
 	disableChip();
+	CAPTURE(cs, reg, data0);
 }
 
 
@@ -224,6 +248,7 @@ void ADE7753::write16(char reg, unsigned int data){
 	SPI.transfer((unsigned char)data0);  
 	delayMicroseconds(50);
 	disableChip();
+	CAPTURE(cs, reg, data);
 }
 
 
@@ -409,8 +434,7 @@ long ADE7753::getIRMS(void){
 	{ // wait for the selected interrupt to occur
 		if ( ( millis() - lastupdate ) > 100) 
 		{ 
-			wdt_reset();
-			Serial.println("\n--> getIRMS Timeout - no AC input"); 
+			LOG_WARN(gridLog.text(PSTR("\n--> getIRMS Timeout - no AC input\n")));
 			break;  
 		}
 	}          
@@ -433,8 +457,7 @@ long ADE7753::getVRMS(void){
 	{ // wait for the selected interrupt to occur
 		if ( ( millis() - lastupdate ) > 100) 
 		{ 
-			wdt_reset();
-			Serial.println("\n--> getIRMS Timeout - no AC input"); 
+			LOG_WARN(gridLog.text(PSTR("\n--> getIRMS Timeout - no AC input\n")));
 			break;  
 		}
 	}          
@@ -564,15 +587,14 @@ char ADE7753::getTemp(){
 	long lastupdate = 0;
 	lastMode = getMode();
 	//Temp measure
+	ADE7753::getresetInterruptStatus(); // Clear all interrupts, before TEMPSEL as the conversion only takes 26 us
 	setMode(TEMPSEL);
-	ADE7753::getresetInterruptStatus(); // Clear all interrupts
 	lastupdate = millis();
 	while( ! ( ADE7753::getInterruptStatus() & TEMPREADY ) ) // wait for Temperature measurement to be ready
 	{ // wait for the selected interrupt to occur
 		if ( ( millis() - lastupdate ) > 100) 
 		{ 
-			wdt_reset();
-			Serial.println("\n--> Temperature Timeout no AC input"); 
+			LOG_WARN(gridLog.text(PSTR("\n--> Temperature Timeout no AC input\n")));
 			ADE7753::getresetInterruptStatus(); // Clear all interrupts
 			break;  
 		}
@@ -588,7 +610,7 @@ char ADE7753::getTemp(){
 	//        { // wait for the selected interrupt to occur
 	//             if ( ( millis() - lastupdate ) > 2500) 
 	//               { 
-	//                 Serial.println("--> Temperature Timeout no AC input"); 
+	//                 gridLog.println("--> Temperature Timeout no AC input"); 
 	//                 ADE7753::getresetInterruptStatus(); // Clear all interrupts
 	//                 break;  
 	//               }
@@ -694,133 +716,195 @@ void ADE7753::setLineCyc(int d){
 	write16(LINECYC,d);
 }
 
-// May have to remove this code because of code/RAM size restriction with Nanode
+/** === setZeroCrossingTimeout ===
+* Zero-Crossing Timeout. If no zero crossings are detected
+* on Channel 2 within a time period specified by this 12-bit register,
+* the interrupt request line (IRQ) is activated
+* @param d: timeout (12 bits unsigned), unit 128/CLKIN
+*/
+void ADE7753::setZeroCrossingTimeout(int d){
+	write16(ZXTOUT,d);
+}
+
+/** === setSagCycles ===
+* Sag Line Cycle Register. This 8-bit register specifies the number of
+* consecutive line cycles the signal on Channel 2 must be below SAGLVL
+* before the SAG output is activated.
+* @param d: line cycles (8 bits unsigned)
+*/
+void ADE7753::setSagCycles(char d){
+	write8(SAGCYC,d);
+}
+
+/** === setSagVoltageLevel ===
+* Sag Voltage Level. An 8-bit write to this register determines at what peak
+* signal level on Channel 2 the SAG pin becomes active. The signal must remain
+* low for the number of cycles specified in the SAGCYC register before the SAG pin is activated
+* @param d: level (8 bits unsigned)
+*/
+void ADE7753::setSagVoltageLevel(char d){
+	write8(SAGLVL,d);
+}
+
+/** === setIPeakLevel ===
+* Channel 1 Peak Level Threshold (Current Channel). This register sets the level of the current
+* peak detection. If the Channel 1 input exceeds this level, the PKI flag in the status register is set.
+* @param d: level (8 bits unsigned)
+*/
+void ADE7753::setIPeakLevel(char d){
+	write8(IPKLVL,d);
+}
+
+/** === setVPeakLevel ===
+* Channel 2 Peak Level Threshold (Voltage Channel). This register sets the level of the
+* voltage peak detection. If the Channel 2 input exceeds this level, 
+* the PKV flag in the status register is set.
+* @param d: level (8 bits unsigned)
+*/
+void ADE7753::setVPeakLevel(char d){
+	write8(VPKLVL,d);
+}
+
+/** === getVpeak ===
+* Channel 2 Peak Register. The maximum input value of the voltage channel since the last read of the register is stored in this register.
+* @param none
+* @return long with the data (24 bits unsigned).
+*/
+long ADE7753::getVpeak(void){
+	return read24(VPEAK);
+}
+
+/** === getIpeak ===
+* Channel 1 Peak Register. The maximum input value of the current channel since the last read
+* of the register is stored in this register.
+* @param none
+* @return long with the data (24 bits unsigned) .
+*/
+long ADE7753::getIpeak(void){
+	return read24(IPEAK);
+}
+
+/** === energyGain ===
+* @param wgain: WGAIN 12-bit (S) - active power gain
+* @param vagain: VAGAIN 12-bit (S) - apparent power gain
+*/
+void ADE7753::energyGain(int wgain, int vagain){
+	write16(WGAIN,wgain);
+	write16(VAGAIN,vagain);
+}
+
+
+#ifdef GRIDDIAG
+// Register dumps, used for code verification et debugging (see GridFeatures.h)
+
+// flag names of the status registers and of MODE, from bit 0
+static const char statusBits[16][10] PROGMEM = {
+	"AEHF", "SAG", "CYCEND", "WSMP", "ZX", "TEMPREADY", "RESET", "AEOF",
+	"PKV", "PKI", "VAEHF", "VAEOF", "ZXTO", "PPOS", "PNEG", "RESERVED"
+};
+static const char modeBits[16][10] PROGMEM = {
+	"DISHPF", "DISLPF2", "DISCF", "DISSAG", "ASUSPEND", "TEMPSEL", "SWRST", "CYCMODE",
+	"DISCH1", "DISCH2", "SWAP", "DTRT1", "DTRT0", "WAVSEL1", "WAVSEL0", "POAM"
+};
+
+// printAllRegisters() format
+#define DUMP_DEC     0     // unsigned decimal
+#define DUMP_SIGNED  1     // 16-bit register, signed decimal
+#define DUMP_BIN     2
+#define DUMP_HEX     3
+
+struct RegisterDump {
+	byte reg;
+	byte bytes;            // width of the SPI read, 1 to 3
+	byte format;           // DUMP_DEC ... DUMP_HEX
+	char name[11];
+};
+
+// in the order of the addresses, CH1OS and CH2OS are printed by printAllRegisters() itself
+static const RegisterDump registerDumps[] PROGMEM = {
+	{ WAVEFORM, 3, DUMP_DEC, "WAVEFORM" }, { AENERGY, 3, DUMP_DEC, "AENERGY" },
+	{ RAENERGY, 3, DUMP_DEC, "RAENERGY" }, { LAENERGY, 3, DUMP_DEC, "LAENERGY" },
+	{ VAENERGY, 3, DUMP_DEC, "VAENERGY" }, { RVAENERGY, 3, DUMP_DEC, "RVAENERGY" },
+	{ LVAENERGY, 3, DUMP_DEC, "LVAENERGY" }, { LVARENERGY, 3, DUMP_DEC, "LVARENERGY" },
+	{ MODE, 2, DUMP_BIN, "MODE" }, { IRQEN, 2, DUMP_BIN, "IRQEN" },
+	{ STATUS, 2, DUMP_BIN, "STATUS" }, { RSTSTATUS, 2, DUMP_BIN, "RSTSTATUS" },
+	{ GAIN, 1, DUMP_BIN, "GAIN" }, { PHCAL, 1, DUMP_HEX, "PHCAL" },
+	{ APOS, 2, DUMP_SIGNED, "APOS" }, { WGAIN, 2, DUMP_SIGNED, "WGAIN" },
+	{ WDIV, 1, DUMP_DEC, "WDIV" }, { CFNUM, 2, DUMP_DEC, "CFNUM" },
+	{ CFDEN, 2, DUMP_DEC, "CFDEN" }, { IRMS, 3, DUMP_DEC, "IRMS" },
+	{ VRMS, 3, DUMP_DEC, "VRMS" }, { IRMSOS, 2, DUMP_SIGNED, "IRMSOS" },
+	{ VRMSOS, 2, DUMP_SIGNED, "VRMSOS" }, { VAGAIN, 2, DUMP_SIGNED, "VAGAIN" },
+	{ VADIV, 1, DUMP_DEC, "VADIV" }, { LINECYC, 2, DUMP_DEC, "LINECYC" },
+	{ ZXTOUT, 2, DUMP_DEC, "ZXTOUT" }, { SAGCYC, 1, DUMP_DEC, "SAGCYC" },
+	{ SAGLVL, 1, DUMP_DEC, "SAGLVL" }, { IPKLVL, 1, DUMP_DEC, "IPKLVL" },
+	{ VPKLVL, 1, DUMP_DEC, "VPKLVL" }, { IPEAK, 3, DUMP_DEC, "IPEAK" },
+	{ RSTIPEAK, 3, DUMP_DEC, "RSTIPEAK" }, { VPEAK, 3, DUMP_DEC, "VPEAK" },
+	{ RSTVPEAK, 3, DUMP_DEC, "RSTVPEAK" }, { TEMP, 1, DUMP_DEC, "TEMP" },
+	{ PERIOD, 2, DUMP_DEC, "PERIOD" }, { TMODE, 1, DUMP_DEC, "TMODE" },
+	{ CHKSUM, 1, DUMP_DEC, "CHKSUM" }, { DIEREV, 1, DUMP_DEC, "DIEREV" }
+};
+
+/** === printBits ===
+* Print a register in binary, then the name of each flag set, one per line
+*/
+static void printBits(PGM_P title, unsigned int bits, const char names[][10]) {
+	gridLog.text(title);
+	gridLog.println(bits, BIN);
+	for (byte i = 0; i < 16; i++)
+	{
+		if ( bits & ( 1U << i ) ) { gridLog.text(names[i]); gridLog.println(); }
+	}
+}
 
-#define NanodeReduceCodeSize 1
-#ifndef NanodeReduceCodeSize
+/** === printOffset ===
+* Print CH1OS or CH2OS: 5-bit magnitude with the sign on bit 5, see spec Page 58 Table 16
+*/
+static void printOffset(PGM_P name, unsigned char b) {
+	gridLog.text(name);
+	gridLog.print(( b & 0x20 ) ? - int (b & 0x1F) : int (b & 0x1F), DEC);
+}
 
 /** === printGetResetInterruptStatus ===
 * used for code verification et debugging
 */
 void ADE7753::printGetResetInterruptStatus(void){
-
-	int InterruptMask;
-	
-	Serial.print("Interrupt Status (binary): ");
-	InterruptMask = ADE7753::getresetInterruptStatus();
-	Serial.println(InterruptMask,BIN);
-	
-	if ( InterruptMask & AEHF )      Serial.println("AEHF");
-	if ( InterruptMask & SAG  )      Serial.println("SAG");
-	if ( InterruptMask & CYCEND )    Serial.println("CYCEND");
-	if ( InterruptMask & WSMP )      Serial.println("WSMP");
-	if ( InterruptMask & ZX )        Serial.println("ZX");
-	if ( InterruptMask & TEMPREADY ) Serial.println("TEMPREADY");
-	if ( InterruptMask & RESET )     Serial.println("RESET");
-	if ( InterruptMask & AEOF )      Serial.println("AEOF");
-	if ( InterruptMask & PKV )       Serial.println("PKV");
-	if ( InterruptMask & PKI )       Serial.println("PKI");
-	if ( InterruptMask & VAEHF )     Serial.println("VAEHF");
-	if ( InterruptMask & VAEOF )     Serial.println("VAEOF");
-	if ( InterruptMask & ZXTO )      Serial.println("ZXTO");
-	if ( InterruptMask & PPOS )      Serial.println("PPOS");
-	if ( InterruptMask & PNEG )      Serial.println("PNEG");
-	if ( InterruptMask & RESERVED )  Serial.println("RESERVED");
+	printBits(PSTR("Interrupt Status (binary): "), getresetInterruptStatus(), statusBits);
 }    
 
 /** === printGetMode ===
 * used for code verification et debugging
 */     
 void ADE7753::printGetMode(void){
-
-	int ModeMask;
-	
-	Serial.print("Mode (binary): ");
-	ModeMask = ADE7753::getMode();
-	Serial.println(ModeMask,BIN);
-	
-	if ( ModeMask & DISHPF )   Serial.println("DISHPF");
-	if ( ModeMask & DISLPF2  ) Serial.println("DISLPF2");
-	if ( ModeMask & DISCF )    Serial.println("DISCF");
-	if ( ModeMask & DISSAG )   Serial.println("DISSAG");
-	if ( ModeMask & ASUSPEND ) Serial.println("ASUSPEND");
-	if ( ModeMask & TEMPSEL )  Serial.println("TEMPSEL");
-	if ( ModeMask & SWRST )    Serial.println("SWRST");
-	if ( ModeMask & CYCMODE )  Serial.println("CYCMODE");
-	if ( ModeMask & DISCH1 )   Serial.println("DISCH1");
-	if ( ModeMask & DISCH2 )   Serial.println("DISCH2");
-	if ( ModeMask & SWAP )     Serial.println("SWAP");
-	if ( ModeMask & DTRT0 )    Serial.println("DTRT0");
-	if ( ModeMask & DTRT1 )    Serial.println("DTRT1");
-	if ( ModeMask & WAVSEL0 )  Serial.println("WAVSEL0");
-	if ( ModeMask & WAVSEL1 )  Serial.println("WAVSEL1");
-	if ( ModeMask & POAM )     Serial.println("POAM");   
+	printBits(PSTR("Mode (binary): "), getMode(), modeBits);
 }
 
-
 /** === printAllRegisters ===
 * used for code verification et debugging
 */    
 void ADE7753::printAllRegisters(void){
-
-	unsigned char b = 0;
-	int i = 0;
-	unsigned char sign = 0;
-	int integrator = 0;
-	Serial.print("WAVEFORM   "); Serial.println(read24(WAVEFORM),DEC);
-	Serial.print("AENERGY    "); Serial.println(read24(AENERGY),DEC);
-	Serial.print("RAENERGY   "); Serial.println(read24(RAENERGY),DEC);
-	Serial.print("LAENERGY   "); Serial.println(read24(LAENERGY),DEC);
-	Serial.print("VAENERGY   "); Serial.println(read24(VAENERGY),DEC);
-	Serial.print("RVAENERGY  "); Serial.println(read24(RVAENERGY),DEC);
-	Serial.print("LVAENERGY  "); Serial.println(read24(LVAENERGY),DEC);
-	Serial.print("LVARENERGY "); Serial.println(read24(LVARENERGY),DEC);
-	Serial.print("MODE       "); Serial.println(read16(MODE),BIN);            
-	Serial.print("IRQEN      "); Serial.println(read16(IRQEN),BIN);
-	Serial.print("STATUS     "); Serial.println(read16(STATUS),BIN);
-	Serial.print("RSTSTATUS  "); Serial.println(read16(RSTSTATUS),BIN);
-
-	// CH1OS register - see spec Page 58 Table 16
-	b = read8(CH1OS);
-	sign = b & 0x20;  // test sign on bit-6
-	if ( sign > 1 ) {i = - int (b & 0x1F) ;} else {i = int (b & 0x1F);}
-	Serial.print("CH1OS  "); Serial.print(i, DEC);  // convert signed 6-bit into signed 16-bit
-	integrator =  b & 0x80; // test integrator flag on bit-8
-	if ( integrator > 1 ) { Serial.println(" Integrator ON");} else { Serial.println(" Integrator OFF");} 
-
-	b = read8(CH2OS);
-	sign = b & 0x20;  // test sign on bit-6
-	if ( sign > 1 ) {i = - int (b & 0x1F) ;} else {i = int (b & 0x1F);}
-	Serial.print("CH2OS  "); Serial.println(i, DEC);  // convert signed 6-bit into signed 16-bit
-	
-	Serial.print("GAIN   "); Serial.println(read8 (GAIN),BIN);
-	Serial.print("PHCAL  "); Serial.println(read8 (PHCAL),HEX);
-	Serial.print("APOS   "); Serial.println(int(read16(APOS)),DEC);
-	Serial.print("WGAIN  "); Serial.println(int (read16(WGAIN)),DEC);
-	Serial.print("WDIV   "); Serial.println(read8 (WDIV),DEC);
-	Serial.print("CFNUM  "); Serial.println(read16(CFNUM),DEC);
-	Serial.print("CFDEN  "); Serial.println(read16(CFDEN),DEC);
-	Serial.print("->IRMS   "); Serial.println(read24(IRMS),DEC);
-	Serial.print("->VRMS   "); Serial.println(read24(VRMS),DEC);
-	Serial.print("--IRMSOS "); Serial.println(int(read16(IRMSOS)),DEC);
-	Serial.print("--VRMSOS "); Serial.println(int(read16(VRMSOS)),DEC);
-	Serial.print("VAGAIN "); Serial.println(int(read16(VAGAIN)),DEC);
-	Serial.print("VADIV  "); Serial.println(read8 (VADIV),DEC);
-	Serial.print("LINECYC  "); Serial.println(read16(LINECYC),DEC);
-	Serial.print("ZXTOUT   "); Serial.println(read16(ZXTOUT),DEC);
-	Serial.print("SAGCYC   "); Serial.println(read8 (SAGCYC),DEC);
-	Serial.print("SAGLVL   "); Serial.println(read8 (SAGLVL),DEC);
-	Serial.print("IPKLVL   "); Serial.println(read8 (IPKLVL),DEC);
-	Serial.print("VPKLVL   "); Serial.println(read8 (VPKLVL),DEC);
-	Serial.print("IPEAK    "); Serial.println(read24(IPEAK),DEC);
-	Serial.print("RSTIPEAK "); Serial.println(read24(RSTIPEAK),DEC);
-	Serial.print("VPEAK    "); Serial.println(read24(VPEAK),DEC);
-	Serial.print("RSTVPEAK "); Serial.println(read24(RSTVPEAK),DEC);
-	Serial.print("TEMP     "); Serial.println(read8 (TEMP),DEC);
-	Serial.print("PERIOD   "); Serial.println(read16(PERIOD),DEC);
-	Serial.print("TMODE    "); Serial.println(read8 (TMODE),DEC);
-	Serial.print("CHKSUM   "); Serial.println(read8 (CHKSUM),DEC);
-	Serial.print("DIEREV   "); Serial.println(read8 (DIEREV),DEC);      
+	unsigned char b;
+
+	for (byte i = 0; i < sizeof(registerDumps) / sizeof(registerDumps[0]); i++)
+	{
+		const RegisterDump *d = &registerDumps[i];
+		byte reg = pgm_read_byte(&d->reg);
+		byte bytes = pgm_read_byte(&d->bytes);
+		byte format = pgm_read_byte(&d->format);
+		unsigned long v = bytes == 3 ? read24(reg) : bytes == 2 ? read16(reg) : read8(reg);
+
+		gridLog.text(d->name);
+		for (byte n = strlen_P(d->name); n < 11; n++) gridLog.write(' ');
+		if ( format == DUMP_SIGNED ) gridLog.println(int (v), DEC);
+		else gridLog.println(v, format == DUMP_BIN ? BIN : format == DUMP_HEX ? HEX : DEC);
+		if ( reg == RSTSTATUS )
+		{
+			b = read8(CH1OS);
+			printOffset(PSTR("CH1OS      "), b);
+			gridLog.text(( b & 0x80 ) ? PSTR(" Integrator ON\n") : PSTR(" Integrator OFF\n")); // integrator flag on bit 7
+			printOffset(PSTR("CH2OS      "), read8(CH2OS));
+			gridLog.println();
+		}
+	}
 } 
 
 /** === chkSum ===
@@ -832,6 +916,11 @@ void ADE7753::printAllRegisters(void){
 char ADE7753::chkSum(){
 	return read8(CHKSUM);
 }
+#endif
+
+
+#ifdef GRIDCALIB
+// Getters of the calibration registers, to read back what was written (see GridFeatures.h)
 
 /** === getActiveEnergy ===
 * Active power is accumulated (integrated) over time in this 24-bit, read-only register
@@ -869,133 +958,139 @@ long ADE7753::getApparentEnergyReset(void){
 	return read24(RVAENERGY);
 }
 
-/** === getCurrentOffset ===
-* Channel 2 RMS Offset Correction Register.
+/** === getCH1Offset / getCH2Offset ===
+* Channel 1 / Channel 2 Offset Adjust. Bit 5 is the sign, bits 0-4 the magnitude, bit 7 of
+* CH1OS enables the digital integrator - see spec Page 58 Table 16
 * @param none
-* @return int with the data (12 bits 2-complement signed).
+* @return char with the data (6 bits sign and magnitude, as written).
 */
-int ADE7753::getCurrentOffset(){
-	return read16(IRMSOS);
+char ADE7753::getCH1Offset(void){
+	return read8(CH1OS);
+}
+char ADE7753::getCH2Offset(void){
+	return read8(CH2OS);
 }
 
-/** === getVoltageOffset ===
-* Channel 2 RMS Offset Correction Register.
-* 
+/** === getPhaseCalibration ===
+* Phase Calibration Register. The phase relationship between Channel 1 and 2 can be adjusted
+* in a range from -2.06 to +0.7 degrees at 50 Hz.
 * @param none
-* @return int with the data (12 bits 2-complement's signed).
+* @return char with the data (6 bits 2-complement signed).
 */
-int ADE7753::getVoltageOffset(){
-	return read16(VRMSOS);
+char ADE7753::getPhaseCalibration(void){
+	return read8(PHCAL);
 }
 
-/** === setZeroCrossingTimeout / getZeroCrossingTimeout ===
-* Zero-Crossing Timeout. If no zero crossings are detected
-* on Channel 2 within a time period specified by this 12-bit register,
-* the interrupt request line (IRQ) is activated
+/** === getActiveEnergyDivider / getApparentEnergyDivider ===
+* Active Energy Divider Register (WDIV) / Apparent Energy Divider Register (VADIV).
 * @param none
-* @return int with the data (12 bits unsigned).
+* @return char with the data (8 bits unsigned).
 */
-void ADE7753::setZeroCrossingTimeout(int d){
-	write16(ZXTOUT,d);
+char ADE7753::getActiveEnergyDivider(void){
+	return read8(WDIV);
 }
-int ADE7753::getZeroCrossingTimeout(){
-	return read16(ZXTOUT);
+char ADE7753::getApparentEnergyDivider(void){
+	return read8(VADIV);
 }
 
-/** === getSagCycles / setSagCycles ===
-* Sag Line Cycle Register. This 8-bit register specifies the number of
-* consecutive line cycles the signal on Channel 2 must be below SAGLVL
-* before the SAG output is activated.
+/** === getSagCycles ===
+* Sag Line Cycle Register, see setSagCycles().
 * @param none
 * @return char with the data (8 bits unsigned).
 */
 char ADE7753::getSagCycles(){
 	return read8(SAGCYC);
 }
-void ADE7753::setSagCycles(char d){
-	write8(SAGCYC,d);
-}
-
-/** === getLineCyc / setLineCyc ===
-* Line Cycle Energy Accumulation Mode Line-Cycle Register. 
-* This 16-bit register is used during line cycle energy accumulation mode 
-* to set the number of half line cycles for energy accumulation
-* @param none
-* @return int with the data (16 bits unsigned).
-*/
-int ADE7753::getLineCyc(){
-	return read16(LINECYC);
-}
 
-
-/** === getSagVoltageLevel / setSagVoltageLevel ===
-* Sag Voltage Level. An 8-bit write to this register determines at what peak
-* signal level on Channel 2 the SAG pin becomes active. The signal must remain
-* low for the number of cycles specified in the SAGCYC register before the SAG pin is activated
+/** === getSagVoltageLevel ===
+* Sag Voltage Level, see setSagVoltageLevel().
 * @param none
 * @return char with the data (8 bits unsigned).
 */
 char ADE7753::getSagVoltageLevel(){
 	return read8(SAGLVL);
 }
-void ADE7753::setSagVoltageLevel(char d){
-	write8(SAGLVL,d);
-}
 
-/** === getIPeakLevel / setIPeakLevel ===
-* Channel 1 Peak Level Threshold (Current Channel). This register sets the level of the current
-* peak detection. If the Channel 1 input exceeds this level, the PKI flag in the status register is set.
+/** === getIPeakLevel / getVPeakLevel ===
+* Channel 1 / Channel 2 Peak Level Threshold, see setIPeakLevel() and setVPeakLevel().
 * @param none
 * @return char with the data (8 bits unsigned).
 */
 char ADE7753::getIPeakLevel(){
 	return read8(IPKLVL);
 }
-void ADE7753::setIPeakLevel(char d){
-	write8(IPKLVL,d);
+char ADE7753::getVPeakLevel(){
+	return read8(VPKLVL);
 }
 
-/** === getVPeakLevel / setVPeakLevel ===
-* Channel 2 Peak Level Threshold (Voltage Channel). This register sets the level of the
-* voltage peak detection. If the Channel 2 input exceeds this level, 
-* the PKV flag in the status register is set.
+/** === getVoltageOffset ===
+* Channel 2 RMS Offset Correction Register.
 * @param none
-* @return char with the data (8bits unsigned).
+* @return int with the data (12 bits 2-complement's signed).
 */
-char ADE7753::getVPeakLevel(){
-	return read8(VPKLVL);
+int ADE7753::getVoltageOffset(){
+	return read16(VRMSOS);
 }
-void ADE7753::setVPeakLevel(char d){
-	write8(VPKLVL,d);
+
+/** === getCurrentOffset ===
+* Channel 1 RMS Offset Correction Register.
+* @param none
+* @return int with the data (12 bits 2-complement signed).
+*/
+int ADE7753::getCurrentOffset(){
+	return read16(IRMSOS);
 }
 
-/** === getVpeak ===
-* Channel 2 Peak Register. The maximum input value of the voltage channel since the last read of the register is stored in this register.
+/** === getActivePowerOffset ===
+* Active Power Offset Correction (APOS).
 * @param none
-* @return long with the data (24 bits unsigned).
+* @return int with the data (16 bits 2-complement signed).
 */
-long ADE7753::getVpeak(void){
-	return read24(VPEAK);
+int ADE7753::getActivePowerOffset(void){
+	return read16(APOS);
 }
 
-/** === getIpeak ===
-* Channel 1 Peak Register. The maximum input value of the current channel since the last read
-* of the register is stored in this register.
+/** === getActivePowerGain / getApparentPowerGain ===
+* Power Gain Adjust (WGAIN) / Apparent Gain Register (VAGAIN).
 * @param none
-* @return long with the data (24 bits unsigned) .
+* @return int with the data (12 bits 2-complement signed).
 */
-long ADE7753::getIpeak(void){
-	return read24(IPEAK);
+int ADE7753::getActivePowerGain(void){
+	return read16(WGAIN);
+}
+int ADE7753::getApparentPowerGain(void){
+	return read16(VAGAIN);
 }
 
-/** === energyGain ===
-* @param 
-* @param 
+/** === getFrequencyDividerNumerator / getFrequencyDividerDenominator ===
+* CF Frequency Divider Numerator (CFNUM) / Denominator (CFDEN) Register.
+* @param none
+* @return int with the data (12 bits unsigned).
 */
-void ADE7753::energyGain(int wgain, int vagain){
-	write16(WGAIN,wgain);
-	write16(VAGAIN,vagain);
+int ADE7753::getFrequencyDividerNumerator(void){
+	return read16(CFNUM);
+}
+int ADE7753::getFrequencyDividerDenominator(void){
+	return read16(CFDEN);
+}
+
+/** === getZeroCrossingTimeout ===
+* Zero-Crossing Timeout, see setZeroCrossingTimeout().
+* @param none
+* @return int with the data (12 bits unsigned).
+*/
+int ADE7753::getZeroCrossingTimeout(){
+	return read16(ZXTOUT);
 }
 
+/** === getLineCyc ===
+* Line Cycle Energy Accumulation Mode Line-Cycle Register. 
+* This 16-bit register is used during line cycle energy accumulation mode 
+* to set the number of half line cycles for energy accumulation
+* @param none
+* @return int with the data (16 bits unsigned).
+*/
+int ADE7753::getLineCyc(){
+	return read16(LINECYC);
+}
 #endif
-
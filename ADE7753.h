@@ -47,11 +47,16 @@ The IRQ Interrupt Request pin of the ADE7753 on the Olimex Energy Shield is not
 to the Arduino board, so we need to continuously poll the interrupt status register to 
 figure out when an an interrupt flag has be set.
 
+The register dumps (printAllRegisters()...) are compiled in with GRIDDIAG only, the getters
+of the offsets, gains, dividers and levels with GRIDCALIB only (see GridFeatures.h).
+
 */  
 
 #ifndef ADE7753_H
 #define ADE7753_H
 
+#include "GridFeatures.h"  // GRIDDIAG, GRIDCALIB
+
 /***
  * Defines
  *
@@ -180,7 +185,7 @@ determine the source of the interrupt.
 #define FULLSCALESELECT_0_125V  0x02
 
 // Class Atributes
-#define CS 10                // Chip Select ADE7753 - Digital output pin nbr on Olimex Energy Shield  
+#define CS 10                // Chip Select ADE7753 - Digital output pin nbr on Olimex Energy Shield, default of the constructor
 #define WRITE 0x80           // WRITE bit BT7 to write to registers
 #define CLKIN 4000000        // ADE7753 frec, 4.000000MHz
 //The cristal associated to the for the ADE7753 the Olimex energy shield is 4.000000 MHz . Therefore 
@@ -191,8 +196,10 @@ determine the source of the interrupt.
 class ADE7753 {
    //public methods
    public:
+      ADE7753(byte csPin = CS);  // one instance per ADE7753 on the SPI bus, each with its own chip select
       void setSPI(void);
       void closeSPI(void);
+      byte getCS(void);
       
       void setMode(int m);
       int  getMode(void);
@@ -200,10 +207,6 @@ class ADE7753 {
       int  getEnabledInterrupts(void);
       int  getInterruptStatus(void);
       int  getresetInterruptStatus(void);
-      
-      void printGetResetInterruptStatus(void);
-      void printGetMode(void);
-      void printAllRegisters(void);
 
       long getActiveEnergyLineSync(void); 
       long getApparentEnergyLineSync(void);
@@ -249,56 +252,51 @@ class ADE7753 {
     // VPKLVL  8-bit (U) - Channel 2 Peak Level Threshold
     // TMODE   8-bit (U) - Test Mode Register
 
- 
-//   //private methods
-//   private:
-      unsigned char read8(char reg);
-      unsigned int read16(char reg);
-      unsigned long read24(char reg);
-      void write16(char reg, unsigned int data);
-      void write8(char reg, unsigned char data);
-      void enableChip(void);  
-      void disableChip(void);
-      long waitInterrupt(unsigned int interrupt);
-};
+#ifdef GRIDDIAG
+      void printGetResetInterruptStatus(void);
+      void printGetMode(void);
+      void printAllRegisters(void);
+      char chkSum(void);
+#endif
 
-#define NanodeReduceCodeSize 1
-#ifndef NanodeReduceCodeSize
-	  
+#ifdef GRIDCALIB
       long getActiveEnergy(void);
       long getActiveEnergyReset(void);
       long getApparentEnergy(void);
       long getApparentEnergyReset(void);
-      char chkSum(void);
       char getCH1Offset(void);
       char getCH2Offset(void);
       char getPhaseCalibration(void);
-      char getEnergyGain(void);
       char getActiveEnergyDivider(void);
       char getApparentEnergyDivider(void);
       char getSagCycles(void);
       char getSagVoltageLevel(void);
       char getIPeakLevel(void);
       char getVPeakLevel(void);
-      
-      int getWattGain(int load);
       int getVoltageOffset(void);
-      int getCurrentOffset(void);     
+      int getCurrentOffset(void);
       int getActivePowerOffset(void);
-      int getPowerOffset(void);
       int getActivePowerGain(void);
+      int getApparentPowerGain(void);
       int getFrequencyDividerNumerator(void);
       int getFrequencyDividerDenominator(void);
       int getZeroCrossingTimeout(void);
-      int getApparentPowerGain(void);
-      int getWattGain();
-      int getLineCyc();
-      
-      // void calibrateEnergyAccurateSource(int Imax, int I, int V, int MeterConstant, long power, int linecyc);
-      // void calibrateEnergy(int CFnominal, int CFexpected);
-      // void calibrateRMSOS(int v1,int v2,int i1,int i2);
-
-//};
+      int getLineCyc(void);
 #endif
 
-#endif
+ 
+//   //private methods
+//   private:
+      unsigned char read8(char reg);
+      unsigned int read16(char reg);
+      unsigned long read24(char reg);
+      void write16(char reg, unsigned int data);
+      void write8(char reg, unsigned char data);
+      void enableChip(void);  
+      void disableChip(void);
+      long waitInterrupt(unsigned int interrupt);
+
+      byte cs;  // chip select pin of this ADE7753
+};
+
+#endif
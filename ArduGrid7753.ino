@@ -15,7 +15,76 @@ V1.0 - Original release
 V1.1 - Reduced SRAM usage with showString, added watchdog timer, added SRAM memory check, randomize network start
 	over 2 seconds to avoid all Nanodes to collide on network access
 	record number of reboots in EEPROM and feed to Pachube, record number of Watchdog timeouts and feed to Pachube 
-V1.2 (soon)- get NTP atomic time, use ATmega328 1024 bytes EEPROM, use Microchip 11AA02E48 2Kbit serial EEPROM (MAC chip),
+V1.2 - SNTP disciplined clock with drift estimation (GridClock), every measurement is time stamped in UTC at CYCEND
+	and the time stamp is sent to Pachube with each datapoint
+	- Upload queue with HTTP status check, response time and retry with exponential backoff (PachubeClient),
+	no more blind delay after sending, no more reboot every 30 mn, only after MAX_UPLOAD_FAILURES consecutive failures
+	- Store and forward buffer in SRAM spilling to EEPROM (OutageBuffer), records are replayed oldest first when
+	the network is back, no more reboot on DHCP failure
+	- Node table in PROGMEM (NodeConfig) giving the feed, label, upload host, offsets and calibration of each
+	Nanode from its full MAC address, replaces the switch statements. The commented out shield #2 settings
+	are kept as a row of the shield table, not assigned to any Nanode
+	- Optional timing counters of the loop phases and of the ADE7753 register reads (GridTrace), dumped on
+	Serial and sent as datastream 17, compiled out by default
+	- Measurement of the line cycle moved to GridMeter, benchmarked on a PC against a simulated ADE7753
+	(host/bench.cpp), the status register is read once instead of twice per poll while waiting for CYCEND
+	- Stack painting at reset and minimum free SRAM ever observed (MemWatch) sent as datastream 18,
+	static SRAM of each module from the build folder with host/memmap.sh
+	- Power save mode for the battery backed sites (GridPower): IDLE sleep between polls, ADE7753 ASUSPEND
+	between measurement cycles, ENC28J60 power save when there is nothing to upload - needs an EtherCard
+	library with powerDown() / powerUp()
+	- ADE7753 bring-up with software reset, RESET flag wait, die revision check and configuration read back
+	(GridMeter::begin), health check before each measurement re-applying a lost configuration in place
+	- Worst case budget for each wait on the ADE7753 (GridWatchdog), the watchdog is fed only while a wait
+	is within its budget, no more wdt_reset() in the timeout branches of the driver. Mains loss is seen
+	with ZXTO after 30 ms (ZXTOUT) and the cycle falls back on peaks and temperature, instead of 2 x 101
+	zero crossing timeouts of 100 ms that could trip the watchdog
+	- Lock free single producer / single consumer queue (SpscQueue) between the measurement and the upload
+	buffer, safe between an ISR and the main loop, stress tested on two threads with host/queuebench.cpp
+	- Optional timer driven acquisition (GridSampler, compiled out by default): Timer2 polls the ADE7753 every
+	1 ms while the loop idles, SPI bytes clocked from the SPI interrupt, cycle results handed through an
+	SpscQueue, ISR latency and missed ticks dumped at each update with and without network traffic
+	- Several ADE7753 per Nanode for the three-phase and multi-circuit boards: chip select pin per driver
+	instance, offsets and calibration per shield row (MeterConfig), line cycle accumulations interleaved
+	and staggered by GridScheduler, datastreams 100-108, 200-208 for the next meters. Requests are no
+	longer held back before the next update, the measurement waits for the answer in flight instead
+	- Three-phase supplies on three ADE7753 (GridPhases): aligned line cycle windows, phase sequence from the
+	zero crossing timing, total P/Q/S, voltage and current imbalance and neutral current in integer math,
+	sent as datastreams 20-26, the Nanode health datastreams go with the first meter only
+	- Optional recording of the ADE7753 register transactions (GridCapture, compiled out by default), dumped
+	on Serial after a cycle without mains or a configuration repair, or a whole session replayed on a PC
+	through the unmodified driver by host/replay.cpp
+	- Load switch events (GridEvents, GRIDEVENTS): short line cycle accumulations between the measurement cycles, steps
+	of P and Q beyond an adaptive noise threshold with inrush settling, in integer math, sent one per request
+	as datastreams 27-29 with the time of the switch, scored on synthetic load profiles by host/bench.cpp
+	- Local HTTP endpoint on port 80 (GridHttp): GET /json or /csv answers the last readings and the health
+	counters from a snapshot kept at each measurement, one TCP packet per meter, without waiting on the
+	ADE7753. Requests per second and latency measured with host/httpload.cpp
+	- Modbus/TCP server on port 502 (GridModbus) for the plant SCADA: function codes 3 and 4 read the last
+	readings, energy totals since reboot and health counters from the same snapshot (GridSnapshot, GRIDSNAPSHOT), on a
+	documented register table. Polls per second and latency measured with host/modbuspoll.cpp
+	- Buffered log with compile time levels (GridLog): a ring sent by the USART TX complete interrupt, the
+	loop drops what does not fit instead of waiting on Serial, messages above LOG_LEVEL compiled out, raw
+	registers of a record on one line in hexadecimal, or as binary frames decoded by host/logdecode.cpp
+	- Optional energy from the CF pulses of the first ADE7753 counted by Timer1 on T1 (GridPulse, compiled
+	out by default): CFNUM/CFDEN set, energy totals of the local servers without the gaps between the
+	cycles, SPI line cycle energy used to cross-check the pulses of each cycle, validated by host/pulsesim.cpp
+	- Optional billing registers (GridBilling, compiled out by default): import and export energy of each
+	tariff of a PROGMEM schedule and maximum demand over 15 minutes, fed by every line cycle accumulation,
+	kept in EEPROM, sent as datastreams 32-36 and read by Modbus, validated by host/billsim.cpp
+	- Optional remote configuration (GridConfig, compiled out by default): offsets, calibration, gains, line
+	cycle count and update period read with GET /config and changed with GET /set, each command signed with
+	an XTEA MAC over a nonce and the MAC address of the node, checked against the register widths, kept in
+	EEPROM and applied between two cycles without a reboot, commands sent by host/gridconf.cpp
+	- Build profiles (GridFeatures.h) instead of the NanodeReduceCodeSize switch that could never be turned
+	off: field, lean, billing, commissioning and debug, each feature also selectable on its own. Register
+	dumps (GRIDDIAG) and calibration getters (GRIDCALIB) of the driver back, local servers, load events,
+	register capture and three-phase figures left out of every profile so that each leaves room for the stack,
+	flash and SRAM of each profile reported by host/profiles.sh
+	- Report by exception (GridDeadband, GRIDDEADBAND): each datastream is sent only when it moves beyond its
+	deadband or after its heartbeat, rules per datastream in a PROGMEM table, a record with nothing left is not sent.
+	Values sent and left out as datastreams 30 and 31, upload saving measured by host/deadbandsim.cpp
+V1.2 (soon)- use ATmega328 1024 bytes EEPROM, use Microchip 11AA02E48 2Kbit serial EEPROM (MAC chip),
 V1.3 (soon)- Averaging, 1mn/1h/24h/30days
 
 
@@ -124,8 +193,9 @@ master. This allows you to have multiple SPI devices sharing the same MISO, MOSI
 Sag Voltage Level (SAGLVL), Channel 1 Current Peak Level Threshold (IPKLVL) and Channel 2 Peak Voltage 
 Level Threshold (VPKLVL) are not used because the IRQ signal is not wired to wakeup the CPU.
 
-Pin CF frequency output is not used for energy measurement or for calibration, therefore complete 
-calibration via the ADE7753 internal registers is not necessary. For sake of simplicity, we only use the
+Pin CF frequency output is not used for calibration, therefore complete 
+calibration via the ADE7753 internal registers is not necessary. With GRIDPULSE, the CF pulses of the
+first ADE7753 are counted by Timer1 for the energy totals (see GridPulse.h). For sake of simplicity, we only use the
 internal registers for offset compensation. Calibration are done directly in the code.
 
 The cristal associated to the for the ADE7753 the Olimex energy shield is 4.000000 MHz . Therefore 
@@ -217,7 +287,8 @@ meter.energySetup(0, 0, 0, 0, 0, 0x0D); // WGAIN,WDIV,APOS,VAGAIN,VADIV,PHCAL  -
 	PHCAL  - Phase Calibration Register       -  6-bit (S) [0x1D  0x21] only valid content of this twos compliment register 
 																		0x0D gives zero phase delay
 
-meter.frequencySetup(0, 0);             // CFNUM,CFDEN  12-bit (U) -- for CF pulse output  -- Refer to spec page 31
+meter.frequencySetup(0, 15);            // CFNUM,CFDEN  12-bit (U) -- for CF pulse output  -- Refer to spec page 31
+	one CF pulse per (CFDEN+1)/(CFNUM+1) LSB of the active energy, DISCF clear in MODE for the pulses to come out
 
 meter.miscSetup(0, 0, 0, 0, 0, 0);
 	ZXTOUT  - Zero-Crossing Timeout          - 12-bit (U) [0 +4096]
@@ -325,6 +396,14 @@ So you first need to include the library at the top your sketch.
 */
 #include <avr/pgmspace.h>
 
+// Build profile of this Nanode, ie. the optional features compiled in (see GridFeatures.h)
+#include "GridFeatures.h"
+
+// The types used in function parameters must be known before the first line of code, where the
+// Arduino IDE inserts the function prototypes it generates
+#include "GridRecord.h"
+#include "NodeConfig.h"
+
 /* EEPROM
 Read and write bytes from/to EEPROM. EEPROM size: 1024 bytes on the ATmega328
 An EEPROM write takes 3.3 ms to complete. The EEPROM memory has a specified life of 100,000 write/erase 
@@ -350,7 +429,38 @@ void EEPROMClass::write(int address, uint8_t value)
 }
 EEPROMClass EEPROM;
 
+/* EEPROM map
+   0         Number of reboots
+   1         Number of watchdog timeouts
+   16-151    Billing registers, two copies of 68 bytes (GridBilling.h, only with GRIDBILLING)
+   152-247   Remote configuration, two copies of 48 bytes (GridConfig.h, only with GRIDCONFIG)
+   256-996   Store and forward ring of measurement records (OutageBuffer.h)
+*/
+
+/* SRAM map - 2048 bytes, see host/memmap.sh for the exact static allocation of each module
+   Ethernet::buffer             700
+   OutageBuffer                 198  (4 records in SRAM + the record being uploaded)
+   SpscQueue measured           80   (2 records handed from the measurement to the upload, buffered one by one)
+   GridMeter x SCHED_METERS     120  (state and results of the cycle of each ADE7753)
+   GridPhases                   87   (only with GRIDPHASES, three-phase figures of the last cycle)
+   GridEvents                   226  (only with GRIDEVENTS, load step detection of each meter, 4 events waiting)
+   GridDeadband                 126  (only with GRIDDEADBAND, last value sent and its time for each datastream, 3 bytes each)
+   GridSnapshot                 192  (only with GRIDSNAPSHOT, last readings, totals and health for the local servers)
+   GridHttp, GridModbus         22   (only with GRIDHTTP, GRIDMODBUS, state of the local servers)
+   GridCapture                  256  (only with GRIDCAPTURE, 40 transaction events, see GridCapture.h)
+   GridTrace                    200  (only with GRIDTRACE, min, max and mean of each phase and counter)
+   Serial buffers               ~130 (core, not measured)
+   GridLog                      152  (ring of the log sent by the TX complete interrupt, see GridLog.h)
+   GridPulse                    25   (only with GRIDPULSE, CF count and cross-check, and 4 per GridMeter)
+   GridBilling                  169  (only with GRIDBILLING, tariff registers and demand window)
+   GridConfig                   139  (only with GRIDCONFIG, rows of the shield table of each meter in SRAM)
+   Others (EtherCard, clock...) ~150 (libraries not measured)
+   Heap and stack               the rest - minimum ever free sent as datastream 18 (MemWatch.h)
+*/
+
 #include <avr/wdt.h> // Watchdog timer
+#include "MemWatch.h"
+MemWatch memWatch;  // minimum free SRAM since reset
 
 // ==================================
 // -- Ethernet/Pachube section
@@ -358,6 +468,11 @@ EEPROMClass EEPROM;
 
 #include <EtherCard.h>  // get latest version from https://github.com/jcw/ethercard
 // EtherShield uses the enc28j60 IC (not the WIZnet W5100 which requires a different library)
+#include "GridClock.h"
+#include "PachubeClient.h"
+#include "OutageBuffer.h"
+#include "GridTrace.h"
+#include "GridLog.h"
 
 #include <NanodeUNIO.h>   // get latest version from https://github.com/sde1000/NanodeUNIO 
 // All Nanodes have a Microchip 11AA02E48 serial EEPROM chip
@@ -383,6 +498,10 @@ boolean bMac; // Success or Failure upon function return
 /* //#define APIKEY  "fqJn9Y0oPQu3rJb46l_Le5GYxJQ1SSLo1ByeEG-eccE"  // MercinatLabs FreeRoom Pachube key for anyone to test this code */
 
 #define REQUEST_RATE 10000 // in milliseconds - Pachube update rate
+#define STREAM_METER 100   // datastream IDs of the measurements of meter m: m * STREAM_METER + 0 to 8, and 27 to 29 for its load events
+#define NTP_SERVER "pool.ntp.org" // SNTP server, may be a local stand-in on the LAN
+#define NTP_SYNC_RATE 60   // number of Pachube updates between SNTP synchronisations (10 mn)
+#define MAX_UPLOAD_FAILURES 20 // consecutive failed uploads before rebooting (more than 1 hour with the backoff)
 unsigned long lastupdate = 0;  // timer value when last Pachube update was done
 uint32_t timer = 0;            // a local timer
 unsigned long PachubeResponseTime = 0; // Time between send to and response from Pachube
@@ -391,7 +510,12 @@ unsigned long pingtimer;   // ping timer
 byte Ethernet::buffer[700];
 Stash stash;     // For filling/controlling EtherCard send buffer using satndard "print" instructions
 
-int MyNanode = 0;
+byte ntpip[4];           // IP of the SNTP server found by DNS
+GridClock gridClock;     // SNTP disciplined UTC clock for time stamping the measurements
+PachubeClient uploader;  // upload of the records, with HTTP status check and retries
+OutageBuffer outage;     // records waiting for upload, in SRAM then EEPROM during network outages
+boolean networkUp = true; // false while DHCP has failed, records are then only buffered
+boolean etherAwake = true; // false while the ENC28J60 is in power save mode (POWER_SAVE)
 
 // -------------------------------
 // END -- Ethernet/Pachube section
@@ -405,11 +529,141 @@ int MyNanode = 0;
 #include <Arduino.h>
 #include "SPI.h"
 #include "ADE7753.h"
+#include "GridMeter.h"
+#include "GridScheduler.h"
+#include "GridPhases.h"
+#include "GridPower.h"
+#include "GridWatchdog.h"
+#include "SpscQueue.h"
+#include "GridSampler.h"
+#include "GridCapture.h"
+#include "GridEvents.h"
+#include "GridDeadband.h"
+#include "GridSnapshot.h"
+#ifdef GRIDHTTP
+#include "GridHttp.h"
+#endif
+#ifdef GRIDMODBUS
+#include "GridModbus.h"
+#endif
+#include "GridPulse.h"
+#include "GridBilling.h"
+#include "GridConfig.h"
+
+GridMeter gridMeters[SCHED_METERS];  // line cycle measurement of each ADE7753, also compiled on the PC by host/bench.cpp
+GridScheduler scheduler;  // round robin acquisition of the ADE7753 of this Nanode
+unsigned int meterRepairs[SCHED_METERS]; // ADE7753 configuration repairs already reported
+#ifdef GRIDPHASES
+GridPhases phases;    // three-phase figures when the meters are the phases of one supply
+boolean threePhase = false; // node wired WIRING_3PHASE with 3 meters
+#endif
+GridPower power;      // duty cycled operation on the battery backed sites
+SpscQueue<GridRecord, 2> measured;  // records of the measurement cycles waiting to be buffered for upload, see bufferMeasured()
+#ifdef GRIDEVENTS
+GridEvents loadEvents; // appliances switched on and off between the measurement cycles
+boolean eventSent = false; // the request in flight carries the oldest load event
+#endif
+#ifdef GRIDDEADBAND
+GridDeadband deadband; // datastreams sent only when they move, or on their heartbeat
+#endif
+#ifdef GRIDSNAPSHOT
+GridSnapshot snapshot; // last readings and health counters, for the local servers
+#endif
+#ifdef GRIDHTTP
+GridHttp gridHttp;     // ... served to the dashboards of the LAN
+#endif
+#ifdef GRIDMODBUS
+GridModbus gridModbus; // ... and to the plant SCADA
+#endif
+#ifdef GRIDCONFIG
+MeterConfig liveShields[SCHED_METERS]; // rows of the shield table of this Nanode, with the changes of GET /set
+#endif
+
+// Calibration of each Olimex Energy Shield: see the shield table below
 
 // ----------------------------
 // END -- Energy Shield Section
 // ----------------------------
 
+
+// ===========================
+// -- Node configuration section
+// ===========================
+
+// One row per Olimex Energy Shield design (see NodeConfig.h), a board with several ADE7753 takes
+// consecutive rows, one per chip select pin
+const MeterConfig shields[] PROGMEM = {
+//	  CS  CH1OS CH2OS IRMSOS VRMSOS  calVrms   calIrms   calVpeak calIpeak  calTemp calActive calApparent calReactive
+	{ CS, -3,   -5,   -2000, +2000,  12498.65, 167623.8, 141.0,   234565.0,  1.0,    34.8,     30.4,       0.60 }, // 0 - Energy shield #1 - ETEL
+	{ CS, -6,   -1,   -2000, -2048,  12225.0,  169192.0, 138.39,  233518.20, 1.0,    67.28,    58.57,      1.40 }  // 1 - Energy shield #2, not assigned yet: Grid RMS #2 runs with shield #1
+//	{ 9,  -3,   -5,   -2000, +2000,  12498.65, 167623.8, 141.0,   234565.0,  1.0,    34.8,     30.4,       0.60 }, // 2 - second ADE7753 of a board starting at row 0 with 2 meters
+};
+
+// One row per Nanode, found by the MAC address read from the 11AA02E48 - the table stays in flash (see NodeConfig.h)
+// Nanodes 1-3 and 6-9 stream other sensors but may be flashed with this sketch for testing, they then
+// stream to the ArduGrid Free Room with the calibration of shield #1
+// Aurora and Skystream are on battery backed remote sites and run duty cycled (POWER_SAVE)
+const NodeConfig nodes[] PROGMEM = {
+//	  MAC                                   n  feed     label                   host               power         shield meters wiring
+	{ {0x00,0x04,0xA3,0x2C,0x2B,0xD6}, 1, "40447", "Aurora",               "api.pachube.com", POWER_SAVE,   0,     1,     WIRING_CIRCUITS },
+	{ {0x00,0x04,0xA3,0x2C,0x30,0xC2}, 2, "40447", "FemtoGrid",            "api.pachube.com", POWER_NORMAL, 0,     1,     WIRING_CIRCUITS },
+	{ {0x00,0x04,0xA3,0x2C,0x1D,0xEA}, 3, "40447", "Skystream",            "api.pachube.com", POWER_SAVE,   0,     1,     WIRING_CIRCUITS },
+	{ {0x00,0x04,0xA3,0x2C,0x1C,0xAC}, 4, "40385", "Grid RMS #1",          "api.pachube.com", POWER_NORMAL, 0,     1,     WIRING_CIRCUITS },
+	{ {0x00,0x04,0xA3,0x2C,0x10,0x8E}, 5, "40386", "Grid RMS #2",          "api.pachube.com", POWER_NORMAL, 0,     1,     WIRING_CIRCUITS },
+	{ {0x00,0x04,0xA3,0x2C,0x28,0xFA}, 6, "40447", "Etel 6 m",             "api.pachube.com", POWER_NORMAL, 0,     1,     WIRING_CIRCUITS },
+	{ {0x00,0x04,0xA3,0x2C,0x26,0xAF}, 7, "40447", "Etel 18 m",            "api.pachube.com", POWER_NORMAL, 0,     1,     WIRING_CIRCUITS },
+	{ {0x00,0x04,0xA3,0x2C,0x13,0xF4}, 8, "40447", "Etel 12 m",            "api.pachube.com", POWER_NORMAL, 0,     1,     WIRING_CIRCUITS },
+	{ {0x00,0x04,0xA3,0x2C,0x2F,0xC4}, 9, "40447", "Etel 9 m",             "api.pachube.com", POWER_NORMAL, 0,     1,     WIRING_CIRCUITS },
+	{ {0x00,0x00,0x00,0x00,0x00,0x00}, 0, "40447", "ArduGrid Free Room",   "api.pachube.com", POWER_NORMAL, 0,     1,     WIRING_CIRCUITS }  // unknown board - must be last
+};
+#define NODE_COUNT ( sizeof(nodes) / sizeof(nodes[0]) )
+
+const NodeConfig *node;  // row of this Nanode in flash, read with pgm_read_*()
+
+#ifdef GRIDDEADBAND
+// Deadband and heartbeat of each datastream (see GridDeadband.h), one row per datastream ID from 0:
+// the measurements of every meter, then the health of the Nanode
+const DeadbandRule deadbands[] PROGMEM = {
+//	  band    heartbeat
+	{ 0.5,    300 },   // 0  - Vrms in V
+	{ 0.05,   300 },   // 1  - Irms in A
+	{ 2.0,    300 },   // 2  - Vpeak
+	{ 0.1,    300 },   // 3  - Ipeak
+	{ 5.0,    300 },   // 4  - Active energy
+	{ 5.0,    300 },   // 5  - Apparent energy
+	{ 5.0,    300 },   // 6  - Reactive energy
+	{ 1.5,    900 },   // 7  - Temperature, a change of 2 degrees
+	{ 0.05,   300 },   // 8  - Frequency in Hz
+	{ 0,      3600 },  // 9  - SNTP offset, changes at each synchronisation only
+	{ -1,     0 },     // 10 - Nanode health, every update: the Nanode is alive
+	{ 0,      3600 },  // 11 - Reboots
+	{ 0,      3600 },  // 12 - Watchdog timeouts
+	{ 100,    600 },   // 13 - Pachube response time in ms
+	{ 0,      600 },   // 14 - Records waiting for upload
+	{ 30,     600 },   // 15 - Age in s of the oldest record waiting
+	{ 0,      3600 },  // 16 - Records dropped
+	{ 0,      900 },   // 17 - Time in the traced phases in ms (GRIDTRACE)
+	{ 0,      3600 },  // 18 - Minimum free SRAM
+	{ 5,      900 }    // 19 - CPU awake in %
+};
+#endif
+
+#ifdef GRIDBILLING
+// Tariff schedule of the billing registers, in local standard time (see GridBilling.h), each day
+// needs a slot at 00:00
+const TariffSlot tariffs[] PROGMEM = {
+//	  days           start    tariff
+	{ BILL_WEEKDAYS, 0,       0 },  // off-peak
+	{ BILL_WEEKDAYS, 6 * 60,  1 },  // peak 06:00-22:00
+	{ BILL_WEEKDAYS, 22 * 60, 0 },
+	{ BILL_WEEKEND,  0,       2 }   // week-end
+};
+#endif
+
+// ----------------------------
+// END -- Node configuration section
+// ----------------------------
+
 unsigned long TimeStampSinceLastReboot;
 
 // Watchdog timer variables
@@ -425,13 +679,15 @@ void setup(){
 
 	ENC28J60 etherchip; // Instantiate class ENC28J60 to "chip"
 	ADE7753 meter;      // Instantiate class ADE7753 to "meter"
+	byte meterStatus;
+	byte meters;        // ADE7753 on this Nanode
 
 	/* We always need to make sure the WDT is disabled immediately after a 
 	* reset, otherwise it will continue to operate with default values.
 	*/
 	wdt_disable();
 
-	Serial.begin(115200);
+	gridLog.begin(115200); // waits for room until the end of setup(), see GridLog.h
 	delay( random(0,2000) ); // delay startup to avoid all Nanodes to collide on network access after a general power-up
 	// and during Pachube updates								
 	// WatchdogSetup();// setup Watch Dog Timer to 8 sec
@@ -439,11 +695,30 @@ void setup(){
 	pinMode(6, OUTPUT);
 	for (int i=0; i < 10; i++) { digitalWrite(6,!digitalRead(6)); delay (50);} // blink LED 6 a bit to greet us after reboot
 
-	showString(PSTR("\n\nArduGrid7753 V1.1 - MercinatLabs (14 Jan 2012)\n"));
-	showString(PSTR("[SRAM available   ] = ")); Serial.println(freeRam());
-	showString(PSTR("[Number of Reboots] = ")); Serial.println(EEPROM.read(0));
-	showString(PSTR("[Watchdog Timeouts] = ")); Serial.println(EEPROM.read(1));
+	LOG_INFO(
+		showString(PSTR("\n\nArduGrid7753 V1.1 - MercinatLabs (14 Jan 2012)\n"));
+		showString(PSTR("[SRAM available   ] = ")); gridLog.println(freeRam());
+		showString(PSTR("[SRAM static      ] = ")); gridLog.println(memWatch.getStatic());
+		showString(PSTR("[Number of Reboots] = ")); gridLog.println(EEPROM.read(0));
+		showString(PSTR("[Watchdog Timeouts] = ")); gridLog.println(EEPROM.read(1))
+	);
 	EEPROM.write(0, EEPROM.read(0)+1 ); // Increment EEPROM for each reboot
+	outage.begin(); // find the records left in EEPROM before reboot
+	LOG_INFO(showString(PSTR("[Buffered records ] = ")); gridLog.println(outage.getDepth()));
+
+	GetMac(); // get MAC adress from the Microchip 11AA02E48 located at the back of the Nanode board
+
+	// Identify which sensor is assigned to this board, its Pachube feed and its calibration
+	node = findNode(macaddr);
+	LOG_INFO(
+		showString(PSTR("n")); gridLog.print(pgm_read_byte(&node->nanode));
+		showString(PSTR(" f")); showString(node->feed);
+		showString(PSTR(" - ")); showString(node->label);
+		if ( pgm_read_byte(&node->nanode) == 0 ) showString(PSTR(" (unknown Nanode)"));
+		showString(PSTR("\n"))
+	);
+	power.begin(pgm_read_byte(&node->power));
+	if ( power.getMode() == POWER_SAVE ) LOG_INFO(showString(PSTR("Power save mode\n")));
 
 	// ===========================
 	// -- Energy Shield section
@@ -451,6 +726,7 @@ void setup(){
 
 	meter.setSPI();  // Initialise SPI communication ADE7753 IC
 	//
+	//// With GRIDCALIB (see GridFeatures.h):
 	//// Use this function for identifying optimum CH1OS and CH2OS settings - both inputs 1 & 2 are shorted to ground
 	//// Note: think of disabling High Pass Filter when doing DC offset input calibration
 	//  meter.setSPI();  // Initialise SPI communication ADE7753 IC
@@ -464,28 +740,86 @@ void setup(){
 	//  meter.setMode( CYCMODE + DISHPF ); // set mode for Line Cycle Accumulation
 	//  TestRMSoffset();
 	//
-	//// Use if you want to test writing to the registers and to display the content of the registers
+	//// With GRIDDIAG: use if you want to test writing to the registers and to display the content of the registers
 	//  TestRegisters ();
 	//
 
-	// Settings for Olimex Energy Shield #1 - Etel
+	// Settings of the Olimex Energy Shields wired to this Nanode, written after a software
+	// reset and read back (see GridMeter.h)
 	// ------------------------------------
-	meter.analogSetup(GAIN_4, GAIN_2, -3, -5, FULLSCALESELECT_0_5V, INTEGRATOR_OFF);  // GAIN1, GAIN2, CH1OS, CH2OS, Range_ch1, integrator_ch1
-	meter.rmsSetup( -2000, +2000 );                 // IRMSOS,VRMSOS  12-bit (S) [-2048 +2048] -- Refer to spec page 25, 26 
-	meter.energySetup(0, 0, 0, 0, 0, 0x0D); // WGAIN,WDIV,APOS,VAGAIN,VADIV,PHCAL  -- Refer to spec page 39, 31, 46, 44, 52, 53
-	meter.frequencySetup(0, 0);             // CFNUM,CFDEN  12-bit (U) -- for CF pulse output  -- Refer to spec page 31
-	meter.miscSetup(0, 0, 0, 0, 0, 0);
-
-	//// Settings for Olimex Energy Shield #2
-	//// ------------------------------------
-	//  meter.analogSetup(GAIN_4, GAIN_2, -6, -1, FULLSCALESELECT_0_5V, INTEGRATOR_OFF);  // GAIN1, GAIN2, CH1OS, CH2OS, Range_ch1, integrator_ch1
-	//  meter.rmsSetup( -2000, -2048 );                 // IRMSOS,VRMSOS  12-bit (S) [-2048 +2048] -- Refer to spec page 25, 26 
-	//  meter.energySetup(0, 0, 0, 0, 0, 0x0D); // WGAIN,WDIV,APOS,VAGAIN,VADIV,PHCAL  -- Refer to spec page 39, 31, 46, 44, 52, 53
-	//  meter.frequencySetup(0, 0);             // CFNUM,CFDEN  12-bit (U) -- for CF pulse output  -- Refer to spec page 31
-	//  meter.miscSetup(0, 0, 0, 0, 0, 0);
-	//          
+	meters = pgm_read_byte(&node->meters);
+	if ( meters > SCHED_METERS ) meters = SCHED_METERS;
+#ifdef GRIDSAMPLER
+	meters = 1; // the sampler drives the ADE7753 on CS (10) only
+#endif
+#ifdef GRIDCONFIG
+	gridConfig.begin(&shields[pgm_read_byte(&node->shield)], liveShields, meters, REQUEST_RATE, macaddr);
+	if ( gridConfig.isRestored() ) LOG_INFO(printConfig());
+#endif
+#ifdef GRIDCAPTURE
+	gridCapture.begin(gridLog); // from the bring-up on
+#endif
+	for (byte i = 0; i < meters; i++)
+	{
+		meterStatus = gridMeters[i].begin(shieldOf(i)); // CS, CH1OS, CH2OS, IRMSOS, VRMSOS
+		if ( meterStatus == METER_OK ) LOG_INFO(printMeter(i, PSTR(" configured\n")));
+		else if ( meterStatus == METER_NO_RESET ) LOG_WARN(printMeter(i, PSTR(" no RESET flag\n")));
+		else if ( meterStatus == METER_NO_CHIP ) LOG_ERROR(printMeter(i, PSTR(" not answering\n")));
+		else LOG_WARN(printMeter(i, PSTR(" configuration not read back\n"))); // check() retries before each cycle
+#ifdef GRIDDIAG
+		ADE7753 registers(CONFIG_BYTE(&shieldOf(i)->cs)); // what the bring-up left in the registers, for the commissioning
+		LOG_INFO(registers.printAllRegisters());
+#endif
+	}
+	scheduler.begin(gridMeters, meters);
+#ifdef GRIDSNAPSHOT
+	snapshot.begin(meters);
+#endif
+#ifdef GRIDHTTP
+	gridHttp.begin(&snapshot);
+#endif
+#ifdef GRIDMODBUS
+	gridModbus.begin(&snapshot);
+#endif
+#ifdef GRIDPULSE
+	gridPulse.begin(); // CF of meter PULSE_METER on T1
+#ifdef GRIDSNAPSHOT
+	if ( power.getMode() != POWER_SAVE ) snapshot.setCounted(PULSE_METER); // no pulse while the A/D converters are suspended
+#endif
+	LOG_INFO(showString(PSTR("CF pulses counted on T1\n")));
+#endif
+#ifdef GRIDBILLING
+	gridBilling.begin(gridMeters, meters, tariffs, sizeof(tariffs) / sizeof(tariffs[0]));
+	LOG_INFO(showString(gridBilling.isRestored() ? PSTR("Billing registers restored\n") : PSTR("Billing registers cleared\n")));
+#endif
+#ifdef GRIDPHASES
+	if ( pgm_read_byte(&node->wiring) == WIRING_3PHASE && meters == PHASES )
+	{
+		threePhase = true;
+		scheduler.setStagger(0); // aligned windows, the phases are measured over the same line cycles
+		phases.begin(gridMeters);
+		LOG_INFO(showString(PSTR("Three-phase supply\n")));
+	}
+#else
+	if ( pgm_read_byte(&node->wiring) == WIRING_3PHASE ) LOG_WARN(showString(PSTR("Three-phase supply needs GRIDPHASES\n")));
+#endif
+#ifdef GRIDEVENTS
+	byte watched = ( power.getMode() == POWER_SAVE ) ? 0 : meters; // not with the A/D converters suspended
+#ifdef GRIDSAMPLER
+	watched = 0; // the sampler owns the status register between the cycles
+#endif
+	loadEvents.begin(gridMeters, watched);
+	for (byte i = 0; i < watched; i++) gridMeters[i].watch(EVENT_LINECYC);
+#endif
+#ifdef GRIDDEADBAND
+	deadband.begin(deadbands, sizeof(deadbands) / sizeof(deadbands[0]));
+#endif
 
 	meter.closeSPI();  // Close SPI communication with ADE7753 IC
+#ifdef GRIDSAMPLER
+	gridSampler.begin();
+	LOG_INFO(showString(PSTR("Timer driven acquisition\n")));
+#endif
 
 	// ----------------------------
 	// END -- Energy Shield Section
@@ -496,35 +830,23 @@ void setup(){
 	// -- Ethernet/Pachube section
 	// ==================================
 
-	GetMac(); // get MAC adress from the Microchip 11AA02E48 located at the back of the Nanode board
-
-	// Identify which sensor is assigned to this board
-	// If you have boards with identical MAC last 2 values, you will have to adjust your code accordingly
-	switch ( macaddr[5] )
-	{
-	case 0xFA: MyNanode = 6;  showString(PSTR("n6 ")); showString(PSTR("f38277 - ")); showString(PSTR("Etel 6 m\n")) ; break; 
-	case 0xC4: MyNanode = 9;  showString(PSTR("n9 ")); showString(PSTR("f38278 - ")); showString(PSTR("Etel 9 m\n")) ; break;
-	case 0xF4: MyNanode = 8;  showString(PSTR("n8 ")); showString(PSTR("f38279 - ")); showString(PSTR("Etel 12 m\n")); break;
-	case 0xAF: MyNanode = 7;  showString(PSTR("n7 ")); showString(PSTR("f38281 - ")); showString(PSTR("Etel 18 m\n")); break;
-	case 0xD6: MyNanode = 1;  showString(PSTR("n1 ")); showString(PSTR("f37667 - ")); showString(PSTR("Aurora\n"))   ; break;
-	case 0xC2: MyNanode = 2;  showString(PSTR("n2 ")); showString(PSTR("f37668 - ")); showString(PSTR("FemtoGrid\n")); break;
-	case 0xEA: MyNanode = 3;  showString(PSTR("n3 ")); showString(PSTR("f35020 - ")); showString(PSTR("Skystream\n")); break;
-	case 0xAC: MyNanode = 4;  showString(PSTR("n4 ")); showString(PSTR("f40385 - ")); showString(PSTR("Grid RMS #1\n")); break;
-	case 0x8E: MyNanode = 5;  showString(PSTR("n5 ")); showString(PSTR("f40386 - ")); showString(PSTR("Grid RMS #2\n")); break;
-	default:  
-		showString(PSTR("unknown Nanode\n\r"));
-		// assigned to NanodeKit free room - https://pachube.com/feeds/40451
-		showString(PSTR("nx ")); showString(PSTR("f40451 - ")); showString(PSTR("NanoKit Free Room\r\n")); break; 
-	}
-
 	// Ethernet/Internet setup
-	while (ether.begin(sizeof Ethernet::buffer, macaddr) == 0) { showString(PSTR( "Failed to access Ethernet controller\n")); }
-	while (!ether.dhcpSetup()) { showString(PSTR("DHCP failed\n")); }
-	ether.printIp("IP:  ", ether.myip);
-	ether.printIp("GW:  ", ether.gwip);  
-	ether.printIp("DNS: ", ether.dnsip); 
-	while (!ether.dnsLookup(PSTR("api.pachube.com"))) { showString(PSTR("DNS failed\n")); }
-	ether.printIp("SRV: ", ether.hisip);  // IP for Pachupe API found by DNS service
+	while (ether.begin(sizeof Ethernet::buffer, macaddr) == 0) { LOG_ERROR(showString(PSTR( "Failed to access Ethernet controller\n"))); }
+	while (!ether.dhcpSetup()) { LOG_ERROR(showString(PSTR("DHCP failed\n"))); }
+	LOG_INFO(
+		printIp(PSTR("IP:  "), ether.myip);
+		printIp(PSTR("GW:  "), ether.gwip);
+		printIp(PSTR("DNS: "), ether.dnsip)
+	);
+	while (!ether.dnsLookup(PSTR(NTP_SERVER))) { LOG_ERROR(showString(PSTR("DNS failed\n"))); }
+	memcpy(ntpip, ether.hisip, 4); // dnsLookup() always answers in hisip
+	LOG_INFO(printIp(PSTR("NTP: "), ntpip));
+	while (!ether.dnsLookup(node->host)) { LOG_ERROR(showString(PSTR("DNS failed\n"))); }
+	LOG_INFO(printIp(PSTR("SRV: "), ether.hisip));  // IP for Pachupe API found by DNS service
+
+	gridClock.begin();
+	for (int i=0; i < 5 && !gridClock.sync(ntpip); i++) { LOG_WARN(showString(PSTR("SNTP failed\n"))); }
+	LOG_INFO(printClock());
 
 	meter.closeSPI();  // Close SPI communication with ADE7753 IC
 
@@ -534,6 +856,7 @@ void setup(){
 
 	WatchdogSetup();// setup Watch Dog Timer to 8 sec
 	wdt_reset();
+	logWait(false); // from now on the log never holds the loop
 
 }
 
@@ -551,65 +874,163 @@ void loop() {
 
 	ENC28J60 etherchip; // Instantiate class ENC28J60 to "chip"
 	ADE7753 meter;      // Instantiate class ADE7753 to "meter"
-	int j = 0;  
-
-	float Vrms 	= 0;
-	float Irms   = 0;
-	float Vpeak  = 0;
-	float Ipeak  = 0;
-	int Temp 	  	= 0;
-	float Frequency = 0;
-	float ActiveEnergy 		= 0;
-	float ApparentEnergy 	= 0;
-	float ReactiveEnergy 	= 0;
-
-	// Energy shield #1 - ETEL
-	float calVrms 	  = 12498.65;
-	float calIrms 	  = 167623.8;
-	float calVpeak 	  = 141.0;
-	float calIpeak 	  = 234565.0;
-	float calTemp 	  = 1.0;
-	float calActiveEnergy 	= 34.8;
-	float calApparentEnergy = 30.4;
-	float calReactiveEnergy = 0.60;
-
-	//	// Energy shield #2
-	//	float calVrms 	  = 12225.0;
-	//	float calIrms 	  = 169192.0;
-	//	float calVpeak 	  = 138.39;
-	//	float calIpeak 	  = 233518.20;
-	//	float calTemp 	  = 1;
-	//	float calActiveEnergy 	= 67.28;
-	//	float calApparentEnergy = 58.57;
-	//	float calReactiveEnergy = 1.40;
-
-	unsigned long lastupdate2 = 0;  // timer value for Energy Shield timeout
-
-	Serial.println("-> main loop"); 
+	unsigned int j = 0;  
+
+	GridRecord rec;                 // raw measurements of this cycle with their UTC time stamp
+
+	LOG_INFO(showString(PSTR("-> main loop\n")));
 	etherchip.initSPI();
+	uploader.begin(&outage);
+	BUS_LOCK(); // the SPI bus is only left to the sampler while the loop idles (GridSampler.h)
 
-	while ( j < 180 )  // As Pachube feeds may hang at times, reboot regularly. We will monitor stability then remove reboot when OK
-	// a value of 180 with an update to Pachube every 10 seconds provoque a reboot every 30 mn. Reboot is very fast.
+	while ( uploader.getFailures() < MAX_UPLOAD_FAILURES )  // Pachube feeds may hang at times, reboot only when it has not answered for a long time
 	{
 
-		//	Serial.println("-> receiving"); 
+		//	gridLog.println("-> receiving"); 
 		wdt_reset();
-		ether.packetLoop(ether.packetReceive());  // check response from Pachube
-		delay(100);
-		showString(PSTR("."));
+		word plen = 0, request = 0, poll = 0; // offsets of a GET request and of a Modbus poll in the Ethernet buffer
+		if ( etherAwake )
+		{
+			plen = ether.packetReceive();
+			request = ether.packetLoop(plen);  // check response from Pachube
+#ifdef GRIDMODBUS
+			poll = ether.accept(MODBUS_PORT, plen);
+#endif
+		}
+		if ( uploader.poll() ) printUpload();      // must follow packetLoop(), the answer is in the Ethernet buffer
+#ifdef GRIDHTTP
+		if ( request != 0 ) serveHttp(request);    // after poll(), the answer overwrites the Ethernet buffer
+#endif
+#ifdef GRIDMODBUS
+		if ( poll != 0 ) serveModbus(poll, plen);
+#endif
+#ifdef GRIDBILLING
+		tickBilling(); // tariff switches and demand window
+#endif
+#if defined(GRIDEVENTS) && !defined(GRIDSAMPLER)
+		// Load switch events, from the short line cycle windows between the measurement cycles
+		if ( loadEvents.due() )
+		{
+			long p, q;
+			meter.closeSPI();
+			gridMeters[0].open();
+			for (byte i = 0; i < scheduler.getCount(); i++)
+			{
+				if ( ! gridMeters[i].pollWindow(p, q) ) continue;
+#ifdef GRIDBILLING
+				gridBilling.add(i, p, EVENT_LINECYC, gridMeters[i].getSigns(), millis());
+#endif
+#ifdef GRIDPULSE
+				if ( i == PULSE_METER ) gridPulse.add(p, EVENT_LINECYC, gridMeters[i].getSigns(), 0, millis()); // import and export of the pulses
+#endif
+				if ( loadEvents.add(i, p, q, EVENT_LINECYC, millis()) ) LOG_INFO(printLoadEvent());
+			}
+			gridMeters[0].close();
+			etherchip.initSPI();
+		}
+#endif
+#ifdef GRIDSAMPLER
+		// End of a line cycle accumulation sampled by the timer, read the peaks and the temperature
+		gridSampler.setTraffic(uploader.busy());
+		if ( gridSampler.cycles.peek() != 0 )
+		{
+			CycleSample *cycle = gridSampler.cycles.peek();
+			unsigned long cycleEnd = cycle->at;
+			stampRecord(rec, cycleEnd); // back to the end of the accumulation window
+			rec.meter = 0;
+			rec.vrms = cycle->vrms;
+			rec.irms = cycle->irms;
+			rec.activeEnergy = cycle->activeEnergy;
+			rec.apparentEnergy = cycle->apparentEnergy;
+			rec.reactiveEnergy = cycle->reactiveEnergy;
+			rec.period = cycle->period;
+			if ( ! cycle->mains ) LOG_WARN(showString(PSTR("--> no mains - peaks and temperature only\n")));
+			LOG_DEBUG(showString(PSTR("--> sampled zero crossings ")); gridLog.println(cycle->zx));
+			gridSampler.cycles.pop();
+			meter.closeSPI();
+			gridMeters[0].open();
+			gridMeters[0].readPeaks(rec);
+			if ( power.getMode() == POWER_SAVE ) gridMeters[0].suspend(); // A/D converters off until the next cycle
+			gridMeters[0].close();
+			etherchip.initSPI();
+			LOG_DEBUG(gridLog.record(rec));
+#ifdef GRIDSNAPSHOT
+			snapshot.update(rec, shieldOf(rec.meter), cycleEnd);
+#endif
+#if defined(GRIDPULSE) && defined(GRIDSNAPSHOT)
+			if ( rec.meter == PULSE_METER && power.getMode() != POWER_SAVE )
+			{   // the sampler does not keep PPOS and PNEG, the cycles share out the pulses
+				float imported, exported;
+				if ( cycle->mains ) gridPulse.add(rec.activeEnergy, METER_LINECYC, 0, 0, cycleEnd);
+				gridPulse.take(rec, shieldOf(PULSE_METER), imported, exported);
+				snapshot.addEnergy(PULSE_METER, imported);
+				snapshot.addEnergy(PULSE_METER, -exported);
+			}
+#endif
+#ifdef GRIDBILLING
+			if ( cycle->mains ) gridBilling.add(rec.meter, rec.activeEnergy, METER_LINECYC, 0, cycleEnd); // the sampler does not keep PPOS and PNEG
+#endif
+			if ( ! measured.push(rec) ) LOG_ERROR(showString(PSTR("--> measurement queue full, record dropped\n")));
+			bufferMeasured();
+		}
+#endif
+		bufferMeasured(); // the Pachube requests are built from the buffer
+		// Replay is throttled by the uploader. Requests go on all along the update period, one
+		// record per meter: the measurement cycle waits for the answer of the request in flight
+		if ( networkUp && uploader.ready() )
+		{
+			networkPower(true);
+			sendRecord(*outage.peek(), j);
+		}
+		else if ( power.getMode() == POWER_SAVE && ! uploader.busy() )
+		{
+			networkPower(false); // nothing to send or to wait for until the next update
+		}
+		if ( ! uploader.busy() ) 
+		{
+			BUS_UNLOCK();
+			power.idle(100);
+			BUS_LOCK();
+			LOG_DEBUG(showString(PSTR(".")));
+		}
 		
-		if ( ( millis()-lastupdate ) > REQUEST_RATE )
+		if ( ( millis()-lastupdate ) > updatePeriod() && ! uploader.busy() ) // at most PACHUBE_TIMEOUT late
 		{
 			lastupdate = millis();
 			timer = lastupdate;
 			j++;
+			power.endCycle();
+			networkPower(true);
+#ifdef GRIDSNAPSHOT
+			setSnapshotHealth(j);
+#endif
+#ifdef GRIDTRACE
+			gridTrace.endCycle();
+			if ( ( j % TRACE_DUMP_RATE ) == 0 )
+			{
+				logWait(true);
+				gridTrace.print(gridLog);
+				logWait(false);
+			}
+#endif
+#ifdef GRIDSAMPLER
+			logWait(true);
+			gridSampler.print(gridLog);
+			logWait(false);
+#endif
 
-			showString(PSTR("\n************************************************************************************************\n"));    
-			showString(PSTR("\nStarting Pachube update loop --- "));
-			showString(PSTR("[memCheck bytes] ")); Serial.print(freeRam());
-			showString(PSTR(" -- [Reboot Time Stamp] "));
-			Serial.println( millis() - TimeStampSinceLastReboot );
-			showString(PSTR("-> Check response from Pachube\n"));
+			LOG_DEBUG(showString(PSTR("\n************************************************************************************************\n")));
+			LOG_INFO(
+				showString(PSTR("\n-> update - free ")); gridLog.print(freeRam());
+				showString(PSTR(", min ")); gridLog.print(memWatch.getLowWater());
+				showString(PSTR(" - up ")); gridLog.print(millis() - TimeStampSinceLastReboot);
+				showString(PSTR(" ms\n"));
+				gridLog.next(); // each line under LOG_LINE, see GridLog.h
+				showString(PSTR("-> log dropped ")); gridLog.print(gridLog.getDropped());
+				showString(PSTR(" - over budget ")); gridLog.print(gridWatchdog.getOverruns());
+				if ( gridWatchdog.getOverruns() != 0 ) { showString(PSTR(" last step ")); gridLog.print(gridWatchdog.getLastOverrun()); }
+				gridLog.println()
+			);
 			
 			// DHCP expiration is a bit brutal, because all other ethernet activity and
 			// incoming packets will be ignored until a new lease has been acquired
@@ -619,65 +1040,75 @@ void loop() {
 			//   showString(PSTR("is fine\n")); 
 
 
-			// ping server 
-			ether.printIp("-> Pinging: ", ether.hisip);
-			pingtimer = micros();
-			ether.clientIcmpRequest(ether.hisip);
-			if ( ( ether.packetReceive() > 0 ) && ether.packetLoopIcmpCheckReply(ether.hisip) ) 
-			{
-				showString(PSTR("-> ping OK = "));
-				Serial.print((micros() - pingtimer) * 0.001, 3);
-				showString(PSTR(" ms\n"));
-			} 
-			else 
+			// ping server - not while waiting for Pachube, the ping would swallow its answer
+			if ( networkUp && ! uploader.busy() )
 			{
-				showString(PSTR("-> ping KO = "));
-				Serial.print((micros() - pingtimer) * 0.001, 3);
-				showString(PSTR(" ms\n"));
+				LOG_DEBUG(printIp(PSTR("-> Pinging: "), ether.hisip));
+				pingtimer = micros();
+				ether.clientIcmpRequest(ether.hisip);
+				if ( ( ether.packetReceive() > 0 ) && ether.packetLoopIcmpCheckReply(ether.hisip) ) 
+				{
+					LOG_INFO(showString(PSTR("-> ping OK = ")); gridLog.print(micros() - pingtimer); showString(PSTR(" us\n")));
+				} 
+				else 
+				{
+					LOG_WARN(showString(PSTR("-> ping KO = ")); gridLog.print(micros() - pingtimer); showString(PSTR(" us\n")));
+				}
 			}
 			
 			// DHCP expiration is a bit brutal, because all other ethernet activity and
 			// incoming packets will be ignored until a new lease has been acquired
+			// The measurements go on and are buffered until a lease is obtained
 			wdt_reset();
-			if ( ether.dhcpExpired() && !ether.dhcpSetup() )
-			{ 
-				showString(PSTR("DHCP failed\n"));
-				delay (200); // delay to let the serial port buffer some time to send the message before rebooting
-				software_Reset() ;  // Reboot so can a new lease can be obtained
+			TRACE_BEGIN(TRACE_DHCP);
+			if ( ! networkUp || ether.dhcpExpired() )
+			{
+				networkUp = ether.dhcpSetup();
+				if ( ! networkUp ) LOG_WARN(showString(PSTR("DHCP failed - buffering\n")));
 			}
+			TRACE_END(TRACE_DHCP);
 
+			// Discipline the clock - the ENC28J60 SPI is still active here
+			if ( ( ( j % NTP_SYNC_RATE ) == 0 ) && networkUp && ! uploader.busy() )
+			{
+				if ( gridClock.sync(ntpip) ) LOG_INFO(printClock());
+				else LOG_WARN(showString(PSTR("-> SNTP failed\n")));
+			}
 
-
+			if ( power.getMode() == POWER_SAVE ) networkPower(false); // not needed during the measurement
 			meter.closeSPI();  // Close SPI communication with ADE7753 IC
 			
 			// ==================================
 			// -- Energy Shield section
 			// ==================================
-			Serial.println("\n-> measurement cycle");
-			meter.setSPI();  // Initialise SPI communication ADE7753 IC
-			meter.setMode( CYCMODE ); // set mode for Line Cycle Accumulation
-			meter.setLineCyc(200);    // set Line Cycle to 200 * 10 ms = 2 sec (at 50Hz, half line cycle = 10 ms)
-			meter.setInterruptsMask(0xFF); // enable all interrupts (useless as only affects IRQ signal, has no effect in status register when using poll mode)
-			// >>> Warning <<< The flag bits in the status register are set irrespective of the state of the enable bits.
-			// Therefore as IRQ signal is not wired, we have to poll the status register for a selected interrupt with its bit mask
-			meter.getresetInterruptStatus(); // Clear all interrupts
-
-
-			lastupdate2 = millis();
-			while( ! ( 
-			( meter.getInterruptStatus() & CYCEND ) // wait for end of accumulation cycle
-			|| 
-			( meter.getInterruptStatus() & ZXTO )  // fall through if missing zero crossing (i.e. no grid input)
-			)
-			)
-			{   // wait for the selected interrupt to occur or timeout
-				if ( ( millis() - lastupdate2 ) > 2500)
-				{ 
-					Serial.println("--> Timeout"); 
-					meter.getresetInterruptStatus(); // Clear all interrupts
-					break;  
-				} 
-			}  
+			LOG_DEBUG(showString(PSTR("\n-> measurement cycle\n")));
+			boolean anomaly = false; // the transactions that led to it are dumped with GRIDCAPTURE
+#ifdef GRIDCONFIG
+			if ( gridConfig.apply() )
+			{   // the changes of GET /set since the previous cycle, the load event windows in progress are dropped by the cycle
+				for (byte i = 0; i < scheduler.getCount(); i++)
+					if ( gridMeters[i].reconfigure() != METER_OK ) LOG_WARN(printMeter(i, PSTR(" configuration not read back\n")));
+#ifdef GRIDEVENTS
+				loadEvents.calibrate();
+#endif
+				LOG_INFO(printConfig());
+			}
+#endif
+			for (byte i = 0; i < scheduler.getCount(); i++)
+			{
+				if ( gridMeters[i].check() != METER_OK ) LOG_ERROR(showString(PSTR("--> ADE7753 configuration lost\n")));
+				else if ( gridMeters[i].getRepairs() != meterRepairs[i] ) LOG_WARN(showString(PSTR("--> ADE7753 configuration re-applied\n")));
+				if ( gridMeters[i].getRepairs() != meterRepairs[i] ) anomaly = true;
+				meterRepairs[i] = gridMeters[i].getRepairs();
+			}
+#ifdef GRIDSAMPLER
+			gridSampler.stop(); // the previous cycle has ended long ago, unless the sampler missed it
+			gridMeters[0].startCycle(); // Line Cycle Accumulation of METER_LINECYC half line cycles (fixed with the sampler)
+			gridSampler.start(); // the record is built at the top of the loop when the cycle has ended
+			gridMeters[0].close();  // Close SPI communication with ADE7753 IC
+			etherchip.initSPI();
+#else
+			scheduler.run(); // Line Cycle Accumulations of GridMeter::getLineCyc() half line cycles, one per ADE7753
 
 			////  // Do it again to discard first set of data because the first line cycle accumulation results 
 			////  // may not have used the accumulation time set by the LINECYC register and should be discarded.
@@ -693,56 +1124,85 @@ void loop() {
 			////          {   // wait for the selected interrupt to occur or timeout
 			////              if ( ( millis() - lastupdate ) > 5500) 
 			////               { 
-			////                 Serial.println("\n>>> Timeout no AC input"); 
+			////                 gridLog.println("\n>>> Timeout no AC input"); 
 			////                 meter.getresetInterruptStatus(); // Clear all interrupts
 			////                 break;  
 			////               } 
 			////          } 
 
-			Vrms 	  = meter.vrms() ;
-			Irms 	  = meter.irms() ;
-			Vpeak 	  = meter.getVpeakReset() ;
-			Ipeak 	  = meter.getIpeakReset() ;
-			Temp 	  = meter.getTemp();
-			Frequency = float(CLKIN/4) / float(meter.getPeriod());
-			ActiveEnergy 	= meter.getActiveEnergyLineSync()  ;
-			ApparentEnergy 	= meter.getApparentEnergyLineSync()  ;
-			ReactiveEnergy 	= meter.getReactiveEnergyLineSync()  ;
-
-
-			Serial.println("--> before calibration"); 
-			Serial.print(" VRMS_100: ");  Serial.println( Vrms,DEC );
-			Serial.print(" IRMS_100: ");  Serial.println( Irms,DEC );
-			Serial.print(" Vpeak   : ");  Serial.println( Vpeak,DEC );
-			Serial.print(" Ipeak   : ");  Serial.println( Ipeak,DEC );
-			Serial.print(" Freq (Hz): "); Serial.println( Frequency, DEC );
-			Serial.print(" Temp: ");      Serial.println( meter.getTemp(), DEC );
-			Serial.print(" ActiveEnergy  : ");      Serial.println( ActiveEnergy, DEC );
-			Serial.print(" ApparentEnergy: ");      Serial.println( ApparentEnergy, DEC );
-			Serial.print(" ReactiveEnergy: ");      Serial.println( ReactiveEnergy, DEC );
-
-			Vrms 	  = Vrms / calVrms ;
-			Irms 	  = Irms / calIrms ;
-			Vpeak 	  = Vpeak / calVpeak ;
-			Ipeak 	  = Ipeak / calIpeak ;
-			Temp 	  = Temp / calTemp ;
-			Frequency = float(CLKIN/4) / float(meter.getPeriod());
-			ActiveEnergy 	= ActiveEnergy / calActiveEnergy ;
-			ApparentEnergy 	= ApparentEnergy / calApparentEnergy ;
-			ReactiveEnergy 	= ReactiveEnergy / calReactiveEnergy ;
-			//
-			Serial.println("--> after calibration"); 
-			Serial.print(" VRMS_100: ");  Serial.println( Vrms,DEC );
-			Serial.print(" IRMS_100: ");  Serial.println( Irms,DEC );
-			Serial.print(" Vpeak   : ");  Serial.println( Vpeak,DEC );
-			Serial.print(" Ipeak   : ");  Serial.println( Ipeak,DEC );
-			Serial.print(" Freq (Hz): "); Serial.println( Frequency, DEC );
-			Serial.print(" Temp: ");      Serial.println( meter.getTemp(), DEC );
-			Serial.print(" ActiveEnergy  : ");      Serial.println( ActiveEnergy, DEC );
-			Serial.print(" ApparentEnergy: ");      Serial.println( ApparentEnergy, DEC );
-			Serial.print(" ReactiveEnergy: ");      Serial.println( ReactiveEnergy, DEC );
-			
-			meter.closeSPI();  // Close SPI communication with ADE7753 IC
+			for (byte i = 0; i < scheduler.getCount(); i++)
+			{
+				scheduler.read(i, rec);
+				stampRecord(rec, gridMeters[i].getCycleEnd()); // time stamp the end of the line cycle accumulation window
+				if ( ! gridMeters[i].hasMains() )
+				{
+					LOG_WARN(showString(PSTR("--> no mains - peaks and temperature only\n")));
+					anomaly = true;
+				}
+
+				LOG_DEBUG(gridLog.record(rec));
+#ifdef GRIDSNAPSHOT
+				snapshot.update(rec, shieldOf(rec.meter), gridMeters[i].getCycleEnd());
+#endif
+#ifdef GRIDPULSE
+				if ( i == PULSE_METER )
+				{   // the SPI energy of the cycle checks the pulses counted over it
+					if ( gridMeters[i].hasMains() ) gridPulse.add(rec.activeEnergy, METER_LINECYC, gridMeters[i].getSigns(), gridMeters[i].getCyclePulses(), gridMeters[i].getCycleEnd());
+					if ( gridMeters[i].hasMains() && ! gridPulse.check(rec, gridMeters[i].getCyclePulses(), gridMeters[i].getSigns()) )
+					{
+						LOG_WARN(printPulses(gridMeters[i].getCyclePulses()));
+						anomaly = true;
+					}
+#ifdef GRIDSNAPSHOT
+					if ( power.getMode() != POWER_SAVE )
+					{
+						float imported, exported;
+						gridPulse.take(rec, shieldOf(i), imported, exported);
+						snapshot.addEnergy(i, imported);
+						snapshot.addEnergy(i, -exported);
+					}
+#endif
+				}
+#endif
+#ifdef GRIDBILLING
+				if ( gridMeters[i].hasMains() ) gridBilling.add(i, rec.activeEnergy, METER_LINECYC, gridMeters[i].getSigns(), gridMeters[i].getCycleEnd());
+#endif
+
+				// Hand the record to the upload side, it is sent from the top of the loop
+				if ( ! measured.push(rec) ) LOG_ERROR(showString(PSTR("--> measurement queue full, record dropped\n")));
+				bufferMeasured(); // one record per meter would not fit in the queue
+#ifdef GRIDPHASES
+				if ( threePhase ) phases.add(rec);
+#endif
+#ifdef GRIDEVENTS
+				// the cycle bridges the windows of the load events
+				if ( gridMeters[i].hasMains() && loadEvents.add(i, rec.activeEnergy, rec.reactiveEnergy, METER_LINECYC, gridMeters[i].getCycleEnd()) ) LOG_INFO(printLoadEvent());
+#endif
+			}
+#ifdef GRIDPHASES
+			if ( threePhase )
+			{
+				phases.detectSequence(rec.period); // from the zero crossings, the SPI is still open
+				phases.compute();
+				LOG_INFO(printPhases());
+			}
+#endif
+			for (byte i = 0; i < scheduler.getCount(); i++)
+			{   // after the phase sequence, which needs the zero crossings
+				if ( power.getMode() == POWER_SAVE ) gridMeters[i].suspend(); // A/D converters off until the next cycle
+#ifdef GRIDEVENTS
+				else gridMeters[i].watch(EVENT_LINECYC); // load events until the next cycle
+#endif
+			}
+			gridMeters[0].close();  // Close SPI communication with ADE7753 IC
+#ifdef GRIDCAPTURE
+			if ( anomaly )
+			{   // ring mode: the last transactions, for host/replay.cpp -d
+				logWait(true);
+				gridCapture.dump();
+				logWait(false);
+			}
+#endif
 			
 			// ----------------------------
 			// END -- Energy Shield Section
@@ -754,108 +1214,7 @@ void loop() {
 			// ==================================
 
 			etherchip.initSPI();
-
-			
-			// DHCP expiration is a bit brutal, because all other ethernet activity and
-			// incoming packets will be ignored until a new lease has been acquired
-			showString(PSTR("-> DHCP? ")); 
-			wdt_reset();
-			if ( ether.dhcpExpired() && !ether.dhcpSetup() )
-			{ 
-				showString(PSTR("DHCP failed\n"));
-				delay (200); // delay to let the serial port buffer some time to send the message before rebooting
-				software_Reset() ;  // Reboot so can a new lease can be obtained
-			}
-			showString(PSTR("is fine\n")); 
-
-
-
-			// Prepare string to send to Pachube
-			// *********************************
-
-			byte sd = stash.create();  // Initialise send data buffer
-			
-			stash.print("0,"); // Datastream 0
-			stash.println( Vrms );
-
-			stash.print("1,"); // Datastream 1
-			stash.println( Irms );
-
-			stash.print("2,"); // Datastream 2
-			stash.println( Vpeak );
-
-			stash.print("3,"); // Datastream 3
-			stash.println( Ipeak );
-
-			stash.print("4,");
-			stash.println( ActiveEnergy );
-
-			stash.print("5,");
-			stash.println( ApparentEnergy );
-
-			stash.print("6,");
-			stash.println( ReactiveEnergy );
-
-			stash.print("7,");
-			stash.println( Temp );
-
-			stash.print("8,");
-			stash.println( Frequency );
-
-			//   stash.print("9,");
-			//   stash.println(  );
-
-			stash.print("10,"); // Datastream 10 - Nanode Health
-			stash.println( j );
-			
-			stash.print("11,");  // Datastream 11 - Nbr of REBOOTs
-			stash.println( EEPROM.read(0) );
-			
-			stash.print("12,");  // Datastream 12 - Nbr of WATCHDOG TIMEOUTs
-			stash.println( EEPROM.read(1)  );
-			
-			stash.save(); // Close streaming send data buffer
-
-			// Select the destination feed according to what the Nanode board is assigned to    
-			switch ( MyNanode )
-			{
-			case 4: // Grid RMS #1
-				Stash::prepare(PSTR("PUT http://$F/v2/feeds/$F.csv HTTP/1.0" "\r\n"
-				"Host: $F" "\r\n"
-				"X-PachubeApiKey: $F" "\r\n"
-				"Content-Length: $D" "\r\n"
-				"\r\n"
-				"$H"),
-				PSTR("api.pachube.com"), PSTR("40385"), PSTR("api.pachube.com"), PSTR(APIKEY), stash.size(), sd);
-				break;
-				
-			case 5: // Grid RMS #2
-				Stash::prepare(PSTR("PUT http://$F/v2/feeds/$F.csv HTTP/1.0" "\r\n"
-				"Host: $F" "\r\n"
-				"X-PachubeApiKey: $F" "\r\n"
-				"Content-Length: $D" "\r\n"
-				"\r\n"
-				"$H"),
-				PSTR("api.pachube.com"), PSTR("40386"), PSTR("api.pachube.com"), PSTR(APIKEY), stash.size(), sd);
-				break;
-				
-			default: // ArduGrid Free Room on Pachube -- https://pachube.com/feeds/40447
-				Stash::prepare(PSTR("PUT http://$F/v2/feeds/$F.csv HTTP/1.0" "\r\n"
-				"Host: $F" "\r\n"
-				"X-PachubeApiKey: $F" "\r\n"
-				"Content-Length: $D" "\r\n"
-				"\r\n"
-				"$H"),
-				PSTR("api.pachube.com"), PSTR("40447"), PSTR("api.pachube.com"), PSTR(APIKEY), stash.size(), sd);
-				break;
-			}
-			
-			// send the packet - this also releases all stash buffers once done
-			showString(PSTR("-> sending\n"));
-			ether.tcpSend();
-			showString(PSTR("-> done sending\n"));
-			delay (1000);
-			//    meter.closeSPI();  // Close SPI communication with ADE7753 IC
+#endif
 
 			// blink LED 6 a bit to show some activity on the board when sending to Pachube       
 			for (int i=0; i < 4; i++) { digitalWrite(6,!digitalRead(6)); delay (50);} 
@@ -865,13 +1224,19 @@ void loop() {
 		// END -- Ethernet/Pachube section
 		// -------------------------------
 
-	} // This is the end of the WHILE ( j < 180 ) loop
+	} // This is the end of the WHILE ( uploader.getFailures() < MAX_UPLOAD_FAILURES ) loop
+	BUS_UNLOCK();
 
 	// ==================================
 	// -- This is the end of the main loop
 	// ====================================
-	// reboot now to clean all dirty buffers to avoid Pachube feed hanging.
-	showString(PSTR("-- rebooting --\n")); delay (250); 
+	// Pachube has not answered for a long time, reboot now to clean all dirty buffers.
+	outage.flush(); // keep the records waiting for upload in EEPROM
+#ifdef GRIDBILLING
+	gridBilling.save();
+#endif
+	LOG_ERROR(showString(PSTR("-- rebooting --\n")));
+	gridLog.flush();
 	software_Reset() ;
 
 } // -- END of main loop
@@ -883,9 +1248,7 @@ void loop() {
 ---------------------------------
 */
 
-#define NanodeReduceCodeSize 1
-#ifndef NanodeReduceCodeSize
-
+#ifdef GRIDDIAG
 // Register R/W testing
 // --------------------
 void TestRegisters (void) {
@@ -899,7 +1262,7 @@ void TestRegisters (void) {
 	showString(PSTR("-- after Status Read-Reset \n"));
 	meter.printGetResetInterruptStatus(); // should be all zeros now
 
-	Serial.println("===");
+	showString(PSTR("===\n"));
 	meter.printGetMode();
 
 	meter.setMode( CYCMODE + TEMPSEL ); // set mode for Line Cycle Accumulation + Temperature reading
@@ -911,9 +1274,12 @@ void TestRegisters (void) {
 	meter.frequencySetup(2005,2006);
 	meter.miscSetup(2000, 101, 102, 103, 104, 105);
 	meter.energySetup(-2000, 200, -30000, -2001, 201, 0x21);
-	Serial.println("---");  
+	showString(PSTR("---\n"));
 	meter.printAllRegisters();
 }
+#endif
+
+#ifdef GRIDCALIB
 
 // Test CH1OS and CH2OS offsets
 // ----------------------------
@@ -933,7 +1299,7 @@ void TestInputOffset (void) {
 	{      
 		meter.analogSetup(GAIN_1, GAIN_1, char (i), char (i), FULLSCALESELECT_0_5V, INTEGRATOR_OFF);  // GAIN1, GAIN2, CH1OS, CH2OS, Range_ch1, integrator_ch1
 		
-		Serial.println(i);
+		gridLog.println(i);
 		
 		showString(PSTR("-> TestInputOffset\n"));
 		Current = meter.read24(IRMS);
@@ -946,12 +1312,10 @@ void TestInputOffset (void) {
 		}
 
 		showString(PSTR("Averaged getIRMS: "));
-		Serial.print(Current/1000,DEC);
-		Serial.println("");
+		gridLog.println(Current/1000,DEC);
 		
 		showString(PSTR("Averaged getVRMS: "));
-		Serial.print(Voltage/1000,DEC);
-		Serial.println("");
+		gridLog.println(Voltage/1000,DEC);
 	} 
 }
 
@@ -987,31 +1351,31 @@ void TestRMSoffset (void) {
 	}
 
 	showString(PSTR("Averaged getIRMS: "));
-	Serial.print(Current/10000,DEC);
-	Serial.println("");
+	gridLog.println(Current/10000,DEC);
 	
 	showString(PSTR("Averaged getVRMS: "));
-	Serial.print(Voltage/10000,DEC);
-	Serial.println("");
+	gridLog.println(Voltage/10000,DEC);
 	
 	showString(PSTR("getIRMS: "));
-	Serial.print(meter.getIRMS(),DEC); // rms measurement update rate is CLKIN/4.
-	Serial.println("");
+	gridLog.println(meter.getIRMS(),DEC); // rms measurement update rate is CLKIN/4.
 	
 	showString(PSTR("getVRMS: "));
-	Serial.print(meter.getVRMS(),DEC);  // rms measurement update rate is CLKIN/4.
-	Serial.println("");
+	gridLog.println(meter.getVRMS(),DEC);  // rms measurement update rate is CLKIN/4.
 	
 	showString(PSTR("IRMS_100: "));
-	Serial.print(meter.irms(),DEC);
-	Serial.println("");
+	gridLog.println(meter.irms(),DEC);
 	
 	showString(PSTR("VRMS_100: "));
-	Serial.print(meter.vrms(),DEC);
-	Serial.println("");
+	gridLog.println(meter.vrms(),DEC);
 	
-	showString(PSTR(("---\n")); 
+	showString(PSTR("IRMSOS, VRMSOS: "));
+	gridLog.print(meter.getCurrentOffset(),DEC);
+	showString(PSTR(", "));
+	gridLog.println(meter.getVoltageOffset(),DEC);
+#ifdef GRIDDIAG
+	showString(PSTR("---\n"));
 	meter.printAllRegisters();
+#endif
 }
 
 #endif
@@ -1027,21 +1391,504 @@ int freeRam () {
 	return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval); 
 }
 
+// Calibrate a record and send it to the Pachube feed of this Nanode
+// j is the Nanode health counter, ie. the number of updates since reboot
+void sendRecord(GridRecord &rec, unsigned int j)
+{
+	const MeterConfig *shield = shieldOf(rec.meter); // calibration of the ADE7753 the record was taken on
+	TRACE_BEGIN(TRACE_STASH);
+	float Vrms 	  = rec.vrms / CONFIG_FLOAT(&shield->calVrms) ;
+	float Irms 	  = rec.irms / CONFIG_FLOAT(&shield->calIrms) ;
+	float Vpeak 	  = rec.vpeak / CONFIG_FLOAT(&shield->calVpeak) ;
+	float Ipeak 	  = rec.ipeak / CONFIG_FLOAT(&shield->calIpeak) ;
+	int   Temp 	  = rec.temp / CONFIG_FLOAT(&shield->calTemp) ;
+	float Frequency = float(CLKIN/4) / float(rec.period);
+	float ActiveEnergy 	= rec.activeEnergy / CONFIG_FLOAT(&shield->calActiveEnergy) ;
+	float ApparentEnergy 	= rec.apparentEnergy / CONFIG_FLOAT(&shield->calApparentEnergy) ;
+	float ReactiveEnergy 	= rec.reactiveEnergy / CONFIG_FLOAT(&shield->calReactiveEnergy) ;
+
+	LOG_DEBUG(
+		showString(PSTR("--> calibrated ")); gridLog.print(rec.meter);
+		showString(PSTR(" V ")); gridLog.print(Vrms);
+		showString(PSTR(" I ")); gridLog.print(Irms);
+		showString(PSTR(" Vp ")); gridLog.print(Vpeak);
+		showString(PSTR(" Ip ")); gridLog.println(Ipeak);
+		gridLog.next();
+		showString(PSTR("--> calibrated ")); gridLog.print(rec.meter);
+		showString(PSTR(" P ")); gridLog.print(ActiveEnergy);
+		showString(PSTR(" S ")); gridLog.print(ApparentEnergy);
+		showString(PSTR(" Q ")); gridLog.print(ReactiveEnergy);
+		showString(PSTR(" Hz ")); gridLog.print(Frequency);
+		showString(PSTR(" T ")); gridLog.println(Temp)
+	);
+
+	// Prepare string to send to Pachube
+	// *********************************
+
+	byte sd = stash.create();  // Initialise send data buffer
+
+	// each value goes only if it moved beyond its deadband, or after its heartbeat (see GridDeadband.h)
+	if ( stashChanged(0, rec, Vrms) ) stash.println( Vrms ); // Datastream 0 - 100, 200 for the next meters
+
+	if ( stashChanged(1, rec, Irms) ) stash.println( Irms ); // Datastream 1
+
+	if ( stashChanged(2, rec, Vpeak) ) stash.println( Vpeak ); // Datastream 2
+
+	if ( stashChanged(3, rec, Ipeak) ) stash.println( Ipeak ); // Datastream 3
+
+	if ( stashChanged(4, rec, ActiveEnergy) ) stash.println( ActiveEnergy );
+
+	if ( stashChanged(5, rec, ApparentEnergy) ) stash.println( ApparentEnergy );
+
+	if ( stashChanged(6, rec, ReactiveEnergy) ) stash.println( ReactiveEnergy );
+
+	if ( stashChanged(7, rec, Temp) ) stash.println( Temp );
+
+	if ( stashChanged(8, rec, Frequency) ) stash.println( Frequency );
+
+	if ( rec.meter == 0 )
+	{   // the health of the Nanode goes once per update, with the first meter
+		stashHealth(9, gridClock.getOffset());     // Datastream 9 - SNTP offset in ms at the last synchronisation
+		stashHealth(10, j);                        // Datastream 10 - Nanode Health
+		stashHealth(11, EEPROM.read(0));           // Datastream 11 - Nbr of REBOOTs
+		stashHealth(12, EEPROM.read(1));           // Datastream 12 - Nbr of WATCHDOG TIMEOUTs
+		stashHealth(13, PachubeResponseTime);      // Datastream 13 - Pachube response time in ms for the previous update
+		stashHealth(14, outage.getDepth());        // Datastream 14 - Nbr of records waiting for upload
+		stashHealth(15, oldestAge());              // Datastream 15 - Age in s of the oldest record waiting for upload
+		stashHealth(16, outage.getDropped());      // Datastream 16 - Nbr of records dropped since reboot
+		stashHealth(18, memWatch.getLowWater());   // Datastream 18 - Minimum free SRAM in bytes since reboot
+		stashHealth(19, power.getDuty());          // Datastream 19 - CPU awake in % during the last update period (100 unless POWER_SAVE)
+#ifdef GRIDTRACE
+		stashHealth(17, gridTrace.getCycleTime() / 1000); // Datastream 17 - Time in ms spent in the traced phases during the last update
+#endif
+#ifdef GRIDDEADBAND
+		stash.print(F("30,"));  // Datastream 30 - Nbr of values sent since reboot
+		stash.println( deadband.getSent() );
+
+		stash.print(F("31,"));  // Datastream 31 - Nbr of values left out by their deadband since reboot
+		stash.println( deadband.getSuppressed() );
+#endif
+#ifdef GRIDBILLING
+		// the registers of the current tariff: those of the others do not move until it comes back
+		byte t = gridBilling.getTariff();
+		const BillRegisters *b = gridBilling.getRegisters();
+		stash.print(F("32,"));  // Datastream 32 - Current tariff [0 BILL_TARIFFS-1]
+		stash.println( t );
+
+		stash.print(F("33,"));  // Datastream 33 - Imported energy of the tariff, in the unit of datastream 4 times hours
+		stash.println( b->importWh[t] );
+
+		stash.print(F("34,"));  // Datastream 34 - Exported energy of the tariff, in the unit of datastream 4 times hours
+		stash.println( b->exportWh[t] );
+
+		stash.print(F("35,"));  // Datastream 35 - Maximum demand over 15 minutes of the tariff, in the unit of datastream 4
+		stash.println( b->maxDemand[t] );
+
+		stash.print(F("36,"));  // Datastream 36 - Demand of the last 15 minutes, in the unit of datastream 4
+		stash.println( gridBilling.getDemand() );
+#endif
+	}
+
+#ifdef GRIDPHASES
+	if ( threePhase && rec.meter == PHASES - 1 )
+	{   // the three-phase figures of the last cycle, with the last phase - see GridPhases.h
+		stash.print(F("20,"));  // Datastream 20 - Total active energy, in the unit of datastream 4
+		stash.println( phases.getActive() );
+
+		stash.print(F("21,"));  // Datastream 21 - Total reactive energy, in the unit of datastream 6
+		stash.println( phases.getReactive() );
+
+		stash.print(F("22,"));  // Datastream 22 - Sum of the apparent energies, in the unit of datastream 5
+		stash.println( phases.getApparent() );
+
+		stash.print(F("23,"));  // Datastream 23 - Voltage imbalance in %
+		stash.println( phases.getVoltageImbalance() * 0.1, 1 );
+
+		stash.print(F("24,"));  // Datastream 24 - Current imbalance in %
+		stash.println( phases.getCurrentImbalance() * 0.1, 1 );
+
+		stash.print(F("25,"));  // Datastream 25 - Neutral current in A
+		stash.println( phases.getNeutral() * 0.01, 2 );
+
+		stash.print(F("26,"));  // Datastream 26 - Phase sequence, 1 ABC, 2 ACB, 0 unknown
+		stash.println( phases.getSequence() );
+	}
+#endif
+
+#ifdef GRIDEVENTS
+	LoadEvent *event = loadEvents.peek();
+	eventSent = ( event != 0 );
+	if ( eventSent )
+	{   // the oldest load event, one per request, time stamped at the switch - see GridEvents.h
+		GridRecord at;
+		unsigned int eid = event->meter * STREAM_METER;
+		stampRecord(at, event->at);
+		stashDatastream(eid + 27, at); // Datastream 27 - Step of active energy, in the unit of datastream 4
+		stash.println( event->active );
+
+		stashDatastream(eid + 28, at); // Datastream 28 - Step of reactive energy, in the unit of datastream 6
+		stash.println( event->reactive );
+
+		stashDatastream(eid + 29, at); // Datastream 29 - Settling time of the load in ms
+		stash.println( event->settle );
+	}
+#endif
+	
+	stash.save(); // Close streaming send data buffer
+#ifdef GRIDDEADBAND
+	if ( stash.size() == 0 )
+	{   // every value within its deadband, no request
+		stash.release();
+		uploader.skip();
+		TRACE_END(TRACE_STASH);
+		LOG_DEBUG(showString(PSTR("-> nothing to send\n")));
+		return;
+	}
+#endif
+
+	// Send to the feed this Nanode board is assigned to
+	Stash::prepare(PSTR("PUT http://$F/v2/feeds/$F.csv HTTP/1.0" "\r\n"
+	"Host: $F" "\r\n"
+	"X-PachubeApiKey: $F" "\r\n"
+	"Content-Length: $D" "\r\n"
+	"\r\n"
+	"$H"),
+	node->host, node->feed, node->host, PSTR(APIKEY), stash.size(), sd);
+	
+	// send the packet - this also releases all stash buffers once done
+	TRACE_END(TRACE_STASH);
+	LOG_DEBUG(showString(PSTR("-> sending\n")));
+	TRACE_BEGIN(TRACE_SEND);
+	uploader.sent(ether.tcpSend()); // the answer is checked by uploader.poll()
+	TRACE_END(TRACE_SEND);
+}
+
+#ifdef GRIDHTTP
+// Answer a GET request of the LAN from the last readings, one TCP packet per part (see GridHttp.h)
+void serveHttp(word request)
+{
+	gridHttp.open((const char *)Ethernet::buffer + request); // before the answer overwrites the request
+	ether.httpServerReplyAck();
+	do
+	{
+		byte *payload = ether.tcpOffset();
+		word len = gridHttp.fill(payload, Ethernet::buffer + sizeof Ethernet::buffer - payload);
+		ether.httpServerReply_with_flags(len, TCP_FLAGS_ACK_V | ( gridHttp.more() ? 0 : TCP_FLAGS_FIN_V ));
+	} while ( gridHttp.more() );
+}
+#endif
+
+#ifdef GRIDMODBUS
+// Answer a Modbus/TCP poll of the SCADA from the last readings, in one TCP packet without
+// closing the connection (see GridModbus.h)
+void serveModbus(word poll, word plen)
+{
+	byte *payload = ether.tcpOffset();
+	word len = gridModbus.reply(Ethernet::buffer + poll, plen - poll, payload, Ethernet::buffer + sizeof Ethernet::buffer - payload);
+	if ( len == 0 ) return; // not a Modbus/TCP frame
+	ether.httpServerReplyAck();
+	ether.httpServerReply_with_flags(len, TCP_FLAGS_ACK_V | TCP_FLAGS_PUSH_V);
+}
+#endif
+
+#ifdef GRIDSNAPSHOT
+// Health counters of the local servers, as sent to datastreams 10-18
+// j is the Nanode health counter, ie. the number of updates since reboot
+void setSnapshotHealth(unsigned int j)
+{
+	snapshot.setHealth(SNAP_UPDATES, j);
+	snapshot.setHealth(SNAP_REBOOTS, EEPROM.read(0));
+	snapshot.setHealth(SNAP_TIMEOUTS, EEPROM.read(1));
+	snapshot.setHealth(SNAP_RESPONSE, PachubeResponseTime);
+	snapshot.setHealth(SNAP_BUFFERED, outage.getDepth());
+	snapshot.setHealth(SNAP_DROPPED, outage.getDropped());
+	snapshot.setHealth(SNAP_FREE, memWatch.getLowWater());
+}
+#endif
+
+// Switch the ENC28J60 in or out of power save mode, with the SPI set for the ENC28J60
+void networkPower(boolean on)
+{
+	if ( on == etherAwake ) return;
+	if ( on ) ether.powerUp();
+	else ether.powerDown();
+	etherAwake = on;
+}
+
+// Buffer the records handed by the measurement, the Pachube requests are built from the buffer
+void bufferMeasured()
+{
+	while ( measured.peek() != 0 )
+	{
+		outage.push(*measured.peek());
+		measured.pop();
+		LOG_DEBUG(printOutage());
+	}
+}
+
+// Display the outcome of the last upload
+void printUpload()
+{
+	PachubeResponseTime = uploader.getResponseTime();
+	LOG_INFO(
+		showString(PSTR("\n-> Pachube HTTP ")); gridLog.print(uploader.getStatus());
+		showString(PSTR(" in ")); gridLog.print(PachubeResponseTime);
+		showString(PSTR(" ms - failures ")); gridLog.println(uploader.getFailures());
+		if ( uploader.getBackoff() != 0 ) { showString(PSTR("-> retry in ")); gridLog.print(uploader.getBackoff()); showString(PSTR(" ms\n")); }
+	);
+#ifdef GRIDEVENTS
+	if ( eventSent && uploader.getBackoff() == 0 ) loadEvents.pop(); // delivered, or rejected for good
+	eventSent = false;
+#endif
+#ifdef GRIDDEADBAND
+	deadband.resend(uploader.getStatus() / 100 != 2); // not delivered, retried or not: every value is sent again
+#endif
+	LOG_INFO(printOutage());
+}
+
+#ifdef GRIDPHASES
+// Display the three-phase figures of the last cycle
+void printPhases()
+{
+	showString(PSTR("--> 3-phase "));
+	if ( phases.getSequence() == PHASE_ABC ) showString(PSTR("ABC"));
+	else if ( phases.getSequence() == PHASE_ACB ) showString(PSTR("ACB"));
+	else showString(PSTR("?"));
+	showString(PSTR(" P ")); gridLog.print( phases.getActive() );
+	showString(PSTR(" Q ")); gridLog.print( phases.getReactive() );
+	showString(PSTR(" S ")); gridLog.println( phases.getApparent() );
+	gridLog.next();
+	showString(PSTR("--> imbalance % V ")); gridLog.print( phases.getVoltageImbalance() * 0.1, 1 );
+	showString(PSTR(" I ")); gridLog.print( phases.getCurrentImbalance() * 0.1, 1 );
+	for (byte k = 0; k < PHASES; k++) { showString(PSTR(" ")); gridLog.print( phases.getCurrentDeviation(k) * 0.1, 1 ); }
+	gridLog.println();
+	gridLog.next();
+	showString(PSTR("--> neutral A ")); gridLog.println( phases.getNeutral() * 0.01, 2 );
+}
+#endif
+
+#ifdef GRIDEVENTS
+// Display the load event just queued
+void printLoadEvent()
+{
+	LoadEvent *event = loadEvents.newest();
+	showString(PSTR("--> load event on ADE7753 ")); gridLog.print(event->meter);
+	showString(PSTR(" - P: ")); gridLog.print(event->active);
+	showString(PSTR(" Q: ")); gridLog.println(event->reactive);
+	gridLog.next();
+	showString(PSTR("--> settling ms: ")); gridLog.print(event->settle);
+	showString(PSTR(" age ms: ")); gridLog.print(millis() - event->at);
+	showString(PSTR(" lost: ")); gridLog.println(loadEvents.getLost());
+}
+#endif
+
+#ifdef GRIDPULSE
+// Display a cycle whose CF pulses do not match its line cycle energy
+void printPulses(unsigned long pulses)
+{
+	showString(PSTR("--> CF pulses ")); gridLog.print(pulses);
+	showString(PSTR(" deviate from LAENERGY by ")); gridLog.println(gridPulse.getDeviation());
+	gridLog.next();
+	showString(PSTR("--> per mille - mismatches: ")); gridLog.print(gridPulse.getMismatches());
+	showString(PSTR(" of ")); gridLog.println(gridPulse.getChecks());
+}
+#endif
+
+// Age in seconds of the oldest record waiting for upload, 0 if none or if it is not time stamped
+unsigned long oldestAge()
+{
+	unsigned long sec, oldest;
+	unsigned int ms;
+	if ( ! outage.getOldest(&oldest) || oldest == 0 ) return 0;
+	gridClock.now(&sec, &ms);
+	return sec - oldest;
+}
+
+#ifdef GRIDBILLING
+// Move the billing registers on with the UTC time, display them at each tariff switch
+void tickBilling()
+{
+	unsigned long sec;
+	unsigned int ms;
+	gridClock.now(&sec, &ms);
+	if ( gridBilling.tick(sec) ) LOG_INFO(printBilling());
+}
+
+// Display the billing registers of the current tariff
+void printBilling()
+{
+	byte t = gridBilling.getTariff();
+	const BillRegisters *b = gridBilling.getRegisters();
+	showString(PSTR("--> tariff ")); gridLog.print(t);
+	showString(PSTR(" import Wh ")); gridLog.print(b->importWh[t]);
+	showString(PSTR(" export Wh ")); gridLog.println(b->exportWh[t]);
+	gridLog.next();
+	showString(PSTR("--> max demand ")); gridLog.print(b->maxDemand[t]);
+	showString(PSTR(" demand ")); gridLog.println(gridBilling.getDemand());
+}
+#endif
+
+#ifdef GRIDCONFIG
+// Display the parameters of the node in use and the number of changes to the tables in flash
+void printConfig()
+{
+	showString(PSTR("--> config: period ")); gridLog.print(gridConfig.getPeriod());
+	showString(PSTR(" ms - linecyc ")); gridLog.print(gridConfig.getLineCyc());
+	showString(PSTR(" - gain ")); gridLog.println(gridConfig.getGain(), HEX);
+	gridLog.next();
+	showString(PSTR("--> config: changed ")); gridLog.print(gridConfig.getChanged());
+	showString(PSTR(" - rejected ")); gridLog.println(gridConfig.getRejected());
+}
+#endif
+
+// Display the state of the store and forward buffer
+void printOutage()
+{
+	showString(PSTR("-> buffered ")); gridLog.print(outage.getDepth());
+	showString(PSTR(" (SRAM ")); gridLog.print(outage.getRamCount());
+	showString(PSTR(", EEPROM ")); gridLog.print(outage.getEepromCount());
+	showString(PSTR(")\n"));
+	gridLog.next();
+	showString(PSTR("-> oldest ")); gridLog.print(oldestAge());
+	showString(PSTR(" s - dropped ")); gridLog.println(outage.getDropped());
+}
+
+// Row of the shield table of an ADE7753 of this Nanode, the first one for a record taken
+// before the node table was changed
+const MeterConfig *shieldOf(byte meter)
+{
+#ifdef GRIDCONFIG
+	if ( meter >= gridConfig.getCount() ) meter = 0;
+	return &liveShields[meter]; // the copies in SRAM, with the changes of GET /set
+#else
+	if ( meter >= pgm_read_byte(&node->meters) ) meter = 0;
+	return &shields[pgm_read_byte(&node->shield) + meter];
+#endif
+}
+
+// Update period in milliseconds, REQUEST_RATE or the one set with GET /set (see GridConfig.h)
+unsigned long updatePeriod()
+{
+#ifdef GRIDCONFIG
+	return gridConfig.getPeriod();
+#else
+	return REQUEST_RATE;
+#endif
+}
+
+// UTC time stamp of a record from the millis() of the end of its accumulation window
+void stampRecord(GridRecord &rec, unsigned long at)
+{
+	unsigned long age = millis() - at;
+	gridClock.now(&rec.utcSec, &rec.utcMs);
+	if ( rec.utcSec == 0 ) return; // clock never synchronised
+	rec.utcSec -= age / 1000;
+	if ( rec.utcMs < age % 1000 ) { rec.utcSec--; rec.utcMs += 1000; }
+	rec.utcMs -= age % 1000;
+}
+
+// Start a Pachube CSV line: datastream ID, then the UTC time stamp of the record if the clock is synchronised
+void stashDatastream(unsigned int id, GridRecord &rec)
+{
+	stash.print(id);
+	stash.print(',');
+	if ( gridClock.isSynced() )
+	{
+		gridClock.printIso(stash, rec.utcSec, rec.utcMs);
+		stash.print(',');
+	}
+}
+
+// Start the Pachube CSV line of a measurement of the record, unless its deadband leaves it out
+// id is the datastream of the meter, 0 to 8
+boolean stashChanged(byte id, GridRecord &rec, float value)
+{
+#ifdef GRIDDEADBAND
+	if ( ! deadband.pass(rec.meter, id, value) ) return false;
+#endif
+	stashDatastream(rec.meter * STREAM_METER + id, rec);
+	return true;
+}
+
+// Stash a health counter of the Nanode, without time stamp, unless its deadband leaves it out
+void stashHealth(byte id, long value)
+{
+#ifdef GRIDDEADBAND
+	if ( ! deadband.pass(0, id, value) ) return;
+#endif
+	stash.print(id);
+	stash.print(',');
+	stash.println(value);
+}
+
+// Display the SNTP clock state
+void printClock()
+{
+	unsigned long sec;
+	unsigned int ms;
+	gridClock.now(&sec, &ms);
+	showString(PSTR("-> UTC ")); gridClock.printIso(gridLog, sec, ms);
+	gridLog.println();
+	gridLog.next();
+	showString(PSTR("-> offset ")); gridLog.print(gridClock.getOffset());
+	showString(PSTR(" ms, delay ")); gridLog.print(gridClock.getDelay());
+	showString(PSTR(" ms, drift ")); gridLog.print(gridClock.getDrift());
+	showString(PSTR(" ppm\n"));
+}
+
 // Display string stored in PROGMEM
 void showString (PGM_P s)
 {
-	char c;
-	while ((c = pgm_read_byte(s++)) != 0)
-	Serial.print(c);
+	gridLog.text(s);
+}
+
+// Display an IP address after a label stored in PROGMEM, as EtherCard printIp() does on Serial
+void printIp(PGM_P label, const byte *ip)
+{
+	showString(label);
+	for (byte i = 0; i < 4; i++)
+	{
+		if ( i != 0 ) gridLog.print('.');
+		gridLog.print(ip[i]);
+	}
+	gridLog.println();
+}
+
+// Display the outcome of the bring-up of an ADE7753
+void printMeter(byte i, PGM_P outcome)
+{
+	showString(PSTR("ADE7753 ")); gridLog.print(i);
+	showString(PSTR(" rev ")); gridLog.print(gridMeters[i].getDieRev(), HEX);
+	showString(outcome);
+}
+
+// Let the log wait for room (dumps) or drop what does not fit (the loop), see GridLog.h
+void logWait(boolean on)
+{
+#if defined(GRIDCAPTURE) && defined(CAPTURE_SESSION)
+	on = true; // host/replay.cpp needs every event of the session
+#endif
+	gridLog.setBlocking(on);
+}
+
+// Row of the node table matching the MAC address, the last row (unknown board) if none does
+const NodeConfig *findNode(byte *mac)
+{
+	byte i;
+	for (i = 0; i < NODE_COUNT - 1; i++)
+	{
+		if ( memcmp_P(mac, nodes[i].mac, 6) == 0 ) break;
+	}
+	return &nodes[i];
 }
 
 void GetMac()
 {
-	showString(PSTR("Reading MAC address... "));
 	bMac=unio.read(macaddr,NANODE_MAC_ADDRESS,6);
-	if (bMac) showString(PSTR("success\n\r"));
-	else showString(PSTR("failure\n\r"));
-	
+	if (bMac) LOG_INFO(showString(PSTR("Reading MAC address... success\n\r")));
+	else LOG_ERROR(showString(PSTR("Reading MAC address... failure\n\r")));
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
 	showString(PSTR("MAC     : "));
 	for (int i=0; i<6; i++) 
 	{
@@ -1049,7 +1896,7 @@ void GetMac()
 		{
 			showString(PSTR("0"));
 		}
-		Serial.print(macaddr[i], HEX);
+		gridLog.print(macaddr[i], HEX);
 		if (i<5) 
 		{
 			showString(PSTR(":"));
@@ -1060,6 +1907,7 @@ void GetMac()
 		}
 	}
 	showString(PSTR("\n--\n"));
+#endif
 }
 
 void software_Reset() // Restarts program from beginning but does not reset the peripherals and registers
@@ -1096,7 +1944,7 @@ void WatchdogSetup(void)
 	//Enable global interrupts
 	sei();
 	
-	showString(PSTR(">>> Watchdog has been initialized\n"));
+	LOG_INFO(showString(PSTR(">>> Watchdog has been initialized\n")));
 }
 
 void WatchdogClear(void)
@@ -1115,12 +1963,16 @@ ISR(WDT_vect)
 {
 	WatchdogSetup(); // If not there, cannot print the message before rebooting
 	EEPROM.write(1, EEPROM.read(1)+1 );  // Increment EEPROM for each WatchDog Timeout
-	showString(PSTR("\nREBOOTING....\n\n"));
+#ifdef GRIDBILLING
+	gridBilling.save(); // up to BILL_SAVE_PERIOD of energy otherwise lost
+#endif
+	gridLog.setBlocking(true); // the interrupts are off, write() sends from the polling loop
+	LOG_ERROR(showString(PSTR("\nREBOOTING....\n\n")));
 	
 	// Time out counter in CPU EEPROM
 	// to be implemened soonest
 	
-	delay(1000); // leave some time for printing on serial port to complete
+	gridLog.flush(); // printing on serial port complete, the TX complete interrupt cannot fire here
 	software_Reset();	
 }
 
@@ -0,0 +1,280 @@
+/* GridBilling.cpp = Time-of-use energy registers and maximum demand for ArduGrid7753
+====================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridBilling.h for the schedule, the demand window and the EEPROM copies.
+
+*/
+
+#include "GridBilling.h"
+
+#ifdef GRIDBILLING
+
+#include <stddef.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+#include "GridConfig.h"
+
+#define BILL_DAY         86400UL   // in seconds
+#define BILL_MS_PER_HOUR 3600000.0
+
+GridBilling gridBilling;
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === signed24 ===
+* @return long with a 24-bit 2-complement register value, LAENERGY of an accumulation
+*/
+static long signed24(long x) {
+	return ( x & 0x800000L ) ? x - 0x1000000L : x;
+}
+
+/** === carry ===
+* Move the whole Wh of a fraction into its register
+*/
+static void carry(unsigned long &total, float &part) {
+	if ( part < 1.0 ) return;
+	unsigned long wh = part;
+	total += wh;
+	part -= wh;
+}
+
+/** === crc ===
+* @return byte with the Dallas/Maxim CRC-8 of the registers, their crc field excluded
+*/
+static byte crc(const BillRegisters &r) {
+	const byte *p = (const byte *)&r;
+	byte c = 0;
+	for (byte i = 0; i < offsetof(BillRegisters, crc); i++) c = _crc_ibutton_update(c, p[i]);
+	return c;
+}
+
+/** === copyAddress ===
+* @return void * with the EEPROM address of copy [0 1]
+*/
+static void *copyAddress(byte copy) {
+	return (void *)( BILL_EEPROM_START + copy * sizeof(BillRegisters) );
+}
+
+/** === load ===
+* Take the newer valid copy of the registers in EEPROM, or start from 0
+* @return boolean false if neither copy is valid
+*/
+boolean GridBilling::load(void) {
+	BillRegisters copy;
+	boolean found = false;
+	for (byte k = 0; k < 2; k++)
+	{
+		eeprom_read_block(&copy, copyAddress(k), sizeof(copy));
+		if ( copy.crc != crc(copy) ) continue;
+		if ( found && (byte)( copy.sequence - regs.sequence ) >= 0x80 ) continue; // older than the other copy
+		regs = copy;
+		found = true;
+	}
+	if ( ! found ) memset(&regs, 0, sizeof(regs));
+	return found;
+}
+
+/** === lookup ===
+* Find the tariff of a time in the schedule, and the time of the next slot
+* @param utcSec: now
+* @return boolean true if the tariff changed
+*/
+boolean GridBilling::lookup(unsigned long utcSec) {
+	unsigned long local = utcSec + BILL_UTC_OFFSET * 60L;
+	byte day = ( local / BILL_DAY + 4 ) % 7; // 1 Jan 1970 was a Thursday
+	unsigned int now = ( local % BILL_DAY ) / 60;
+	unsigned int next = 24 * 60; // the next midnight, if no slot is left today
+	unsigned int latest = 0;
+	byte found = 0xFF;
+	for (byte i = 0; i < slots; i++)
+	{
+		TariffSlot s;
+		memcpy_P(&s, &schedule[i], sizeof(s));
+		if ( ! ( s.days & ( 1 << day ) ) ) continue;
+		if ( s.start > now )
+		{
+			if ( s.start < next ) next = s.start;
+		}
+		else if ( found == 0xFF || s.start >= latest )
+		{
+			found = s.tariff;
+			latest = s.start;
+		}
+	}
+	if ( found >= BILL_TARIFFS ) found = 0; // no slot at 00:00, or a bad tariff
+	nextSwitch = local - local % BILL_DAY + next * 60UL - BILL_UTC_OFFSET * 60L;
+	if ( found == tariff ) return false;
+	if ( importPart >= 0.5 ) regs.importWh[tariff]++; // rounded into the tariff that ends
+	if ( exportPart >= 0.5 ) regs.exportWh[tariff]++;
+	importPart = exportPart = 0;
+	tariff = found;
+	return true;
+}
+
+/** === close ===
+* End the sub-block of the current minute, and update the demand of the window
+* @param utcMinute: the new minute
+*/
+void GridBilling::close(unsigned long utcMinute) {
+	if ( minute != 0 && utcMinute == minute + 1 )
+	{
+		unsigned long e = minuteWh * BILL_SUB_UNIT + 0.5;
+		if ( e > 0xFFFF ) e = 0xFFFF;
+		windowSum = windowSum - subs[sub] + e;
+		subs[sub] = e;
+		sub = ( sub + 1 ) % BILL_SUBS;
+		if ( filled < BILL_SUBS ) filled++;
+		if ( filled == BILL_SUBS )
+		{
+			demand = windowSum * 60 / ( BILL_SUB_UNIT * BILL_SUBS );
+			if ( demand > regs.maxDemand[tariff] )
+			{
+				regs.maxDemand[tariff] = demand;
+				regs.maxAt[tariff] = utcMinute * 60;
+			}
+		}
+	}
+	else
+	{   // the first minute is partial, or minutes were missed: the window starts again
+		memset(subs, 0, sizeof(subs));
+		windowSum = 0;
+		sub = 0;
+		filled = 0;
+	}
+	minute = utcMinute;
+	minuteWh = 0;
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* Restore the registers from EEPROM
+* @param meters: GridMeter of each ADE7753 of the Nanode, for their calibration
+* @param count: meters billed [1 SCHED_METERS]
+* @param schedule: table of TariffSlot in PROGMEM
+* @param slots: rows of the table
+*/
+void GridBilling::begin(GridMeter *meters, byte count, const TariffSlot *schedule, byte slots) {
+	this->meters = meters;
+	this->count = count;
+	this->schedule = schedule;
+	this->slots = slots;
+	restored = load();
+	importPart = exportPart = 0;
+	measured = 0;
+	tariff = 0;
+	nextSwitch = 0;
+	memset(subs, 0, sizeof(subs));
+	windowSum = 0;
+	minuteWh = 0;
+	minute = 0;
+	sub = 0;
+	filled = 0;
+	demand = 0;
+	savedAt = millis();
+}
+
+/** === add ===
+* Integrate a line cycle accumulation into the registers of the current tariff
+* @param meter: [0 count-1]
+* @param active: LAENERGY of the accumulation, raw 24-bit
+* @param linecyc: half line cycles of the accumulation
+* @param signs: PPOS and PNEG seen since the previous accumulation, see GridMeter::getSigns()
+* @param at: millis() of the end of the accumulation
+*/
+void GridBilling::add(byte meter, long active, unsigned int linecyc, unsigned int signs, unsigned long at) {
+	if ( meter >= count || linecyc == 0 ) return;
+	if ( signs & ( PPOS | PNEG ) ) regs.reversals++;
+	if ( measured & ( 1 << meter ) )
+	{
+		const MeterConfig *shield = meters[meter].getConfig();
+		unsigned long dt = at - lastAt[meter];
+		float power = signed24(active) * ( float(METER_LINECYC) / linecyc ) / CONFIG_FLOAT(&shield->calActiveEnergy);
+		float wh = power * ( dt > BILL_GAP_MAX ? BILL_GAP_MAX : dt ) / BILL_MS_PER_HOUR;
+		if ( wh > 0 )
+		{
+			importPart += wh;
+			minuteWh += wh;
+			carry(regs.importWh[tariff], importPart);
+		}
+		else
+		{
+			exportPart -= wh;
+			carry(regs.exportWh[tariff], exportPart);
+		}
+	}
+	measured |= 1 << meter;
+	lastAt[meter] = at;
+}
+
+/** === tick ===
+* Follow the clock: switch the tariff at its slots, close the minutes of the demand window,
+* save the registers every BILL_SAVE_PERIOD
+* @param utcSec: now, 0 if the clock has never been synchronised
+* @return boolean true if the tariff changed
+*/
+boolean GridBilling::tick(unsigned long utcSec) {
+	boolean switched = false;
+	if ( millis() - savedAt >= BILL_SAVE_PERIOD ) save();
+	if ( utcSec == 0 ) return false;
+	if ( utcSec >= nextSwitch ) switched = lookup(utcSec);
+	if ( utcSec / 60 != minute ) close(utcSec / 60);
+	return switched;
+}
+
+/** === save ===
+* Write the registers into the older EEPROM copy, only the bytes that changed
+*/
+void GridBilling::save(void) {
+	regs.sequence++;
+	regs.crc = crc(regs);
+	eeprom_update_block(&regs, copyAddress(regs.sequence & 1), sizeof(regs));
+	savedAt = millis();
+}
+
+/** === isRestored ===
+* @return boolean true if begin() found the registers in EEPROM
+*/
+boolean GridBilling::isRestored(void) {
+	return restored;
+}
+
+/** === getTariff ===
+* @return byte with the current tariff [0 BILL_TARIFFS-1]
+*/
+byte GridBilling::getTariff(void) {
+	return tariff;
+}
+
+/** === getDemand ===
+* @return unsigned long with the demand of the last full window, in the unit of datastream 4
+*/
+unsigned long GridBilling::getDemand(void) {
+	return demand;
+}
+
+/** === getRegisters ===
+* @return const BillRegisters * with the energy and demand registers of each tariff
+*/
+const BillRegisters *GridBilling::getRegisters(void) {
+	return &regs;
+}
+
+#endif
@@ -0,0 +1,160 @@
+/* GridBilling.h = Time-of-use energy registers and maximum demand for ArduGrid7753
+==================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Billing needs the energy of each tariff period and the maximum demand over 15 minutes.
+The datastreams only give the mean power of a 2 s cycle every update period, a sample and
+not an integral. When GRIDBILLING is defined below, the registers are kept on the board,
+fed by every line cycle accumulation of the meters of the Nanode: the measurement cycles,
+and with GRIDEVENTS the short windows of the load events in between (see GridEvents.h).
+Without the windows, the power of a cycle is held until the next one, BILL_GAP_MAX at most:
+host/billsim.cpp gives errors of up to 2.5 % on the energy and 3.5 % on the demand for
+loads switched every few seconds, against 0.5 % with the windows. GRIDEVENTS costs about
+230 bytes of SRAM, which PROFILE_BILLING cannot spare (see GridFeatures.h).
+
+	add()         an accumulation: its LAENERGY is the mean power of the meter since its
+	              previous accumulation, which is integrated into the import (power > 0) or
+	              the export (power < 0) register of the current tariff, in the unit of
+	              datastream 4 times hours (Wh). A gap of more than BILL_GAP_MAX is counted
+	              as BILL_GAP_MAX. The PPOS and PNEG flags latched by the ADE7753 since the
+	              previous accumulation (see GridMeter::getSigns()) tell that the power changed
+	              sign in between: the net energy still goes by its sign, and the
+	              accumulation is counted as a reversal.
+	tick()        once per pass of the loop with the UTC time: the tariff and the demand
+	              window follow the clock. Nothing is scheduled until the clock has been
+	              synchronised, the energy goes to the current tariff (0 after a reboot).
+
+The meters of the Nanode are billed together: the phases of a three-phase supply, or the
+circuits of a board, as one customer.
+
+Tariffs: the schedule is a small table of TariffSlot in PROGMEM (see ArduGrid7753.ino),
+in local standard time (BILL_UTC_OFFSET, without daylight saving time, as the meters of
+the utility). On a given day the tariff is the one of the latest slot started, each day
+needs a slot at 00:00 (tariff 0 otherwise). The table is only read when the tariff may
+change: tick() keeps the UTC time of the next slot, add() and tick() are O(1). The Wh
+fractions left at a switch are rounded into the tariff that ends.
+
+Maximum demand: a sliding window of BILL_SUBS sub-blocks of one minute, aligned on the
+UTC minutes. At the end of each minute the oldest sub-block leaves the window, and the
+demand of the window (its imported energy over 15 minutes, as a power) is compared with
+the maximum of the current tariff, kept with the UTC time of the end of its window. A
+missed minute (a clock step, a hung loop) starts the window again.
+
+EEPROM: the registers (BillRegisters) are saved every BILL_SAVE_PERIOD and before a
+reboot, alternately into two copies with a sequence number and a CRC-8: a power loss
+during a save leaves the previous copy intact. begin() takes the newer valid copy. The
+fractions of Wh and the demand window are not saved.
+
+	EEPROM map: see ArduGrid7753.ino
+
+The registers of the current tariff and the demand are uploaded with the health of the
+Nanode, as datastreams 32 to 36 (see ArduGrid7753.ino), and every register is read by the
+Modbus server when there is one (see GridModbus.h). host/billsim.cpp plays load profiles
+over several days against the exact integrals, and a corrupted save.
+
+*/
+
+#ifndef GRIDBILLING_H
+#define GRIDBILLING_H
+
+#include "GridFeatures.h"
+// #define GRIDBILLING             // uncomment for the tariff and demand registers (about 170 bytes of SRAM)
+
+#define BILL_TARIFFS      4         // tariff registers
+#define BILL_UTC_OFFSET   60        // in minutes - local standard time of the schedule, CET
+#define BILL_SUBS         15        // one minute sub-blocks of the demand window, 15 minutes
+#define BILL_SUB_UNIT     10        // sub-block energies per Wh, in tenths of Wh
+#define BILL_GAP_MAX      60000     // in milliseconds - longest time between two accumulations integrated
+#define BILL_SAVE_PERIOD  3600000UL // in milliseconds - between two EEPROM saves
+#define BILL_EEPROM_START 16        // first EEPROM address of the two copies
+
+// TariffSlot days
+#define BILL_SUNDAY       0x01
+#define BILL_MONDAY       0x02
+#define BILL_TUESDAY      0x04
+#define BILL_WEDNESDAY    0x08
+#define BILL_THURSDAY     0x10
+#define BILL_FRIDAY       0x20
+#define BILL_SATURDAY     0x40
+#define BILL_WEEKDAYS     0x3E
+#define BILL_WEEKEND      0x41
+#define BILL_EVERYDAY     0x7F
+
+#ifdef GRIDBILLING
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include "GridMeter.h"
+#include "GridScheduler.h"
+
+struct TariffSlot {
+	byte days;                 // BILL_SUNDAY ... BILL_SATURDAY
+	unsigned int start;        // minute of the local day [0 1439]
+	byte tariff;               // [0 BILL_TARIFFS-1]
+};
+
+struct BillRegisters {
+	byte sequence;             // of the save, the newer copy wins
+	unsigned long importWh[BILL_TARIFFS];  // in the unit of datastream 4 times hours
+	unsigned long exportWh[BILL_TARIFFS];
+	unsigned long maxDemand[BILL_TARIFFS]; // in the unit of datastream 4, imported
+	unsigned long maxAt[BILL_TARIFFS];     // UTC seconds of the end of the window of the maximum
+	unsigned int reversals;    // accumulations with PPOS or PNEG
+	byte crc;                  // CRC-8 of the bytes above
+};
+
+class GridBilling {
+   //public methods
+   public:
+      void begin(GridMeter *meters, byte count, const TariffSlot *schedule, byte slots);
+      void add(byte meter, long active, unsigned int linecyc, unsigned int signs, unsigned long at);
+      boolean tick(unsigned long utcSec);
+      void save(void);
+      boolean isRestored(void);
+      byte getTariff(void);
+      unsigned long getDemand(void);
+      const BillRegisters *getRegisters(void);
+
+   //private methods
+   private:
+      boolean load(void);
+      boolean lookup(unsigned long utcSec);
+      void close(unsigned long utcMinute);
+
+      GridMeter *meters;
+      byte count;                // meters billed
+      const TariffSlot *schedule; // in flash, read with memcpy_P()
+      byte slots;
+      BillRegisters regs;
+      boolean restored;          // the registers were read from EEPROM by begin()
+      float importPart;          // fractions of Wh not yet in the registers
+      float exportPart;
+      unsigned long lastAt[SCHED_METERS]; // millis() of the end of the previous accumulation of each meter
+      byte measured;             // bit m set once meter m has an accumulation
+      byte tariff;               // [0 BILL_TARIFFS-1]
+      unsigned long nextSwitch;  // UTC seconds of the next slot, 0 before the first tick()
+      unsigned int subs[BILL_SUBS]; // imported energy of each minute of the window, in 1 / BILL_SUB_UNIT Wh
+      unsigned long windowSum;   // of subs
+      float minuteWh;            // imported in the current minute
+      unsigned long minute;      // UTC minute of the current sub-block, 0 before the first tick()
+      byte sub;                  // next sub-block written
+      byte filled;               // sub-blocks in the window since it started
+      unsigned long demand;      // of the last full window, in the unit of datastream 4
+      unsigned long savedAt;     // millis() of the last save
+};
+
+extern GridBilling gridBilling;
+
+#endif
+
+#endif
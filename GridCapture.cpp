@@ -0,0 +1,175 @@
+/* GridCapture.cpp = Recording of the ADE7753 register transactions for ArduGrid7753
+==================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridCapture.h for the format of the events and the two modes.
+
+*/
+
+#include "GridCapture.h"
+
+#ifdef GRIDCAPTURE
+
+GridCapture gridCapture;
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === emit ===
+* Print an event on a line of its own: '@' and 12 hexadecimal digits
+*/
+void GridCapture::emit(CaptureEvent &e) {
+	byte *b = (byte *)&e;
+	out->print('@');
+	for (byte i = 0; i < sizeof(CaptureEvent); i++)
+	{
+		if ( b[i] < 0x10 ) out->print('0');
+		out->print(b[i], HEX);
+	}
+	out->println();
+}
+
+/** === push ===
+* Add an event, the oldest one is overwritten when the ring is full. In session mode the
+* events held are complete and printed first, unless the event is in their round.
+*/
+void GridCapture::push(byte op, byte repeat, byte dt, unsigned long value) {
+#ifdef CAPTURE_SESSION
+	if ( ! ( repeat & CAPTURE_ROUND ) )
+	{
+		for (byte i = 0; i < count; i++) emit(ring[i]);
+		head = count = 0;
+	}
+#endif
+	CaptureEvent *e = &ring[head];
+	e->op = op;
+	e->repeat = repeat;
+	e->dt = dt;
+	e->value[0] = value >> 16;
+	e->value[1] = value >> 8;
+	e->value[2] = value;
+	head = ( head + 1 ) % CAPTURE_SLOTS;
+	if ( count < CAPTURE_SLOTS ) count++;
+	else lost++;
+}
+
+/** === same ===
+* @return boolean true if the event is the transaction given, on the chip in bits 6-7
+*/
+static boolean same(CaptureEvent *e, byte op, byte chip, unsigned long value) {
+	return e->op == op && ( e->repeat & 0xC0 ) == chip
+	       && e->value[0] == (byte)( value >> 16 ) && e->value[1] == (byte)( value >> 8 ) && e->value[2] == (byte)value;
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* Start recording
+* @param out: where the events are printed, Serial
+*/
+void GridCapture::begin(Print &out) {
+	this->out = &out;
+	head = count = 0;
+	lost = 0;
+	round = 0;
+	chips = 0;
+	last = micros();
+}
+
+/** === record ===
+* One transaction of ADE7753.cpp, at its end
+* @param cs: chip select pin of the ADE7753
+* @param address: address byte sent, register with WRITE (bit 7) for a write
+* @param value: read or written
+*/
+void GridCapture::record(byte cs, byte address, unsigned long value) {
+	if ( out == 0 ) return;
+	byte op = ( address & 0x3F ) | ( ( address & 0x80 ) ? CAPTURE_WRITE : 0 );
+	unsigned long ticks = ( micros() - last ) / CAPTURE_TICK_US;
+	last += ticks * CAPTURE_TICK_US;
+	byte chip = 0;
+	value &= 0xFFFFFF;
+	while ( chip < chips && pins[chip] != cs ) chip++;
+	if ( chip == chips )
+	{   // a new chip select pin, the last chip is reused when all are taken
+		if ( chips < CAPTURE_CHIPS ) chips++;
+		else chip = CAPTURE_CHIPS - 1;
+		pins[chip] = cs;
+		push(CAPTURE_CHIP, chip << 6, 0, cs);
+		round = 0;
+	}
+	chip <<= 6;
+	if ( round != 0 )
+	{
+		byte first = ( head + CAPTURE_SLOTS - round ) % CAPTURE_SLOTS;
+		byte passes = ring[first].repeat & CAPTURE_REPEATS;
+		byte p = 1;  // event of the round expected next
+		while ( p < round && ( ring[( first + p ) % CAPTURE_SLOTS].repeat & CAPTURE_REPEATS ) == passes ) p++;
+		if ( p == round ) p = 0;
+		CaptureEvent *e = &ring[( first + p ) % CAPTURE_SLOTS];
+		if ( same(e, op, chip, value) && ( p != 0 || passes < CAPTURE_REPEATS ) && e->dt + ticks <= 0xFF )
+		{   // one more pass of the round
+			e->repeat++;
+			e->dt += ticks;
+			return;
+		}
+		if ( p == 0 && passes == 0 && round < CAPTURE_CHIPS && ticks <= 0xFF )
+		{   // the round is in its first pass, it takes another chip
+			for (p = 0; p < round && ( ring[( first + p ) % CAPTURE_SLOTS].repeat & 0xC0 ) != chip; p++);
+			if ( p == round )
+			{
+				push(op, chip | CAPTURE_ROUND, ticks, value);
+				round++;
+				return;
+			}
+		}
+	}
+	if ( ticks > 0xFF )
+	{
+		push(CAPTURE_GAP, 0, 0, ticks);
+		ticks = 0;
+	}
+	push(op, chip, ticks, value);
+	round = 1;
+}
+
+/** === dump ===
+* Print the events held, oldest first, and empty the ring. In ring mode the chips are told
+* first, their markers may have been overwritten. In session mode, print the last event,
+* which would otherwise wait for the next transaction.
+*/
+void GridCapture::dump(void) {
+	if ( out == 0 ) return;
+	if ( lost != 0 )
+	{
+		CaptureEvent marker = { CAPTURE_LOST, 0, 0, { 0, (byte)( lost >> 8 ), (byte)lost } };
+		emit(marker);
+	}
+#ifndef CAPTURE_SESSION
+	for (byte chip = 0; chip < chips; chip++)
+	{
+		CaptureEvent marker = { CAPTURE_CHIP, (byte)( chip << 6 ), 0, { 0, 0, pins[chip] } };
+		emit(marker);
+	}
+#endif
+	for (byte i = 0; i < count; i++) emit(ring[( head + CAPTURE_SLOTS - count + i ) % CAPTURE_SLOTS]);
+	head = count = 0;
+	lost = 0;
+	round = 0;
+}
+
+#endif
@@ -0,0 +1,134 @@
+/* GridCapture.h = Recording of the ADE7753 register transactions for ArduGrid7753
+================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Field bugs (storms of zero crossing timeouts, odd jumps of LAENERGY...) cannot be
+reproduced on the bench unless we know what the chip returned. When GRIDCAPTURE is
+defined below, every register read or write of ADE7753.cpp is recorded as a 6-byte
+CaptureEvent:
+
+	op        register, with CAPTURE_WRITE for a write, or a marker (CAPTURE_MARK)
+	repeat    bits 0-4: identical transactions that followed (same chip, register and
+	          value), so that a run of status polls takes one event. Bit 5: CAPTURE_ROUND.
+	          Bits 6-7: the chip, one of the CAPTURE_CHIPS last chip select pins seen
+	dt        time since the previous event in CAPTURE_TICK_US, to the last of the repeats
+	value     read or written, 24 bits MSB first
+
+GridScheduler polls the meters in turn, so that their repeats alternate. An event followed
+by events marked CAPTURE_ROUND, each on another chip, is a round: the first transaction of
+each event of the round in the order of the events, then the second one of each..., each
+event taking part in 1 + repeats of these passes. The first events of a round may take one
+pass more than the last ones, when the round was interrupted in the middle of a pass. The
+status polls of three meters thus take three events, and the dt of a round adds up to the
+time of its last transaction.
+
+and the markers:
+
+	CAPTURE_CHIP     the chip of bits 6-7 of repeat is the ADE7753 whose chip select pin is value
+	CAPTURE_GAP      value ticks since the previous event, too long for dt (the loop idles)
+	CAPTURE_LOST     value events were overwritten in the ring before dump()
+
+The events are printed on Serial as '@' followed by the 12 hexadecimal digits of the 6 bytes,
+one per line, so that they can be picked out of a Serial log among the other messages.
+
+Two modes:
+
+	ring      the last CAPTURE_EVENTS events are kept, 240 bytes of SRAM. The sketch dumps
+	          them when a cycle ended without mains or when check() repaired a meter: the
+	          transactions that led to it
+	session   with CAPTURE_SESSION defined below, each event is printed as soon as it is
+	          complete, from setup() on, for a whole session. Serial then slows the loop
+	          down, but not the sequence of the transactions, which is what a replay needs
+
+host/replay.cpp plays a session back through the unmodified ADE7753 class, GridMeter and
+GridScheduler: each transaction of the code is checked against the trace, and the reads
+return the recorded values. A trace of the field is thus a regression test (the code must
+ask the same registers in the same order) and a benchmark of the acquisition path.
+
+The reads of the timer driven acquisition (GridSampler.h) do not go through ADE7753.cpp
+and are not recorded.
+
+*/
+
+#ifndef GRIDCAPTURE_H
+#define GRIDCAPTURE_H
+
+#include "GridFeatures.h"
+// #define GRIDCAPTURE             // uncomment to record the ADE7753 register transactions
+// #define CAPTURE_SESSION         // ... and print them all on Serial instead of keeping the last ones
+
+#define CAPTURE_EVENTS   40        // ring of the last events, 6 bytes each
+#define CAPTURE_TICK_US  64        // unit of dt, 255 ticks = 16 ms
+#define CAPTURE_CHIPS    4         // chip select pins told apart in the events
+#define CAPTURE_REPEATS  0x1F      // bits of repeat that count the repeats
+#define CAPTURE_ROUND    0x20      // bit of repeat, the event is in the round of the previous one
+
+// CaptureEvent op
+#define CAPTURE_WRITE    0x40      // register written, the register is in bits 0-5
+#define CAPTURE_MARK     0x80      // marker, not a transaction
+#define CAPTURE_CHIP     0x80      // chip select pin of a chip
+#define CAPTURE_GAP      0x81      // ticks since the previous event
+#define CAPTURE_LOST     0x82      // events overwritten before the dump
+
+#ifdef GRIDCAPTURE
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+
+#ifdef CAPTURE_SESSION
+#define CAPTURE_SLOTS    CAPTURE_CHIPS  // the round that may still take repeats
+#else
+#define CAPTURE_SLOTS    CAPTURE_EVENTS
+#endif
+
+#define CAPTURE(cs, address, value)  gridCapture.record(cs, address, value)
+
+struct CaptureEvent {
+	byte op;                   // register | CAPTURE_WRITE, or a marker
+	byte repeat;               // identical transactions that followed, CAPTURE_ROUND, the chip in bits 6-7
+	byte dt;                   // in CAPTURE_TICK_US, since the previous event to the last repeat
+	byte value[3];             // MSB first
+};
+
+class GridCapture {
+   //public methods
+   public:
+      void begin(Print &out);
+      void record(byte cs, byte address, unsigned long value);
+      void dump(void);
+
+   //private methods
+   private:
+      void push(byte op, byte repeat, byte dt, unsigned long value);
+      void emit(CaptureEvent &e);
+
+      Print *out;                // Serial, 0 until begin()
+      CaptureEvent ring[CAPTURE_SLOTS];
+      byte head;                 // next slot
+      byte count;                // events held
+      unsigned int lost;         // events overwritten since the last dump()
+      byte round;                // events of the last round, which may take repeats
+      byte pins[CAPTURE_CHIPS];  // chip select pin of each chip
+      byte chips;                // chips told
+      unsigned long last;        // micros() of the last event, in whole ticks
+};
+
+extern GridCapture gridCapture;
+
+#else
+
+#define CAPTURE(cs, address, value)
+
+#endif
+
+#endif
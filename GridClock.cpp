@@ -0,0 +1,253 @@
+/* GridClock.cpp = SNTP disciplined UTC clock for time stamping ArduGrid7753 measurements
+========================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridClock.h for a description of the synchronisation scheme.
+
+*/
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include <EtherCard.h>
+#include "GridClock.h"
+
+// NTP packet offsets in the Ethernet buffer (14 bytes Ethernet + 20 bytes IP + 8 bytes UDP = 0x2A)
+#define NTP_RX_P 0x4A   // receive timestamp  (T2) - 32 bits seconds, 32 bits fraction
+#define NTP_TX_P 0x52   // transmit timestamp (T3) - 32 bits seconds, 32 bits fraction
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+// Read a big-endian 32 bits word from the Ethernet buffer
+static unsigned long get32(word pos) {
+	return (unsigned long)Ethernet::buffer[pos]   << 24 |
+	       (unsigned long)Ethernet::buffer[pos+1] << 16 |
+	       (unsigned long)Ethernet::buffer[pos+2] << 8  |
+	       (unsigned long)Ethernet::buffer[pos+3];
+}
+
+// Convert a NTP timestamp at pos in the Ethernet buffer to Unix seconds + milliseconds
+static void getStamp(word pos, unsigned long *sec, unsigned int *ms) {
+	*sec = get32(pos) - NTP_UNIX_OFFSET;
+	*ms  = (unsigned int)(((get32(pos+4) >> 16) * 1000UL) >> 16);
+}
+
+// Difference a - b in milliseconds (valid for differences below 24 days)
+static long diffMs(unsigned long aSec, unsigned int aMs, unsigned long bSec, unsigned int bMs) {
+	return (long)(aSec - bSec) * 1000L + ((long)aMs - (long)bMs);
+}
+
+// Add a signed number of milliseconds to a time stamp
+static void addMs(unsigned long *sec, unsigned int *ms, long delta) {
+	long m = (long)*ms + delta % 1000L;
+	*sec += delta / 1000L;
+	if ( m < 0 )     { m += 1000; (*sec)--; }
+	if ( m >= 1000 ) { m -= 1000; (*sec)++; }
+	*ms = (unsigned int)m;
+}
+
+/** === setAnchor ===
+* Tie the UTC time sec.ms to the millis() value at.
+*/
+void GridClock::setAnchor(unsigned long sec, unsigned int ms, unsigned long at) {
+	anchorSec = sec;
+	anchorMs = ms;
+	anchorMillis = at;
+}
+
+/** === local ===
+* Current UTC time from the anchor and the drift corrected millis() count.
+* Not monotonic - used for the SNTP time stamps T1 and T4.
+*/
+void GridClock::local(unsigned long *sec, unsigned int *ms) {
+	unsigned long at = millis();
+	unsigned long elapsed = at - anchorMillis;
+	// elapsed * driftPpm / 10^6 without overflowing 32 bits
+	long correction = (long)(elapsed / 1000) * driftPpm / 1000L + (long)(elapsed % 1000) * driftPpm / 1000000L;
+	*sec = anchorSec;
+	*ms  = anchorMs;
+	addMs(sec, ms, (long)elapsed + correction);
+	if ( elapsed > NTP_REANCHOR ) setAnchor(*sec, *ms, at); // keep elapsed small for the correction arithmetic
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* Start the clock at 1 Jan 1970 with no drift correction, until the first synchronisation.
+*/
+void GridClock::begin(void) {
+	setAnchor(0, 0, millis());
+	lastSec = 0;
+	lastMs = 0;
+	syncMillis = 0;
+	driftPpm = 0;
+	offset = 0;
+	delayMs = 0;
+	synced = false;
+}
+
+/** === sync ===
+* Send a SNTP request to ntpip and wait up to NTP_TIMEOUT ms for the answer.
+* The first answer sets the clock, the next ones measure the offset, refine the
+* drift estimate and correct the clock.
+* Packets that are not the SNTP answer are handed over to packetLoop().
+* @param ntpip: IP address of the SNTP server
+* @return true when the clock has been synchronised
+*/
+boolean GridClock::sync(uint8_t *ntpip) {
+	unsigned long t1Sec, t2Sec, t3Sec, t4Sec;
+	uint32_t txSec;
+	unsigned int  t1Ms,  t2Ms,  t3Ms,  t4Ms;
+	unsigned long t1Millis, t4Millis;
+	word len;
+
+	local(&t1Sec, &t1Ms);
+	t1Millis = millis();
+	ether.ntpRequest(ntpip, NTP_LOCAL_PORT);
+
+	while ( ( millis() - t1Millis ) < NTP_TIMEOUT )
+	{
+		len = ether.packetReceive();
+		if ( len == 0 ) continue;
+		t4Millis = millis(); // stamp the arrival before any processing
+		local(&t4Sec, &t4Ms);
+		if ( ! ether.ntpProcessAnswer(&txSec, NTP_LOCAL_PORT) )
+		{
+			ether.packetLoop(len); // not for us (ARP, ping...)
+			continue;
+		}
+		getStamp(NTP_RX_P, &t2Sec, &t2Ms);
+		getStamp(NTP_TX_P, &t3Sec, &t3Ms);
+
+		delayMs = (int)( (long)(t4Millis - t1Millis) - diffMs(t3Sec, t3Ms, t2Sec, t2Ms) );
+		if ( delayMs < 0 ) delayMs = 0; // server time resolution coarser than ours
+
+		if ( ! synced )
+		{
+			// First answer: step the clock to the server time plus half the round trip
+			offset = 0;
+			addMs(&t3Sec, &t3Ms, delayMs / 2);
+			setAnchor(t3Sec, t3Ms, t4Millis);
+			synced = true;
+		}
+		else
+		{
+			offset = ( diffMs(t2Sec, t2Ms, t1Sec, t1Ms) + diffMs(t3Sec, t3Ms, t4Sec, t4Ms) ) / 2;
+
+			// The offset accumulated since the last synchronisation is the residual drift
+			unsigned long interval = ( t4Millis - syncMillis ) / 1000; // in seconds
+			if ( ( abs(offset) < NTP_STEP_LIMIT ) && ( interval >= 10 ) )
+			{
+				driftPpm += ( offset * 1000L / (long)interval ) / 2; // damped by half to filter network jitter
+				driftPpm = constrain(driftPpm, -NTP_MAX_DRIFT, NTP_MAX_DRIFT);
+			}
+			addMs(&t4Sec, &t4Ms, offset);
+			setAnchor(t4Sec, t4Ms, t4Millis);
+		}
+		syncMillis = t4Millis;
+		return true;
+	}
+	return false;
+}
+
+/** === isSynced ===
+* @return true once the clock has been synchronised at least once since reboot
+*/
+boolean GridClock::isSynced(void) {
+	return synced;
+}
+
+/** === now ===
+* Monotonic UTC time.
+* @param sec: seconds since 1 Jan 1970
+* @param ms: milliseconds [0 999]
+*/
+void GridClock::now(unsigned long *sec, unsigned int *ms) {
+	local(sec, ms);
+	if ( diffMs(*sec, *ms, lastSec, lastMs) < 0 )
+	{
+		*sec = lastSec; // hold the clock after a negative correction
+		*ms = lastMs;
+	}
+	lastSec = *sec;
+	lastMs = *ms;
+}
+
+/** === printIso ===
+* Print a time stamp as ISO 8601 UTC as accepted by Pachube, ie. 2012-01-14T10:20:30.123Z
+* Date from days since epoch by the civil_from_days algorithm:
+*	http://howardhinnant.github.io/date_algorithms.html
+*/
+void GridClock::printIso(Print &p, unsigned long sec, unsigned int ms) {
+	unsigned long days = sec / 86400UL;
+	unsigned long tod  = sec % 86400UL;
+	unsigned long z    = days + 719468UL;
+	unsigned long era  = z / 146097UL;
+	unsigned long doe  = z - era * 146097UL;
+	unsigned long yoe  = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+	unsigned long doy  = doe - (365*yoe + yoe/4 - yoe/100);
+	unsigned int  mp   = (5*doy + 2) / 153;
+	unsigned int  d    = doy - (153*mp + 2)/5 + 1;
+	unsigned int  m    = mp < 10 ? mp + 3 : mp - 9;
+	unsigned int  y    = yoe + era * 400 + (m <= 2);
+	unsigned int  field[5] = { m, d, (unsigned int)(tod / 3600), (unsigned int)(tod / 60 % 60), (unsigned int)(tod % 60) };
+	const char sep[] = "--T::";
+
+	p.print(y);
+	for (byte i = 0; i < 5; i++)
+	{
+		p.print(sep[i]);
+		if ( field[i] < 10 ) p.print('0');
+		p.print(field[i]);
+	}
+	p.print('.');
+	if ( ms < 100 ) p.print('0');
+	if ( ms < 10 )  p.print('0');
+	p.print(ms);
+	p.print('Z');
+}
+
+/** === getOffset ===
+* @return offset measured at the last synchronisation, in ms (server - local)
+*/
+long GridClock::getOffset(void) {
+	return offset;
+}
+
+/** === getDelay ===
+* @return round trip delay of the last synchronisation, in ms
+*/
+int GridClock::getDelay(void) {
+	return delayMs;
+}
+
+/** === getDrift ===
+* @return frequency correction applied to millis(), in ppm
+*/
+long GridClock::getDrift(void) {
+	return driftPpm;
+}
+
+/** === getSyncAge ===
+* @return milliseconds elapsed since the last successful synchronisation
+*/
+unsigned long GridClock::getSyncAge(void) {
+	return millis() - syncMillis;
+}
@@ -0,0 +1,88 @@
+/* GridClock.h = SNTP disciplined UTC clock for time stamping ArduGrid7753 measurements
+======================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Pachube stamps every value with its own arrival time, which includes DNS, DHCP and the
+delay(1000) after each send. To compare the nine Nanodes together, each measurement is
+now stamped on the board itself with the UTC time at the end of the accumulation window.
+
+The clock is the millis() counter of the ATmega328, anchored to UTC by a SNTP exchange
+(RFC 4330) done with the EtherCard ntpRequest() / ntpProcessAnswer() functions.
+The 4 time stamps of the exchange are used:
+
+	T1 = local time when the request is sent
+	T2 = server time when the request is received   (NTP receive timestamp)
+	T3 = server time when the answer is sent        (NTP transmit timestamp)
+	T4 = local time when the answer is received
+
+	offset = ((T2 - T1) + (T3 - T4)) / 2
+	delay  =  (T4 - T1) - (T3 - T2)
+
+The answer is polled in a tight loop right after the request, so T4 is not delayed by
+the 100 ms pace of the main loop. Between synchronisations the millis() count is corrected
+by the estimated frequency error (drift in ppm) of the Nanode crystal, which is refined at
+each synchronisation from the offset accumulated since the previous one.
+
+The time returned by now() never goes backward: a negative offset correction holds the
+clock until real time has caught up with the last returned value.
+
+	http://tools.ietf.org/html/rfc4330
+	https://github.com/jcw/ethercard
+
+*/
+
+#ifndef GRIDCLOCK_H
+#define GRIDCLOCK_H
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+
+#define NTP_LOCAL_PORT   123          // low byte of the UDP port used by ntpRequest() (EtherCard sends from port 10*256 + this value)
+#define NTP_TIMEOUT      250          // in milliseconds - max wait for the SNTP answer
+#define NTP_UNIX_OFFSET  2208988800UL // seconds between the NTP era (1 Jan 1900) and the Unix epoch (1 Jan 1970)
+#define NTP_STEP_LIMIT   1000         // in milliseconds - larger offsets are stepped without refining the drift
+#define NTP_MAX_DRIFT    20000        // in ppm - bound of the drift estimate (a ceramic resonator is within 0.5 %)
+#define NTP_REANCHOR     3600000UL    // in milliseconds - fold the drift correction into the anchor every hour
+
+class GridClock {
+   //public methods
+   public:
+      void begin(void);
+      boolean sync(uint8_t *ntpip);
+      boolean isSynced(void);
+      void now(unsigned long *sec, unsigned int *ms);
+      void printIso(Print &p, unsigned long sec, unsigned int ms);
+
+      long getOffset(void);
+      int  getDelay(void);
+      long getDrift(void);
+      unsigned long getSyncAge(void);
+
+   //private methods
+   private:
+      void local(unsigned long *sec, unsigned int *ms);
+      void setAnchor(unsigned long sec, unsigned int ms, unsigned long at);
+
+      unsigned long anchorSec;    // UTC seconds at anchorMillis
+      unsigned int  anchorMs;     // UTC milliseconds at anchorMillis
+      unsigned long anchorMillis; // millis() value of the anchor
+      unsigned long lastSec;      // last value returned by now(), for monotonicity
+      unsigned int  lastMs;
+      unsigned long syncMillis;   // millis() value of the last successful synchronisation
+      long driftPpm;              // frequency correction applied to millis(), in ppm
+      long offset;                // last measured offset, in ms
+      int  delayMs;               // last measured round trip delay, in ms
+      boolean synced;
+};
+
+#endif
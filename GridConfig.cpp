@@ -0,0 +1,535 @@
+/* GridConfig.cpp = Remote configuration of the calibration and of the scheduling for ArduGrid7753
+================================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridConfig.h for the commands, their MAC and the EEPROM copies.
+
+*/
+
+#include "GridConfig.h"
+
+#ifdef GRIDCONFIG
+
+#include <stddef.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+#include "ADE7753.h"
+#include "GridMeter.h"
+#include "GridSampler.h"
+
+#define CONFIG_XTEA_DELTA  0x9E3779B9UL
+#define CONFIG_XTEA_CYCLES 32
+#define CONFIG_HALF_MS     10      // in milliseconds - a half line cycle at 50 Hz
+
+GridConfig gridConfig;
+
+struct ConfigParam {
+	char name[18];             // in /config and in p=
+	byte type;                 // CONFIG_INT6 ... CONFIG_GAINS
+	byte offset;               // in MeterConfig, for the parameters of a meter
+};
+
+// in the order of CONFIG_CH1OS ... CONFIG_GAIN
+static const ConfigParam params[CONFIG_PARAMS] PROGMEM = {
+	{ "ch1os",             CONFIG_INT6,       offsetof(MeterConfig, ch1os) },
+	{ "ch2os",             CONFIG_INT6,       offsetof(MeterConfig, ch2os) },
+	{ "irmsos",            CONFIG_INT12,      offsetof(MeterConfig, irmsos) },
+	{ "vrmsos",            CONFIG_INT12,      offsetof(MeterConfig, vrmsos) },
+	{ "calVrms",           CONFIG_REAL,       offsetof(MeterConfig, calVrms) },
+	{ "calIrms",           CONFIG_REAL,       offsetof(MeterConfig, calIrms) },
+	{ "calVpeak",          CONFIG_REAL,       offsetof(MeterConfig, calVpeak) },
+	{ "calIpeak",          CONFIG_REAL,       offsetof(MeterConfig, calIpeak) },
+	{ "calTemp",           CONFIG_REAL,       offsetof(MeterConfig, calTemp) },
+	{ "calActiveEnergy",   CONFIG_REAL,       offsetof(MeterConfig, calActiveEnergy) },
+	{ "calApparentEnergy", CONFIG_REAL,       offsetof(MeterConfig, calApparentEnergy) },
+	{ "calReactiveEnergy", CONFIG_REAL,       offsetof(MeterConfig, calReactiveEnergy) },
+	{ "period",            CONFIG_MILLIS,     0 },
+	{ "linecyc",           CONFIG_HALFCYCLES, 0 },
+	{ "gain",              CONFIG_GAINS,      0 }
+};
+
+static const byte configKey[16] PROGMEM = { CONFIG_KEY };
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === real ===
+* @return float with the IEEE 754 bits of a calibration value
+*/
+static float real(long value) {
+	int32_t bits = value;
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+/** === word32 ===
+* @return uint32_t with 4 bytes, least significant first - 32 bits on the PC as on the ATmega328
+*/
+static uint32_t word32(const byte *p) {
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/** === xtea ===
+* Encipher one 64-bit block with XTEA, 32 cycles
+*/
+static void xtea(uint32_t v[2], const uint32_t k[4]) {
+	uint32_t sum = 0;
+	for (byte i = 0; i < CONFIG_XTEA_CYCLES; i++)
+	{
+		v[0] += ( ( ( v[1] << 4 ) ^ ( v[1] >> 5 ) ) + v[1] ) ^ ( sum + k[sum & 3] );
+		sum += CONFIG_XTEA_DELTA;
+		v[1] += ( ( ( v[0] << 4 ) ^ ( v[0] >> 5 ) ) + v[0] ) ^ ( sum + k[( sum >> 11 ) & 3] );
+	}
+}
+
+/** === isEnd ===
+* @return boolean true at the end of a field of the query
+*/
+static boolean isEnd(char c) {
+	return c == '&' || c == ' ' || c == '\r' || c == '\n' || c == 0;
+}
+
+/** === hexDigits ===
+* Read n bytes written as 2n hexadecimal digits, most significant first
+* @return const char * after the digits, 0 if one is not hexadecimal or if more follow
+*/
+static const char *hexDigits(const char *s, byte *out, byte n) {
+	for (byte i = 0; i < 2 * n; i++, s++)
+	{
+		char c = *s | 0x20; // lower case
+		byte d;
+		if ( *s >= '0' && *s <= '9' ) d = *s - '0';
+		else if ( c >= 'a' && c <= 'f' ) d = c - 'a' + 10;
+		else return 0;
+		out[i / 2] = ( i & 1 ) ? out[i / 2] | d : d << 4;
+	}
+	return isEnd(*s) ? s : 0;
+}
+
+/** === decimal ===
+* @return const char * after the decimal digits of v, 0 if none or if they do not end the field
+*/
+static const char *decimal(const char *s, unsigned long &v) {
+	const char *start = s;
+	v = 0;
+	while ( *s >= '0' && *s <= '9' ) v = v * 10 + ( *s++ - '0' );
+	return ( s == start || ! isEnd(*s) ) ? 0 : s;
+}
+
+/** === stored ===
+* @return long with the value of a parameter of the node in a block, def if it is not changed
+*/
+static long stored(const ConfigBlock &b, byte param, long def) {
+	for (byte i = 0; i < CONFIG_ENTRIES; i++)
+		if ( b.entry[i].key == param ) return b.entry[i].value;
+	return def;
+}
+
+/** === crc ===
+* @return unsigned int with the CRC-16 of a block, its crc field excluded
+*/
+static unsigned int crc(const ConfigBlock &b) {
+	const byte *p = (const byte *)&b;
+	unsigned int c = 0xFFFF;
+	for (byte i = 0; i < offsetof(ConfigBlock, crc); i++) c = _crc16_update(c, p[i]);
+	return c;
+}
+
+/** === copyAddress ===
+* @return void * with the EEPROM address of copy [0 1]
+*/
+static void *copyAddress(byte copy) {
+	return (void *)( CONFIG_EEPROM_START + copy * sizeof(ConfigBlock) );
+}
+
+/** === flashValue ===
+* @return long with the value of a parameter in the tables in flash, or the defaults of the sketch
+*/
+long GridConfig::flashValue(byte meter, byte param) {
+	const byte *p = (const byte *)&flash[meter] + pgm_read_byte(&params[param].offset);
+	int32_t bits;
+	switch ( param )
+	{
+	case CONFIG_PERIOD:  return defaultPeriod;
+	case CONFIG_LINECYC: return METER_LINECYC;
+	case CONFIG_GAIN:    return METER_GAIN;
+	}
+	switch ( getType(param) )
+	{
+	case CONFIG_INT6:    return (char)pgm_read_byte(p);
+	case CONFIG_INT12:   return (int)pgm_read_word(p);
+	}
+	memcpy_P(&bits, p, sizeof(bits));
+	return bits;
+}
+
+/** === read ===
+* Take the newer valid copy of the EEPROM list
+* @return boolean false if neither copy is valid, or of this version
+*/
+boolean GridConfig::read(ConfigBlock &b) {
+	ConfigBlock copy;
+	boolean found = false;
+	for (byte k = 0; k < 2; k++)
+	{
+		eeprom_read_block(&copy, copyAddress(k), sizeof(copy));
+		if ( copy.version != CONFIG_VERSION || copy.crc != crc(copy) ) continue;
+		if ( found && (byte)( copy.sequence - b.sequence ) >= 0x80 ) continue; // older than the other copy
+		b = copy;
+		found = true;
+	}
+	return found;
+}
+
+/** === save ===
+* Write the list into the older EEPROM copy, only the bytes that changed
+*/
+void GridConfig::save(ConfigBlock &b) {
+	b.version = CONFIG_VERSION;
+	b.sequence++;
+	b.crc = crc(b);
+	eeprom_update_block(&b, copyAddress(b.sequence & 1), sizeof(b));
+}
+
+/** === load ===
+* Copy the rows of the node from flash, then apply the changes of the EEPROM list. The
+* entries out of range (a meter the node does not have, a range narrowed by a new build)
+* are left out.
+* @return boolean false if no valid list was found, the tables in flash are then in use
+*/
+boolean GridConfig::load(void) {
+	ConfigBlock b;
+	memcpy_P(rows, flash, count * sizeof(MeterConfig));
+	period = defaultPeriod;
+	linecyc = METER_LINECYC;
+	gain = METER_GAIN;
+	changed = 0;
+	if ( ! read(b) ) return false;
+	for (byte i = 0; i < CONFIG_ENTRIES; i++)
+	{
+		byte key = b.entry[i].key;
+		byte param = key & 0x0F;
+		byte meter = key >> 4;
+		if ( param >= CONFIG_PARAMS || meter >= ( param < CONFIG_PERIOD ? count : 1 ) ) continue;
+		if ( ! valid(param, b.entry[i].value, b) ) continue;
+		set(meter, param, b.entry[i].value);
+		changed++;
+	}
+	return true;
+}
+
+/** === valid ===
+* @param param: CONFIG_CH1OS ... CONFIG_GAIN
+* @param value: as ConfigCommand::value
+* @param b: the EEPROM list, for the update period and line cycle count that go together
+* @return boolean true if the value fits its register and its range
+*/
+boolean GridConfig::valid(byte param, long value, const ConfigBlock &b) {
+	unsigned long p = stored(b, CONFIG_PERIOD, defaultPeriod);
+	unsigned long n = stored(b, CONFIG_LINECYC, METER_LINECYC);
+	switch ( getType(param) )
+	{
+	case CONFIG_INT6:   return value >= -31 && value <= 31;
+	case CONFIG_INT12:  return value >= -2048 && value <= 2047;
+	case CONFIG_REAL:   return real(value) > 0 && real(value) < CONFIG_CAL_MAX; // NaN fails both
+	case CONFIG_GAINS:  return value >= 0 && value <= 0xFF && ( value & 0x07 ) <= GAIN_16
+	                           && ( ( value >> 3 ) & 0x03 ) <= FULLSCALESELECT_0_125V && ( value >> 5 ) <= GAIN_16;
+	case CONFIG_MILLIS: p = value; break;
+	default:
+#ifdef GRIDSAMPLER
+		if ( value != METER_LINECYC ) return false; // the sampler reads the energies itself
+#endif
+		if ( value < CONFIG_LINECYC_MIN || value > CONFIG_LINECYC_MAX ) return false;
+		n = value;
+		break;
+	}
+	return p >= CONFIG_PERIOD_MIN && p <= CONFIG_PERIOD_MAX && p >= n * CONFIG_HALF_MS + CONFIG_MARGIN;
+}
+
+/** === set ===
+* Apply a valid value to the rows in SRAM, or to the parameters of the node
+*/
+void GridConfig::set(byte meter, byte param, long value) {
+	byte *p = (byte *)&rows[meter] + pgm_read_byte(&params[param].offset);
+	int i = value;
+	int32_t bits = value;
+	switch ( param )
+	{
+	case CONFIG_PERIOD:  period = value; return;
+	case CONFIG_LINECYC: linecyc = value; return;
+	case CONFIG_GAIN:    gain = value; return;
+	}
+	switch ( getType(param) )
+	{
+	case CONFIG_INT6:    *(char *)p = value; break;
+	case CONFIG_INT12:   memcpy(p, &i, sizeof(i)); break;
+	default:             memcpy(p, &bits, sizeof(bits)); break;
+	}
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* Copy the rows of the node into SRAM and apply the changes kept in EEPROM
+* @param flash: first row of the node in the shield table, in PROGMEM
+* @param rows: room for count rows in SRAM, given to GridMeter::begin() and to the calibration
+* @param count: meters of the node [1 SCHED_METERS]
+* @param period: in milliseconds - update period of the sketch, REQUEST_RATE
+* @param node: MAC address of the Nanode, 6 bytes in SRAM, the commands for another one are denied
+*/
+void GridConfig::begin(const MeterConfig *flash, MeterConfig *rows, byte count, unsigned long period, const byte *node) {
+	this->flash = flash;
+	this->rows = rows;
+	this->count = count;
+	this->node = node;
+	defaultPeriod = period;
+	restored = load();
+	pending = false;
+	rejected = 0;
+}
+
+/** === command ===
+* Check and keep a change, from the query of GET /set. Writes EEPROM when accepted, about
+* 12 bytes, the rows in SRAM are left as they are until apply().
+* @param query: after "GET /set?", up to a space, at most CONFIG_QUERY_MAX characters read
+* @return byte with CONFIG_OK, CONFIG_BAD_PARAM, CONFIG_BAD_VALUE, CONFIG_DENIED or CONFIG_FULL
+*/
+byte GridConfig::command(const char *query) {
+	ConfigCommand c;
+	ConfigBlock b;
+	byte mac[8], expected[8], key[16];
+	byte fields = 0;           // bit of each field found, p v n h
+	byte v[4];
+	unsigned long m = 0;
+	const char *s = query;
+	while ( s != 0 && s < query + CONFIG_QUERY_MAX && s[0] != 0 && s[1] == '=' )
+	{
+		char name = s[0];
+		s += 2;
+		switch ( name )
+		{
+		case 'p': c.param = find(s); fields |= 0x01; if ( c.param == CONFIG_NONE ) return CONFIG_BAD_PARAM; break;
+		case 'm': s = decimal(s, m); break;
+		case 'v': s = hexDigits(s, v, 4); fields |= 0x02; break;
+		case 'n': s = decimal(s, c.nonce); fields |= 0x04; break;
+		case 'h': s = hexDigits(s, mac, 8); fields |= 0x08; break;
+		}
+		while ( s != 0 && ! isEnd(*s) ) s++;
+		if ( s == 0 || *s != '&' ) break;
+		s++;
+	}
+	if ( s == 0 || fields != 0x0F || m >= ( c.param < CONFIG_PERIOD ? count : 1 ) ) return CONFIG_BAD_PARAM;
+	c.meter = m;
+	memcpy(c.node, node, sizeof(c.node));
+	c.value = (int32_t)( (uint32_t)v[0] << 24 | (uint32_t)v[1] << 16 | (uint32_t)v[2] << 8 | v[3] );
+	memcpy_P(key, configKey, sizeof(key));
+	sign(c, key, expected);
+	byte diff = 0;
+	for (byte i = 0; i < sizeof(mac); i++) diff |= mac[i] ^ expected[i]; // the same time for any MAC
+	if ( ! read(b) )
+	{
+		memset(&b, 0, sizeof(b));
+		for (byte i = 0; i < CONFIG_ENTRIES; i++) b.entry[i].key = CONFIG_FREE;
+	}
+	if ( diff != 0 || c.nonce <= b.nonce )
+	{
+		rejected++;
+		return CONFIG_DENIED;
+	}
+	if ( c.param == CONFIG_DEFAULTS )
+	{
+		for (byte i = 0; i < CONFIG_ENTRIES; i++) b.entry[i].key = CONFIG_FREE;
+	}
+	else
+	{
+		byte k = c.meter << 4 | c.param;
+		byte slot = CONFIG_ENTRIES;
+		if ( ! valid(c.param, c.value, b) ) return CONFIG_BAD_VALUE;
+		for (byte i = 0; i < CONFIG_ENTRIES; i++)
+		{
+			if ( b.entry[i].key == k ) { slot = i; break; }
+			if ( b.entry[i].key == CONFIG_FREE && slot == CONFIG_ENTRIES ) slot = i;
+		}
+		if ( c.value == flashValue(c.meter, c.param) )
+		{   // back to the tables in flash
+			if ( slot < CONFIG_ENTRIES && b.entry[slot].key == k ) b.entry[slot].key = CONFIG_FREE;
+		}
+		else
+		{
+			if ( slot == CONFIG_ENTRIES ) return CONFIG_FULL;
+			b.entry[slot].key = k;
+			b.entry[slot].value = c.value;
+		}
+	}
+	b.nonce = c.nonce;
+	save(b);
+	pending = true;
+	return CONFIG_OK;
+}
+
+/** === apply ===
+* To be called between two measurement cycles, before the health check of the meters:
+* apply the changes accepted since the last call to the rows in SRAM and to the parameters
+* of the node. The caller then writes the registers, see GridMeter::reconfigure().
+* @return boolean true if the configuration was reloaded
+*/
+boolean GridConfig::apply(void) {
+	if ( ! pending ) return false;
+	pending = false;
+	load();
+	return true;
+}
+
+/** === isPending ===
+* @return boolean true if a change waits for apply()
+*/
+boolean GridConfig::isPending(void) {
+	return pending;
+}
+
+/** === isRestored ===
+* @return boolean true if begin() found the list of changes in EEPROM
+*/
+boolean GridConfig::isRestored(void) {
+	return restored;
+}
+
+/** === getCount ===
+* @return byte with the meters of the node, rows in SRAM
+*/
+byte GridConfig::getCount(void) {
+	return count;
+}
+
+/** === getChanged ===
+* @return byte with the parameters that differ from the tables in flash [0 CONFIG_ENTRIES]
+*/
+byte GridConfig::getChanged(void) {
+	return changed;
+}
+
+/** === getRejected ===
+* @return unsigned int with the commands with a wrong MAC or an old nonce since reboot
+*/
+unsigned int GridConfig::getRejected(void) {
+	return rejected;
+}
+
+/** === getPeriod ===
+* @return unsigned long with the update period in use, in milliseconds
+*/
+unsigned long GridConfig::getPeriod(void) {
+	return period;
+}
+
+/** === getLineCyc ===
+* @return unsigned int with the half line cycles of a measurement cycle in use
+*/
+unsigned int GridConfig::getLineCyc(void) {
+	return linecyc;
+}
+
+/** === getGain ===
+* @return byte with the GAIN register in use
+*/
+byte GridConfig::getGain(void) {
+	return gain;
+}
+
+/** === print ===
+* Print the parameters in use as JSON members, "name":value separated by commas
+* @param meter: [0 count-1], or CONFIG_NODE for the update period, line cycle count and gain
+*/
+void GridConfig::print(Print &out, byte meter) {
+	if ( meter == CONFIG_NODE )
+	{
+		out.print(F("\"period\":")); out.print(period);
+		out.print(F(",\"linecyc\":")); out.print(linecyc);
+		out.print(F(",\"gain\":")); out.print(gain);
+		return;
+	}
+	for (byte i = 0; i < CONFIG_PERIOD; i++)
+	{
+		const byte *p = (const byte *)&rows[meter] + pgm_read_byte(&params[i].offset);
+		char name[sizeof(params[i].name)];
+		strcpy_P(name, params[i].name);
+		if ( i > 0 ) out.write(',');
+		out.write('"'); out.print(name); out.print(F("\":"));
+		switch ( getType(i) )
+		{
+		case CONFIG_INT6:  out.print((int)*(const char *)p); break;
+		case CONFIG_INT12: out.print(*(const int *)p); break;
+		default:           out.print(*(const float *)p, 3); break;
+		}
+	}
+}
+
+/** === find ===
+* @param name: parameter name, up to the end of the field ('&', ' ' or 0)
+* @return byte with the parameter, CONFIG_DEFAULTS, or CONFIG_NONE for an unknown name
+*/
+byte GridConfig::find(const char *name) {
+	byte n = 0;
+	while ( ! isEnd(name[n]) && n < sizeof(params[0].name) ) n++;
+	if ( n == 8 && strncmp_P(name, PSTR("defaults"), 8) == 0 ) return CONFIG_DEFAULTS;
+	for (byte i = 0; i < CONFIG_PARAMS; i++)
+		if ( strlen_P(params[i].name) == n && strncmp_P(name, params[i].name, n) == 0 ) return i;
+	return CONFIG_NONE;
+}
+
+/** === getType ===
+* @return byte with the type of a parameter, CONFIG_INT6 ... CONFIG_GAINS
+*/
+byte GridConfig::getType(byte param) {
+	return pgm_read_byte(&params[param].type);
+}
+
+/** === sign ===
+* XTEA CBC-MAC of a command, over 16 bytes: nonce, parameter, meter, value (least significant
+* byte first) and the MAC address of the Nanode. Also used by host/gridconf.cpp.
+* @param c: the command
+* @param key: 16 bytes, CONFIG_KEY, in SRAM
+* @param mac: 8 bytes on return
+*/
+void GridConfig::sign(const ConfigCommand &c, const byte *key, byte *mac) {
+	byte m[16];
+	uint32_t k[4], y[2] = { 0, 0 };
+	for (byte i = 0; i < 4; i++)
+	{
+		m[i] = c.nonce >> ( 8 * i );
+		m[6 + i] = c.value >> ( 8 * i );
+		k[i] = word32(key + 4 * i);
+	}
+	m[4] = c.param;
+	m[5] = c.meter;
+	memcpy(m + 10, c.node, sizeof(c.node));
+	for (byte b = 0; b < sizeof(m); b += 8)
+	{
+		y[0] ^= word32(m + b);
+		y[1] ^= word32(m + b + 4);
+		xtea(y, k);
+	}
+	for (byte i = 0; i < 4; i++)
+	{
+		mac[i] = y[0] >> ( 8 * i );
+		mac[4 + i] = y[1] >> ( 8 * i );
+	}
+}
+
+#endif
@@ -0,0 +1,207 @@
+/* GridConfig.h = Remote configuration of the calibration and of the scheduling for ArduGrid7753
+==============================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+The offsets and calibration of each shield (see NodeConfig.h), the gains, the line cycle
+count and the update period were constants: changing one meant reflashing the Nanodes one
+by one. When GRIDCONFIG is defined below, they can be changed over the LAN through the
+local HTTP endpoint (see GridHttp.h), and the changes are kept in EEPROM:
+
+	GET /config   the parameters in use, as JSON: the update period, the line cycle count,
+	              the GAIN register, then the offsets and calibration of each meter
+	GET /set?p=<parameter>&m=<meter>&v=<value>&n=<nonce>&h=<mac>
+	              change one parameter, p its name as in /config, m the meter for the
+	              offsets and calibration (0 if left out), v the 32 bits of the value in 8
+	              hexadecimal digits (IEEE 754 bits for the calibration), n a decimal
+	              counter and h its MAC in 16 hexadecimal digits. p=defaults drops every
+	              change, back to the tables in flash.
+
+The rows of the shield table of the node are copied into SRAM at begin(), and the changes
+kept in EEPROM are applied to the copies: with GRIDCONFIG the rows given to GridMeter and
+to the calibration of the records are the ones in SRAM, read through CONFIG_BYTE() ...
+CONFIG_FLOAT() below, which read the flash otherwise.
+
+Authentication: h is the XTEA CBC-MAC, under the 128-bit CONFIG_KEY, of the 16 bytes of
+the command (nonce, parameter, meter, value and the MAC address of the Nanode, see sign()).
+The nonce must be above the one of the last command accepted, kept in EEPROM, so that a
+command seen on the LAN cannot be replayed, and the MAC address must be the one of the
+node, so that it cannot be replayed against another Nanode either: CONFIG_KEY is shared by
+the fleet. Failed commands are counted (getRejected()). host/gridconf.cpp signs and sends
+the commands, for the MAC address given with -a. Set CONFIG_KEY before flashing, the same
+for host/gridconf.cpp.
+
+Validation: each value is checked against the width of its register (6-bit CH1OS and
+CH2OS, 12-bit IRMSOS and VRMSOS, the fields of GAIN and the 16-bit LINECYC, see the
+register table of ArduGrid7753.ino), the calibration must be a positive number below
+2^24, the largest 24-bit register value, and the update period must leave CONFIG_MARGIN
+besides the line cycle accumulation.
+
+Live changes: command() only writes EEPROM. The changes are applied by apply(), called by
+the sketch before the health check of the next measurement cycle: no cycle accumulation is
+then in progress, and the window of the load events in progress is dropped by the cycle
+that starts (see GridMeter::watch()). The registers are written and read back by GridMeter::reconfigure(). The
+records waiting for upload are calibrated at upload time, with the calibration in use.
+
+Line cycle count: the calibration stays the one of METER_LINECYC half cycles, GridMeter
+scales the energies of a cycle of another count to METER_LINECYC half cycles (see
+GridMeter.h). The timer driven acquisition (GRIDSAMPLER) reads the energies itself: the
+count is then fixed.
+
+EEPROM: the changes are a list of CONFIG_ENTRIES parameters (ConfigBlock), the others are
+the ones of the tables in flash. A value set back to the one of the flash frees its entry.
+The list is saved alternately into two copies with a sequence number, a layout version
+(CONFIG_VERSION) and a CRC-16: a power loss during a save leaves the previous copy, and a
+block of another version is ignored. Losing both copies (or the key) brings the tables in
+flash back, and the nonce to 0.
+
+	EEPROM map: see ArduGrid7753.ino
+
+*/
+
+#ifndef GRIDCONFIG_H
+#define GRIDCONFIG_H
+
+#include "GridFeatures.h"
+// #define GRIDCONFIG              // uncomment for the remote configuration (about 140 bytes of SRAM with 3 meters)
+
+#define CONFIG_KEY        0x41, 0x72, 0x64, 0x75, 0x47, 0x72, 0x69, 0x64, 0x37, 0x37, 0x35, 0x33, 0x20, 0x6B, 0x65, 0x79 // 128-bit XTEA key - change it
+#define CONFIG_VERSION    1         // layout of ConfigBlock
+#define CONFIG_ENTRIES    8         // parameters changed at most
+#define CONFIG_EEPROM_START 152     // first EEPROM address of the two copies
+#define CONFIG_LINECYC_MIN  100     // half line cycles, 1 s at 50 Hz
+#define CONFIG_LINECYC_MAX  1000    // 10 s
+#define CONFIG_PERIOD_MIN   5000UL  // in milliseconds - shortest update period
+#define CONFIG_PERIOD_MAX   600000UL // in milliseconds - 10 mn
+#define CONFIG_MARGIN       4000UL  // in milliseconds - of the update period besides the accumulation, RMS averages and uploads
+#define CONFIG_CAL_MAX      16777216.0 // above any calibration, 2^24
+#define CONFIG_QUERY_MAX    128     // characters of a query read at most
+
+// Parameters, the offsets and calibration in the order of MeterConfig
+#define CONFIG_CH1OS       0
+#define CONFIG_CH2OS       1
+#define CONFIG_IRMSOS      2
+#define CONFIG_VRMSOS      3
+#define CONFIG_CAL         4        // calVrms ... calReactiveEnergy, 4 to 11
+#define CONFIG_PERIOD      12       // of the node
+#define CONFIG_LINECYC     13
+#define CONFIG_GAIN        14
+#define CONFIG_PARAMS      15
+#define CONFIG_DEFAULTS    15       // p=defaults
+#define CONFIG_NONE        0xFF     // find() of an unknown name
+#define CONFIG_FREE        0xFF     // ConfigEntry key of an unused entry
+#define CONFIG_NODE        0xFF     // print() meter of the parameters of the node
+
+// getType()
+#define CONFIG_INT6        0        // CH1OS, CH2OS  6-bit (S) sign and magnitude [-31 +31]
+#define CONFIG_INT12       1        // IRMSOS, VRMSOS 12-bit (S) [-2048 +2047]
+#define CONFIG_REAL        2        // calibration, raw register value per unit ]0 CONFIG_CAL_MAX[
+#define CONFIG_MILLIS      3        // update period [CONFIG_PERIOD_MIN CONFIG_PERIOD_MAX]
+#define CONFIG_HALFCYCLES  4        // LINECYC 16-bit (U) [CONFIG_LINECYC_MIN CONFIG_LINECYC_MAX]
+#define CONFIG_GAINS       5        // GAIN 8-bit |3 bits PGA2 gain|2 bits full scale|3 bits PGA1 gain|
+
+// command() status
+#define CONFIG_OK          0        // kept in EEPROM, applied at the next cycle
+#define CONFIG_BAD_PARAM   1        // unknown parameter or meter, or a malformed query
+#define CONFIG_BAD_VALUE   2        // out of the range of the register
+#define CONFIG_DENIED      3        // wrong MAC, or a nonce already used
+#define CONFIG_FULL        4        // CONFIG_ENTRIES parameters already changed
+
+// Fields of a MeterConfig row: from SRAM with GRIDCONFIG, from flash otherwise
+#ifdef GRIDCONFIG
+#define CONFIG_BYTE(p)     (*(const byte *)(p))
+#define CONFIG_WORD(p)     (*(const unsigned int *)(p))
+#define CONFIG_FLOAT(p)    (*(const float *)(p))
+#else
+#define CONFIG_BYTE(p)     pgm_read_byte(p)
+#define CONFIG_WORD(p)     pgm_read_word(p)
+#define CONFIG_FLOAT(p)    pgm_read_float(p)
+#endif
+
+#ifdef GRIDCONFIG
+
+#ifndef GRIDHTTP
+#error "GRIDCONFIG is read and set through the HTTP endpoint: define GRIDHTTP too, see GridFeatures.h"
+#endif
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include "NodeConfig.h"
+
+struct ConfigCommand {
+	unsigned long nonce;       // above the one of the last command accepted
+	byte param;                // CONFIG_CH1OS ... CONFIG_GAIN, or CONFIG_DEFAULTS
+	byte meter;                // [0 count-1], 0 for the parameters of the node
+	long value;                // int parameters sign extended, calibration as its IEEE 754 bits
+	byte node[6];              // MAC address of the Nanode the command is for
+};
+
+struct ConfigEntry {
+	byte key;                  // meter << 4 | parameter, CONFIG_FREE if unused
+	long value;                // as ConfigCommand::value
+};
+
+struct ConfigBlock {
+	byte version;              // CONFIG_VERSION
+	byte sequence;             // of the save, the newer copy wins
+	unsigned long nonce;       // of the last command accepted
+	ConfigEntry entry[CONFIG_ENTRIES];
+	unsigned int crc;          // CRC-16 of the bytes above
+};
+
+class GridConfig {
+   //public methods
+   public:
+      void begin(const MeterConfig *flash, MeterConfig *rows, byte count, unsigned long period, const byte *node);
+      byte command(const char *query);
+      boolean apply(void);
+      boolean isPending(void);
+      boolean isRestored(void);
+      byte getCount(void);
+      byte getChanged(void);
+      unsigned int getRejected(void);
+      unsigned long getPeriod(void);
+      unsigned int getLineCyc(void);
+      byte getGain(void);
+      void print(Print &out, byte meter);
+      static byte find(const char *name);
+      static byte getType(byte param);
+      static void sign(const ConfigCommand &c, const byte *key, byte *mac);
+
+   //private methods
+   private:
+      boolean load(void);
+      boolean read(ConfigBlock &b);
+      void save(ConfigBlock &b);
+      boolean valid(byte param, long value, const ConfigBlock &b);
+      void set(byte meter, byte param, long value);
+      long flashValue(byte meter, byte param);
+
+      const MeterConfig *flash;  // rows of the node in the shield table, read with pgm_read_*()
+      MeterConfig *rows;         // the same in SRAM, with the changes applied
+      const byte *node;          // MAC address of the Nanode, 6 bytes, signed with each command
+      byte count;                // meters of the node
+      unsigned long defaultPeriod; // REQUEST_RATE of the sketch
+      unsigned long period;      // in milliseconds - update period in use
+      unsigned int linecyc;      // half line cycles of a measurement cycle in use
+      byte gain;                 // GAIN register in use
+      byte changed;              // entries of the EEPROM list applied
+      boolean restored;          // begin() found a valid block in EEPROM
+      boolean pending;           // a command was accepted since the last apply()
+      unsigned int rejected;     // commands denied since reboot
+};
+
+extern GridConfig gridConfig;
+
+#endif
+
+#endif
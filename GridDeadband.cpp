@@ -0,0 +1,104 @@
+/* GridDeadband.cpp = Report by exception of the datastreams of ArduGrid7753
+========================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridDeadband.h for the rules.
+
+*/
+
+#include <math.h>
+#include "GridDeadband.h"
+
+#ifdef GRIDDEADBAND
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* @param rules: PROGMEM table of the rules, by datastream ID from 0
+* @param count: rows of the table, at most DEADBAND_STREAMS
+*/
+void GridDeadband::begin(const DeadbandRule *rules, byte count) {
+	this->rules = rules;
+	this->count = count > DEADBAND_STREAMS ? DEADBAND_STREAMS : count;
+	for (byte i = 0; i < DEADBAND_CHANNELS; i++)
+	{
+		channels[i].last = DEADBAND_UNSET;
+		channels[i].sentAt = 0;
+	}
+	sent = 0;
+	suppressed = 0;
+}
+
+/** === pass ===
+* Decide whether a value goes into the request, and take it as sent if it does
+* @param meter: ADE7753 of the record [0 SCHED_METERS-1]
+* @param id: datastream ID of the meter, 0 to 8, or of the health, 9 to 19 (meter 0)
+* @param value: in the unit of the datastream
+* @return boolean true if the value is to be sent
+*/
+boolean GridDeadband::pass(byte meter, byte id, float value) {
+	DeadbandChannel *c;
+	float band, step, steps;
+	int heartbeat;
+	byte now = millis() / ( DEADBAND_TICK * 1000UL );
+
+	if ( id >= count || meter >= SCHED_METERS || ( id >= DEADBAND_MEASURES && meter != 0 ) )
+	{
+		sent++; // no rule
+		return true;
+	}
+	c = &channels[id < DEADBAND_MEASURES ? meter * DEADBAND_MEASURES + id : SCHED_METERS * DEADBAND_MEASURES + id - DEADBAND_MEASURES];
+	band = pgm_read_float(&rules[id].band);
+	heartbeat = pgm_read_word(&rules[id].heartbeat);
+	if ( heartbeat > DEADBAND_HEARTBEAT_MAX ) heartbeat = DEADBAND_HEARTBEAT_MAX;
+	heartbeat = heartbeat / DEADBAND_TICK - 1; // in whole ticks, never later than the heartbeat
+	step = band > 0 ? band / DEADBAND_STEPS : 1;
+
+	if ( band >= 0 && c->last != DEADBAND_UNSET && (int)(byte)( now - c->sentAt ) < heartbeat
+	     && ( band > 0 ? ! ( fabs(value - c->last * step) > band - step / 2 ) : fabs(value - c->last * step) < step / 2 ) )
+	{
+		suppressed++;
+		return false;
+	}
+	steps = floor(value / step + 0.5);
+	c->last = fabs(steps) > 32767 ? DEADBAND_UNSET : (int)steps;
+	c->sentAt = now;
+	sent++;
+	return true;
+}
+
+/** === resend ===
+* To be called with the outcome of each request
+* @param all: true if it was not delivered, the next value of every datastream is sent,
+* whatever the record it comes in
+*/
+void GridDeadband::resend(boolean all) {
+	if ( ! all ) return;
+	for (byte i = 0; i < DEADBAND_CHANNELS; i++) channels[i].last = DEADBAND_UNSET;
+}
+
+/** === getSent ===
+* @return unsigned long with the values sent since reboot
+*/
+unsigned long GridDeadband::getSent(void) {
+	return sent;
+}
+
+/** === getSuppressed ===
+* @return unsigned long with the values left out since reboot
+*/
+unsigned long GridDeadband::getSuppressed(void) {
+	return suppressed;
+}
+
+#endif
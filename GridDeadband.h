@@ -0,0 +1,114 @@
+/* GridDeadband.h = Report by exception of the datastreams of ArduGrid7753
+======================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Up to now every datastream went to Pachube with every record, moving or not: the
+temperature, the frequency and the reboot counters cost as many Stash bytes, float
+formatting and ENC28J60 time as the currents. A datastream is now sent only when its value
+has moved by more than its deadband since the value last sent, or when it has been silent
+for its heartbeat, so that Pachube still sees it alive and a missed change is caught up:
+
+	band        in the unit of the datastream, the value is sent when |value - last sent|
+	            is over it. 0 sends every change of the value rounded to an integer (the
+	            counters), a negative band every value
+	heartbeat   in seconds, the value is sent anyway after that long without being sent,
+	            at most DEADBAND_HEARTBEAT_MAX
+
+One rule per datastream ID of a meter, 0 to 8, and of the health of the Nanode, 9 to 19,
+taken from a PROGMEM table of the sketch (see deadbands[] in ArduGrid7753.ino): the rules
+of datastreams 0-8 apply to every meter, each meter keeping its own last values. A
+datastream without a row is always sent, so are the datastreams of the three-phase figures
+and of the load events, which are events already.
+
+The last value sent and the time it was sent are kept in SRAM for each datastream, 3 bytes
+each, 114 for three meters:
+
+	last        the value in steps of band / DEADBAND_STEPS (of 1 with a band of 0), on 16
+	            bits. The band is narrowed by half a step, so that the value Pachube holds
+	            is never further than the band from the one measured. A value beyond 32767
+	            steps is not kept and the next one is sent
+	sentAt      millis() in ticks of DEADBAND_TICK seconds, on 8 bits. The heartbeat is
+	            counted in whole ticks less one: the value goes up to 3 ticks before the
+	            heartbeat, never after it. A datastream left without a pass() for more
+	            than DEADBAND_HEARTBEAT_MAX (a meter unplugged) may then wait a heartbeat
+	            more
+
+pass() takes them as sent as soon as the line is stashed, before the answer of Pachube:
+when a request is not delivered (any status but 2xx, a time out included), resend() forgets
+the last values of every datastream, so that the next value of each is sent, in the retry
+of the record or, when it was rejected for good (4xx), in the next record of its meter.
+Nothing is then lost because it was taken for sent by a request that Pachube did not take.
+A record with nothing left to send is not sent at all (see PachubeClient::skip()).
+
+The values sent and suppressed since reboot are counted, and sent as datastreams 30 and 31
+with the health of the Nanode: their ratio is the saving in Stash lines.
+Without GRIDDEADBAND (see GridFeatures.h) every datastream is sent, as before, and
+datastreams 30 and 31 are not. host/deadbandsim.cpp plays a day of readings through the
+default rules and reports the bytes uploaded with and without them, and the error of the
+values held by Pachube.
+
+*/
+
+#ifndef GRIDDEADBAND_H
+#define GRIDDEADBAND_H
+
+#include "GridFeatures.h"
+// #define GRIDDEADBAND            // uncomment for the report by exception (126 bytes of SRAM with 3 meters)
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include <avr/pgmspace.h>
+#include "GridScheduler.h"
+
+#define DEADBAND_MEASURES       9      // datastreams 0-8 of each meter
+#define DEADBAND_HEALTH         11     // datastreams 9-19 of the health of the Nanode, with meter 0
+#define DEADBAND_STREAMS        ( DEADBAND_MEASURES + DEADBAND_HEALTH )  // rows of the rule table at most
+#define DEADBAND_CHANNELS       ( SCHED_METERS * DEADBAND_MEASURES + DEADBAND_HEALTH )
+#define DEADBAND_STEPS          8      // steps of the last value sent in a band
+#define DEADBAND_UNSET          -32768 // no last value, the next one is sent
+#define DEADBAND_TICK           16     // in seconds - step of the time the value was sent
+#define DEADBAND_HEARTBEAT_MAX  ( 255 * DEADBAND_TICK )  // in seconds - the time sent is kept on 8 bits
+
+struct DeadbandRule {
+	float band;                // in the unit of the datastream, 0 any change, < 0 every value
+	unsigned int heartbeat;    // in seconds - longest silence of the datastream
+};
+
+#ifdef GRIDDEADBAND
+
+struct DeadbandChannel {
+	int last;                  // value last sent in steps of the band, DEADBAND_UNSET before the first one
+	byte sentAt;               // millis() in ticks of DEADBAND_TICK when it was sent
+};
+
+class GridDeadband {
+   //public methods
+   public:
+      void begin(const DeadbandRule *rules, byte count);
+      boolean pass(byte meter, byte id, float value);
+      void resend(boolean all);
+      unsigned long getSent(void);
+      unsigned long getSuppressed(void);
+
+   //private methods
+   private:
+      const DeadbandRule *rules; // PROGMEM, by datastream ID
+      byte count;                // rows of the rule table
+      DeadbandChannel channels[DEADBAND_CHANNELS];
+      unsigned long sent;        // values sent since reboot
+      unsigned long suppressed;  // values left out since reboot
+};
+
+#endif
+
+#endif
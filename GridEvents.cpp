@@ -0,0 +1,281 @@
+/* GridEvents.cpp = Load switch-on / switch-off events from short line cycle windows for ArduGrid7753
+=================================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridEvents.h for the detection of the steps.
+
+*/
+
+#include "GridEvents.h"
+
+#ifdef GRIDEVENTS
+
+#include "GridConfig.h"
+
+#define EVENT_HALF     10                      // in milliseconds - half line cycle at 50 Hz, to date the events
+#define EVENT_DEV_MAX  8191                    // largest deviation taken by the mean, so that it fits an unsigned int
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === signed24 ===
+* @return long with a 24-bit 2-complement register value, LAENERGY or LVARENERGY
+*/
+static long signed24(long x) {
+	return ( x & 0x800000L ) ? x - 0x1000000L : x;
+}
+
+/** === deviation ===
+* @return unsigned int with |d|, at most EVENT_DEV_MAX
+*/
+static unsigned int deviation(long d) {
+	if ( d < 0 ) d = -d;
+	return d > EVENT_DEV_MAX ? EVENT_DEV_MAX : d;
+}
+
+/** === toUnits ===
+* @param raw: step of a window energy
+* @param cal: calibration of the shield, raw value of a 2 s cycle per unit
+* @return int with the step in the unit of the datastream, rounded
+*/
+static int toUnits(long raw, float cal) {
+	float x = raw * ( (float)METER_LINECYC / EVENT_LINECYC ) / cal;
+	if ( x > 32767.0 ) return 32767;
+	if ( x < -32767.0 ) return -32767;
+	return x < 0 ? (int)( x - 0.5 ) : (int)( x + 0.5 );
+}
+
+/** === threshold ===
+* @return unsigned int with the threshold of a step, in raw window energy
+*/
+unsigned int GridEvents::threshold(unsigned int dev, unsigned int min) {
+	unsigned long t = ( (unsigned long)dev * EVENT_NOISE_K ) >> EVENT_BASELINE;
+	return t > min ? t : min;
+}
+
+/** === push ===
+* Queue the event of a settled step, dated within its first window
+* @return boolean false if the queue is full, the event is lost
+*/
+boolean GridEvents::push(LoadTrack &t, byte meter) {
+	const MeterConfig *shield = meters[meter].getConfig();
+	long dp = t.lastP - ( t.baseP >> EVENT_BASELINE );
+	long dq = t.lastQ - ( t.baseQ >> EVENT_BASELINE );
+	long step = dp, part = t.firstP - ( t.baseP >> EVENT_BASELINE );
+	unsigned long offset = 0;
+	if ( (unsigned long)deviation(dq) * t.minP > (unsigned long)deviation(dp) * t.minQ )
+	{   // the step is mostly reactive, date it from Q
+		step = dq;
+		part = t.firstQ - ( t.baseQ >> EVENT_BASELINE );
+	}
+	if ( step != 0 && ( part > 0 ) == ( step > 0 ) )
+	{   // the window took part of the step, the switch was that much before its end
+		if ( part < 0 ) { part = -part; step = -step; }
+		if ( part < step ) offset = (unsigned long)t.span * ( step - part ) / step;
+	}
+	if ( held == EVENT_QUEUE )
+	{
+		lost++;
+		return false;
+	}
+	LoadEvent &e = queue[( head + held ) % EVENT_QUEUE];
+	e.at = t.start + offset;
+	e.active = toUnits(dp, CONFIG_FLOAT(&shield->calActiveEnergy));
+	e.reactive = toUnits(dq, CONFIG_FLOAT(&shield->calReactiveEnergy));
+	e.settle = t.settle > offset ? t.settle - offset : 0;
+	e.meter = meter;
+	held++;
+	return true;
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* @param meters: GridMeter of the board, through GridMeter::begin()
+* @param count: meters watched, 0 to watch none
+*/
+void GridEvents::begin(GridMeter *meters, byte count) {
+	this->meters = meters;
+	this->count = count;
+	head = held = 0;
+	lost = 0;
+	lastPoll = millis();
+	for (byte i = 0; i < count; i++)
+	{
+		tracks[i].state = EVENT_LEARN;
+		tracks[i].count = 0;
+	}
+	calibrate();
+}
+
+/** === calibrate ===
+* Compute the thresholds of the steps from the calibration of each meter, again after a
+* remote change of the calibration (see GridConfig.h)
+*/
+void GridEvents::calibrate(void) {
+	for (byte i = 0; i < count; i++)
+	{
+		const MeterConfig *shield = meters[i].getConfig();
+		LoadTrack &t = tracks[i];
+		t.minP = EVENT_MIN_WATTS * CONFIG_FLOAT(&shield->calActiveEnergy) * EVENT_LINECYC / METER_LINECYC;
+		t.minQ = EVENT_MIN_VARS * CONFIG_FLOAT(&shield->calReactiveEnergy) * EVENT_LINECYC / METER_LINECYC;
+		if ( t.minP == 0 ) t.minP = 1;
+		if ( t.minQ == 0 ) t.minQ = 1;
+	}
+}
+
+/** === due ===
+* @return boolean true every EVENT_POLL ms when meters are watched: time to poll their windows
+*/
+boolean GridEvents::due(void) {
+	if ( count == 0 || millis() - lastPoll < EVENT_POLL ) return false;
+	lastPoll = millis();
+	return true;
+}
+
+/** === add ===
+* Take the window of a meter, given by GridMeter::pollWindow(), or the line cycle energies of
+* a measurement cycle
+* @param meter: [0 count-1]
+* @param active: LAENERGY of the window
+* @param reactive: LVARENERGY of the window
+* @param linecyc: half line cycles of the window, EVENT_LINECYC or METER_LINECYC
+* @param at: millis() when the end of the window was seen
+* @return boolean true if an event was queued, see newest()
+*/
+boolean GridEvents::add(byte meter, long active, long reactive, unsigned int linecyc, unsigned long at) {
+	if ( meter >= count ) return false;
+	LoadTrack &t = tracks[meter];
+	long p = signed24(active) * EVENT_LINECYC / (long)linecyc;
+	long q = signed24(reactive) * EVENT_LINECYC / (long)linecyc;
+	unsigned int window = linecyc * EVENT_HALF;
+	long dp = p - ( t.baseP >> EVENT_BASELINE );
+	long dq = q - ( t.baseQ >> EVENT_BASELINE );
+	unsigned int thrP = threshold(t.devP, t.minP);
+	unsigned int thrQ = threshold(t.devQ, t.minQ);
+	boolean beyond = deviation(dp) > thrP || deviation(dq) > thrQ;
+	boolean steady = false;    // the window goes into the baseline
+	boolean queued = false;
+	switch ( t.state )
+	{
+	case EVENT_LEARN:
+		if ( t.count == 0 )
+		{
+			t.baseP = p << EVENT_BASELINE;
+			t.baseQ = q << EVENT_BASELINE;
+			t.devP = t.devQ = 0;
+		}
+		else steady = true;
+		if ( ++t.count == ( 1 << EVENT_BASELINE ) ) t.state = EVENT_STEADY;
+		break;
+	case EVENT_STEADY:
+		steady = ! beyond;
+		if ( steady ) break;
+		t.state = EVENT_STEP;
+		t.count = 1;
+		t.firstP = p;
+		t.firstQ = q;
+		t.start = at - window;
+		t.span = window;
+		break;
+	case EVENT_STEP:
+		if ( ! beyond ) t.state = EVENT_STEADY; // a spike, the baseline goes on
+		else if ( ++t.count >= EVENT_CONFIRM )
+		{
+			t.state = EVENT_SETTLING;
+			t.stable = 0;
+		}
+		break;
+	case EVENT_SETTLING:
+		t.count++;
+		if ( deviation(p - t.lastP) <= thrP && deviation(q - t.lastQ) <= thrQ )
+		{   // the level started with the previous window
+			if ( t.stable++ == 0 )
+			{
+				t.settle = t.lastAt - t.window - t.start;
+				t.sumP = t.lastP;
+				t.sumQ = t.lastQ;
+			}
+			t.sumP += p;
+			t.sumQ += q;
+		}
+		else t.stable = 0;
+		if ( t.stable < EVENT_SETTLE && t.count < EVENT_SETTLE_MAX ) break;
+		if ( t.stable == 0 )
+		{   // no level, the last window is taken
+			t.settle = at - window - t.start;
+			t.sumP = p;
+			t.sumQ = q;
+		}
+		p = t.lastP = t.sumP / ( t.stable + 1 );
+		q = t.lastQ = t.sumQ / ( t.stable + 1 );
+		dp = p - ( t.baseP >> EVENT_BASELINE );
+		dq = q - ( t.baseQ >> EVENT_BASELINE );
+		if ( deviation(dp) > thrP || deviation(dq) > thrQ )
+		{   // not an inrush back to the baseline
+			queued = push(t, meter);
+		}
+		t.baseP = p << EVENT_BASELINE;
+		t.baseQ = q << EVENT_BASELINE;
+		t.state = EVENT_STEADY;
+		break;
+	}
+	if ( steady )
+	{   // exponential averages of the steady windows
+		t.baseP += dp;
+		t.baseQ += dq;
+		t.devP += deviation(dp) - ( t.devP >> EVENT_BASELINE );
+		t.devQ += deviation(dq) - ( t.devQ >> EVENT_BASELINE );
+	}
+	t.lastP = p;
+	t.lastQ = q;
+	t.lastAt = at;
+	t.window = window;
+	return queued;
+}
+
+/** === peek ===
+* @return LoadEvent* with the oldest event waiting for upload, 0 if none
+*/
+LoadEvent *GridEvents::peek(void) {
+	return held == 0 ? 0 : &queue[head];
+}
+
+/** === newest ===
+* @return LoadEvent* with the last event queued, 0 if none
+*/
+LoadEvent *GridEvents::newest(void) {
+	return held == 0 ? 0 : &queue[( head + held - 1 ) % EVENT_QUEUE];
+}
+
+/** === pop ===
+* Drop the oldest event, once delivered
+*/
+void GridEvents::pop(void) {
+	if ( held == 0 ) return;
+	head = ( head + 1 ) % EVENT_QUEUE;
+	held--;
+}
+
+/** === getLost ===
+* @return unsigned int with the events dropped on a full queue since reboot
+*/
+unsigned int GridEvents::getLost(void) {
+	return lost;
+}
+
+#endif
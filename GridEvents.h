@@ -0,0 +1,140 @@
+/* GridEvents.h = Load switch-on / switch-off events from short line cycle windows for ArduGrid7753
+===============================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+One active energy per update period tells how much was used, not when an appliance was
+switched. Between two measurement cycles the ADE7753 is left running line cycle
+accumulations of EVENT_LINECYC half cycles (200 ms at 50 Hz, see GridMeter::watch()),
+and the loop hands each window to add(), with the LAENERGY and LVARENERGY it latched.
+The windows stop during a measurement cycle (4 s every 10 s): the line cycle energies of
+the cycle are handed to add() as well, scaled to EVENT_LINECYC, so that a slow ramp of the
+load is followed across the gap instead of being taken for a step.
+The detection only uses long integers on the raw register values, per meter:
+
+	baseline     exponential average of P and Q over about EVENT_BASELINE windows, while
+	             the load is steady, and the mean absolute deviation of the windows from it
+	threshold    EVENT_NOISE_K times the mean deviation, at least EVENT_MIN_WATTS and
+	             EVENT_MIN_VARS: a noisy load (a computer, a dimmer) raises its own threshold
+	step         a window beyond the threshold in P or Q, confirmed by EVENT_CONFIRM windows
+	             in a row. A shorter spike (a switching transient) is dropped
+	settling     the step is over when EVENT_SETTLE windows in a row are within the threshold
+	             of each other (a motor inrush, a compressor start), or after EVENT_SETTLE_MAX
+	             windows. The average of the stable windows less the baseline is the step, and an event if it is
+	             still beyond the threshold: an inrush that falls back to the baseline is not
+
+The event is dated within its first window: the part of the step in the first window
+beyond the threshold tells how far into the window the load switched. It is queued as a
+LoadEvent of 11 bytes (millis() of the switch, steps of P and Q in the unit of datastreams
+4 and 6, settling time), the calibration being applied to the step only, at the end. The
+queue holds EVENT_QUEUE events, the later ones are counted as lost until the upload takes
+them (datastreams 27-29, see sendRecord() in ArduGrid7753.ino).
+
+A switch while the loop waits on a request for more than a window, or during the settling
+and the RMS averages of a measurement cycle, is dated at the first window after it.
+Nothing is watched in POWER_SAVE, which suspends the A/D converters.
+
+The events are compiled in when GRIDEVENTS is defined below, in no profile (see
+GridFeatures.h): the tracks of 3 meters and the queue take 226 bytes of SRAM.
+
+host/bench.cpp runs load profiles on the simulated ADE7753 (appliances with inrush, a noisy
+load, a slow ramp) with the measurement cycles in between, and reports the detection
+latency, the error on the time and on the steps, and the false positives.
+
+*/
+
+#ifndef GRIDEVENTS_H
+#define GRIDEVENTS_H
+
+#include "GridFeatures.h"
+// #define GRIDEVENTS              // uncomment for the load switch events (about 230 bytes of SRAM with 3 meters)
+
+#define EVENT_LINECYC      20    // half line cycles per window, 200 ms at 50Hz
+#define EVENT_POLL         50    // in milliseconds - between two reads of the status registers by the loop
+
+#ifdef GRIDEVENTS
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include "GridMeter.h"
+#include "GridScheduler.h"
+
+#define EVENT_BASELINE     3     // the baseline averages about 2^3 windows
+#define EVENT_NOISE_K      4     // threshold in mean deviations of the steady windows
+#define EVENT_MIN_WATTS    25    // smallest step of P, in the unit of datastream 4
+#define EVENT_MIN_VARS     25    // smallest step of Q, in the unit of datastream 6
+#define EVENT_CONFIRM      2     // windows beyond the threshold in a row for a step
+#define EVENT_SETTLE       3     // windows within the threshold of each other for the new level
+#define EVENT_SETTLE_MAX   50    // windows at most before the level is taken as it is, 10 s
+#define EVENT_QUEUE        4     // events waiting for upload
+
+// LoadTrack state
+#define EVENT_LEARN        0     // the first windows make the baseline
+#define EVENT_STEADY       1
+#define EVENT_STEP         2     // beyond the threshold, not yet confirmed
+#define EVENT_SETTLING     3     // confirmed, waiting for the new level
+
+struct LoadEvent {
+	unsigned long at;          // millis() of the switch
+	int  active;               // step of P, in the unit of datastream 4
+	int  reactive;             // step of Q, in the unit of datastream 6
+	unsigned int settle;       // in milliseconds, from the switch to the new level
+	byte meter;                // ADE7753 of the Nanode [0 SCHED_METERS-1]
+};
+
+struct LoadTrack {
+	long baseP, baseQ;         // baseline x 2^EVENT_BASELINE, raw window energies
+	unsigned int devP, devQ;   // mean absolute deviation x 2^EVENT_BASELINE
+	unsigned int minP, minQ;   // EVENT_MIN_WATTS and EVENT_MIN_VARS in raw window energies
+	long firstP, firstQ;       // first window beyond the threshold
+	long lastP, lastQ;         // previous window, then the new level
+	long sumP, sumQ;           // stable windows of the settling
+	unsigned long start;       // millis() of the start of the first window beyond the threshold
+	unsigned int span;         // in milliseconds, length of the first window beyond the threshold
+	unsigned long lastAt;      // millis() of the end of the previous window
+	unsigned int settle;       // in milliseconds, from start to the start of the stable windows
+	unsigned int window;       // in milliseconds, length of the previous window
+	byte state;                // EVENT_LEARN ... EVENT_SETTLING
+	byte count;                // windows in the state
+	byte stable;               // windows within the threshold of the previous one
+};
+
+class GridEvents {
+   //public methods
+   public:
+      void begin(GridMeter *meters, byte count);
+      void calibrate(void);
+      boolean due(void);
+      boolean add(byte meter, long active, long reactive, unsigned int linecyc, unsigned long at);
+      LoadEvent *peek(void);
+      LoadEvent *newest(void);
+      void pop(void);
+      unsigned int getLost(void);
+
+   //private methods
+   private:
+      boolean push(LoadTrack &t, byte meter);
+      unsigned int threshold(unsigned int dev, unsigned int min);
+
+      GridMeter *meters;
+      byte count;                // meters watched
+      LoadTrack tracks[SCHED_METERS];
+      LoadEvent queue[EVENT_QUEUE];
+      byte head;                 // oldest event
+      byte held;                 // events in the queue
+      unsigned int lost;         // events dropped on a full queue since reboot
+      unsigned long lastPoll;    // millis() of the last due()
+};
+
+#endif
+
+#endif
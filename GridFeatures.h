@@ -0,0 +1,109 @@
+/* GridFeatures.h = Build profiles of ArduGrid7753, the optional features compiled in
+==================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+The 32 KB of flash and 2 KB of SRAM of the ATmega328 do not hold every feature at once,
+and each site needs its own set: a billing node does not need the register dumps of the
+commissioning, a node on a LAN without dashboard does not need the local servers. Each
+feature is compiled in only when its GRIDxxx is defined: its code, its SRAM and its calls
+from the sketch are left out otherwise. A function compiled in but never called is
+dropped at link time anyway (-ffunction-sections and --gc-sections of the Arduino IDE).
+
+A profile picks the features of a kind of node, GRIDPROFILE below:
+
+	PROFILE_FIELD           default - the records uploaded to Pachube by exception
+	                        (GRIDDEADBAND), no local servers
+	PROFILE_LEAN            every datastream of every record uploaded, nothing else
+	PROFILE_BILLING         lean + the billing registers (GRIDBILLING), fed by the
+	                        measurement cycles and uploaded as datastreams 32-36
+	PROFILE_COMMISSIONING   lean + register dumps and calibration getters (GRIDDIAG,
+	                        GRIDCALIB), for the shields on the bench
+	PROFILE_DEBUG           lean + the timing counters (GRIDTRACE)
+
+Each feature can also be added to any profile on its own, by uncommenting its define: below
+for the ones of this file, in its header for the others (GRIDPULSE in GridPulse.h,
+GRIDEVENTS in GridEvents.h, GRIDSNAPSHOT in GridSnapshot.h, GRIDBILLING in GridBilling.h,
+GRIDCONFIG in GridConfig.h, GRIDSAMPLER in GridSampler.h, GRIDTRACE in GridTrace.h,
+GRIDCAPTURE in GridCapture.h, GRIDDEADBAND in GridDeadband.h, GRIDPHASES in GridPhases.h).
+Each of these headers includes this one first, so that the profile is seen by every
+source file, ADE7753.cpp included. GRIDPHASES, the three-phase figures, is in no profile:
+every node of the table of ArduGrid7753.ino is wired WIRING_CIRCUITS, a node wired
+WIRING_3PHASE needs it. Neither are the local servers and the remote configuration
+(GRIDSNAPSHOT with GRIDHTTP, GRIDMODBUS, GRIDCONFIG), the load events and the register
+capture (GRIDEVENTS, GRIDCAPTURE): each of them takes 200 to 350 bytes of SRAM on top of
+lean, more than is left for the heap and the stack once the deadband is in. A node that
+needs one of them is built from lean, and its datastream 18 checked. GRIDPULSE is small,
+but without the snapshot it only cross-checks the pulses.
+
+	GRIDHTTP     GET /json, /csv on port 80 (see GridHttp.h), needs GRIDSNAPSHOT, needed by GRIDCONFIG
+	GRIDMODBUS   Modbus/TCP on port 502 (see GridModbus.h), needs GRIDSNAPSHOT
+	GRIDDIAG     register dumps of the ADE7753 driver (printAllRegisters()...) after the
+	             bring-up of each meter, TestRegisters() of the sketch
+	GRIDCALIB    getters of the offsets, gains, dividers and levels of the ADE7753 driver,
+	             offset searches TestInputOffset() and TestRMSoffset() of the sketch
+
+The waveform register (getWaveform()) needs no define: nothing calls it, the linker drops it.
+
+host/profiles.sh builds every profile with arduino-cli and reports its flash and SRAM, the
+SRAM map of ArduGrid7753.ino gives the share of each module. Without an AVR toolchain, the
+static SRAM of the sketch and of its modules was measured from the debug information of a
+build on a PC, with the sizes of avr-gcc (int and pointers 2 bytes, no padding), the string
+literals left in SRAM included, the core and the libraries (Serial, EtherCard) left out.
+These take about 280 bytes (see the SRAM map), the stack needs about 150 at its deepest
+(sendRecord() with the EtherCard calls and the interrupts on top):
+
+	profile          SRAM    left for the heap and the stack
+	FIELD            1521    247
+	LEAN             1395    373
+	BILLING          1548    220
+	COMMISSIONING    1395    373
+	DEBUG            1595    173
+
+Datastream 18 gives the minimum free SRAM of a running node. Flash was not measured,
+host/profiles.sh gives it with the SRAM of the core and the libraries included.
+
+*/
+
+#ifndef GRIDFEATURES_H
+#define GRIDFEATURES_H
+
+#define PROFILE_FIELD          0
+#define PROFILE_LEAN           1
+#define PROFILE_BILLING        2
+#define PROFILE_COMMISSIONING  3
+#define PROFILE_DEBUG          4
+
+#ifndef GRIDPROFILE
+#define GRIDPROFILE  PROFILE_FIELD   // profile of this build, may also be given with -DGRIDPROFILE=n
+#endif
+
+// #define GRIDDIAG                  // uncomment for the register dumps of the ADE7753
+// #define GRIDCALIB                 // uncomment for the calibration getters and offset searches
+// #define GRIDHTTP                  // uncomment for the HTTP endpoint, with GRIDSNAPSHOT (about 20 bytes of SRAM)
+// #define GRIDMODBUS                // uncomment for the Modbus/TCP server, with GRIDSNAPSHOT (about 10 bytes of SRAM)
+
+#if GRIDPROFILE == PROFILE_FIELD
+#define GRIDDEADBAND
+#endif
+
+#if GRIDPROFILE == PROFILE_BILLING
+#define GRIDBILLING
+#endif
+
+#if GRIDPROFILE == PROFILE_COMMISSIONING
+#define GRIDDIAG
+#define GRIDCALIB
+#endif
+
+#if GRIDPROFILE == PROFILE_DEBUG
+#define GRIDTRACE
+#endif
+
+#endif
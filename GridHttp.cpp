@@ -0,0 +1,267 @@
+/* GridHttp.cpp = Local HTTP endpoint serving the latest readings of ArduGrid7753
+==============================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridHttp.h for the pages and the parts of an answer.
+
+*/
+
+#include "GridHttp.h"
+
+#ifdef GRIDHTTP
+
+struct HttpField {
+	byte id;                   // datastream of the Pachube feed, of meter 0
+	byte decimals;             // of the value kept
+	char name[9];              // JSON key
+};
+
+// in the order of SnapReading::value, and of the health fields of GridSnapshot::setHealth()
+static const HttpField meterFields[SNAP_FIELDS] PROGMEM = {
+	{ 0, 2, "vrms" }, { 1, 2, "irms" }, { 4, 2, "active" }, { 5, 2, "apparent" },
+	{ 6, 2, "reactive" }, { 7, 0, "temp" }, { 8, 2, "freq" }
+};
+static const HttpField healthFields[SNAP_HEALTH] PROGMEM = {
+	{ 10, 0, "updates" }, { 11, 0, "reboots" }, { 12, 0, "timeouts" }, { 13, 0, "response" },
+	{ 14, 0, "buffered" }, { 16, 0, "dropped" }, { 18, 0, "free" }
+};
+
+static const char httpJson[] PROGMEM = "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nPragma: no-cache\r\n\r\n{";
+static const char httpCsv[] PROGMEM = "HTTP/1.0 200 OK\r\nContent-Type: text/csv\r\nPragma: no-cache\r\n\r\n";
+static const char httpNotFound[] PROGMEM = "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n\r\nGET /json or /csv\r\n";
+#ifdef GRIDCONFIG
+static const char httpBadRequest[] PROGMEM = "HTTP/1.0 400 Bad Request";
+static const char httpForbidden[] PROGMEM = "HTTP/1.0 403 Forbidden";
+static const char httpOk[] PROGMEM = "HTTP/1.0 200 OK";
+static const char httpHeaders[] PROGMEM = "\r\nContent-Type: application/json\r\nPragma: no-cache\r\n\r\n{";
+
+// GET /set status, in the order of CONFIG_OK ... CONFIG_FULL
+static const char configStatus[][10] PROGMEM = { "ok", "bad_param", "bad_value", "denied", "full" };
+#endif
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+// Print into the TCP payload of the Ethernet buffer, the bytes beyond its end are dropped
+class HttpFiller : public Print {
+   public:
+      HttpFiller(byte *out, unsigned int size) : start(out), ptr(out), end(out + size) {}
+      size_t write(uint8_t c) { if ( ptr == end ) return 0; *ptr++ = c; return 1; }
+      unsigned int length(void) { return ptr - start; }
+
+   private:
+      byte *start, *ptr, *end;
+};
+
+/** === text ===
+* Print a string of flash
+*/
+static void text(Print &out, PGM_P s) {
+	char c;
+	while ( ( c = pgm_read_byte(s++) ) != 0 ) out.write(c);
+}
+
+/** === digits ===
+* Print the n last decimal digits of v, with leading zeros
+*/
+static void digits(Print &out, unsigned long v, byte n) {
+	unsigned long d = 1;
+	while ( --n > 0 ) d *= 10;
+	for ( ; d > 0; d /= 10) out.write('0' + v / d % 10);
+}
+
+/** === fixed ===
+* Print a fixed point value, ie. 23012 with 2 decimals as 230.12
+*/
+static void fixed(Print &out, long v, byte decimals) {
+	unsigned long a = v < 0 ? -v : v;
+	unsigned long scale = 1;
+	for (byte i = 0; i < decimals; i++) scale *= 10;
+	if ( v < 0 ) out.write('-');
+	out.print(a / scale);
+	if ( decimals == 0 ) return;
+	out.write('.');
+	digits(out, a, decimals);
+}
+
+/** === isPath ===
+* @return boolean true if the request path, after "GET /", is the one given
+*/
+static boolean isPath(const char *s, PGM_P path) {
+	byte n = strlen_P(path);
+	return strncmp_P(s, path, n) == 0 && ( s[n] == ' ' || s[n] == '?' );
+}
+
+
+#ifdef GRIDCONFIG
+/** === configPart ===
+* Print a part of the answer of GET /config: the parameters of the node first, then one
+* meter per part
+*/
+static void configPart(Print &out, byte part) {
+	if ( part == 0 )
+	{
+		text(out, httpOk); text(out, httpHeaders);
+		gridConfig.print(out, CONFIG_NODE);
+		text(out, PSTR(",\"changed\":")); out.print(gridConfig.getChanged());
+		text(out, PSTR(",\"pending\":")); out.print(gridConfig.isPending() ? 1 : 0);
+		text(out, PSTR(",\"rejected\":")); out.print(gridConfig.getRejected());
+		text(out, PSTR(",\"meters\":["));
+		return;
+	}
+	text(out, PSTR("{\"meter\":")); out.print(part - 1); out.write(',');
+	gridConfig.print(out, part - 1);
+	text(out, part == gridConfig.getCount() ? PSTR("}]}\r\n") : PSTR("},"));
+}
+
+/** === setAnswer ===
+* Print the answer of GET /set
+*/
+static void setAnswer(Print &out, byte result) {
+	if ( result == CONFIG_OK ) text(out, httpOk);
+	else text(out, result == CONFIG_DENIED ? httpForbidden : httpBadRequest);
+	text(out, httpHeaders);
+	text(out, PSTR("\"status\":\"")); text(out, configStatus[result]); text(out, PSTR("\"}\r\n"));
+}
+#endif
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* @param snapshot: last readings of the meters and health counters, kept by the sketch
+*/
+void GridHttp::begin(GridSnapshot *snapshot) {
+	this->snapshot = snapshot;
+	page = HTTP_NOT_FOUND;
+	part = 1;
+	served = 0;
+	replyTime = 0;
+}
+
+/** === open ===
+* Start the answer of a request
+* @param request: TCP payload of the request, "GET /json HTTP/1.1..." - read here only
+* @return byte with the page of the answer, HTTP_JSON, HTTP_CSV, HTTP_NOT_FOUND, or with
+* GRIDCONFIG HTTP_CONFIG and HTTP_SET, the change of GET /set being kept here
+*/
+byte GridHttp::open(const char *request) {
+	started = micros();
+	part = 0;
+	page = HTTP_NOT_FOUND;
+	if ( strncmp_P(request, PSTR("GET /"), 5) != 0 ) return page;
+	request += 5;
+	if ( isPath(request, PSTR("")) || isPath(request, PSTR("json")) ) page = HTTP_JSON;
+	else if ( isPath(request, PSTR("csv")) ) page = HTTP_CSV;
+#ifdef GRIDCONFIG
+	else if ( isPath(request, PSTR("config")) ) page = HTTP_CONFIG;
+	else if ( strncmp_P(request, PSTR("set?"), 4) == 0 )
+	{
+		result = gridConfig.command(request + 4);
+		page = HTTP_SET;
+	}
+#endif
+	return page;
+}
+
+/** === fill ===
+* Print the next part of the answer: the status line, the headers and the health, then
+* one part per meter
+* @param out: TCP payload of the Ethernet buffer
+* @param size: room left in the Ethernet buffer
+* @return unsigned int with the length of the part
+*/
+unsigned int GridHttp::fill(byte *out, unsigned int size) {
+	HttpFiller f(out, size);
+	if ( ! more() ) return 0;
+	if ( page == HTTP_NOT_FOUND ) text(f, httpNotFound);
+#ifdef GRIDCONFIG
+	else if ( page == HTTP_SET ) setAnswer(f, result);
+	else if ( page == HTTP_CONFIG ) configPart(f, part);
+#endif
+	else if ( part == 0 )
+	{
+		text(f, page == HTTP_JSON ? httpJson : httpCsv);
+		for (byte i = 0; i < SNAP_HEALTH; i++)
+		{
+			const HttpField *h = &healthFields[i];
+			if ( page == HTTP_JSON ) { f.write('"'); text(f, h->name); text(f, PSTR("\":")); }
+			else { f.print(pgm_read_byte(&h->id)); f.write(','); }
+			fixed(f, snapshot->getHealth(i), pgm_read_byte(&h->decimals));
+			if ( page == HTTP_JSON ) f.write(',');
+			else f.println();
+		}
+		if ( page == HTTP_JSON )
+		{
+			text(f, PSTR("\"served\":")); f.print(served);
+			text(f, PSTR(",\"reply_us\":")); f.print(replyTime);
+			text(f, PSTR(",\"meters\":["));
+		}
+	}
+	else
+	{
+		byte m = part - 1;
+		const SnapReading *r = snapshot->getReading(m);
+		if ( page == HTTP_JSON )
+		{
+			text(f, PSTR("{\"meter\":")); f.print(m);
+			text(f, PSTR(",\"utc\":")); f.print(r->utcSec); f.write('.'); digits(f, r->utcMs, 3);
+		}
+		for (byte i = 0; i < SNAP_FIELDS; i++)
+		{
+			const HttpField *v = &meterFields[i];
+			if ( page == HTTP_JSON ) { text(f, PSTR(",\"")); text(f, v->name); text(f, PSTR("\":")); }
+			else { f.print(m * 100 + pgm_read_byte(&v->id)); f.write(','); }
+			fixed(f, r->value[i], pgm_read_byte(&v->decimals));
+			if ( page == HTTP_CSV ) f.println();
+		}
+		if ( page == HTTP_JSON ) text(f, part == snapshot->getMeters() ? PSTR("}]}\r\n") : PSTR("},"));
+	}
+	part++;
+	if ( ! more() )
+	{
+		served++;
+		replyTime = micros() - started;
+	}
+	return f.length();
+}
+
+/** === more ===
+* @return boolean true while parts of the answer are left to fill()
+*/
+boolean GridHttp::more(void) {
+#ifdef GRIDCONFIG
+	if ( page == HTTP_SET ) return part < 1;
+	if ( page == HTTP_CONFIG ) return part < gridConfig.getCount() + 1;
+#endif
+	return part < ( page == HTTP_NOT_FOUND ? 1 : snapshot->getMeters() + 1 );
+}
+
+/** === getServed ===
+* @return unsigned int with the answers since reboot
+*/
+unsigned int GridHttp::getServed(void) {
+	return served;
+}
+
+/** === getReplyTime ===
+* @return unsigned long with the time in microseconds from open() to the last part of the last answer
+*/
+unsigned long GridHttp::getReplyTime(void) {
+	return replyTime;
+}
+
+#endif
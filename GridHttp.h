@@ -0,0 +1,98 @@
+/* GridHttp.h = Local HTTP endpoint serving the latest readings of ArduGrid7753
+============================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+A dashboard on the LAN only saw the readings after their round trip through Pachube. The
+Nanode now answers GET requests on port 80 itself, from the snapshot of the last readings
+taken at each measurement cycle (see GridSnapshot.h), so that a request never waits on the
+ADE7753:
+
+	open()        a request arrived on port 80: its path picks the page. Called before the
+	              Ethernet buffer is overwritten by the answer
+	fill()        the next part of the answer, written into the TCP payload of the Ethernet
+	              buffer, as long as more() is true
+
+Pages:
+
+	GET /  or /json   {"updates":..,"reboots":..,..,"served":..,"reply_us":..,"meters":[{"meter":0,
+	                  "utc":1791234567.123,"vrms":..,"irms":..,"active":..,"apparent":..,
+	                  "reactive":..,"temp":..,"freq":..},..]}
+	GET /csv          one line per datastream, "id,value", with the IDs of the Pachube feed
+	                  (m * 100 + 0, 1, 4-8 for meter m, 10-18 for the health)
+	GET /config       the parameters in use, GET /set?... changes one (only with GRIDCONFIG,
+	                  see GridConfig.h): {"status":"ok"} or the reason of the refusal, with
+	                  400 Bad Request or 403 Forbidden
+	anything else     404
+
+The answer of three meters does not fit in the 700 bytes Ethernet buffer: it is sent in
+one TCP packet per part (EtherCard httpServerReply_with_flags()), the health first, then
+one part per meter. Each part is printed from the field tables in flash in a bounded
+time, fixed point integers only. reply_us is the time from open() to the last part of the
+previous answer, the packets sent in between included.
+
+host/httpload.cpp is the load generator: requests per second and response latency against
+a Nanode, or against this module served on the PC.
+
+Compiled in with GRIDHTTP and GRIDSNAPSHOT, uncommented by hand in GridFeatures.h and
+GridSnapshot.h: no profile has the local servers (see GridFeatures.h).
+
+*/
+
+#ifndef GRIDHTTP_H
+#define GRIDHTTP_H
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include "GridSnapshot.h"
+#include "GridFeatures.h"
+#include "GridConfig.h"
+
+// open() page
+#define HTTP_JSON        0
+#define HTTP_CSV         1
+#define HTTP_NOT_FOUND   2
+#define HTTP_CONFIG      3         // with GRIDCONFIG
+#define HTTP_SET         4
+
+#ifdef GRIDHTTP
+
+#ifndef GRIDSNAPSHOT
+#error "GRIDHTTP answers from the snapshot of the last readings: define GRIDSNAPSHOT too, see GridSnapshot.h"
+#endif
+
+class GridHttp {
+   //public methods
+   public:
+      void begin(GridSnapshot *snapshot);
+      byte open(const char *request);
+      unsigned int fill(byte *out, unsigned int size);
+      boolean more(void);
+      unsigned int getServed(void);
+      unsigned long getReplyTime(void);
+
+   //private methods
+   private:
+      GridSnapshot *snapshot;    // last readings and health counters
+      byte page;                 // HTTP_JSON ... of the answer in progress
+      byte part;                 // next part of the answer, 0 for the status line and the health
+      unsigned int served;       // answers since reboot
+      unsigned long started;     // micros() at open()
+      unsigned long replyTime;   // in microseconds - from open() to the last part of the previous answer
+#ifdef GRIDCONFIG
+      byte result;               // GridConfig::command() status of GET /set
+#endif
+};
+
+#endif
+
+#endif
@@ -0,0 +1,286 @@
+/* GridLog.cpp = Buffered Serial log with compile time levels for ArduGrid7753
+===========================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridLog.h for the levels, the ring and the binary frames.
+
+*/
+
+#include "GridLog.h"
+
+#ifdef UDR0
+#define LOG_USART  // ATmega328: the ring is sent by the TX complete interrupt
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#endif
+
+#define LOG_MASK   ( LOG_BUFFER - 1 )
+
+GridLog gridLog;
+
+#ifdef LOG_USART
+ISR(USART_TX_vect) {
+	gridLog.sent();
+}
+#endif
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === start ===
+* Send the first byte of the ring when the USART is idle
+*/
+void GridLog::start(void) {
+#ifdef LOG_USART
+	byte sreg = SREG;
+	cli();
+	if ( ! sending )
+	{
+		sending = true;
+		sent();
+	}
+	SREG = sreg;
+#endif
+}
+
+/** === commit ===
+* Hand the bytes written since the last commit to the interrupt
+*/
+void GridLog::commit(void) {
+	queued += ( fill - head ) & LOG_MASK;
+	head = fill; // before sending is read: sent() sees the bytes or start() sends them
+	if ( ! sending ) start();
+}
+
+/** === poll ===
+* Stand-in for the TX complete interrupt while the interrupts are off
+*/
+void GridLog::poll(void) {
+#ifdef LOG_USART
+	if ( ! ( UCSR0A & _BV(TXC0) ) ) return;
+	UCSR0A = ( UCSR0A & _BV(U2X0) ) | _BV(TXC0); // clear TXC0, keep the double speed bit
+	sent();
+#endif
+}
+
+/** === put ===
+* Write a value of a binary frame, little endian, into its checksum
+* @param value: unsigned, or signed cast to unsigned
+* @param bytes: [1 4]
+*/
+void GridLog::put(unsigned long value, byte bytes) {
+	for (byte i = 0; i < bytes; i++)
+	{
+		sum += (byte)value;
+		write((byte)value);
+		value >>= 8;
+	}
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* Set the USART, and enable the TX complete interrupt. The log waits for room until
+* setBlocking(false)
+* @param baud: of Serial
+*/
+void GridLog::begin(unsigned long baud) {
+	Serial.begin(baud);
+	head = tail = fill = 0;
+	depth = 0;
+	failed = false;
+	sending = false;
+	blocking = true;
+	dropped = 0;
+	queued = 0;
+#ifdef LOG_USART
+	UCSR0B |= _BV(TXCIE0);
+#endif
+}
+
+/** === open ===
+* Start a message: its bytes are sent whole by close(), or dropped
+*/
+void GridLog::open(void) {
+	if ( depth++ == 0 ) failed = false;
+}
+
+/** === close ===
+* End a message, and send it if all its bytes fitted in the ring
+*/
+void GridLog::close(void) {
+	if ( depth == 0 || --depth != 0 ) return;
+#ifdef LOG_USART
+	if ( ! failed ) commit();
+#endif
+	failed = false;
+}
+
+/** === next ===
+* End the message and start the next one: a helper printing several lines sends each whole
+*/
+void GridLog::next(void) {
+	close();
+	open();
+}
+
+/** === write ===
+* Queue one byte, sent by the TX complete interrupt once its message is closed
+* @param c: byte
+* @return size_t with 1, or 0 if the ring is full and the log does not wait
+*/
+size_t GridLog::write(uint8_t c) {
+#ifdef LOG_USART
+	if ( failed ) return 0;
+	byte next = ( fill + 1 ) & LOG_MASK;
+	while ( next == tail )
+	{
+		if ( ! blocking )
+		{
+			fill = head; // the message is dropped whole
+			dropped++;
+			if ( depth != 0 ) failed = true;
+			return 0;
+		}
+		commit(); // the bytes of the message before this one must go to make room
+		if ( ! ( SREG & _BV(SREG_I) ) ) poll(); // in an ISR, the interrupt cannot fire
+	}
+	buffer[fill] = c;
+	fill = next;
+	if ( depth == 0 ) commit(); // a byte out of any message is a message
+	return 1;
+#else
+	queued++;
+	return Serial.write(c);
+#endif
+}
+
+/** === text ===
+* Queue a string stored in PROGMEM
+*/
+void GridLog::text(PGM_P s) {
+	char c;
+	while ( ( c = pgm_read_byte(s++) ) != 0 ) write(c);
+}
+
+/** === hex ===
+* Queue the low digits of a value in hexadecimal, with the leading zeros: a 24-bit
+* register takes 6 digits whatever its sign
+* @param value: unsigned, or signed cast to unsigned
+* @param digits: [1 8]
+*/
+void GridLog::hex(unsigned long value, byte digits) {
+	char t[8];
+	for (byte i = digits; i > 0; i--)
+	{
+		byte d = value & 0x0F;
+		t[i - 1] = d < 10 ? '0' + d : 'A' - 10 + d;
+		value >>= 4;
+	}
+	for (byte i = 0; i < digits; i++) write(t[i]);
+}
+
+/** === record ===
+* Queue the raw registers of a record, on one line in hexadecimal, or as a binary frame
+* with GRIDLOG_BINARY
+* @param rec: record of a measurement cycle
+*/
+void GridLog::record(const GridRecord &rec) {
+	open(); // whole or not at all, the decoder counts on it
+#ifdef GRIDLOG_BINARY
+	write(LOG_SYNC);
+	sum = 0;
+	put(LOG_FRAME_RECORD, 1);
+	put(LOG_RECORD_BYTES, 1);
+	put(rec.utcSec, 4);
+	put(rec.utcMs, 2);
+	put(rec.vrms, 4);
+	put(rec.irms, 4);
+	put(rec.vpeak, 4);
+	put(rec.ipeak, 4);
+	put(rec.activeEnergy, 4);
+	put(rec.apparentEnergy, 4);
+	put(rec.reactiveEnergy, 4);
+	put(rec.period, 2);
+	put(rec.temp, 1);
+	put(rec.meter, 1);
+	write(sum);
+#else
+	text(PSTR("--> raw ")); hex(rec.meter, 1);
+	text(PSTR(" ")); hex(rec.utcSec, 8);
+	text(PSTR(".")); hex(rec.utcMs, 3);
+	text(PSTR(" V ")); hex(rec.vrms, 6);
+	text(PSTR(" I ")); hex(rec.irms, 6);
+	text(PSTR(" Vp ")); hex(rec.vpeak, 6);
+	text(PSTR(" Ip ")); hex(rec.ipeak, 6);
+	text(PSTR(" P ")); hex(rec.activeEnergy, 6);
+	text(PSTR(" S ")); hex(rec.apparentEnergy, 6);
+	text(PSTR(" Q ")); hex(rec.reactiveEnergy, 6);
+	text(PSTR(" PER ")); hex(rec.period, 4);
+	text(PSTR(" T ")); hex(rec.temp, 2);
+	text(PSTR("\r\n"));
+#endif
+	close();
+}
+
+/** === setBlocking ===
+* @param on: true to wait for room in the ring, as Serial does, false to drop
+*/
+void GridLog::setBlocking(boolean on) {
+	blocking = on;
+}
+
+/** === flush ===
+* Wait until the ring is sent, from the polling loop if the interrupts are off
+*/
+void GridLog::flush(void) {
+#ifdef LOG_USART
+	while ( sending )
+	{
+		if ( ! ( SREG & _BV(SREG_I) ) ) poll();
+	}
+#endif
+}
+
+/** === sent ===
+* The USART has sent a byte: load the next one. Called by the TX complete interrupt
+*/
+void GridLog::sent(void) {
+#ifdef LOG_USART
+	if ( tail == head )
+	{
+		sending = false;
+		return;
+	}
+	UDR0 = buffer[tail];
+	tail = ( tail + 1 ) & LOG_MASK;
+#endif
+}
+
+/** === getDropped ===
+* @return unsigned int with the messages dropped because the ring was full, since reboot
+*/
+unsigned int GridLog::getDropped(void) {
+	return dropped;
+}
+
+/** === getQueued ===
+* @return unsigned long with the bytes sent or being sent since reboot, dropped messages excluded
+*/
+unsigned long GridLog::getQueued(void) {
+	return queued;
+}
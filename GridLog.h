@@ -0,0 +1,152 @@
+/* GridLog.h = Buffered Serial log with compile time levels for ArduGrid7753
+=========================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Serial.print() waits as soon as the 64 bytes of the HardwareSerial buffer are full, ie. for
+86.8 us per byte at 115200 baud: the 700 to 900 bytes printed around each measurement held
+the loop for 50 to 70 ms per update, on top of the float formatting of every value with 10
+decimals (Serial.println(x, DEC) takes DEC as the number of digits).
+
+The log now goes into a ring of LOG_BUFFER bytes, sent by the USART TX complete interrupt
+(USART_TX_vect, one byte per interrupt, about 3 us each). HardwareSerial keeps its UDRE
+interrupt and its receive side: Serial.begin() sets the baud rate, but nothing else may
+write to Serial, the USART would then be fed twice. The sketch and its modules print on
+gridLog, which is a Print, so that print(), println(), printIso() and the dumps work as
+before.
+
+Each message, ie. the statements of one LOG_ERROR() ... LOG_DEBUG(), goes out whole or not
+at all: its bytes are written after the ones being sent, and handed to the interrupt by
+close() only once they all fit. Once the loop runs, a message that does not fit in the ring
+is dropped, never waited for, and counted (getDropped()). setBlocking(true) waits for room
+instead, as Serial did: from begin() to the end of setup(), for the dumps of GridTrace,
+GridSampler and GridCapture, and in the watchdog ISR, where flush() sends the ring from the
+polling loop as the interrupts are off.
+
+The ring is LOG_BUFFER bytes, 11 ms at 115200 baud. The messages printed by the loop at
+LOG_INFO and above are kept under LOG_LINE bytes, half the ring, so that two of them written
+in a row both fit: a helper printing several lines calls next() between them, and the line
+of each update is now two. The hexadecimal record of LOG_DEBUG, about 103 bytes, fits an
+empty ring. The 128 bytes are paid for by the measurement queue of ArduGrid7753.ino, which
+holds 2 records instead of 4 as each record is buffered as soon as it is pushed.
+
+Levels - each message goes through one of the macros below, with the statements that print
+it as argument:
+
+	LOG_ERROR()   records or uploads lost, chip not answering, reboot
+	LOG_WARN()    no mains, retries, time outs
+	LOG_INFO()    two lines per update and per upload, load events, three-phase figures
+	LOG_DEBUG()   raw and calibrated values of each record, the '.' of the idle loop
+
+The messages above LOG_LEVEL are compiled out with their strings: no code, no flash.
+
+Records - record() prints the raw registers of a GridRecord in hexadecimal, on one line
+with fixed widths, instead of 9 decimal lines: no 32-bit division per digit. With
+GRIDLOG_BINARY defined below, the record goes as a binary frame instead, 42 bytes instead
+of about 100, decoded by host/logdecode.cpp from a capture of the Serial port:
+
+	LOG_SYNC  tag  length  payload (little endian)  checksum (sum of tag, length, payload)
+
+LOG_SYNC is never in the text, which is 7-bit ASCII. A frame is written whole or dropped.
+
+On a PC (host/), without the USART registers, the log goes straight to Serial.
+
+*/
+
+#ifndef GRIDLOG_H
+#define GRIDLOG_H
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include <avr/pgmspace.h>
+#include "GridRecord.h"
+
+// #define GRIDLOG_BINARY        // uncomment to send the records as binary frames for host/logdecode.cpp
+
+#define LOG_LEVEL_NONE   0
+#define LOG_LEVEL_ERROR  1
+#define LOG_LEVEL_WARN   2
+#define LOG_LEVEL_INFO   3
+#define LOG_LEVEL_DEBUG  4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL        LOG_LEVEL_INFO   // messages of a higher level are compiled out
+#endif
+
+#define LOG_BUFFER       128     // bytes of the ring, a power of 2 above a binary frame (LOG_RECORD_BYTES + 4)
+#define LOG_LINE         64      // longest message printed by the loop, half the ring
+#define LOG_SYNC         0xA5    // first byte of a binary frame
+#define LOG_FRAME_RECORD 'R'     // tag of a GridRecord frame
+#define LOG_RECORD_BYTES 38      // its payload
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...)   do { gridLog.open(); __VA_ARGS__; gridLog.close(); } while (0)
+#else
+#define LOG_ERROR(...)   do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...)    do { gridLog.open(); __VA_ARGS__; gridLog.close(); } while (0)
+#else
+#define LOG_WARN(...)    do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...)    do { gridLog.open(); __VA_ARGS__; gridLog.close(); } while (0)
+#else
+#define LOG_INFO(...)    do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...)   do { gridLog.open(); __VA_ARGS__; gridLog.close(); } while (0)
+#else
+#define LOG_DEBUG(...)   do {} while (0)
+#endif
+
+class GridLog : public Print {
+   //public methods
+   public:
+      void begin(unsigned long baud);
+      void open(void);
+      void close(void);
+      void next(void);
+      virtual size_t write(uint8_t c);
+      void text(PGM_P s);
+      void hex(unsigned long value, byte digits);
+      void record(const GridRecord &rec);
+      void setBlocking(boolean on);
+      void flush(void);
+      void sent(void);
+      unsigned int getDropped(void);
+      unsigned long getQueued(void);
+      using Print::write;        // write(str) and write(buf, size)
+
+   //private methods
+   private:
+      void start(void);
+      void commit(void);
+      void poll(void);
+      void put(unsigned long value, byte bytes);
+
+      byte buffer[LOG_BUFFER];
+      volatile byte head;        // end of the bytes handed to sent()
+      volatile byte tail;        // next byte sent by sent()
+      byte fill;                 // next byte written by write(), from head on until commit()
+      byte depth;                // messages open, nested LOG_ macros included
+      boolean failed;            // a byte of the open message did not fit, it is dropped
+      volatile boolean sending;  // a byte of the ring is in the USART
+      boolean blocking;          // write() waits for room instead of dropping
+      byte sum;                  // checksum of the frame being written
+      unsigned int dropped;      // messages dropped since reboot
+      unsigned long queued;      // bytes handed to sent() since reboot
+};
+
+extern GridLog gridLog;
+
+#endif
@@ -0,0 +1,552 @@
+/* GridMeter.cpp = Line cycle measurement of the ADE7753 into a record for ArduGrid7753
+=====================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridMeter.h for the sequence of a measurement.
+
+*/
+
+#include <avr/pgmspace.h>
+#include "GridMeter.h"
+#include "GridConfig.h"
+#include "GridTrace.h"
+#include "GridLog.h"
+#include "GridWatchdog.h"
+
+// Registers written by configure(), read back by verify()
+static const byte configRegs[] PROGMEM = {
+	GAIN, CH1OS, CH2OS,                                 // analogSetup()
+	IRMSOS, VRMSOS,                                     // rmsSetup()
+	WGAIN, WDIV, APOS, VAGAIN, VADIV, PHCAL,            // energySetup()
+	CFNUM, CFDEN,                                       // frequencySetup()
+	ZXTOUT, SAGCYC, SAGLVL, IPKLVL, VPKLVL              // miscSetup(), TMODE is left out
+};
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === signMagnitude ===
+* Offset as written to CH1OS / CH2OS by analogSetup(), integrator bit off
+* @return byte with the sign on bit 5 and the magnitude on bits 0-4
+*/
+static byte signMagnitude(char os) {
+	return ( os < 0 ) ? ( 0x20 | -os ) : os;
+}
+
+/** === gain ===
+* @return byte with the GAIN register, METER_GAIN or the one set remotely (see GridConfig.h)
+*/
+static byte gain(void) {
+#ifdef GRIDCONFIG
+	return gridConfig.getGain();
+#else
+	return METER_GAIN;
+#endif
+}
+
+/** === normalise ===
+* Scale the energy of an accumulation of linecyc half cycles to METER_LINECYC half cycles
+* @param raw: 24-bit register value, 2-complement if isSigned
+* @return long with the raw 24-bit register value of METER_LINECYC half cycles
+*/
+static long normalise(long raw, unsigned int linecyc, boolean isSigned) {
+	if ( linecyc == METER_LINECYC ) return raw;
+	if ( isSigned && ( raw & 0x800000L ) ) raw -= 0x1000000L;
+	float x = (float)raw * METER_LINECYC / linecyc;
+	return (long)( x < 0 ? x - 0.5 : x + 0.5 ) & 0xFFFFFFL;
+}
+
+/** === mask ===
+* @return bits of a configuration register that hold data, the others read as 0 or as the sign
+*/
+static unsigned int mask(byte reg) {
+	switch ( reg )
+	{
+	case CH1OS:  return 0xBF;               // bit 6 not used
+	case CH2OS:  case PHCAL: return 0x3F;   // 6-bit
+	case APOS:   return 0xFFFF;
+	case WGAIN:  case VAGAIN: case IRMSOS: case VRMSOS:
+	case CFNUM:  case CFDEN:  case ZXTOUT:
+		return 0x0FFF;                      // 12-bit
+	}
+	return 0xFF;
+}
+
+/** === expected ===
+* @return value of a configuration register once configure() has been applied
+*/
+unsigned int GridMeter::expected(byte reg) {
+	switch ( reg )
+	{
+	case GAIN:   return gain();
+	case CH1OS:  return signMagnitude((char)CONFIG_BYTE(&config->ch1os));
+	case CH2OS:  return signMagnitude((char)CONFIG_BYTE(&config->ch2os));
+	case IRMSOS: return CONFIG_WORD(&config->irmsos) & 0x0FFF;
+	case VRMSOS: return CONFIG_WORD(&config->vrmsos) & 0x0FFF;
+	case PHCAL:  return METER_PHCAL;
+	case CFNUM:  return METER_CFNUM;
+	case CFDEN:  return METER_CFDEN;
+	case ZXTOUT: return METER_ZXTOUT;
+	}
+	return 0;
+}
+
+/** === reset ===
+* Software reset of the ADE7753, all the registers are back to their power up values
+* @return byte with METER_OK, METER_NO_RESET if the end of the reset was not flagged
+*/
+byte GridMeter::reset(void) {
+	unsigned long start = millis();
+	meter.setMode( SWRST );
+	delayMicroseconds(METER_SWRST_US);
+	while ( ! ( meter.getInterruptStatus() & RESET ) )
+	{
+		if ( ( millis() - start ) > METER_RESET_TIMEOUT ) return METER_NO_RESET;
+	}
+	meter.getresetInterruptStatus(); // Clear RESET
+	suspended = true; // the A/D converters just started, let them settle before the next cycle
+	return METER_OK;
+}
+
+/** === configure ===
+* Write the settings of the Olimex Energy Shield of this GridMeter
+*/
+void GridMeter::configure(void) {
+	byte g = gain();
+	meter.analogSetup(g & 0x07, g >> 5, (char)CONFIG_BYTE(&config->ch1os), (char)CONFIG_BYTE(&config->ch2os),
+	                  ( g >> 3 ) & 0x03, INTEGRATOR_OFF);  // GAIN1, GAIN2, CH1OS, CH2OS, Range_ch1, integrator_ch1
+	meter.rmsSetup( (int)CONFIG_WORD(&config->irmsos), (int)CONFIG_WORD(&config->vrmsos) ); // IRMSOS,VRMSOS  12-bit (S) [-2048 +2048] -- Refer to spec page 25, 26
+	meter.energySetup(0, 0, 0, 0, 0, METER_PHCAL); // WGAIN,WDIV,APOS,VAGAIN,VADIV,PHCAL  -- Refer to spec page 39, 31, 46, 44, 52, 53
+	meter.frequencySetup(METER_CFNUM, METER_CFDEN); // CFNUM,CFDEN  12-bit (U) -- for CF pulse output  -- Refer to spec page 31
+	meter.miscSetup(METER_ZXTOUT, 0, 0, 0, 0, 0); // ZXTOUT,SAGCYC,SAGLVL,IPKLVL,VPKLVL,TMODE
+}
+
+/** === verify ===
+* Read back the configuration registers
+* @return byte with METER_OK, METER_MISMATCH on the first register that differs
+*/
+byte GridMeter::verify(void) {
+	for (byte i = 0; i < sizeof(configRegs); i++)
+	{
+		byte reg = pgm_read_byte(&configRegs[i]);
+		unsigned int m = mask(reg);
+		unsigned int v = ( m > 0xFF ) ? meter.read16(reg) : meter.read8(reg);
+		if ( ( v & m ) != expected(reg) ) return METER_MISMATCH;
+	}
+	return METER_OK;
+}
+
+
+/** === average ===
+* Poll while an RMS average is taken, giving up when the budget is spent
+* @param s: METER_VRMS or METER_IRMS
+* @param step: phase of GridTrace.h, for GridWatchdog
+*/
+void GridMeter::average(byte s, byte step) {
+	gridWatchdog.step(step, METER_RMS_BUDGET);
+	while ( poll() == s && gridWatchdog.alive() ) ;
+	gridWatchdog.done();
+	if ( state != s ) return;
+	LOG_WARN(gridLog.text(PSTR("--> RMS - no AC input\n")));
+	end(false);
+}
+
+/** === end ===
+* End of the cycle, the record can be taken by read()
+* @param withMains: false when the mains was lost, or a wait gave up, the RMS values,
+* the period and the energies are then 0
+*/
+void GridMeter::end(boolean withMains) {
+	if ( state == METER_CYCLE ) cycleEnd = millis();
+	mains = withMains;
+	if ( ! mains )
+	{
+		vrms = irms = 0;
+		period = 0;
+		activeEnergy = apparentEnergy = reactiveEnergy = 0;
+	}
+	state = METER_READY;
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* Bring-up of the ADE7753: reset, die revision check, configuration written and read back.
+* The SPI is opened and left open.
+* @param config: row of the shield table in PROGMEM, chip select pin, CH1OS, CH2OS [-31 +31],
+* IRMSOS, VRMSOS [-2048 +2047] and calibration of the shield
+* @return byte with METER_OK, METER_NO_RESET, METER_NO_CHIP or METER_MISMATCH
+*/
+byte GridMeter::begin(const MeterConfig *config) {
+	byte status;
+	this->config = config;
+	meter = ADE7753(CONFIG_BYTE(&config->cs));
+	repairs = 0;
+	state = METER_IDLE;
+	meter.setSPI();  // Initialise SPI communication ADE7753 IC
+	status = reset();
+	dierev = meter.read8(DIEREV);
+	if ( dierev == 0x00 || dierev == 0xFF ) return METER_NO_CHIP;
+	if ( status != METER_OK ) return status;
+	configure();
+	return verify();
+}
+
+/** === check ===
+* Health check, to be called before startCycle() which clears the RESET flag. A chip that
+* went through a reset is reset and reconfigured, a corrupted configuration is re-applied.
+* The SPI is opened and left open.
+* @return byte with METER_OK, possibly after a repair, or the status of the failed repair
+*/
+byte GridMeter::check(void) {
+	byte status;
+	meter.setSPI();
+	if ( ( meter.getInterruptStatus() & RESET ) || meter.read8(DIEREV) != dierev )
+	{
+		repairs++;
+		status = reset();
+		if ( meter.read8(DIEREV) != dierev ) return METER_NO_CHIP;
+		if ( status != METER_OK ) return status;
+		configure();
+		return verify();
+	}
+	if ( verify() == METER_OK ) return METER_OK;
+	repairs++;
+	configure();
+	return verify();
+}
+
+/** === reconfigure ===
+* Write the configuration again and read it back, after the offsets or the gains were
+* changed remotely (see GridConfig.h). Not counted as a repair. The SPI is opened and
+* left open.
+* @return byte with METER_OK or METER_MISMATCH
+*/
+byte GridMeter::reconfigure(void) {
+	meter.setSPI();
+	configure();
+	return verify();
+}
+
+/** === getDieRev ===
+* @return byte with the die revision read by begin()
+*/
+byte GridMeter::getDieRev(void) {
+	return dierev;
+}
+
+/** === getRepairs ===
+* @return number of times check() had to re-apply the configuration since begin()
+*/
+unsigned int GridMeter::getRepairs(void) {
+	return repairs;
+}
+
+/** === getConfig ===
+* @return row of the shield table given to begin(): read the calibration with CONFIG_FLOAT()
+*/
+const MeterConfig *GridMeter::getConfig(void) {
+	return config;
+}
+
+/** === getLineCyc ===
+* @return unsigned int with the half line cycles of an accumulation, METER_LINECYC or the
+* count set remotely (see GridConfig.h)
+*/
+unsigned int GridMeter::getLineCyc(void) {
+#ifdef GRIDCONFIG
+	return gridConfig.getLineCyc();
+#else
+	return METER_LINECYC;
+#endif
+}
+
+/** === getCycleBudget ===
+* @return unsigned int with the budget of the wait for CYCEND in ms, METER_CYCEND_TIMEOUT
+* scaled to the line cycle count
+*/
+unsigned int GridMeter::getCycleBudget(void) {
+	return (unsigned long)METER_CYCEND_TIMEOUT * getLineCyc() / METER_LINECYC;
+}
+
+/** === startCycle ===
+* Open the SPI and start a line cycle accumulation
+*/
+void GridMeter::startCycle(void) {
+	TRACE_BEGIN(TRACE_SPI);
+	meter.setSPI();  // Initialise SPI communication ADE7753 IC
+	resume();
+	start();
+	TRACE_END(TRACE_SPI);
+}
+
+/** === resume ===
+* First part of startCycle(), with the SPI open: line cycle accumulation mode, and the
+* A/D converters back on if they were suspended
+*/
+void GridMeter::resume(void) {
+	meter.setMode( CYCMODE | METER_DISCF ); // set mode for Line Cycle Accumulation, also clears ASUSPEND
+	if ( suspended )
+	{
+		delay(METER_SETTLE); // let the A/D converters and the filters settle
+		suspended = false;
+	}
+}
+
+/** === start ===
+* Second part of startCycle(), with the SPI open and resume() done: start the accumulation.
+* GridScheduler calls it for all the meters in a row to align their windows.
+*/
+void GridMeter::start(void) {
+	meter.setLineCyc(getLineCyc());
+	PULSE_START(pulses); // the accumulation restarts with the write of LINECYC
+	meter.setInterruptsMask(0xFF); // enable all interrupts (useless as only affects IRQ signal, has no effect in status register when using poll mode)
+	// >>> Warning <<< The flag bits in the status register are set irrespective of the state of the enable bits.
+	// Therefore as IRQ signal is not wired, we have to poll the status register for a selected interrupt with its bit mask
+	meter.getresetInterruptStatus(); // Clear all interrupts
+	seen = 0;
+	state = METER_CYCLE;
+}
+
+/** === zeroCrossed ===
+* Read RSTSTATUS, outside of a cycle, for the phase sequence (see GridPhases.h)
+* @return boolean true if a zero crossing was flagged since the last read
+*/
+boolean GridMeter::zeroCrossed(void) {
+	return ( meter.getresetInterruptStatus() & ZX ) != 0;
+}
+
+/** === poll ===
+* Read RSTSTATUS once, which clears the flags, and move the cycle on: at CYCEND read the
+* period and the energies, at each zero crossing of the RMS averages read VRMS or IRMS
+* @return byte with the state, METER_IDLE ... METER_READY
+*/
+byte GridMeter::poll(void) {
+	int status;
+	if ( state == METER_IDLE || state == METER_READY || state == METER_WATCH ) return state;
+	status = meter.getresetInterruptStatus();
+	seen |= ( status & ( PPOS | PNEG ) ) >> 8;
+	if ( status & ZXTO )
+	{
+		LOG_WARN(gridLog.text(state == METER_CYCLE ? PSTR("--> ZXTO - no AC input\n") : PSTR("--> RMS - no AC input\n")));
+		end(false);
+		return state;
+	}
+	if ( state == METER_CYCLE )
+	{
+		if ( ! ( status & CYCEND ) ) return state;
+		cycleEnd = millis();
+		PULSE_END(pulses);
+		signs = seen;
+		mains = true;
+		period 	  = meter.getPeriod();
+		activeEnergy 	= meter.getActiveEnergyLineSync()  ;
+		apparentEnergy 	= meter.getApparentEnergyLineSync()  ;
+		reactiveEnergy 	= meter.getReactiveEnergyLineSync()  ;
+		if ( getLineCyc() != METER_LINECYC )
+		{   // the calibration is for METER_LINECYC half cycles
+			activeEnergy = normalise(activeEnergy, getLineCyc(), true);
+			apparentEnergy = normalise(apparentEnergy, getLineCyc(), false);
+			reactiveEnergy = normalise(reactiveEnergy, getLineCyc(), true);
+#ifdef GRIDPULSE
+			pulses = ( pulses * METER_LINECYC + getLineCyc() / 2 ) / getLineCyc();
+#endif
+		}
+		state = METER_VRMS;
+		samples = 0;
+		sum = 0;
+		return state;
+	}
+	if ( ! ( status & ZX ) ) return state;
+	if ( samples > 0 ) sum += meter.read24( state == METER_VRMS ? VRMS : IRMS ); // Ignore first reading to avoid garbage
+	if ( samples++ < METER_RMS_SAMPLES ) return state;
+	if ( state == METER_VRMS )
+	{
+		vrms = sum / METER_RMS_SAMPLES;
+		state = METER_IRMS;
+	}
+	else
+	{
+		irms = sum / METER_RMS_SAMPLES;
+		state = METER_READY;
+	}
+	samples = 0;
+	sum = 0;
+	return state;
+}
+
+/** === waitCycleEnd ===
+* Wait for the end of the line cycle accumulation
+* @return int with CYCEND, ZXTO when there is no mains (missing zero crossing), 0 on timeout
+*/
+int GridMeter::waitCycleEnd(void) {
+	TRACE_BEGIN(TRACE_CYCEND);
+	gridWatchdog.step(TRACE_CYCEND, getCycleBudget());
+	while ( poll() == METER_CYCLE && gridWatchdog.alive() ) ; // wait for the selected interrupt to occur or timeout
+	gridWatchdog.done();
+	TRACE_END(TRACE_CYCEND);
+	if ( state == METER_CYCLE )
+	{ 
+		LOG_WARN(gridLog.text(PSTR("--> Timeout\n")));
+		end(false);
+		return 0;
+	}
+	return mains ? CYCEND : ZXTO;
+}
+
+/** === hasMains ===
+* @return boolean true if the last cycle ended with CYCEND and no zero crossing was missed since
+*/
+boolean GridMeter::hasMains(void) {
+	return mains;
+}
+
+/** === getCycleEnd ===
+* @return millis() at the end of the last line cycle accumulation (CYCEND), or when the mains was found lost
+*/
+unsigned long GridMeter::getCycleEnd(void) {
+	return cycleEnd;
+}
+
+/** === getCyclePulses ===
+* @return unsigned long with the CF pulses counted from start() to CYCEND of the last cycle
+* with mains, 0 without GRIDPULSE (see GridPulse.h)
+*/
+unsigned long GridMeter::getCyclePulses(void) {
+#ifdef GRIDPULSE
+	return pulses;
+#else
+	return 0;
+#endif
+}
+
+/** === getSigns ===
+* @return unsigned int with PPOS and PNEG if the active power changed sign from the previous
+* CYCEND to the last one (see GridBilling.h)
+*/
+unsigned int GridMeter::getSigns(void) {
+	return (unsigned int)signs << 8;
+}
+
+/** === read ===
+* Finish the RMS averages of the cycle if needed, read the peaks and the temperature and
+* hand the measurements of the cycle over. Without mains, only the peaks and the temperature
+* are read, the other values are 0.
+* @param rec: record filled with the raw register values, the time stamp and the meter are left untouched
+*/
+void GridMeter::read(GridRecord &rec) {
+	if ( state == METER_VRMS )
+	{
+		TRACE_BEGIN(TRACE_VRMS);
+		average(METER_VRMS, TRACE_VRMS);
+		TRACE_END(TRACE_VRMS);
+	}
+	if ( state == METER_IRMS )
+	{
+		TRACE_BEGIN(TRACE_IRMS);
+		average(METER_IRMS, TRACE_IRMS);
+		TRACE_END(TRACE_IRMS);
+	}
+	if ( state != METER_READY )
+	{   // not started, or still waiting for CYCEND when the caller gave up
+		LOG_WARN(gridLog.text(PSTR("--> Timeout\n")));
+		end(false);
+	}
+	rec.vrms = vrms;
+	rec.irms = irms;
+	rec.period = period;
+	rec.activeEnergy = activeEnergy;
+	rec.apparentEnergy = apparentEnergy;
+	rec.reactiveEnergy = reactiveEnergy;
+	readPeaks(rec);
+	state = METER_IDLE;
+}
+
+/** === readPeaks ===
+* Read and reset the peaks, and read the temperature. Part of read(), also used alone
+* with the timer driven acquisition (see GridSampler.h) which reads the rest.
+* @param rec: record, only the peaks and the temperature are set
+*/
+void GridMeter::readPeaks(GridRecord &rec) {
+	rec.vpeak 	  = meter.getVpeakReset() ;
+	rec.ipeak 	  = meter.getIpeakReset() ;
+	TRACE_BEGIN(TRACE_TEMP);
+	gridWatchdog.step(TRACE_TEMP, METER_TEMP_BUDGET);
+	rec.temp 	  = meter.getTemp();
+	gridWatchdog.done();
+	TRACE_END(TRACE_TEMP);
+}
+
+/** === suspend ===
+* Turn off both A/D converters until the next startCycle(), the registers are kept
+*/
+void GridMeter::suspend(void) {
+	meter.setMode( ASUSPEND | METER_DISCF );
+	suspended = true;
+}
+
+/** === watch ===
+* Between two cycles, with the SPI open: run line cycle accumulations of a few half cycles
+* back to back, taken by pollWindow(). The next startCycle() ends them.
+* @param linecyc: half line cycles per window
+*/
+void GridMeter::watch(unsigned int linecyc) {
+	resume();
+	meter.setLineCyc(linecyc);
+	meter.getresetInterruptStatus(); // Clear all interrupts
+	seen = 0;
+	samples = 0;
+	state = METER_WATCH;
+}
+
+/** === pollWindow ===
+* One read of RSTSTATUS after watch(), and of the line cycle energies at CYCEND. The first
+* window after watch() is skipped, it may not have lasted LINECYC half cycles (spec page 40-41).
+* @param active: LAENERGY of the window on return
+* @param reactive: LVARENERGY of the window on return
+* @return boolean true if a window ended since the last call
+*/
+boolean GridMeter::pollWindow(long &active, long &reactive) {
+	if ( state != METER_WATCH ) return false;
+	int status = meter.getresetInterruptStatus();
+	seen |= ( status & ( PPOS | PNEG ) ) >> 8;
+	if ( ! ( status & CYCEND ) ) return false;
+	signs = seen;
+	seen = 0;
+	active = meter.getActiveEnergyLineSync();
+	reactive = meter.getReactiveEnergyLineSync();
+	if ( samples == 0 )
+	{
+		samples = 1;
+		return false;
+	}
+	return true;
+}
+
+/** === open ===
+* Open SPI communication with ADE7753 IC, startCycle() and check() do it themselves
+*/
+void GridMeter::open(void) {
+	meter.setSPI();
+}
+
+/** === close ===
+* Close SPI communication with ADE7753 IC
+*/
+void GridMeter::close(void) {
+	meter.closeSPI();
+}
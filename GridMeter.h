@@ -0,0 +1,202 @@
+/* GridMeter.h = Line cycle measurement of the ADE7753 into a record for ArduGrid7753
+===================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+The measurement part of the main loop, moved out of ArduGrid7753.ino so that it can be
+compiled and benchmarked on a PC together with ADE7753.cpp (see host/bench.cpp):
+
+	begin()         bring-up: software reset, die revision check, configuration written and read back
+	check()         health check before each cycle: re-apply the configuration in place if it was lost
+	reconfigure()   write the configuration again after a remote change (see GridConfig.h)
+	startCycle()    open the SPI, start a line cycle accumulation of getLineCyc() half cycles,
+	                ie. open(), resume() the A/D converters and start() the accumulation
+	poll()          one read of RSTSTATUS, and of the registers due, moving the cycle on (see below)
+	waitCycleEnd()  poll until CYCEND, or ZXTO when there is no mains
+	read()          poll until the RMS averages are taken, then read the peaks and the temperature
+	                and hand the record over; without mains only the peaks and the temperature
+	readPeaks()     the peaks and temperature part of read(), for the timer driven acquisition (GridSampler.h)
+	suspend()       turn off the A/D converters until the next startCycle() (POWER_SAVE, see GridPower.h)
+	watch()         between two cycles, short line cycle accumulations for the load events,
+	                each one taken by pollWindow() (see GridEvents.h)
+	close()         close the SPI, for the ENC28J60
+
+Each GridMeter drives one ADE7753, on the chip select pin and with the offsets of its row
+of the shield table (see NodeConfig.h). Several of them are run side by side by
+GridScheduler (see GridScheduler.h), which is why a cycle is a state machine that only
+moves on in poll(), one status read at a time:
+
+	METER_IDLE      no cycle, or its record was taken by read()
+	METER_CYCLE     accumulating, waiting for CYCEND or ZXTO
+	METER_VRMS      CYCEND seen: the period and the line cycle energies were read at once,
+	                VRMS is read at each of the next METER_RMS_SAMPLES zero crossings
+	METER_IRMS      then IRMS the same way
+	METER_READY     the averages are taken, or the mains was lost
+	METER_WATCH     short accumulations between the cycles, until the next startCycle()
+
+The RSTSTATUS read by poll() clears the flags, so that a zero crossing is seen once. The
+energies are read at CYCEND, before they are latched again by the next accumulation.
+
+The UTC time stamp of the record is left to the caller, getCycleEnd() gives the millis()
+of CYCEND (or of the mains loss) to date it from.
+
+Mains loss
+----------
+ZXTOUT is set to METER_ZXTOUT, so that ZXTO is raised one ZXTOUT period (30 ms) after the
+last zero crossing. The cycle is then METER_READY without mains as soon as it is seen,
+instead of polling for a CYCEND that will never come: the RMS averages and the energies
+are left at 0. The RMS averages also give up at the first ZXTO, if the mains is lost
+while they are taken.
+
+Each wait is a step with a worst case budget (see GridWatchdog.h): the watchdog is fed
+while the step is within its budget, and a step that overruns it gives up.
+
+Bring-up and health check
+-------------------------
+begin() issues SWRST, waits the 18 us after which the ADE7753 accepts SPI transfers again,
+then polls STATUS for the RESET flag that marks the end of the reset. DIEREV is read
+next: 0x00 or 0xFF means that nobody answers on the SPI bus (shield missing, CS or MISO
+broken). The configuration (gains, offsets of the node, energy, CF and misc settings) is
+then written, and every written register is read back and compared, masked to its width
+(12-bit IRMSOS, VRMSOS, WGAIN... the unused bits read as 0 or as the sign).
+
+A brown-out of the shield or a glitch on the SPI lines can reset the chip or corrupt a
+register while the Nanode keeps running. Instead of waiting for the watchdog to reboot
+the whole board, and lose the measurement windows and the SNTP sync, check() is called
+before each cycle. It reads STATUS for a RESET flag (the flags are cleared at each
+startCycle(), so a RESET seen here means the chip restarted), checks DIEREV against the
+value read by begin(), and compares the configuration. A restarted chip is reset and
+reconfigured, a corrupted register is re-applied in place. Each repair is counted.
+A check costs 20 register reads, about 4 ms on the SPI bus (see host/bench.cpp).
+
+Line cycle count
+----------------
+An accumulation is METER_LINECYC half cycles, or the count set remotely with GRIDCONFIG
+(see GridConfig.h). The calibration of the shield table and the consumers of the records
+(GridEvents, GridBilling, GridPulse...) are for METER_LINECYC half cycles: at CYCEND the
+energies and the CF pulses of another count are scaled to METER_LINECYC half cycles, and
+the budget of the wait for CYCEND is scaled with the count (getCycleBudget()).
+
+CF pulse output
+---------------
+CFNUM and CFDEN set one CF pulse per METER_CFDEN+1 LSB of the active energy. CF is enabled
+(DISCF clear in MODE) only when GRIDPULSE counts its pulses (see GridPulse.h), the pulses
+of each line cycle accumulation from start() to CYCEND are then given by getCyclePulses().
+
+*/
+
+#ifndef GRIDMETER_H
+#define GRIDMETER_H
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include "ADE7753.h"
+#include "GridRecord.h"
+#include "NodeConfig.h"
+#include "GridPulse.h"
+
+#define METER_LINECYC         200   // half line cycles per accumulation, 200 * 10 ms = 2 sec at 50Hz
+#define METER_CYCEND_TIMEOUT  2500  // in milliseconds - budget of the wait for CYCEND, 200 half cycles at 45 Hz is 2.2 s
+#define METER_RMS_SAMPLES     100   // zero crossing synchronised readings averaged per RMS value
+#define METER_RMS_BUDGET      1500  // in milliseconds - budget of one RMS average, 101 half cycles at 45 Hz is 1.12 s
+#define METER_TEMP_BUDGET     150   // in milliseconds - budget of the temperature conversion, ADE7753::getTemp() gives up after 100 ms
+#define METER_ZXTOUT          840   // ZXTOUT 12-bit (U), unit 128/CLKIN = 35.8 us: 30 ms, 3 half cycles at 50 Hz
+#define METER_SETTLE          40    // in milliseconds - wait after ASUSPEND before accumulating, 2 line cycles at 50Hz
+#define METER_GAIN1           GAIN_4                 // PGA gain of channel 1 (current)
+#define METER_GAIN2           GAIN_2                 // PGA gain of channel 2 (voltage)
+#define METER_SCALE           FULLSCALESELECT_0_5V   // full scale of channel 1
+#define METER_GAIN            ( ( METER_GAIN2 << 5 ) | ( METER_SCALE << 3 ) | METER_GAIN1 ) // GAIN register
+#define METER_PHCAL           0x0D                   // phase calibration, power up value
+#define METER_CFNUM           0                      // CFNUM 12-bit (U) -- one CF pulse per METER_CFDEN+1 LSB of the active energy
+#define METER_CFDEN           15                     // CFDEN 12-bit (U) -- Refer to spec page 31
+#ifdef GRIDPULSE
+#define METER_DISCF           0                      // CF on, counted on T1
+#else
+#define METER_DISCF           DISCF                  // CF off, its pulses are not used
+#endif
+#define METER_SWRST_US        18    // in microseconds - no SPI transfer after SWRST (see SWRST in ADE7753.h)
+#define METER_RESET_TIMEOUT   10    // in milliseconds - max wait for the RESET flag after SWRST
+
+// poll() state, in the order of a cycle
+#define METER_IDLE            0
+#define METER_CYCLE           1
+#define METER_VRMS            2
+#define METER_IRMS            3
+#define METER_READY           4
+#define METER_WATCH           5
+
+// begin() and check() status
+#define METER_OK              0
+#define METER_NO_RESET        1     // RESET flag not seen after SWRST
+#define METER_NO_CHIP         2     // DIEREV reads 0x00 or 0xFF, or not the one seen by begin()
+#define METER_MISMATCH        3     // a register read back differs from the configuration
+
+class GridMeter {
+   //public methods
+   public:
+      byte begin(const MeterConfig *config);
+      byte check(void);
+      byte reconfigure(void);
+      byte getDieRev(void);
+      unsigned int getRepairs(void);
+      const MeterConfig *getConfig(void);
+      static unsigned int getLineCyc(void);
+      static unsigned int getCycleBudget(void);
+      void startCycle(void);
+      void resume(void);
+      void start(void);
+      byte poll(void);
+      boolean zeroCrossed(void);
+      int  waitCycleEnd(void);
+      boolean hasMains(void);
+      unsigned long getCycleEnd(void);
+      unsigned long getCyclePulses(void);
+      unsigned int getSigns(void);
+      void read(GridRecord &rec);
+      void readPeaks(GridRecord &rec);
+      void suspend(void);
+      void watch(unsigned int linecyc);
+      boolean pollWindow(long &active, long &reactive);
+      void open(void);
+      void close(void);
+
+   //private methods
+   private:
+      byte reset(void);
+      void configure(void);
+      byte verify(void);
+      unsigned int expected(byte reg);
+      void average(byte s, byte step);
+      void end(boolean withMains);
+
+      ADE7753 meter;
+      const MeterConfig *config;  // row of the shield table, read with CONFIG_BYTE() ... CONFIG_FLOAT()
+      boolean suspended;      // the A/D converters are off (ASUSPEND)
+      boolean mains;          // the last cycle ended with CYCEND, no ZXTO seen since
+      byte dierev;            // die revision read by begin()
+      unsigned int repairs;   // configurations re-applied by check()
+
+      byte state;             // METER_IDLE ... METER_READY
+      byte samples;           // zero crossings seen by the current RMS average, the first is skipped, or windows seen by watch()
+      long sum;               // of the readings of the current RMS average
+      unsigned long cycleEnd; // millis() at CYCEND or at the mains loss
+      long vrms, irms;        // of the cycle, kept until read()
+      long activeEnergy, apparentEnergy, reactiveEnergy;
+      int  period;
+      byte seen;              // PPOS and PNEG read since the previous CYCEND, >> 8
+      byte signs;             // the same, latched at the last CYCEND
+#ifdef GRIDPULSE
+      unsigned long pulses;   // CF count at start(), then the pulses of the cycle from CYCEND on
+#endif
+};
+
+#endif
@@ -0,0 +1,162 @@
+/* GridModbus.cpp = Modbus/TCP server of the latest readings of ArduGrid7753 for SCADA polling
+===========================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridModbus.h for the register table.
+
+*/
+
+#include "GridModbus.h"
+#include "GridBilling.h"
+
+#ifdef GRIDMODBUS
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === lookup ===
+* @param reg: register address
+* @param value: register on return, the high or low word of its 32-bit value
+* @return boolean false if the register is not in the table
+*/
+boolean GridModbus::lookup(word reg, word &value) {
+	unsigned long v;
+	if ( reg < MODBUS_HEALTH )
+	{
+		byte m = reg / MODBUS_METER;
+		byte k = ( reg % MODBUS_METER ) >> 1;
+		if ( m >= snapshot->getMeters() ) return false;
+		const SnapReading *r = snapshot->getReading(m);
+		if ( k < SNAP_FIELDS ) v = r->value[k];
+		else if ( k == SNAP_FIELDS ) v = r->importWh;
+		else if ( k == SNAP_FIELDS + 1 ) v = r->exportWh;
+		else v = r->utcSec;
+	}
+#ifdef GRIDBILLING
+	else if ( reg >= MODBUS_BILLING )
+	{
+		const BillRegisters *b = gridBilling.getRegisters();
+		byte t = ( reg - MODBUS_BILLING ) >> 3;
+		byte k = ( ( reg - MODBUS_BILLING ) & 7 ) >> 1;
+		if ( t < BILL_TARIFFS )
+		{
+			if ( k == 0 ) v = b->importWh[t];
+			else if ( k == 1 ) v = b->exportWh[t];
+			else if ( k == 2 ) v = b->maxDemand[t];
+			else v = b->maxAt[t];
+		}
+		else if ( t == BILL_TARIFFS && k < 3 )
+		{
+			if ( k == 0 ) v = gridBilling.getTariff();
+			else if ( k == 1 ) v = gridBilling.getDemand();
+			else v = b->reversals;
+		}
+		else return false;
+	}
+#endif
+	else
+	{
+		byte k = ( reg - MODBUS_HEALTH ) >> 1;
+		if ( reg - MODBUS_HEALTH >= 2 * ( SNAP_HEALTH + 1 ) ) return false;
+		v = k < SNAP_HEALTH ? snapshot->getHealth(k) : polls;
+	}
+	value = ( reg & 1 ) ? v : v >> 16; // high word first
+	return true;
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* @param snapshot: last readings of the meters and health counters, kept by the sketch
+*/
+void GridModbus::begin(GridSnapshot *snapshot) {
+	this->snapshot = snapshot;
+	polls = 0;
+	exceptions = 0;
+}
+
+/** === reply ===
+* Answer a request. The request is read first, so that the answer may overwrite it.
+* @param request: TCP payload of the request, MBAP header then PDU
+* @param length: bytes of the TCP payload
+* @param out: TCP payload of the answer in the Ethernet buffer
+* @param size: room left in the Ethernet buffer
+* @return word with the length of the answer, 0 if the request is not a Modbus/TCP frame
+*/
+word GridModbus::reply(const byte *request, word length, byte *out, word size) {
+	if ( length < MODBUS_MBAP + 5 ) return 0;
+	if ( request[2] != 0 || request[3] != 0 ) return 0; // protocol identifier
+	if ( ( request[4] << 8 | request[5] ) + 6 > length ) return 0;
+	byte header[MODBUS_MBAP];
+	memcpy(header, request, MODBUS_MBAP);
+	byte function = request[7];
+	word start = request[8] << 8 | request[9];
+	word count = request[10] << 8 | request[11];
+	byte error = 0;
+	word pdu;
+
+	memcpy(out, header, MODBUS_MBAP);
+	if ( function != MODBUS_READ_HOLDING && function != MODBUS_READ_INPUT ) error = MODBUS_ILLEGAL_FUNCTION;
+	else if ( count == 0 || count > MODBUS_MAX_READ || MODBUS_MBAP + 2 + 2 * count > size ) error = MODBUS_ILLEGAL_VALUE;
+	else
+	{
+		for (word i = 0; i < count; i++)
+		{
+			word value;
+			if ( ! lookup(start + i, value) )
+			{
+				error = MODBUS_ILLEGAL_ADDRESS;
+				break;
+			}
+			out[MODBUS_MBAP + 2 + 2 * i] = value >> 8;
+			out[MODBUS_MBAP + 3 + 2 * i] = value;
+		}
+	}
+	out[MODBUS_MBAP] = function;
+	if ( error != 0 )
+	{
+		out[MODBUS_MBAP] |= 0x80;
+		out[MODBUS_MBAP + 1] = error;
+		pdu = 2;
+		exceptions++;
+	}
+	else
+	{
+		out[MODBUS_MBAP + 1] = 2 * count;
+		pdu = 2 + 2 * count;
+		polls++;
+	}
+	out[4] = 0;
+	out[5] = pdu + 1; // the unit identifier and the PDU
+	return MODBUS_MBAP + pdu;
+}
+
+/** === getPolls ===
+* @return unsigned long with the requests answered with registers since reboot
+*/
+unsigned long GridModbus::getPolls(void) {
+	return polls;
+}
+
+/** === getExceptions ===
+* @return unsigned int with the requests answered with an exception since reboot
+*/
+unsigned int GridModbus::getExceptions(void) {
+	return exceptions;
+}
+
+#endif
@@ -0,0 +1,121 @@
+/* GridModbus.h = Modbus/TCP server of the latest readings of ArduGrid7753 for SCADA polling
+=========================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+The plant SCADA speaks Modbus/TCP, and read the Nanodes through a gateway scraping
+Pachube. The Nanode now answers Read Holding Registers (function code 3) and Read Input
+Registers (4) on port 502 itself, from the snapshot of the last readings taken at each
+measurement cycle (see GridSnapshot.h): a poll never waits on the ADE7753. Both function
+codes read the same table. The unit identifier is not checked, and echoed.
+
+Register table - each value is a signed 32-bit integer on two registers, the high word
+first (at the even address). For meter m, from address m * MODBUS_METER:
+
+	+0   Vrms x 100                  datastream 0
+	+2   Irms x 100                  datastream 1
+	+4   active x 100                datastream 4, mean power of the last 2 s cycle
+	+6   apparent x 100              datastream 5
+	+8   reactive x 100              datastream 6
+	+10  temperature                 datastream 7
+	+12  frequency x 100, in Hz      datastream 8
+	+14  imported energy since reboot, in the unit of datastream 4 times hours (Wh)
+	+16  exported energy since reboot
+	+18  UTC seconds of the last record, 0 if the clock is not synchronised
+
+and from MODBUS_HEALTH:
+
+	+0   updates since reboot        datastream 10
+	+2   reboots (EEPROM 0)          datastream 11
+	+4   watchdog timeouts (EEPROM 1) datastream 12
+	+6   Pachube response time in ms datastream 13
+	+8   records waiting for upload  datastream 14
+	+10  records dropped             datastream 16
+	+12  minimum free SRAM in bytes  datastream 18
+	+14  polls answered since reboot
+
+and with GRIDBILLING (see GridBilling.h), for tariff t from MODBUS_BILLING + t * 8:
+
+	+0   imported energy, in the unit of datastream 4 times hours (Wh), kept in EEPROM
+	+2   exported energy
+	+4   maximum demand over 15 minutes, in the unit of datastream 4
+	+6   UTC seconds of the end of its window
+
+then from MODBUS_BILLING + BILL_TARIFFS * 8: the current tariff, the demand of the last
+window, and the accumulations with a reversal of the power (PPOS or PNEG).
+
+Meter m reads 0 until its first record. A poll of an address outside the table (a meter the
+Nanode does not have, a hole between the blocks) gets exception 2, another function code
+exception 1, and a quantity of 0 or above MODBUS_MAX_READ exception 3.
+
+One request per TCP segment, answered in one segment (9 + 2 x quantity bytes), without
+closing the connection: the SCADA keeps its connection open between the polls, EtherCard
+answering each segment from its own sequence numbers.
+
+host/modbuspoll.cpp is a Modbus/TCP client polling a Nanode, or this module served on the
+PC, and reporting the polls per second and their latency.
+
+Compiled in with GRIDMODBUS and GRIDSNAPSHOT, uncommented by hand in GridFeatures.h and
+GridSnapshot.h: no profile has the local servers (see GridFeatures.h).
+
+*/
+
+#ifndef GRIDMODBUS_H
+#define GRIDMODBUS_H
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include "GridSnapshot.h"
+#include "GridFeatures.h"
+
+#define MODBUS_PORT      502
+#define MODBUS_METER     20      // registers per meter
+#define MODBUS_HEALTH    100     // first register of the health counters
+#define MODBUS_BILLING   120     // first register of the billing registers
+#define MODBUS_MAX_READ  125     // registers per request, Modbus limit
+#define MODBUS_MBAP      7       // bytes of the MBAP header, the unit identifier included
+
+// function codes
+#define MODBUS_READ_HOLDING      3
+#define MODBUS_READ_INPUT        4
+
+// exception codes
+#define MODBUS_ILLEGAL_FUNCTION  1
+#define MODBUS_ILLEGAL_ADDRESS   2
+#define MODBUS_ILLEGAL_VALUE     3
+
+#ifdef GRIDMODBUS
+
+#ifndef GRIDSNAPSHOT
+#error "GRIDMODBUS answers from the snapshot of the last readings: define GRIDSNAPSHOT too, see GridSnapshot.h"
+#endif
+
+class GridModbus {
+   //public methods
+   public:
+      void begin(GridSnapshot *snapshot);
+      word reply(const byte *request, word length, byte *out, word size);
+      unsigned long getPolls(void);
+      unsigned int getExceptions(void);
+
+   //private methods
+   private:
+      boolean lookup(word reg, word &value);
+
+      GridSnapshot *snapshot;    // last readings and health counters
+      unsigned long polls;       // requests answered with registers since reboot
+      unsigned int exceptions;   // requests answered with an exception since reboot
+};
+
+#endif
+
+#endif
@@ -0,0 +1,257 @@
+/* GridPhases.cpp = Three-phase figures from three ADE7753 for ArduGrid7753
+=========================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridPhases.h for the phase sequence detection and the integer math.
+
+*/
+
+#include "GridPhases.h"
+
+#ifdef GRIDPHASES
+
+#include "GridConfig.h"
+#include "GridTrace.h"
+#include "GridWatchdog.h"
+
+// Cosine and sine in Q10 of the voltage angles in the ABC sequence: A at 0, B at -120, C at +120 degrees.
+// The sines change sign in the ACB sequence.
+static const int cosV[PHASES] = { 1024, -512, -512 };
+static const int sinV[PHASES] = { 0, -887, 887 };
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === isqrt ===
+* @return unsigned long with the integer square root of n, rounded down
+*/
+static unsigned long isqrt(unsigned long n) {
+	unsigned long root = 0;
+	unsigned long bit = 1UL << 30;
+	while ( bit > n ) bit >>= 2;
+	while ( bit != 0 )
+	{
+		if ( n >= root + bit )
+		{
+			n -= root + bit;
+			root = ( root >> 1 ) + bit;
+		}
+		else root >>= 1;
+		bit >>= 2;
+	}
+	return root;
+}
+
+/** === toLong ===
+* @return long with x rounded to the nearest integer
+*/
+static long toLong(float x) {
+	return x < 0 ? (long)( x - 0.5 ) : (long)( x + 0.5 );
+}
+
+/** === near ===
+* @return boolean true if x is within h/6 of y
+*/
+static boolean near(unsigned long x, unsigned long y, unsigned long h) {
+	return ( x > y ? x - y : y - x ) < h / 6;
+}
+
+/** === imbalance ===
+* @param x: value of each phase
+* @param deviation: signed deviation of each phase from the mean in 0.1 %, or 0
+* @return unsigned int with the largest deviation from the mean in 0.1 % of the mean
+*/
+unsigned int GridPhases::imbalance(unsigned int *x, int *deviation) {
+	long mean = ( (long)x[0] + x[1] + x[2] ) / PHASES;
+	unsigned int worst = 0;
+	for (byte k = 0; k < PHASES; k++)
+	{
+		long d = ( mean != 0 ) ? ( (long)x[k] - mean ) * 1000 / mean : 0;
+		if ( deviation != 0 ) deviation[k] = d;
+		if ( d < 0 ) d = -d;
+		if ( d > worst ) worst = d;
+	}
+	return worst;
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* @param meters: GridMeter of phases A, B and C, already through GridMeter::begin()
+*/
+void GridPhases::begin(GridMeter *meters) {
+	this->meters = meters;
+	sequence = PHASE_UNKNOWN;
+}
+
+/** === add ===
+* Take the record of one phase, converted to integers with the calibration of its meter
+* @param rec: record read by GridScheduler, rec.meter is the phase [0 2]
+*/
+void GridPhases::add(GridRecord &rec) {
+	byte k = rec.meter;
+	if ( k >= PHASES ) return;
+	const MeterConfig *shield = meters[k].getConfig();
+	volts[k] = toLong( rec.vrms * 10.0 / CONFIG_FLOAT(&shield->calVrms) );
+	amps[k]  = toLong( rec.irms * 100.0 / CONFIG_FLOAT(&shield->calIrms) );
+	active[k]   = toLong( rec.activeEnergy / CONFIG_FLOAT(&shield->calActiveEnergy) );
+	apparent[k] = toLong( rec.apparentEnergy / CONFIG_FLOAT(&shield->calApparentEnergy) );
+	reactive[k] = toLong( rec.reactiveEnergy / CONFIG_FLOAT(&shield->calReactiveEnergy) );
+}
+
+/** === detectSequence ===
+* Time the zero crossings of the three phases, with the SPI open
+* @param period: PERIOD register of phase A, 0 without mains
+* @return byte with the sequence, PHASE_UNKNOWN if a phase is missing or out of place
+*/
+byte GridPhases::detectSequence(unsigned int period) {
+	unsigned long h = (unsigned long)period * 500UL / ( CLKIN / 4000UL ); // half line period in us
+	unsigned long at[PHASES];
+	unsigned long delay[PHASES] = { 0, 0, 0 };  // of B and C after A modulo h, summed over the rounds
+	sequence = PHASE_UNKNOWN;
+	if ( h == 0 ) return sequence;
+	gridWatchdog.step(TRACE_CYCEND, PHASE_BUDGET);
+	for (byte r = 0; r < PHASE_ROUNDS; r++)
+	{
+		byte seen = 0;
+		for (byte k = 0; k < PHASES; k++) meters[k].zeroCrossed(); // clear the ZX flags
+		unsigned long start = micros();
+		while ( seen != ( 1 << PHASES ) - 1 )
+		{
+			for (byte k = 0; k < PHASES; k++)
+			{
+				if ( ! ( seen & ( 1 << k ) ) && meters[k].zeroCrossed() )
+				{
+					at[k] = micros();
+					seen |= 1 << k;
+				}
+			}
+			if ( micros() - start > 3 * h || ! gridWatchdog.alive() )
+			{   // a phase without zero crossings
+				gridWatchdog.done();
+				return sequence;
+			}
+		}
+		for (byte k = 1; k < PHASES; k++)
+		{
+			long d = (long)( at[k] - at[0] ) % (long)h;
+			delay[k] += ( d < 0 ) ? d + h : d;
+		}
+	}
+	gridWatchdog.done();
+	delay[1] /= PHASE_ROUNDS;
+	delay[2] /= PHASE_ROUNDS;
+	if ( near(delay[1], 2 * h / 3, h) && near(delay[2], h / 3, h) ) sequence = PHASE_ABC;
+	else if ( near(delay[1], h / 3, h) && near(delay[2], 2 * h / 3, h) ) sequence = PHASE_ACB;
+	return sequence;
+}
+
+/** === compute ===
+* Totals, imbalance and neutral current of the three phases given to add()
+*/
+void GridPhases::compute(void) {
+	long x = 0, y = 0;  // sum of the current phasors, in 0.01 A x 1024
+	byte shift = 0;
+	totalP = totalQ = totalS = 0;
+	for (byte k = 0; k < PHASES; k++)
+	{
+		long p = active[k];
+		long q = reactive[k];
+		long s = ( sequence == PHASE_ACB ) ? -sinV[k] : sinV[k];
+		long c = cosV[k];
+		totalP += active[k];
+		totalQ += reactive[k];
+		totalS += apparent[k];
+
+		// the current lags its voltage by phi, cos(phi) = p / m and sin(phi) = q / m
+		while ( p > 0x7FFF || p < -0x7FFF || q > 0x7FFF || q < -0x7FFF ) { p /= 2; q /= 2; } // p * p + q * q within a long
+		long m = isqrt( (unsigned long)( p * p ) + (unsigned long)( q * q ) );
+		if ( m != 0 )
+		{   // cos(theta - phi) and sin(theta - phi) in Q10
+			long cs = ( c * p + s * q ) / m;
+			s = ( s * p - c * q ) / m;
+			c = cs;
+		}
+		x += amps[k] * c;
+		y += amps[k] * s;
+	}
+	x /= 1024;
+	y /= 1024;
+	while ( x > 0x7FFF || x < -0x7FFF || y > 0x7FFF || y < -0x7FFF ) { x /= 2; y /= 2; shift++; }
+	neutral = isqrt( (unsigned long)( x * x ) + (unsigned long)( y * y ) ) << shift;
+	vImbalance = imbalance(volts, 0);
+	iImbalance = imbalance(amps, iDeviation);
+}
+
+/** === getSequence ===
+* @return byte with the last result of detectSequence(), PHASE_UNKNOWN ... PHASE_ACB
+*/
+byte GridPhases::getSequence(void) {
+	return sequence;
+}
+
+/** === getActive ===
+* @return long with the active energy of the three phases, in the unit of datastream 4
+*/
+long GridPhases::getActive(void) {
+	return totalP;
+}
+
+/** === getReactive ===
+* @return long with the reactive energy of the three phases, in the unit of datastream 6
+*/
+long GridPhases::getReactive(void) {
+	return totalQ;
+}
+
+/** === getApparent ===
+* @return long with the sum of the apparent energies of the phases, in the unit of datastream 5
+*/
+long GridPhases::getApparent(void) {
+	return totalS;
+}
+
+/** === getVoltageImbalance ===
+* @return unsigned int with the largest deviation of a phase voltage from their mean, in 0.1 %
+*/
+unsigned int GridPhases::getVoltageImbalance(void) {
+	return vImbalance;
+}
+
+/** === getCurrentImbalance ===
+* @return unsigned int with the largest deviation of a phase current from their mean, in 0.1 %
+*/
+unsigned int GridPhases::getCurrentImbalance(void) {
+	return iImbalance;
+}
+
+/** === getCurrentDeviation ===
+* @param phase: 0 for A, 1 for B, 2 for C
+* @return int with the deviation of the current of the phase from the mean, in 0.1 %
+*/
+int GridPhases::getCurrentDeviation(byte phase) {
+	return iDeviation[phase];
+}
+
+/** === getNeutral ===
+* @return unsigned int with the neutral current, in 0.01 A
+*/
+unsigned int GridPhases::getNeutral(void) {
+	return neutral;
+}
+
+#endif
@@ -0,0 +1,122 @@
+/* GridPhases.h = Three-phase figures from three ADE7753 for ArduGrid7753
+=======================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+The ADE7753 is a single phase meter. A three-phase supply is measured with three of them,
+one per phase (meters 0, 1 and 2 of a board wired WIRING_3PHASE, see NodeConfig.h), run by
+GridScheduler with aligned windows (a stagger of 0, see GridScheduler.h): the three line
+cycle accumulations start within about 1 ms of each other and cover the same 2 seconds.
+
+After each cycle, add() takes the record of each phase and converts it once to integers
+with the calibration of its shield row:
+
+	voltage    in 0.1 V
+	current    in 0.01 A
+	P, Q, S    active, reactive, apparent energy of the cycle, in the unit of datastreams 4-6
+
+compute() then combines the three phases with long integer math only:
+
+	total P, Q, S        sums of the phases
+	imbalance            largest deviation of a phase from the mean of the three, in 0.1 %
+	                     of the mean, for the voltages and for the currents (the definition
+	                     of NEMA MG1), and the signed deviation of the current of each phase
+	neutral current      modulus of the sum of the current phasors. Each current lags its
+	                     voltage by the angle given by P and Q, the voltages being 120
+	                     degrees apart in the order of the phase sequence. Angles are kept
+	                     as cosine and sine in Q10 (1024 = 1), the modulus is an integer
+	                     square root
+
+The phase sequence is found from the timing of the zero crossings by detectSequence():
+the ZX flags of the three chips are cleared, then their status registers are polled in
+turn and the micros() of the first zero crossing of each is kept, over PHASE_ROUNDS rounds.
+The ZX flag is raised at both crossings of the voltage, so the delays of B and C after A
+are taken modulo half a line period h:
+
+	ABC     B lags A by 120 degrees   B at 2h/3, C at h/3
+	ACB     B leads A by 120 degrees  B at h/3, C at 2h/3
+
+A delay more than h/6 away from both gives PHASE_UNKNOWN (a phase missing, or two chips
+on the same phase). A voltage input wired the wrong way round shifts its phase by 180
+degrees, which the half period cannot see: the sequence stays right, but the neutral
+current is then wrong, as P of that phase is negative.
+
+A status read takes about 0.26 ms, so a zero crossing is timed up to 0.8 ms late with
+three meters on the bus, within the h/6 (1.7 ms at 50 Hz) of tolerance. host/bench.cpp
+runs simulated three-phase sources with a known imbalance, at unity and lagging power
+factors, in both sequences, and checks the figures against a floating point reference.
+
+Without GRIDPHASES (see GridFeatures.h) a board wired WIRING_3PHASE is measured as three
+separate circuits, and datastreams 20 to 26 are not sent.
+
+*/
+
+#ifndef GRIDPHASES_H
+#define GRIDPHASES_H
+
+#include "GridFeatures.h"
+// #define GRIDPHASES              // uncomment for the three-phase figures (87 bytes of SRAM)
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include "GridMeter.h"
+#include "GridRecord.h"
+
+#define PHASES          3
+#define PHASE_ROUNDS    4     // zero crossings timed per phase by detectSequence()
+#define PHASE_BUDGET    150   // in milliseconds - budget of detectSequence(), PHASE_ROUNDS x 3 half cycles at 45 Hz
+
+// detectSequence() result
+#define PHASE_UNKNOWN   0
+#define PHASE_ABC       1     // B lags A by 120 degrees
+#define PHASE_ACB       2     // B leads A by 120 degrees
+
+// NodeConfig wiring of the ADE7753 of a board
+#define WIRING_CIRCUITS 0     // separate single phase circuits, no aggregation
+#define WIRING_3PHASE   1     // meters 0, 1 and 2 are phases A, B and C of one supply
+
+#ifdef GRIDPHASES
+
+class GridPhases {
+   //public methods
+   public:
+      void begin(GridMeter *meters);
+      void add(GridRecord &rec);
+      byte detectSequence(unsigned int period);
+      void compute(void);
+      byte getSequence(void);
+      long getActive(void);
+      long getReactive(void);
+      long getApparent(void);
+      unsigned int getVoltageImbalance(void);
+      unsigned int getCurrentImbalance(void);
+      int  getCurrentDeviation(byte phase);
+      unsigned int getNeutral(void);
+
+   //private methods
+   private:
+      unsigned int imbalance(unsigned int *x, int *deviation);
+
+      GridMeter *meters;      // PHASES of them, A B C
+      byte sequence;          // PHASE_UNKNOWN, PHASE_ABC, PHASE_ACB
+      unsigned int volts[PHASES];   // in 0.1 V
+      unsigned int amps[PHASES];    // in 0.01 A
+      long active[PHASES], reactive[PHASES], apparent[PHASES];
+      long totalP, totalQ, totalS;
+      unsigned int vImbalance, iImbalance;  // in 0.1 %
+      int  iDeviation[PHASES];      // in 0.1 %
+      unsigned int neutral;         // in 0.01 A
+};
+
+#endif
+
+#endif
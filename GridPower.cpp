@@ -0,0 +1,84 @@
+/* GridPower.cpp = Duty cycled operation of the Nanode and of the ADE7753 for ArduGrid7753
+=======================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridPower.h for the power modes.
+
+*/
+
+#include <avr/sleep.h>
+#include <avr/power.h>
+#include "GridPower.h"
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* @param m: POWER_NORMAL or POWER_SAVE
+*/
+void GridPower::begin(byte m) {
+	mode = m;
+	slept = 0;
+	duty = 100;
+	cycleStart = micros();
+	if ( mode == POWER_SAVE )
+	{
+		ADCSRA &= ~(1<<ADEN); // the ADC must be disabled before it is switched off
+		power_adc_disable();
+		power_twi_disable();
+	}
+}
+
+byte GridPower::getMode(void) {
+	return mode;
+}
+
+/** === idle ===
+* Pace the main loop - delay() in POWER_NORMAL mode, IDLE sleep in POWER_SAVE mode
+* @param ms: time to wait in milliseconds
+*/
+void GridPower::idle(unsigned int ms) {
+	unsigned long start = millis();
+	if ( mode != POWER_SAVE )
+	{
+		delay(ms);
+		return;
+	}
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	while ( ( millis() - start ) < ms )
+	{
+		unsigned long t = micros();
+		sleep_enable();
+		sleep_cpu();   // woken up by the next interrupt, at most 1.024 ms away (Timer0)
+		sleep_disable();
+		slept += micros() - t;
+	}
+}
+
+/** === endCycle ===
+* Close the current update period and compute its duty cycle
+*/
+void GridPower::endCycle(void) {
+	unsigned long t = micros();
+	unsigned long period = t - cycleStart;
+	if ( slept >= period ) duty = 0;
+	else duty = 100 - slept / ( period / 100 + 1 );
+	slept = 0;
+	cycleStart = t;
+}
+
+/** === getDuty ===
+* @return time awake during the last update period in %, 100 in POWER_NORMAL mode
+*/
+byte GridPower::getDuty(void) {
+	return duty;
+}
@@ -0,0 +1,71 @@
+/* GridPower.h = Duty cycled operation of the Nanode and of the ADE7753 for ArduGrid7753
+=====================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+On the battery backed remote sites, the Nanode does not need to run flat out between two
+updates. Each node is given a power mode in the node table (see NodeConfig.h):
+
+POWER_NORMAL - as up to V1.1, the loop is paced by delay(), everything stays powered.
+
+POWER_SAVE   - the loop is paced by the IDLE sleep mode of the ATmega328: the CPU clock is
+               stopped and the Timer0 overflow interrupt of millis() wakes it up every
+               1.024 ms, so millis() and the SNTP clock keep running, and the UART and SPI
+               stay available. The ADC and the TWI of the ATmega328, which are not used,
+               are switched off.
+               Between two measurement cycles the ADE7753 A/D converters are turned off
+               with the ASUSPEND bit of the MODE register (see GridMeter::suspend()), and
+               the ENC28J60 is put in power save mode when there is nothing to upload
+               (see ArduGrid7753.ino).
+
+The watchdog is not used to wake up from the deeper POWER-DOWN mode, as it is already
+the 8 s reset watchdog, and POWER-DOWN would stop millis().
+
+Accuracy: the measurements only ever covered the line cycle accumulation window of each
+update (METER_LINECYC half line cycles every REQUEST_RATE), and the ADE7753 is running
+during the whole window. After ASUSPEND, METER_SETTLE ms are waited for the A/D
+converters and filters to settle before the accumulation starts. The fraction of the
+time covered by the measurements (window / update period) is the same in both modes.
+
+getDuty() gives the fraction of time the CPU was awake during the last update period,
+sent to Pachube as datastream 19. The current draw of both modes is estimated on a PC
+with host/bench.cpp.
+
+*/
+
+#ifndef GRIDPOWER_H
+#define GRIDPOWER_H
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+
+#define POWER_NORMAL  0
+#define POWER_SAVE    1
+
+class GridPower {
+   //public methods
+   public:
+      void begin(byte mode);
+      byte getMode(void);
+      void idle(unsigned int ms);
+      void endCycle(void);
+      byte getDuty(void);
+
+   //private methods
+   private:
+      byte mode;
+      unsigned long slept;          // in microseconds, asleep during the current update period
+      unsigned long cycleStart;     // micros() at the start of the current update period
+      byte duty;                    // in %, awake during the last update period
+};
+
+#endif
@@ -0,0 +1,200 @@
+/* GridPulse.cpp = Energy from the CF pulses of the ADE7753 counted by Timer1 for ArduGrid7753
+===========================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridPulse.h for the wiring of CF and the cross-check.
+
+*/
+
+#include <math.h>
+#include "GridPulse.h"
+
+#ifdef GRIDPULSE
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "GridMeter.h"
+#include "GridConfig.h"
+
+#define PULSE_LSB        ( float( METER_CFDEN + 1 ) / float( METER_CFNUM + 1 ) ) // LAENERGY LSB per CF pulse
+#define PULSE_CAL_HOURS  ( METER_LINECYC / 100.0 / 3600.0 )  // line cycle accumulation of calActiveEnergy, at 50 Hz
+
+GridPulse gridPulse;
+
+/** === signed24 ===
+* @return long with a 24-bit 2-complement register value, LAENERGY of a record
+*/
+static long signed24(long x) {
+	return ( x & 0x800000L ) ? x - 0x1000000L : x;
+}
+
+ISR(TIMER1_OVF_vect) {
+	gridPulse.overflow();
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* Timer1 clocked by the rising edges of T1, normal mode, overflow interrupt on. Replaces
+* the 8-bit PWM set by the Arduino core.
+*/
+void GridPulse::begin(void) {
+	pinMode(PULSE_PIN, INPUT);
+	byte sreg = SREG;
+	cli();
+	TCCR1B = 0;
+	TCCR1A = 0;
+	TCNT1 = 0;
+	overflows = 0;
+	TIFR1 = _BV(TOV1); // clear a pending overflow
+	TIMSK1 = _BV(TOIE1);
+	TCCR1B = _BV(CS12) | _BV(CS11) | _BV(CS10); // external clock on T1, rising edge
+	SREG = sreg;
+	taken = 0;
+	positive = 0;
+	negative = 0;
+	addedAt = millis();
+	reversed = false;
+	checks = 0;
+	mismatches = 0;
+	deviation = 0;
+}
+
+/** === getCount ===
+* @return unsigned long with the CF pulses since begin(), wraps after 2^32
+*/
+unsigned long GridPulse::getCount(void) {
+	byte sreg = SREG;
+	cli();
+	unsigned int high = overflows;
+	unsigned int low = TCNT1;
+	if ( ( TIFR1 & _BV(TOV1) ) && low < 0x8000 ) high++; // wrapped, its interrupt not taken yet
+	SREG = sreg;
+	return (unsigned long)high << 16 | low;
+}
+
+/** === add ===
+* A line cycle accumulation of meter PULSE_METER, window or cycle, for the share of the
+* import and the export in take()
+* @param active: LAENERGY of the accumulation
+* @param linecyc: its half line cycles
+* @param signs: PPOS and PNEG since the previous accumulation, see GridMeter::getSigns()
+* @param pulses: CF pulses of the accumulation (see GridMeter::getCyclePulses()), 0 if not counted
+* @param at: millis() of its end
+*/
+void GridPulse::add(long active, unsigned int linecyc, unsigned int signs, unsigned long pulses, unsigned long at) {
+	unsigned long dt = at - addedAt;
+	float lsb = signed24(active);
+	float scale = float( dt > PULSE_GAP_MAX ? PULSE_GAP_MAX : dt ) / ( linecyc * 10.0 ); // 10 ms per half cycle at 50 Hz
+	addedAt = at;
+	if ( signs & ( PPOS | PNEG ) )
+	{
+		reversed = true;
+		if ( pulses != 0 )
+		{   // the pulses are the import plus the export of the accumulation, LAENERGY their net
+			float gross = pulses * PULSE_LSB;
+			if ( gross < fabs(lsb) ) gross = fabs(lsb);
+			positive += ( gross + lsb ) / 2 * scale;
+			negative += ( gross - lsb ) / 2 * scale;
+			return;
+		}
+	}
+	if ( lsb > 0 ) positive += lsb * scale;
+	else negative -= lsb * scale;
+}
+
+/** === take ===
+* Energy of the pulses since the previous take(), or since begin(), as an import and an export
+* @param rec: record of meter PULSE_METER, for the sign of the energy
+* @param shield: calibration of its ADE7753
+* @param imported: in the unit of datastream 4 times hours (Wh) on return
+* @param exported: the same, >= 0
+*/
+void GridPulse::take(const GridRecord &rec, const MeterConfig *shield, float &imported, float &exported) {
+	unsigned long count = getCount();
+	unsigned long now = millis();
+	float wh = ( count - taken ) * PULSE_LSB * PULSE_CAL_HOURS / CONFIG_FLOAT(&shield->calActiveEnergy);
+	float tail = float(signed24(rec.activeEnergy)) * ( now - addedAt > PULSE_GAP_MAX ? PULSE_GAP_MAX : now - addedAt ) / ( METER_LINECYC * 10.0 );
+	taken = count;
+	addedAt = now; // the pulses from the last accumulation to now are counted, at the power of the record
+	if ( tail > 0 ) positive += tail;
+	else negative -= tail;
+	if ( ( reversed || ( positive > 0 && negative > 0 ) ) && positive + negative > 0 )
+	{   // the pulses of both, shared out by the integrated accumulations
+		imported = wh * positive / ( positive + negative );
+		exported = wh - imported;
+	}
+	else if ( signed24(rec.activeEnergy) < 0 )
+	{
+		imported = 0;
+		exported = wh;
+	}
+	else
+	{
+		imported = wh;
+		exported = 0;
+	}
+	positive = 0;
+	negative = 0;
+	reversed = false;
+}
+
+/** === check ===
+* Cross-check of the pulses of a line cycle accumulation with its LAENERGY read on the SPI
+* @param rec: record of meter PULSE_METER, with mains
+* @param pulses: counted from start() to CYCEND, see GridMeter::getCyclePulses()
+* @param signs: PPOS and PNEG of the cycle, see GridMeter::getSigns()
+* @return boolean false if the pulses deviate by more than PULSE_TOLERANCE per mille
+*/
+boolean GridPulse::check(const GridRecord &rec, unsigned long pulses, unsigned int signs) {
+	long lsb = signed24(rec.activeEnergy);
+	float expected = ( lsb < 0 ? -lsb : lsb ) / PULSE_LSB;
+	if ( expected < PULSE_CHECK_MIN || ( signs & ( PPOS | PNEG ) ) ) return true;
+	float d = 1000.0 * ( pulses - expected ) / expected;
+	deviation = d > 1000.0 ? 1000 : (int)d; // a counter gone mad reads as +100 %
+	checks++;
+	if ( deviation <= PULSE_TOLERANCE && deviation >= -PULSE_TOLERANCE ) return true;
+	mismatches++;
+	return false;
+}
+
+/** === getChecks ===
+* @return unsigned int with the windows checked since reboot
+*/
+unsigned int GridPulse::getChecks(void) {
+	return checks;
+}
+
+/** === getMismatches ===
+* @return unsigned int with the windows out of PULSE_TOLERANCE since reboot
+*/
+unsigned int GridPulse::getMismatches(void) {
+	return mismatches;
+}
+
+/** === getDeviation ===
+* @return int with the deviation of the last window checked, in per mille [-1000 1000]
+*/
+int GridPulse::getDeviation(void) {
+	return deviation;
+}
+
+/** === overflow ===
+* Timer1 wrapped: 65536 more pulses. Called by the overflow interrupt.
+*/
+void GridPulse::overflow(void) {
+	overflows++;
+}
+
+#endif
@@ -0,0 +1,127 @@
+/* GridPulse.h = Energy from the CF pulses of the ADE7753 counted by Timer1 for ArduGrid7753
+=========================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+The energy totals of GridSnapshot.h are integrated from the mean power of each line cycle
+accumulation, taken as the power until the next one: a load that changes between two
+measurement cycles (a few seconds of the update period) is missed, or counted for too long.
+
+The ADE7753 integrates the active power without a gap on its own, and gives it out on its
+CF pin: one pulse for each (CFDEN+1)/(CFNUM+1) LSB of the active energy register, WDIV being
+0 (spec page 31). When GRIDPULSE is defined below, CF of the ADE7753 of meter PULSE_METER is
+wired to T1 (digital pin 5, PD5) and counted by Timer1 clocked from that pin: the CPU only
+sees one overflow interrupt per 65536 pulses, which gives the high word of the count.
+GridMeter sets CFNUM and CFDEN (METER_CFNUM, METER_CFDEN) and clears DISCF in MODE when
+GRIDPULSE is defined, and sets DISCF otherwise (see GridMeter.h).
+
+	begin()       Timer1 counting on the rising edges of T1, overflow interrupt on
+	getCount()    pulses since begin(), read with the interrupts off
+	add()         each line cycle accumulation of the meter, the windows of the load events
+	              and the cycles: its LAENERGY is integrated over the time since the
+	              previous one into a positive and a negative energy, as GridBilling does,
+	              and its PPOS and PNEG flags (see GridMeter::getSigns()) are kept. The
+	              pulses of a cycle in which the power changed sign are its import plus
+	              its export, LAENERGY their net: both are found from them
+	take()        the energy of the pulses since the previous take(), for the totals of
+	              GridSnapshot (see GridSnapshot::addEnergy()), in the unit of datastream 4
+	              times hours, as an import and an export. CF does not give the sign of
+	              the energy, the pulses count the import plus the export: when the power
+	              kept its sign since the previous take() they all go by the sign of the
+	              record, when it changed sign (PPOS or PNEG, or accumulations of both
+	              signs) they are shared out in proportion of the positive and the negative
+	              energies integrated by add(), the power of the record carried on to
+	              take(). The pulses keep the total exact, the accumulations only share
+	              it out (see host/pulsesim.cpp for the error of the share).
+	check()       SPI cross-check: the pulses counted by GridMeter over its line cycle
+	              accumulation (start() to CYCEND, see GridMeter::getCyclePulses()) against
+	              the LAENERGY of the record. A deviation of more than PULSE_TOLERANCE per
+	              mille is a mismatch (CF not wired, a wrong divider, a counter stopped...).
+	              Windows of less than PULSE_CHECK_MIN pulses are not checked: a pulse is
+	              then more than the tolerance, nor the ones in which the power changed
+	              sign: the pulses are then the import plus the export, LAENERGY their net.
+
+The SPI reads stay as they are for the datastreams, the check only compares what they
+already read. The pulses of the A/D converters suspended in POWER_SAVE mode are missing,
+the sketch then keeps the integrated power for the totals. With the timer driven
+acquisition (GridSampler.h) the CYCEND is seen by the sampler, the window is not counted
+and check() is not run.
+
+The calibration of datastream 4 (MeterConfig::calActiveEnergy) is in LSB per W over the
+METER_LINECYC half cycles at 50 Hz of a line cycle accumulation, ie. 2 s: one LSB is
+1 / (3600 / 2 x calActiveEnergy) Wh.
+
+Timer1 is then no more free for analogWrite() on pins 9 and 10 nor for a library using it.
+On a PC (host/) the overflows are simulated by HostSim.cpp from the pulses of the simulated
+ADE7753, see host/pulsesim.cpp.
+
+*/
+
+#ifndef GRIDPULSE_H
+#define GRIDPULSE_H
+
+#include "GridFeatures.h"
+// #define GRIDPULSE               // uncomment to count the CF pulses of meter PULSE_METER on T1
+
+#define PULSE_METER      0         // meter whose CF is wired to T1
+#define PULSE_PIN        5         // T1 = PD5
+#define PULSE_TOLERANCE  20        // per mille - deviation of the pulses of a cycle from its LAENERGY
+#define PULSE_CHECK_MIN  200       // pulses - shortest window checked
+#define PULSE_GAP_MAX    60000     // in milliseconds - longest time between two accumulations integrated by add()
+
+#ifdef GRIDPULSE
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include "GridRecord.h"
+#include "NodeConfig.h"
+
+#define PULSE_START(n)   n = gridPulse.getCount()       // at the start of a window
+#define PULSE_END(n)     n = gridPulse.getCount() - n   // at its end, n is then the pulses of the window
+
+class GridPulse {
+   //public methods
+   public:
+      void begin(void);
+      unsigned long getCount(void);
+      void add(long active, unsigned int linecyc, unsigned int signs, unsigned long pulses, unsigned long at);
+      void take(const GridRecord &rec, const MeterConfig *shield, float &imported, float &exported);
+      boolean check(const GridRecord &rec, unsigned long pulses, unsigned int signs);
+      unsigned int getChecks(void);
+      unsigned int getMismatches(void);
+      int getDeviation(void);
+
+      void overflow(void);       // from ISR(TIMER1_OVF_vect)
+
+   //private methods
+   private:
+      volatile unsigned int overflows; // high word of the count
+      unsigned long taken;       // count at the last take()
+      float positive;            // LSB of the positive accumulations since the last take(), integrated by add()
+      float negative;            // and of the negative ones, as a positive value
+      unsigned long addedAt;     // millis() of the end of the last accumulation given to add()
+      boolean reversed;          // PPOS or PNEG since the last take()
+      unsigned int checks;       // windows checked since reboot
+      unsigned int mismatches;   // of them out of PULSE_TOLERANCE
+      int deviation;             // per mille, of the last window checked
+};
+
+extern GridPulse gridPulse;
+
+#else
+
+#define PULSE_START(n)
+#define PULSE_END(n)
+
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+/* GridRecord.h = One measurement cycle of the ADE7753 as acquired by ArduGrid7753
+==================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Register values are kept raw (before calibration) so that a record stays small (38 bytes)
+and can be calibrated at upload time with the constants of the node it was taken on.
+
+The time stamp is the UTC time of the end of the line cycle accumulation window (CYCEND),
+as given by the SNTP disciplined clock (see GridClock.h). It is 0 when the clock has never
+been synchronised since the last reboot.
+
+*/
+
+#ifndef GRIDRECORD_H
+#define GRIDRECORD_H
+
+struct GridRecord {
+	unsigned long utcSec;      // UTC time stamp at CYCEND - seconds since 1 Jan 1970
+	unsigned int  utcMs;       // UTC time stamp at CYCEND - milliseconds [0 999]
+	long vrms;                 // VRMS  24-bit (U) - mean of 100 zero-crossing synchronised readings
+	long irms;                 // IRMS  24-bit (U) - mean of 100 zero-crossing synchronised readings
+	long vpeak;                // RSTVPEAK 24-bit (U)
+	long ipeak;                // RSTIPEAK 24-bit (U)
+	long activeEnergy;         // LAENERGY   24-bit (S) - over LINECYC half line cycles
+	long apparentEnergy;       // LVAENERGY  24-bit (U) - over LINECYC half line cycles
+	long reactiveEnergy;       // LVARENERGY 24-bit (S) - over LINECYC half line cycles
+	int  period;               // PERIOD 16-bit (U)
+	char temp;                 // TEMP    8-bit (S)
+	byte meter;                // ADE7753 of the Nanode it was taken on [0 SCHED_METERS-1], see GridScheduler.h
+};
+
+#endif
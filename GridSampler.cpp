@@ -0,0 +1,255 @@
+/* GridSampler.cpp = Timer driven acquisition of the ADE7753 for ArduGrid7753
+===========================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridSampler.h for the sequence of the reads and the sharing of the SPI bus.
+
+*/
+
+#include "GridSampler.h"
+
+#ifdef GRIDSAMPLER
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "ADE7753.h"
+
+// Chip select of the ADE7753, CS = digital pin 10 = PB2, driven directly from the ISR
+#define SAMPLER_CS_LOW()   PORTB &= ~_BV(PB2)
+#define SAMPLER_CS_HIGH()  PORTB |= _BV(PB2)
+
+// SPI settings of ADE7753::setSPI(): SPI_MODE2, MSBFIRST, SPI_CLOCK_DIV32, plus the interrupt
+#define SAMPLER_SPCR       ( _BV(SPIE) | _BV(SPE) | _BV(MSTR) | _BV(CPOL) | _BV(SPR1) )
+#define SAMPLER_SPSR       _BV(SPI2X)
+
+GridSampler gridSampler;
+
+ISR(TIMER2_COMPA_vect) {
+	gridSampler.tick();
+}
+
+ISR(SPI_STC_vect) {
+	gridSampler.transferred();
+}
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === read ===
+* Start reading a register, the data bytes are clocked by transferred()
+* @param r: register
+* @param n: width of the register in bytes
+*/
+void GridSampler::read(byte r, byte n) {
+	spcr = SPCR;
+	spsr = SPSR;
+	SPCR = SAMPLER_SPCR;
+	SPSR = SAMPLER_SPSR;
+	reg = r;
+	bytes = n;
+	count = 0;
+	value = 0;
+	SAMPLER_CS_LOW();
+	SPDR = r;
+}
+
+/** === push ===
+* End of the cycle: queue its CycleSample and stop the ticks
+* @param mains: false when the cycle ended with ZXTO
+*/
+void GridSampler::push(boolean mains) {
+	cycle.at = millis();
+	cycle.mains = mains;
+	cycle.zx = zx;
+	cycle.vrms = zx ? sumV / zx : 0;
+	cycle.irms = zx ? sumI / zx : 0;
+	if ( ! mains )
+	{
+		cycle.vrms = cycle.irms = 0;
+		cycle.activeEnergy = cycle.apparentEnergy = cycle.reactiveEnergy = 0;
+		cycle.period = 0;
+	}
+	cycles.push(cycle);
+	TCCR2B = 0;
+	TIMSK2 = 0;
+	running = false;
+}
+
+/** === done ===
+* A register has been read, go on with the next one
+*/
+void GridSampler::done(void) {
+	byte r = reg;
+	reg = 0;
+	switch ( r )
+	{
+	case RSTSTATUS:
+		if ( value & ZXTO ) push(false);
+		else if ( value & CYCEND ) read(LAENERGY, 3);
+		else if ( value & ZX ) read(VRMS, 3);
+		break;
+	case VRMS:
+		sumV += value;
+		read(IRMS, 3);
+		break;
+	case IRMS:
+		sumI += value;
+		zx++;
+		break;
+	case LAENERGY:
+		cycle.activeEnergy = value;
+		read(LVAENERGY, 3);
+		break;
+	case LVAENERGY:
+		cycle.apparentEnergy = value;
+		read(LVARENERGY, 3);
+		break;
+	case LVARENERGY:
+		cycle.reactiveEnergy = value;
+		read(PERIOD, 2);
+		break;
+	case PERIOD:
+		cycle.period = value;
+		push(true);
+		break;
+	}
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* Timer2 in CTC mode with a period of SAMPLER_TICK_US, stopped until start()
+*/
+void GridSampler::begin(void) {
+	TCCR2B = 0;
+	TIMSK2 = 0;
+	TCCR2A = _BV(WGM21);
+	OCR2A = SAMPLER_TICK_US / 8 - 1; // 16 MHz / 128 = 8 us per count
+	for (byte i = 0; i < 2; i++) latMin[i] = 0xFF;
+}
+
+/** === start ===
+* Start sampling a line cycle accumulation, to be called right after GridMeter::startCycle()
+* with the bus locked
+*/
+void GridSampler::start(void) {
+	sumV = sumI = 0;
+	zx = 0;
+	reg = 0;
+	running = true;
+	TCNT2 = 0;
+	TIFR2 = _BV(OCF2A);
+	TIMSK2 = _BV(OCIE2A);
+	TCCR2B = _BV(CS22) | _BV(CS20); // prescaler 128
+}
+
+/** === stop ===
+* Stop sampling before the end of the cycle, ie. when the meter has to be reconfigured
+*/
+void GridSampler::stop(void) {
+	TCCR2B = 0;
+	TIMSK2 = 0;
+	running = false;
+	while ( reg != 0 ) ; // transaction in flight
+}
+
+/** === lock ===
+* The main loop takes the SPI bus, for the ENC28J60 or the ADE7753
+*/
+void GridSampler::lock(void) {
+	locked = true;
+	while ( reg != 0 ) ; // transaction in flight, clocked by the SPI interrupt
+}
+
+void GridSampler::unlock(void) {
+	locked = false;
+}
+
+/** === setTraffic ===
+* @param on: true while a Pachube request is in flight, the jitter is kept apart
+*/
+void GridSampler::setTraffic(boolean on) {
+	traffic = on ? 1 : 0;
+}
+
+/** === tick ===
+* Timer2 compare match: read the status register unless the bus is taken
+*/
+void GridSampler::tick(void) {
+	byte latency = TCNT2; // counts since the compare match
+	ticks[traffic]++;
+	if ( latency < latMin[traffic] ) latMin[traffic] = latency;
+	if ( latency > latMax[traffic] ) latMax[traffic] = latency;
+	if ( locked || reg != 0 || ! running )
+	{
+		missed[traffic]++;
+		return;
+	}
+	read(RSTSTATUS, 2);
+}
+
+/** === transferred ===
+* SPI transfer complete: store the byte received and clock the next one
+*/
+void GridSampler::transferred(void) {
+	if ( count > 0 ) value = ( value << 8 ) | SPDR;
+	else delayMicroseconds(4); // t9 - minimum time between the address and the data of a read
+	if ( count < bytes )
+	{
+		count++;
+		SPDR = 0x00;
+		return;
+	}
+	SAMPLER_CS_HIGH();
+	SPCR = spcr;
+	SPSR = spsr;
+	done();
+}
+
+/** === print ===
+* Dump the jitter of the ticks without and with network traffic since the last dump
+*/
+void GridSampler::print(Print &p) {
+	unsigned int t[2], m[2];
+	byte lo[2], hi[2];
+	byte sreg = SREG;
+	cli();
+	for (byte i = 0; i < 2; i++)
+	{
+		t[i] = ticks[i];   m[i] = missed[i];
+		lo[i] = latMin[i]; hi[i] = latMax[i];
+		ticks[i] = missed[i] = 0;
+		latMin[i] = 0xFF;  latMax[i] = 0;
+	}
+	SREG = sreg;
+	for (byte i = 0; i < 2; i++)
+	{
+		p.print(i ? F(" -- traffic: ") : F("sampler quiet: "));
+		p.print(t[i]);
+		p.print(F(" ticks, missed "));
+		p.print(m[i]);
+		if ( t[i] == 0 ) continue;
+		p.print(F(", latency "));
+		p.print(lo[i] * 8);
+		p.print('-');
+		p.print(hi[i] * 8);
+		p.print(F(" us"));
+	}
+	p.println();
+}
+
+#endif
@@ -0,0 +1,130 @@
+/* GridSampler.h = Timer driven acquisition of the ADE7753 for ArduGrid7753
+=========================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+In the default acquisition, the main loop polls the ADE7753 for the zero crossings and
+the end of the line cycle accumulation, so the readings are as late as the Serial
+prints, ether.packetLoop() and the 100 ms pace of the loop make them.
+
+When GRIDSAMPLER is defined below, Timer2 interrupts every SAMPLER_TICK_US instead, and
+the ISR starts a read of RSTSTATUS. The bytes of the SPI transactions are clocked from
+the SPI interrupt (SPI_STC_vect), so the CPU is not held while they shift:
+
+	RSTSTATUS      every tick, clears the flags
+	ZX             VRMS then IRMS, added to the sums of the cycle
+	CYCEND         LAENERGY, LVAENERGY, LVARENERGY and PERIOD, then the mean RMS of the
+	               cycle and its energies are pushed as one CycleSample to the queue
+	ZXTO           a CycleSample without mains is pushed
+
+The main loop takes the CycleSample from the queue (SpscQueue.h, the ISR is the producer)
+and reads the peaks and the temperature itself.
+
+The ADE7753 and the ENC28J60 share the SPI bus. The main loop holds the bus with lock()
+while it uses the ENC28J60 or the ADE7753, and the ticks that fall meanwhile are missed:
+with the 100 ms pace, the sampler runs during the idle time of the loop. lock() waits
+for the transaction in flight, at most 8 bytes.
+
+Jitter: at each tick the latency of the ISR is read from TCNT2, in 8 us steps, and the
+missed ticks are counted. Both are kept apart for the ticks with and without network
+traffic (setTraffic(), set by the main loop while a Pachube request is in flight), and
+dumped by print() at each update.
+
+The sampler takes Timer2 (Timer0 is millis() / micros(), Timer1 counts CF with GRIDPULSE) and
+about 70 us of CPU per 1 ms tick. It only runs between start() and the CycleSample,
+so that the CPU can still sleep between the cycles in POWER_SAVE mode (see GridPower.h).
+
+Being AVR only, it is not compiled in the host benchmark.
+
+*/
+
+#ifndef GRIDSAMPLER_H
+#define GRIDSAMPLER_H
+
+#include "GridFeatures.h"
+// #define GRIDSAMPLER             // uncomment for the timer driven acquisition
+
+#define SAMPLER_TICK_US  1000      // Timer2 period in microseconds, CTC with a prescaler of 128
+#define SAMPLER_QUEUE    2         // CycleSample slots, 2 x 28 bytes
+
+#ifdef GRIDSAMPLER
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include "SpscQueue.h"
+
+#define BUS_LOCK()       gridSampler.lock()
+#define BUS_UNLOCK()     gridSampler.unlock()
+
+struct CycleSample {
+	unsigned long at;          // millis() at CYCEND or ZXTO
+	boolean mains;             // false when the cycle ended with ZXTO
+	byte zx;                   // zero crossings sampled, the others fell in a lock()
+	long vrms;                 // mean of the VRMS readings at the sampled zero crossings
+	long irms;
+	long activeEnergy;         // LAENERGY, LVAENERGY, LVARENERGY at CYCEND
+	long apparentEnergy;
+	long reactiveEnergy;
+	unsigned int period;       // PERIOD
+};
+
+class GridSampler {
+   //public methods
+   public:
+      void begin(void);
+      void start(void);
+      void stop(void);
+      void lock(void);
+      void unlock(void);
+      void setTraffic(boolean on);
+      void print(Print &p);
+
+      void tick(void);           // from ISR(TIMER2_COMPA_vect)
+      void transferred(void);    // from ISR(SPI_STC_vect)
+
+      SpscQueue<CycleSample, SAMPLER_QUEUE> cycles;  // produced by the ISR, consumed by the main loop
+
+   //private methods
+   private:
+      void read(byte reg, byte bytes);
+      void done(void);
+      void push(boolean mains);
+
+      volatile boolean running;  // between start() and the CycleSample
+      volatile boolean locked;   // the main loop holds the SPI bus
+      volatile byte reg;         // register being read, 0 when the bus is free
+      byte bytes;                // data bytes of the register
+      byte count;                // data bytes received
+      unsigned long value;       // data shifted in
+      byte spcr, spsr;           // SPI settings of the main loop, restored after each transaction
+
+      unsigned long sumV, sumI;  // VRMS / IRMS readings of the cycle
+      byte zx;
+      CycleSample cycle;         // being read at CYCEND
+
+      byte traffic;              // 1 while a Pachube request is in flight
+      unsigned int ticks[2];     // per traffic state
+      unsigned int missed[2];    // ticks while the bus was locked or busy
+      byte latMin[2];            // ISR latency in Timer2 counts (8 us)
+      byte latMax[2];
+};
+
+extern GridSampler gridSampler;
+
+#else
+
+#define BUS_LOCK()
+#define BUS_UNLOCK()
+
+#endif
+
+#endif
@@ -0,0 +1,137 @@
+/* GridScheduler.cpp = Round robin acquisition of several ADE7753 for ArduGrid7753
+=================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridScheduler.h for the interleaving of the meters.
+
+*/
+
+#include "GridScheduler.h"
+#include "GridTrace.h"
+#include "GridWatchdog.h"
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === traceStep ===
+* @return phase of GridTrace.h, also the GridWatchdog step, of a GridMeter state
+*/
+static byte traceStep(byte phase) {
+	switch ( phase )
+	{
+	case METER_VRMS: return TRACE_VRMS;
+	case METER_IRMS: return TRACE_IRMS;
+	}
+	return TRACE_CYCEND;
+}
+
+/** === budget ===
+* @return worst case duration in ms of a phase over all the meters
+*/
+unsigned int GridScheduler::budget(byte phase) {
+	if ( phase == METER_CYCLE ) return GridMeter::getCycleBudget() + ( count - 1 ) * stagger + count * SCHED_START;
+	return METER_RMS_BUDGET + ( count - 1 ) * stagger;
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* @param meters: GridMeter of each ADE7753, already through GridMeter::begin()
+* @param count: number of meters [1 SCHED_METERS]
+*/
+void GridScheduler::begin(GridMeter *meters, byte count) {
+	this->meters = meters;
+	this->count = count;
+	stagger = SCHED_STAGGER;
+}
+
+/** === setStagger ===
+* @param ms: time between the starts of two accumulations, 0 aligns the windows: the
+* accumulations are started in a row, within about 1 ms
+*/
+void GridScheduler::setStagger(unsigned int ms) {
+	stagger = ms;
+}
+
+/** === getCount ===
+* @return byte with the number of meters
+*/
+byte GridScheduler::getCount(void) {
+	return count;
+}
+
+/** === run ===
+* Start the line cycle accumulation of every meter, stagger ms apart, and poll them in
+* turn until they are all METER_READY or the budget of a phase is spent
+*/
+void GridScheduler::run(void) {
+	unsigned long start = millis();
+	byte started = 0;
+	byte phase = METER_CYCLE;
+	TRACE_BEGIN(TRACE_CYCEND);
+	gridWatchdog.step(TRACE_CYCEND, budget(METER_CYCLE));
+	if ( stagger == 0 )
+	{   // aligned windows: the SPI of every meter opened and its A/D converters resumed first
+		TRACE_BEGIN(TRACE_SPI);
+		for (byte i = 0; i < count; i++)
+		{
+			meters[i].open();
+			meters[i].resume();
+		}
+		for (byte i = 0; i < count; i++) meters[i].start();
+		TRACE_END(TRACE_SPI);
+		started = count;
+	}
+	while ( true )
+	{
+		if ( started < count && ( millis() - start ) >= (unsigned long)started * stagger )
+		{
+			meters[started++].startCycle();
+		}
+		byte slowest = METER_READY;
+		for (byte i = 0; i < count; i++)
+		{
+			byte s = ( i < started ) ? meters[i].poll() : METER_CYCLE;
+			if ( s < slowest ) slowest = s;
+		}
+		if ( slowest != phase )
+		{   // every meter is through the phase
+			gridWatchdog.done();
+			TRACE_END(traceStep(phase));
+			phase = slowest;
+			if ( phase == METER_READY ) return;
+			TRACE_BEGIN(traceStep(phase));
+			gridWatchdog.step(traceStep(phase), budget(phase));
+		}
+		else if ( ! gridWatchdog.alive() )
+		{   // the meters behind end without mains in read()
+			gridWatchdog.done();
+			TRACE_END(traceStep(phase));
+			return;
+		}
+	}
+}
+
+/** === read ===
+* Take the record of a meter after run(), see GridMeter::read()
+* @param i: meter [0 count-1]
+* @param rec: record filled with the raw register values and the meter, the time stamp is left untouched
+*/
+void GridScheduler::read(byte i, GridRecord &rec) {
+	meters[i].read(rec);
+	rec.meter = i;
+}
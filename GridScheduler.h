@@ -0,0 +1,78 @@
+/* GridScheduler.h = Round robin acquisition of several ADE7753 for ArduGrid7753
+===============================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+A three-phase or multi-circuit board carries up to SCHED_METERS ADE7753 on the SPI bus,
+each with its own chip select pin and calibration (one row of the shield table each, see
+NodeConfig.h), and one GridMeter each.
+
+Measured one after the other, N meters would take N x 4 s, more than the update period
+for 3 of them. run() interleaves them instead: the line cycle accumulations are started
+SCHED_STAGGER ms apart, then each pass of the loop calls GridMeter::poll() on every meter
+in turn, which reads its status register and, when due, its energies at CYCEND or its
+VRMS / IRMS at a zero crossing. All the meters are measured within one cycle, about 4 s
+plus the stagger.
+
+Staggering the starts keeps the SPI load flat: the CYCEND of each meter falls in its own
+half line cycle, so that the 4 energy and period reads of the meters do not pile up on
+top of the zero crossing reads of the others. host/bench.cpp counts the SPI transactions
+other than the status polls per half line cycle: 4 at most with one meter, 6 with three,
+against a mean of 0.5 per meter.
+
+A stagger of 0 (setStagger()) aligns the windows instead, for the three phases of one
+supply (see GridPhases.h): the SPI of every meter is set and its A/D converters resumed
+first, then the accumulations are started in a row, within about 1 ms, so that the meters
+integrate over the same line cycles. The CYCENDs then pile up: 12 transactions at most in
+one half cycle with three meters, for the same mean.
+
+run() is the blocking part, with one GridWatchdog step per phase (the slowest meter
+gives the phase): CYCEND while a meter accumulates, then VRMS, then IRMS. A meter that is
+behind when the budget of a phase is spent ends without mains in read().
+
+read() then takes the record of each meter, with its peaks and temperature, and tags it
+with the meter number. Its datastreams are numbered from it (see sendRecord() in
+ArduGrid7753.ino).
+
+*/
+
+#ifndef GRIDSCHEDULER_H
+#define GRIDSCHEDULER_H
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include "GridMeter.h"
+#include "GridRecord.h"
+
+#define SCHED_METERS   3     // ADE7753 per Nanode at most, one GridMeter each (about 50 bytes of SRAM)
+#define SCHED_STAGGER  20    // in milliseconds - between the starts of two accumulations, 2 half cycles at 50Hz
+#define SCHED_START    60    // in milliseconds - startCycle() of one meter: setSPI() and METER_SETTLE after ASUSPEND
+
+class GridScheduler {
+   //public methods
+   public:
+      void begin(GridMeter *meters, byte count);
+      void setStagger(unsigned int ms);
+      byte getCount(void);
+      void run(void);
+      void read(byte i, GridRecord &rec);
+
+   //private methods
+   private:
+      unsigned int budget(byte phase);
+
+      GridMeter *meters;      // count of them
+      byte count;
+      unsigned int stagger;   // in milliseconds
+};
+
+#endif
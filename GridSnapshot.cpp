@@ -0,0 +1,152 @@
+/* GridSnapshot.cpp = Last readings and energy totals of ArduGrid7753, for the local servers
+=========================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridSnapshot.h for the fixed point values and the energy totals.
+
+*/
+
+#include "GridSnapshot.h"
+
+#ifdef GRIDSNAPSHOT
+
+#include "GridConfig.h"
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === hundredths ===
+* @return long with a calibrated value x 100, rounded
+*/
+static long hundredths(float x) {
+	x *= 100.0;
+	return x < 0 ? (long)( x - 0.5 ) : (long)( x + 0.5 );
+}
+
+/** === signed24 ===
+* @return long with a 24-bit 2-complement register value, LAENERGY or LVARENERGY of a record
+*/
+static long signed24(long x) {
+	return ( x & 0x800000L ) ? x - 0x1000000L : x;
+}
+
+/** === carry ===
+* Move the whole Wh of a fraction into its total
+*/
+static void carry(unsigned long &total, float &part) {
+	if ( part < 1.0 ) return;
+	unsigned long wh = part;
+	total += wh;
+	part -= wh;
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* @param meters: ADE7753 of the Nanode
+*/
+void GridSnapshot::begin(byte meters) {
+	this->meters = meters;
+	measured = 0;
+	counted = 0;
+	memset(readings, 0, sizeof(readings));
+	memset(health, 0, sizeof(health));
+}
+
+/** === update ===
+* Keep the calibrated values of a record, as sendRecord() sends them to Pachube, and
+* integrate the energy since the previous record of the meter
+* @param rec: record of a measurement cycle
+* @param shield: calibration of the ADE7753 the record was taken on
+* @param at: millis() of the end of the line cycle accumulation of the record
+*/
+void GridSnapshot::update(GridRecord &rec, const MeterConfig *shield, unsigned long at) {
+	if ( rec.meter >= meters ) return;
+	SnapReading &r = readings[rec.meter];
+	float active = signed24(rec.activeEnergy) / CONFIG_FLOAT(&shield->calActiveEnergy);
+	if ( ( measured & ( 1 << rec.meter ) ) && ! ( counted & ( 1 << rec.meter ) ) )
+	{
+		unsigned long dt = at - r.at;
+		addEnergy(rec.meter, active * ( dt > SNAP_GAP_MAX ? SNAP_GAP_MAX : dt ) / 3600000.0);
+	}
+	measured |= 1 << rec.meter;
+	r.at = at;
+	r.utcSec = rec.utcSec;
+	r.utcMs = rec.utcMs;
+	r.value[SNAP_VRMS] = hundredths(rec.vrms / CONFIG_FLOAT(&shield->calVrms));
+	r.value[SNAP_IRMS] = hundredths(rec.irms / CONFIG_FLOAT(&shield->calIrms));
+	r.value[SNAP_ACTIVE] = hundredths(active);
+	r.value[SNAP_APPARENT] = hundredths(rec.apparentEnergy / CONFIG_FLOAT(&shield->calApparentEnergy));
+	r.value[SNAP_REACTIVE] = hundredths(signed24(rec.reactiveEnergy) / CONFIG_FLOAT(&shield->calReactiveEnergy));
+	r.value[SNAP_TEMP] = (int)( rec.temp / CONFIG_FLOAT(&shield->calTemp) );
+	r.value[SNAP_FREQ] = rec.period == 0 ? 0 : hundredths(float(CLKIN/4) / float(rec.period));
+}
+
+/** === setCounted ===
+* The energy totals of a meter come from addEnergy() only, its power is no more integrated
+* @param meter: [0 getMeters()-1]
+*/
+void GridSnapshot::setCounted(byte meter) {
+	if ( meter < meters ) counted |= 1 << meter;
+}
+
+/** === addEnergy ===
+* Add to the import or the export total of a meter
+* @param meter: [0 getMeters()-1]
+* @param wh: in the unit of datastream 4 times hours, > 0 imported, < 0 exported
+*/
+void GridSnapshot::addEnergy(byte meter, float wh) {
+	if ( meter >= meters ) return;
+	SnapReading &r = readings[meter];
+	if ( wh > 0 ) r.importPart += wh;
+	else r.exportPart -= wh;
+	carry(r.importWh, r.importPart);
+	carry(r.exportWh, r.exportPart);
+}
+
+/** === setHealth ===
+* @param field: SNAP_UPDATES ... SNAP_FREE
+* @param value: as sent to its datastream
+*/
+void GridSnapshot::setHealth(byte field, long value) {
+	if ( field < SNAP_HEALTH ) health[field] = value;
+}
+
+/** === getMeters ===
+* @return byte with the meters of the Nanode
+*/
+byte GridSnapshot::getMeters(void) {
+	return meters;
+}
+
+/** === getReading ===
+* @param meter: [0 getMeters()-1]
+* @return const SnapReading* with the last readings of the meter, all 0 until its first record
+*/
+const SnapReading *GridSnapshot::getReading(byte meter) {
+	return &readings[meter < meters ? meter : 0];
+}
+
+/** === getHealth ===
+* @param field: SNAP_UPDATES ... SNAP_FREE
+* @return long with the last value given to setHealth()
+*/
+long GridSnapshot::getHealth(byte field) {
+	return field < SNAP_HEALTH ? health[field] : 0;
+}
+
+#endif
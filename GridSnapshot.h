@@ -0,0 +1,111 @@
+/* GridSnapshot.h = Last readings and energy totals of ArduGrid7753, for the local servers
+=======================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+The local servers (GridHttp.h on port 80, GridModbus.h on port 502) answer from this
+snapshot, taken at each measurement cycle, so that a request never waits on the ADE7753:
+
+	update()      at each record of the measurement, the calibrated values of its meter are
+	              kept in fixed point (hundredths, as the datastreams are sent, the
+	              temperature in units) with the UTC time stamp of the record
+	setHealth()   at each update period, the health counters of datastreams 10-18
+
+Energy totals: the line cycle accumulation of a record gives the mean active power of its
+2 s (datastream 4). It is taken as the power of the meter from the previous record on, and
+integrated into an import total (power > 0) and an export total (power < 0), in the unit
+of datastream 4 times hours, ie. Wh when datastream 4 is calibrated in W. A gap of more than
+SNAP_GAP_MAX between two records of a meter (a reboot of the ENC28J60, a hung update...) is
+counted as SNAP_GAP_MAX. The totals start from 0 at each reboot: the reboot counter tells
+a reader when they did.
+
+With GRIDPULSE (see GridPulse.h), the totals of the meter whose CF pulses are counted are
+taken from the pulses instead: setCounted() stops the integration of its power, and the
+sketch gives the energy of the pulses at each of its records to addEnergy().
+
+The snapshot is compiled in when GRIDSNAPSHOT is defined below, in no profile (see
+GridFeatures.h), which the local servers need: 192 bytes of SRAM with 3 meters. Without
+it GRIDPULSE only cross-checks the pulses, their totals have no reader.
+
+*/
+
+#ifndef GRIDSNAPSHOT_H
+#define GRIDSNAPSHOT_H
+
+#include "GridFeatures.h"
+// #define GRIDSNAPSHOT            // uncomment for the snapshot of the local servers (about 190 bytes of SRAM with 3 meters)
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include "GridRecord.h"
+#include "NodeConfig.h"
+#include "GridScheduler.h"
+
+#define SNAP_GAP_MAX     60000   // in milliseconds - longest time between two records integrated
+
+// SnapReading value
+#define SNAP_VRMS        0       // datastream 0, x 100
+#define SNAP_IRMS        1       // datastream 1, x 100
+#define SNAP_ACTIVE      2       // datastream 4, x 100
+#define SNAP_APPARENT    3       // datastream 5, x 100
+#define SNAP_REACTIVE    4       // datastream 6, x 100
+#define SNAP_TEMP        5       // datastream 7
+#define SNAP_FREQ        6       // datastream 8, x 100
+#define SNAP_FIELDS      7
+
+// setHealth() field
+#define SNAP_UPDATES     0       // datastream 10 - updates since reboot
+#define SNAP_REBOOTS     1       // datastream 11
+#define SNAP_TIMEOUTS    2       // datastream 12 - watchdog timeouts
+#define SNAP_RESPONSE    3       // datastream 13 - Pachube response time in ms
+#define SNAP_BUFFERED    4       // datastream 14 - records waiting for upload
+#define SNAP_DROPPED     5       // datastream 16 - records dropped since reboot
+#define SNAP_FREE        6       // datastream 18 - minimum free SRAM in bytes since reboot
+#define SNAP_HEALTH      7
+
+#ifdef GRIDSNAPSHOT
+
+struct SnapReading {
+	unsigned long utcSec;      // UTC time stamp of the record, 0 if none yet or the clock is not synchronised
+	unsigned int  utcMs;
+	long value[SNAP_FIELDS];   // SNAP_VRMS ... SNAP_FREQ
+	unsigned long at;          // millis() of the end of the cycle of the record
+	unsigned long importWh;    // energy totals since reboot
+	unsigned long exportWh;
+	float importPart;          // fractions of Wh not yet in the totals
+	float exportPart;
+};
+
+class GridSnapshot {
+   //public methods
+   public:
+      void begin(byte meters);
+      void update(GridRecord &rec, const MeterConfig *shield, unsigned long at);
+      void setCounted(byte meter);
+      void addEnergy(byte meter, float wh);
+      void setHealth(byte field, long value);
+      byte getMeters(void);
+      const SnapReading *getReading(byte meter);
+      long getHealth(byte field);
+
+   //private methods
+   private:
+      SnapReading readings[SCHED_METERS];
+      long health[SNAP_HEALTH];
+      byte meters;               // meters of the Nanode
+      byte measured;             // bit m set once meter m has a record
+      byte counted;              // bit m set when the totals of meter m come from addEnergy()
+};
+
+#endif
+
+#endif
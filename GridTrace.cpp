@@ -0,0 +1,121 @@
+/* GridTrace.cpp = Timing counters of the measurement and upload phases of ArduGrid7753
+=====================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridTrace.h for the phases and counters, and how to compile them in.
+
+*/
+
+#include "GridTrace.h"
+
+#ifdef GRIDTRACE
+
+#include <avr/pgmspace.h>
+
+GridTrace gridTrace; // zero initialised, ready to use before setup()
+
+static const char traceNames[TRACE_ENTRIES][8] PROGMEM = {
+	"spi", "cycend", "vrms", "irms", "temp", "stash", "send", "dhcp",
+	"read8", "read16", "read24"
+};
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === add ===
+* Fold one value into the min / max / mean of an entry
+* @param entry: phase or counter
+* @param value: duration in us, or number of calls
+*/
+void GridTrace::add(byte entry, unsigned long value) {
+	if ( n[entry] == 0 || value < min[entry] ) min[entry] = value;
+	if ( value > max[entry] ) max[entry] = value;
+	if ( sum[entry] > 0xFFFFFFFFUL - value || n[entry] == 0xFFFF )
+	{
+		sum[entry] /= 2; // keep the mean, forget half of the history
+		n[entry] /= 2;
+	}
+	sum[entry] += value;
+	n[entry]++;
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin / end ===
+* Mark the beginning and the end of an occurrence of a phase
+* @param phase: TRACE_SPI ... TRACE_DHCP
+*/
+void GridTrace::begin(byte phase) {
+	start[phase] = micros();
+}
+
+void GridTrace::end(byte phase) {
+	unsigned long d = micros() - start[phase];
+	add(phase, d);
+	cycleTime += d;
+}
+
+/** === count ===
+* Count one call, ie. an ADE7753 register read
+* @param counter: TRACE_READ8 ... TRACE_READ24
+*/
+void GridTrace::count(byte counter) {
+	calls[counter - TRACE_PHASES]++;
+}
+
+/** === endCycle ===
+* Fold the calls counted during the update that just ended into the counter entries
+*/
+void GridTrace::endCycle(void) {
+	for (byte i = TRACE_PHASES; i < TRACE_ENTRIES; i++)
+	{
+		add(i, calls[i - TRACE_PHASES]);
+		calls[i - TRACE_PHASES] = 0;
+	}
+	lastCycleTime = cycleTime;
+	cycleTime = 0;
+}
+
+/** === print ===
+* Dump the table, one line per entry: name, occurrences, min, mean, max
+* @param p: Serial
+*/
+void GridTrace::print(Print &p) {
+	char c;
+	p.println(F("-> trace: name n min mean max (in us, or calls per update)"));
+	for (byte i = 0; i < TRACE_ENTRIES; i++)
+	{
+		const char *s = traceNames[i];
+		byte len = 0;
+		p.print(F("   "));
+		while ( ( c = pgm_read_byte(s++) ) != 0 ) { p.print(c); len++; }
+		while ( len++ < 7 ) p.print(' ');
+		p.print(' '); p.print(n[i]);
+		p.print(' '); p.print(min[i]);
+		p.print(' '); p.print(n[i] ? sum[i] / n[i] : 0);
+		p.print(' '); p.println(max[i]);
+	}
+}
+
+/** === getCycleTime ===
+* @return time in us spent in the traced phases during the last complete update
+*/
+unsigned long GridTrace::getCycleTime(void) {
+	return lastCycleTime;
+}
+
+#endif
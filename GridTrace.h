@@ -0,0 +1,102 @@
+/* GridTrace.h = Timing counters of the measurement and upload phases of ArduGrid7753
+===================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+To find out where the time of each 10 s update goes, the main phases of the loop are
+timed, and the ADE7753 register reads are counted, into a fixed table giving for each
+entry its min, max and mean:
+
+	phases   - duration in microseconds of each occurrence
+	counters - number of read8() / read16() / read24() calls during one update
+
+The durations come from micros(), ie. Timer0 with a resolution of 4 us (64 CPU cycles).
+Timer1 and Timer2 are left free for the application.
+
+The table is dumped on Serial every TRACE_DUMP_RATE updates, and the total time of the
+traced phases during the last update is sent to Pachube as datastream 17.
+
+Tracing is compiled in only when GRIDTRACE is defined below (the Arduino IDE cannot pass
+-D options, and the define must be seen by ADE7753.cpp as well). When it is not, the
+TRACE_xxx macros are empty and neither code nor SRAM is used. When it is, the table
+takes 200 bytes of SRAM.
+
+*/
+
+#ifndef GRIDTRACE_H
+#define GRIDTRACE_H
+
+#include "GridFeatures.h"
+// #define GRIDTRACE             // uncomment to compile the timing counters in
+
+#define TRACE_DUMP_RATE  6       // number of Pachube updates between two dumps on Serial (1 mn)
+
+// Phases
+#define TRACE_SPI        0       // ADE7753 SPI setup and mode for the line cycle accumulation
+#define TRACE_CYCEND     1       // wait for the end of the line cycle accumulation
+#define TRACE_VRMS       2       // 100 VRMS readings synchronised on zero crossing
+#define TRACE_IRMS       3       // 100 IRMS readings synchronised on zero crossing
+#define TRACE_TEMP       4       // temperature conversion
+#define TRACE_STASH      5       // calibration and Pachube request build
+#define TRACE_SEND       6       // tcpSend()
+#define TRACE_DHCP       7       // DHCP lease check or renewal
+#define TRACE_PHASES     8       // number of phases above, also the index of the first counter below
+// Counters, from TRACE_PHASES on
+#define TRACE_READ8      8       // ADE7753 8-bit register reads
+#define TRACE_READ16     9       // 16-bit register reads
+#define TRACE_READ24     10      // 24-bit register reads
+#define TRACE_ENTRIES    11      // phases and counters
+
+#ifdef GRIDTRACE
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+
+#define TRACE_BEGIN(p)   gridTrace.begin(p)
+#define TRACE_END(p)     gridTrace.end(p)
+#define TRACE_COUNT(c)   gridTrace.count(c)
+
+class GridTrace {
+   //public methods
+   public:
+      void begin(byte phase);
+      void end(byte phase);
+      void count(byte counter);
+      void endCycle(void);
+      void print(Print &p);
+      unsigned long getCycleTime(void);
+
+   //private methods
+   private:
+      void add(byte entry, unsigned long value);
+
+      unsigned long start[TRACE_PHASES];  // micros() at the beginning of each phase
+      unsigned long min[TRACE_ENTRIES];
+      unsigned long max[TRACE_ENTRIES];
+      unsigned long sum[TRACE_ENTRIES];
+      unsigned int  n[TRACE_ENTRIES];
+      unsigned int  calls[TRACE_ENTRIES - TRACE_PHASES];  // register reads during the current update
+      unsigned long cycleTime;            // in microseconds, traced phases during the current update
+      unsigned long lastCycleTime;        // ... and during the last complete one
+};
+
+extern GridTrace gridTrace;
+
+#else
+
+#define TRACE_BEGIN(p)
+#define TRACE_END(p)
+#define TRACE_COUNT(c)
+
+#endif
+
+#endif
@@ -0,0 +1,72 @@
+/* GridWatchdog.cpp = Deadline budgets of the long operations of ArduGrid7753, feeding the watchdog
+===============================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See GridWatchdog.h for how the steps feed the watchdog.
+
+*/
+
+#include <avr/wdt.h> // Watchdog timer
+#include "GridWatchdog.h"
+
+GridWatchdog gridWatchdog;
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === step ===
+* Start a step of a long operation
+* @param id: of the step, a phase of GridTrace.h
+* @param budget: worst case duration of the step in ms
+*/
+void GridWatchdog::step(byte id, unsigned int budget) {
+	this->id = id;
+	this->budget = budget;
+	start = millis();
+	wdt_reset();
+}
+
+/** === alive ===
+* Feed the watchdog while the current step is within its budget
+* @return boolean true while within the budget, false once it is spent
+*/
+boolean GridWatchdog::alive(void) {
+	if ( ( millis() - start ) > budget ) return false;
+	wdt_reset();
+	return true;
+}
+
+/** === done ===
+* End of the current step
+*/
+void GridWatchdog::done(void) {
+	if ( ( millis() - start ) > budget )
+	{
+		overruns++;
+		lastOverrun = id;
+	}
+	else wdt_reset();
+}
+
+/** === getOverruns ===
+* @return number of steps that went past their budget since the reboot
+*/
+unsigned int GridWatchdog::getOverruns(void) {
+	return overruns;
+}
+
+/** === getLastOverrun ===
+* @return byte with the id of the last step that went past its budget, meaningless while getOverruns() is 0
+*/
+byte GridWatchdog::getLastOverrun(void) {
+	return lastOverrun;
+}
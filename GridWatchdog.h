@@ -0,0 +1,64 @@
+/* GridWatchdog.h = Deadline budgets of the long operations of ArduGrid7753, feeding the watchdog
+=============================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+The watchdog is set to 8 s by WatchdogSetup() and reboots the Nanode from its ISR (see
+ArduGrid7753.ino). Feeding it from the timeout branches of the ADE7753 driver kept a stuck
+loop alive for ever, while a legitimately slow sequence, such as vrms() then irms() on a
+dead line (2 x 101 timeouts of 100 ms), could still trip it.
+
+Instead, each step of the measurement that waits on the ADE7753 declares its worst case
+duration, and the watchdog is fed only while the step stays within it:
+
+	step(id, budget)  start a step with its worst case duration in ms, feeds the watchdog
+	alive()           to be called while the step polls: feeds the watchdog and returns
+	                  true while the step is within its budget, false once it is spent,
+	                  the step then gives up and takes its fallback path
+	done()            end of the step, an overrun of the budget is counted
+
+A step that hangs without calling alive(), or that goes on polling past its budget,
+no longer feeds the watchdog, which reboots the board at most 8 s later.
+
+The step ids are the phases of GridTrace.h.
+
+*/
+
+#ifndef GRIDWATCHDOG_H
+#define GRIDWATCHDOG_H
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+
+#define WATCHDOG_PERIOD  8000    // in milliseconds - WDPS_8S of WatchdogSetup()
+
+class GridWatchdog {
+   //public methods
+   public:
+      void step(byte id, unsigned int budget);
+      boolean alive(void);
+      void done(void);
+      unsigned int getOverruns(void);
+      byte getLastOverrun(void);
+
+   //private methods
+   private:
+      unsigned long start;    // millis() at the beginning of the current step
+      unsigned int budget;    // in milliseconds, worst case duration of the current step
+      byte id;                // current step
+      unsigned int overruns;  // steps that went past their budget since the reboot
+      byte lastOverrun;       // id of the last one
+};
+
+extern GridWatchdog gridWatchdog;
+
+#endif
@@ -0,0 +1,64 @@
+/* MemWatch.cpp = Stack high-water mark of the ATmega328 SRAM for ArduGrid7753
+============================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See MemWatch.h for how the SRAM is painted and measured.
+
+*/
+
+#include "MemWatch.h"
+
+extern uint8_t _end;           // end of .bss, start of the heap
+extern uint8_t __stack;        // RAMEND
+extern uint8_t __data_start;
+extern uint8_t *__brkval;      // top of the heap, 0 if malloc() was never called
+
+/** === paintStack ===
+* Fill the SRAM from the end of .bss to RAMEND with MEM_CANARY. Runs in .init1, before
+* .init2 clears r1 and sets the stack pointer, so it is written in assembly and uses no stack.
+*/
+void paintStack(void) __attribute__ ((naked)) __attribute__ ((used)) __attribute__ ((section (".init1")));
+void paintStack(void) {
+	__asm volatile (
+	"    ldi r30, lo8(_end)      \n"
+	"    ldi r31, hi8(_end)      \n"
+	"    ldi r24, %0             \n"
+	"    ldi r25, hi8(__stack)   \n"
+	"    rjmp 2f                 \n"
+	"1:  st Z+, r24              \n"
+	"2:  cpi r30, lo8(__stack)   \n"
+	"    cpc r31, r25            \n"
+	"    brlo 1b                 \n"
+	"    breq 1b                 \n"
+	: : "i" (MEM_CANARY));
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === getLowWater ===
+* Count the paint left above the heap. Takes about 0.1 ms per 100 free bytes.
+* @return minimum free SRAM in bytes since reset
+*/
+unsigned int MemWatch::getLowWater(void) {
+	uint8_t *p = ( __brkval == 0 ) ? &_end : __brkval;
+	unsigned int n = 0;
+	while ( p < &__stack && *p == MEM_CANARY ) { p++; n++; }
+	return n;
+}
+
+/** === getStatic ===
+* @return size in bytes of the static variables (.data and .bss), all modules
+*/
+unsigned int MemWatch::getStatic(void) {
+	return &_end - &__data_start;
+}
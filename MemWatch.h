@@ -0,0 +1,45 @@
+/* MemWatch.h = Stack high-water mark of the ATmega328 SRAM for ArduGrid7753
+==========================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+freeRam() gives the gap between the heap and the stack at the time it is called, which
+misses the deepest calls (DHCP, DNS, Stash::prepare...) made in between.
+
+At reset, before the C runtime initialises the variables, the whole SRAM above the static
+variables (.data and .bss) is painted with MEM_CANARY. The stack overwrites the paint as
+it grows down, so the paint left at the bottom of the gap is the SRAM that was never used
+since reset: the minimum free SRAM ever observed.
+
+	SRAM 2048 bytes: 0x100 .data .bss | heap -> ... free ... <- stack | 0x8FF RAMEND
+
+The static allocations of each module are found on the PC from the object files of the
+Arduino build with host/memmap.sh.
+
+*/
+
+#ifndef MEMWATCH_H
+#define MEMWATCH_H
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+
+#define MEM_CANARY  0xC5   // paint of the unused SRAM
+
+class MemWatch {
+   //public methods
+   public:
+      unsigned int getLowWater(void);
+      unsigned int getStatic(void);
+};
+
+#endif
@@ -0,0 +1,69 @@
+/* NodeConfig.h = Per Nanode configuration row for ArduGrid7753, stored in PROGMEM
+=================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+As we use one Nanode per sensor, the MAC address read from the Microchip 11AA02E48 identifies
+the board, hence the sensor it is wired to and the Pachube feed it streams to.
+
+Each Nanode is described by one row of the node table (see ArduGrid7753.ino). The table is
+kept in flash with PROGMEM and is never copied to SRAM: the sketch keeps a pointer to the
+row of the board, and reads the fields with pgm_read_byte() / pgm_read_word() /
+pgm_read_float(). The feed, label and host strings can be handed directly to functions
+taking PROGMEM strings, such as showString(), ether.dnsLookup() and the $F argument of
+Stash::prepare().
+
+The last row of the table has an all zero MAC and is used for unknown boards.
+
+The ADE7753 of a board are described apart, one MeterConfig row per Olimex Energy Shield
+in the shield table: its chip select pin, the offsets written to the chip and the
+calibration applied at upload time. A node row points to its first shield row and gives
+the number of ADE7753 on the board, the following rows being the other ones. Nanodes
+wired to the same shield design share its row. The rows are read through the pointer that
+GridMeter keeps (see GridMeter::getConfig()), with CONFIG_BYTE() / CONFIG_WORD() /
+CONFIG_FLOAT(): the rows of the node are copies in SRAM when they can be changed remotely
+(GRIDCONFIG, see GridConfig.h), the rows of the table otherwise.
+
+The ADE7753 of a board measure separate circuits, or the three phases of one supply
+(WIRING_3PHASE), which are then combined into three-phase figures (see GridPhases.h).
+
+*/
+
+#ifndef NODECONFIG_H
+#define NODECONFIG_H
+
+struct MeterConfig {
+	byte  cs;                 // chip select pin of the ADE7753, CS (10) on the Olimex Energy Shield
+	char  ch1os;              // CH1OS   6-bit (S) [-32 +32]       -- Refer to spec page 58 Table 16
+	char  ch2os;              // CH2OS   6-bit (S) [-32 +32]
+	int   irmsos;             // IRMSOS 12-bit (S) [-2048 +2048]   -- Refer to spec page 25, 26
+	int   vrmsos;             // VRMSOS 12-bit (S) [-2048 +2048]
+	float calVrms;            // Raw register value per unit: V, A, Wh...
+	float calIrms;
+	float calVpeak;
+	float calIpeak;
+	float calTemp;
+	float calActiveEnergy;
+	float calApparentEnergy;
+	float calReactiveEnergy;
+};
+
+struct NodeConfig {
+	byte  mac[6];             // MAC address of the Nanode (11AA02E48)
+	byte  nanode;             // Nanode number, 0 for an unknown board
+	char  feed[6];            // Pachube feed ID
+	char  label[20];          // Sensor description
+	char  host[16];           // Upload target
+	byte  power;              // POWER_NORMAL, or POWER_SAVE for the battery backed sites (see GridPower.h)
+	byte  shield;             // row of the first ADE7753 in the shield table
+	byte  meters;             // number of ADE7753 on the board [1 SCHED_METERS], see GridScheduler.h
+	byte  wiring;             // WIRING_CIRCUITS, or WIRING_3PHASE for the phases of one supply on 3 meters (see GridPhases.h)
+};
+
+#endif
@@ -0,0 +1,191 @@
+/* OutageBuffer.cpp = Store and forward buffer of measurement records for ArduGrid7753
+=====================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See OutageBuffer.h for the layout of the SRAM and EEPROM rings.
+
+*/
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include <stddef.h>
+#include <avr/eeprom.h>
+#include "OutageBuffer.h"
+
+#define OUTAGE_SLOT_SIZE (1 + sizeof(GridRecord))
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+int OutageBuffer::slotAddress(byte slot) {
+	return OUTAGE_EEPROM_START + slot * OUTAGE_SLOT_SIZE;
+}
+
+/** === dropEeprom ===
+* Drop the oldest EEPROM record to make room
+*/
+void OutageBuffer::dropEeprom(void) {
+	eeprom_update_byte((uint8_t *)slotAddress(eeHead), 0x00);
+	if ( taken ) takenLost = true; // the oldest record is the one handed out by peek()
+	eeHead = ( eeHead + 1 ) % OUTAGE_EEPROM_SLOTS;
+	eeCount--;
+	dropped++;
+}
+
+/** === spill ===
+* Move the oldest SRAM record to the tail of the EEPROM ring
+*/
+void OutageBuffer::spill(void) {
+	int addr;
+	if ( ramCount == 0 ) return;
+	if ( eeCount == OUTAGE_EEPROM_SLOTS - 1 ) dropEeprom();
+	addr = slotAddress(( eeHead + eeCount ) % OUTAGE_EEPROM_SLOTS);
+	eeprom_update_block(&ram[ramHead], (void *)(addr + 1), sizeof(GridRecord)); // record first, then its flag
+	eeprom_update_byte((uint8_t *)addr, OUTAGE_VALID);
+	eeCount++;
+	ramHead = ( ramHead + 1 ) % OUTAGE_RAM;
+	ramCount--;
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* Empty the SRAM ring and find the records left in the EEPROM ring before the last reboot
+*/
+void OutageBuffer::begin(void) {
+	byte slot;
+	ramHead = 0;
+	ramCount = 0;
+	eeHead = 0;
+	eeCount = 0;
+	taken = false;
+	takenLost = false;
+	dropped = 0;
+
+	// The head is the valid slot following an empty one - there is always an empty slot
+	for (slot = 0; slot < OUTAGE_EEPROM_SLOTS; slot++)
+	{
+		byte previous = ( slot + OUTAGE_EEPROM_SLOTS - 1 ) % OUTAGE_EEPROM_SLOTS;
+		if ( eeprom_read_byte((uint8_t *)slotAddress(slot)) == OUTAGE_VALID &&
+		     eeprom_read_byte((uint8_t *)slotAddress(previous)) != OUTAGE_VALID )
+		{
+			eeHead = slot;
+			break;
+		}
+	}
+	if ( slot == OUTAGE_EEPROM_SLOTS ) return; // no record
+	while ( eeCount < OUTAGE_EEPROM_SLOTS - 1 &&
+	        eeprom_read_byte((uint8_t *)slotAddress(( eeHead + eeCount ) % OUTAGE_EEPROM_SLOTS)) == OUTAGE_VALID )
+	{
+		eeCount++;
+	}
+}
+
+/** === push ===
+* Add a record, spilling the oldest SRAM record to EEPROM if the SRAM ring is full
+* @param rec: measurement record, copied into the buffer
+*/
+void OutageBuffer::push(GridRecord &rec) {
+	if ( ramCount == OUTAGE_RAM ) spill();
+	ram[( ramHead + ramCount ) % OUTAGE_RAM] = rec;
+	ramCount++;
+}
+
+/** === peek ===
+* Hand out the oldest record for upload. It stays in the buffer until release().
+* @return copy of the oldest record, 0 if the buffer is empty
+*/
+GridRecord *OutageBuffer::peek(void) {
+	if ( eeCount > 0 )
+		eeprom_read_block(&cache, (void *)(slotAddress(eeHead) + 1), sizeof(GridRecord));
+	else if ( ramCount > 0 )
+		cache = ram[ramHead];
+	else
+		return 0;
+	taken = true;
+	takenLost = false;
+	return &cache;
+}
+
+/** === release ===
+* End of the upload of the record handed out by peek()
+* @param remove: true when the record has been delivered (or will never be), false to retry it later
+*/
+void OutageBuffer::release(boolean remove) {
+	if ( remove && taken && ! takenLost )
+	{
+		if ( eeCount > 0 )
+		{
+			eeprom_update_byte((uint8_t *)slotAddress(eeHead), 0x00);
+			eeHead = ( eeHead + 1 ) % OUTAGE_EEPROM_SLOTS;
+			eeCount--;
+		}
+		else if ( ramCount > 0 )
+		{
+			ramHead = ( ramHead + 1 ) % OUTAGE_RAM;
+			ramCount--;
+		}
+	}
+	taken = false;
+	takenLost = false;
+}
+
+/** === flush ===
+* Move all SRAM records to EEPROM, ie. before a reboot
+*/
+void OutageBuffer::flush(void) {
+	while ( ramCount > 0 ) spill();
+}
+
+/** === getDepth ===
+* @return number of records waiting for upload
+*/
+unsigned int OutageBuffer::getDepth(void) {
+	return ramCount + eeCount;
+}
+
+byte OutageBuffer::getRamCount(void) {
+	return ramCount;
+}
+
+byte OutageBuffer::getEepromCount(void) {
+	return eeCount;
+}
+
+/** === getOldest ===
+* @param sec: UTC time stamp of the oldest record, seconds since 1 Jan 1970
+* @return false if the buffer is empty
+*/
+boolean OutageBuffer::getOldest(unsigned long *sec) {
+	if ( eeCount > 0 )
+		eeprom_read_block(sec, (void *)(slotAddress(eeHead) + 1 + offsetof(GridRecord, utcSec)), sizeof(*sec));
+	else if ( ramCount > 0 )
+		*sec = ram[ramHead].utcSec;
+	else
+		return false;
+	return true;
+}
+
+/** === getDropped ===
+* @return number of records dropped because the EEPROM ring was full, since reboot
+*/
+unsigned int OutageBuffer::getDropped(void) {
+	return dropped;
+}
@@ -0,0 +1,84 @@
+/* OutageBuffer.h = Store and forward buffer of measurement records for ArduGrid7753
+===================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+When DHCP expires or Pachube is down, the records of the measurement cycles are kept
+until they can be uploaded, oldest first.
+
+The most recent records are kept in a small ring in SRAM. When it is full, its oldest
+record is moved (spilled) to a ring in the ATmega328 EEPROM, so the EEPROM is only
+written while the network is unavailable. The EEPROM ring also survives a reboot.
+Because records are always spilled from the head of the SRAM ring, every EEPROM record
+is older than every SRAM record, and the buffer is replayed in time stamp order by
+taking the EEPROM records first.
+
+EEPROM slot = 1 flag byte + 1 GridRecord (39 bytes). A slot holds a record when its
+flag is OUTAGE_VALID. Records are written before their flag and released by clearing
+the flag only, so the wear is spread over all slots and a power loss during a write
+leaves at most one record missing. One slot is always kept empty so that the head of
+the ring can be found again at boot: it is the valid slot that follows an empty one.
+
+When the EEPROM ring is full, its oldest record is dropped and counted.
+
+The Microchip 11AA02E48 UNIO chip was considered but not used: only 192 of its 256
+bytes are writable (5 records) and the bit-banged UNIO bus is much slower.
+
+	EEPROM map: see ArduGrid7753.ino
+
+*/
+
+#ifndef OUTAGEBUFFER_H
+#define OUTAGEBUFFER_H
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include "GridRecord.h"
+
+#define OUTAGE_RAM           4     // records kept in SRAM (38 bytes each)
+#define OUTAGE_EEPROM_START  256   // first EEPROM address of the ring
+#define OUTAGE_EEPROM_SLOTS  19    // 19 x 39 = 741 bytes, up to address 996 - holds 18 records
+#define OUTAGE_VALID         0xA6  // flag of a slot holding a record (erased EEPROM reads 0xFF) - was 0xA5 for the 37 byte records
+
+class OutageBuffer {
+   //public methods
+   public:
+      void begin(void);
+      void push(GridRecord &rec);
+      GridRecord *peek(void);
+      void release(boolean remove);
+      void flush(void);
+
+      unsigned int getDepth(void);
+      byte getRamCount(void);
+      byte getEepromCount(void);
+      boolean getOldest(unsigned long *sec);
+      unsigned int getDropped(void);
+
+   //private methods
+   private:
+      void spill(void);
+      void dropEeprom(void);
+      int  slotAddress(byte slot);
+
+      GridRecord ram[OUTAGE_RAM];
+      GridRecord cache;         // copy of the record handed out by peek()
+      byte ramHead;             // index of the oldest SRAM record
+      byte ramCount;
+      byte eeHead;              // slot of the oldest EEPROM record
+      byte eeCount;
+      boolean taken;            // a record has been handed out by peek() and not released yet
+      boolean takenLost;        // ... and it has been dropped meanwhile
+      unsigned int dropped;
+};
+
+#endif
@@ -0,0 +1,199 @@
+/* PachubeClient.cpp = Upload client with HTTP status check and retry with backoff for ArduGrid7753
+================================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See PachubeClient.h for a description of the retry policy.
+
+*/
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include <EtherCard.h>
+#include "PachubeClient.h"
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === parseStatus ===
+* Status code of an HTTP status line, ie. 200 for "HTTP/1.1 200 OK"
+* @return int with the status code, 0 if the line is not an HTTP status line
+*/
+static int parseStatus(const char *reply) {
+	int code = 0;
+	if ( strncmp_P(reply, PSTR("HTTP/"), 5) != 0 ) return 0;
+	while ( *reply != ' ' && *reply != '\r' && *reply != 0 ) reply++;
+	if ( *reply++ != ' ' ) return 0;
+	for (byte i = 0; i < 3; i++, reply++)
+	{
+		if ( *reply < '0' || *reply > '9' ) return 0;
+		code = code * 10 + ( *reply - '0' );
+	}
+	return code;
+}
+
+/** === complete ===
+* Apply the retry policy to the outcome of the request in flight
+* @param code: HTTP status code, 0 on timeout
+*/
+void PachubeClient::complete(int code) {
+	inFlight = false;
+	status = code;
+	responseTime = millis() - sentMillis;
+
+	if ( code >= 200 && code < 300 )
+	{
+		buffer->release(true);
+		delivered++;
+		failures = 0;
+		backoff = 0;
+	}
+	else if ( code >= 400 && code < 500 && code != 408 && code != 429 )
+	{
+		buffer->release(true); // Pachube will never accept it
+		rejected++;
+		failures = 0;
+		backoff = 0;
+	}
+	else
+	{
+		buffer->release(false);
+		failures++;
+		backoff = ( backoff == 0 ) ? PACHUBE_BACKOFF_MIN : min(backoff * 2, (unsigned long)PACHUBE_BACKOFF_MAX);
+		backoff += random(0, backoff / 8); // de-synchronise the Nanodes
+		failMillis = millis();
+	}
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === begin ===
+* @param records: store and forward buffer holding the records to upload
+*/
+void PachubeClient::begin(OutageBuffer *records) {
+	buffer = records;
+	inFlight = false;
+	sentMillis = millis() - PACHUBE_INTERVAL;
+	status = 0;
+	responseTime = 0;
+	backoff = 0;
+	failures = 0;
+	delivered = 0;
+	rejected = 0;
+}
+
+/** === ready ===
+* @return true when a record is waiting, no request is in flight, and both the minimum
+* interval between requests and the backoff have elapsed
+*/
+boolean PachubeClient::ready(void) {
+	if ( inFlight || buffer->getDepth() == 0 ) return false;
+	if ( ( millis() - sentMillis ) < PACHUBE_INTERVAL ) return false;
+	if ( backoff != 0 && ( millis() - failMillis ) < backoff ) return false;
+	return true;
+}
+
+/** === busy ===
+* @return true while a request is waiting for its answer
+*/
+boolean PachubeClient::busy(void) {
+	return inFlight;
+}
+
+/** === sent ===
+* To be called right after ether.tcpSend() with the record handed out by buffer->peek().
+* @param fd: session returned by tcpSend()
+*/
+void PachubeClient::sent(byte fd) {
+	session = fd;
+	sentMillis = millis();
+	inFlight = true;
+}
+
+/** === skip ===
+* To be called instead of sent() when nothing of the record handed out by buffer->peek()
+* is left to send: it is released as delivered, without a request
+*/
+void PachubeClient::skip(void) {
+	buffer->release(true);
+}
+
+/** === poll ===
+* Check for the answer to the request in flight. Must be called right after
+* ether.packetLoop() as tcpReply() points into the Ethernet buffer.
+* @return true when the request has completed (answered or timed out)
+*/
+boolean PachubeClient::poll(void) {
+	const char *reply;
+	if ( ! inFlight ) return false;
+	reply = ether.tcpReply(session);
+	if ( reply != 0 )
+	{
+		complete(parseStatus(reply));
+		return true;
+	}
+	if ( ( millis() - sentMillis ) > PACHUBE_TIMEOUT )
+	{
+		complete(0);
+		return true;
+	}
+	return false;
+}
+
+/** === getStatus ===
+* @return HTTP status code of the last request, 0 if it timed out
+*/
+int PachubeClient::getStatus(void) {
+	return status;
+}
+
+/** === getResponseTime ===
+* @return time in ms between tcpSend() and the answer of Pachube, for the last request
+*/
+unsigned long PachubeClient::getResponseTime(void) {
+	return responseTime;
+}
+
+/** === getBackoff ===
+* @return current wait before retrying in ms, 0 when the last request succeeded
+*/
+unsigned long PachubeClient::getBackoff(void) {
+	return backoff;
+}
+
+/** === getFailures ===
+* @return number of consecutive failed requests (timeouts, 5xx)
+*/
+unsigned int PachubeClient::getFailures(void) {
+	return failures;
+}
+
+/** === getDelivered ===
+* @return number of records accepted by Pachube (2xx) since reboot
+*/
+unsigned int PachubeClient::getDelivered(void) {
+	return delivered;
+}
+
+/** === getRejected ===
+* @return number of records dropped on a 4xx answer since reboot
+*/
+unsigned int PachubeClient::getRejected(void) {
+	return rejected;
+}
@@ -0,0 +1,88 @@
+/* PachubeClient.h = Upload client with HTTP status check and retry with backoff for ArduGrid7753
+==============================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Up to V1.1 each update was sent with ether.tcpSend() followed by a blind delay(1000), the
+answer of Pachube was never looked at, and the only cure for a hanging feed was to reboot
+every 180 updates.
+
+The records to upload are taken, oldest first, from the store and forward buffer
+(see OutageBuffer.h). One request is in flight at a time, and requests are spaced by at
+least PACHUBE_INTERVAL so that replaying a backlog does not hog the Nanode. The status
+line of the HTTP answer ("HTTP/1.1 200 OK") is parsed from tcpReply() as soon as it
+arrives, which also gives the response time of Pachube:
+
+	2xx          -> record delivered, removed from the buffer
+	4xx          -> record rejected by Pachube (bad key, bad feed...), removed from the buffer
+	408, 429     -> retried, as for 5xx
+	5xx, timeout -> record kept, retried after an exponential backoff with random jitter
+	                so that the nine Nanodes do not all retry at the same time
+
+EtherCard opens a new TCP connection for each tcpSend(), and a request of several records
+does not fit in the 700 bytes Ethernet buffer, so the connection cannot be kept alive
+between updates. The answer is however detected within a packetLoop() pass instead of
+waiting a full second.
+
+A record whose datastreams are all left out by the deadbands (see GridDeadband.h) is
+released with skip() instead of being sent as an empty request.
+
+*/
+
+#ifndef PACHUBECLIENT_H
+#define PACHUBECLIENT_H
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+#include "GridRecord.h"
+#include "OutageBuffer.h"
+
+#define PACHUBE_INTERVAL     1000    // in milliseconds - minimum time between two requests
+#define PACHUBE_TIMEOUT      5000    // in milliseconds - max wait for the HTTP status line
+#define PACHUBE_BACKOFF_MIN  5000    // in milliseconds - wait before the first retry
+#define PACHUBE_BACKOFF_MAX  320000  // in milliseconds - the wait doubles at each failure up to this value
+
+class PachubeClient {
+   //public methods
+   public:
+      void begin(OutageBuffer *records);
+      boolean ready(void);
+      boolean busy(void);
+      void sent(byte session);
+      void skip(void);
+      boolean poll(void);
+
+      int  getStatus(void);
+      unsigned long getResponseTime(void);
+      unsigned long getBackoff(void);
+      unsigned int getFailures(void);
+      unsigned int getDelivered(void);
+      unsigned int getRejected(void);
+
+   //private methods
+   private:
+      void complete(int code);
+
+      OutageBuffer *buffer;         // records waiting for upload
+      byte session;                 // EtherCard session of the request in flight
+      boolean inFlight;
+      int  status;                  // HTTP status of the last request, 0 on timeout
+      unsigned long sentMillis;     // millis() when the request in flight was sent
+      unsigned long responseTime;   // in milliseconds, of the last request
+      unsigned long failMillis;     // millis() of the last failure
+      unsigned long backoff;        // in milliseconds, current wait before retrying
+      unsigned int failures;        // consecutive failures
+      unsigned int delivered;
+      unsigned int rejected;
+};
+
+#endif
@@ -0,0 +1,125 @@
+/* SpscQueue.h = Lock free single producer / single consumer queue for ArduGrid7753
+================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Hands items from one producer to one consumer that may interrupt each other, ie. an
+ISR polling the ADE7753 and the main loop building the Pachube requests, without
+disabling the interrupts.
+
+The queue is a ring of N items, N a power of two up to 128. head and tail are free
+running 8-bit counters, the slot of a counter is counter & (N - 1) and the number of
+items is (byte)(head - tail), which stays right when they wrap at 256:
+
+	head   written by the producer only, counts the items pushed
+	tail   written by the consumer only, counts the items popped
+
+A load or store of one byte is atomic on the AVR, so each side reads the counter of the
+other side without a lock. The producer copies the item into its slot before publishing
+it with head, and the consumer is done with the slot before releasing it with tail:
+SPSC_BARRIER() keeps the compiler (and, on a PC, the CPU) from moving the copy across
+the store of the counter.
+
+When the queue is full, push() drops the new item and counts it: the producer never
+waits, it may be an ISR.
+
+The items are used in place: peek() gives the oldest item, pop() releases it once done.
+
+	SpscQueue<GridRecord, 2> measured;     // 2 x 38 + 4 bytes of SRAM
+
+Being a template, the queue is all in this header. host/queuebench.cpp runs a producer
+and a consumer on two threads of a PC to check it and measure its throughput.
+
+*/
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#if ARDUINO >= 100
+#include <Arduino.h> // Arduino 1.0
+#else
+#include <WProgram.h> // Arduino 0022+
+#endif
+
+#ifdef __AVR__
+#define SPSC_BARRIER()  asm volatile ("" ::: "memory")     // compiler barrier, the AVR does not reorder
+#else
+#define SPSC_BARRIER()  __sync_synchronize()               // full barrier on a multi core PC
+#endif
+
+template <class T, byte N>
+class SpscQueue {
+   //public methods
+   public:
+      SpscQueue() : head(0), tail(0), dropped(0) {}
+
+      /** === push ===
+      * Producer side: copy an item at the end of the queue
+      * @return boolean false if the queue is full, the item is dropped and counted
+      */
+      boolean push(const T &item) {
+         byte h = head;
+         if ( (byte)( h - tail ) == N )
+         {
+            dropped++;
+            return false;
+         }
+         slots[h & ( N - 1 )] = item;
+         SPSC_BARRIER();
+         head = h + 1;
+         return true;
+      }
+
+      /** === peek ===
+      * Consumer side: oldest item, left in the queue until pop()
+      * @return pointer to the item, 0 if the queue is empty
+      */
+      T *peek(void) {
+         byte t = tail;
+         if ( head == t ) return 0;
+         SPSC_BARRIER();
+         return &slots[t & ( N - 1 )];
+      }
+
+      /** === pop ===
+      * Consumer side: release the item given by peek()
+      */
+      void pop(void) {
+         byte t = tail;
+         if ( head == t ) return;
+         SPSC_BARRIER();
+         tail = t + 1;
+      }
+
+      /** === count ===
+      * @return number of items in the queue: a minimum for the consumer, a maximum for the producer
+      */
+      byte count(void) {
+         return (byte)( head - tail );
+      }
+
+      /** === getDropped ===
+      * @return number of items dropped by push() on a full queue, read by the producer only
+      * or with the interrupts disabled as it is 16-bit
+      */
+      unsigned int getDropped(void) {
+         return dropped;
+      }
+
+   //private methods
+   private:
+      typedef char capacityIsPowerOfTwo[( N & ( N - 1 ) ) == 0 && N != 0 && N <= 128 ? 1 : -1];
+
+      T slots[N];
+      volatile byte head;       // items pushed, written by the producer
+      volatile byte tail;       // items popped, written by the consumer
+      unsigned int dropped;     // items dropped on a full queue, written by the producer
+};
+
+#endif
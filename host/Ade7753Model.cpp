@@ -0,0 +1,247 @@
+/* Ade7753Model.cpp = Register level model of the ADE7753 on the simulated SPI bus
+================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See Ade7753Model.h for what is modelled.
+
+*/
+
+#include "Ade7753Model.h"
+#include "ADE7753.h"
+
+Ade7753Model::Ade7753Model() {
+	mains = true;
+	frequency = 50;
+	phaseUs = 0;
+	vrms  = 2874690;   // 230 V with the calibration of shield #1
+	irms  = 837000;    // 5 A
+	vpeak = 45800;
+	ipeak = 1660000;
+	activePerHalfCycle   = 105;
+	apparentPerHalfCycle = 110;
+	reactivePerHalfCycle = 2;
+	load = 0;
+	temp = 0x30;
+	suspendedUs = 0;
+	cfPin = 0;
+	cfPulses = 0;
+	reset();
+}
+
+/** === reset ===
+* Power up values of the registers
+*/
+void Ade7753Model::reset(void) {
+	memset(regs, 0, sizeof(regs));
+	regs[MODE]    = DISCF | DISSAG;
+	regs[STATUS]  = RESET;
+	regs[IRQEN]   = 0x0040;
+	regs[LINECYC] = 0xFFFF;
+	regs[ZXTOUT]  = 0x0FFF;
+	regs[SAGCYC]  = 0xFF;
+	regs[IPKLVL]  = 0xFF;
+	regs[VPKLVL]  = 0xFF;
+	regs[DIEREV]  = 0x02;
+	lastUpdate = simNow();
+	lastCrossing = simNow();
+	tempDue = 0;
+	halfCycles = 0;
+	accActive = accApparent = accReactive = 0;
+	cfPart = 0;
+	lastActive = 0;
+	count = 0;
+}
+
+
+/*****************************
+*
+* private functions
+*
+*****************************/
+
+/** === update ===
+* Raise the status flags of the events that happened since the last update
+*/
+void Ade7753Model::update(void) {
+	unsigned long long t = simNow();
+	unsigned long long halfPeriod = 500000ULL / frequency;
+	unsigned long long shift = halfPeriod - phaseUs % halfPeriod; // the crossings fall at phaseUs modulo halfPeriod
+
+	if ( regs[MODE] & ASUSPEND )
+	{
+		suspendedUs += t - lastUpdate; // A/D converters off, no zero crossing
+		lastCrossing = t;
+	}
+	else if ( mains )
+	{
+		unsigned long long crossings = ( t + shift ) / halfPeriod - ( lastUpdate + shift ) / halfPeriod;
+		if ( crossings > 0 )
+		{
+			regs[STATUS] |= ZX;
+			lastCrossing = t - ( t + shift ) % halfPeriod;
+			for (unsigned long long c = crossings; c > 0 && ( regs[MODE] & ( CYCMODE | DISCF ) ) != DISCF; c--)
+			{
+				if ( regs[MODE] & CYCMODE )
+				{   // each half cycle adds its energies, a load profile may change them at each crossing
+					if ( load != 0 ) load(this, lastCrossing - ( c - 1 ) * halfPeriod);
+					if ( lastActive < 0 && activePerHalfCycle > 0 ) regs[STATUS] |= PPOS;
+					if ( lastActive > 0 && activePerHalfCycle < 0 ) regs[STATUS] |= PNEG;
+					if ( activePerHalfCycle != 0 ) lastActive = activePerHalfCycle;
+					accActive   += activePerHalfCycle;
+					accApparent += apparentPerHalfCycle;
+					accReactive += reactivePerHalfCycle;
+					if ( ++halfCycles >= regs[LINECYC] )
+					{
+						regs[LAENERGY]   = accActive & 0xFFFFFF;
+						regs[LVAENERGY]  = accApparent & 0xFFFFFF;
+						regs[LVARENERGY] = accReactive & 0xFFFFFF;
+						regs[STATUS] |= CYCEND;
+						halfCycles = 0;
+						accActive = accApparent = accReactive = 0;
+					}
+				}
+				if ( ! ( regs[MODE] & DISCF ) )
+				{   // CF pulses of the half cycle
+					cfPart += ( activePerHalfCycle < 0 ? -activePerHalfCycle : activePerHalfCycle ) * ( regs[CFNUM] + 1 );
+					unsigned long n = cfPart / ( regs[CFDEN] + 1 );
+					cfPart -= n * ( regs[CFDEN] + 1 );
+					cfPulses += n;
+					if ( cfPin != 0 && n > 0 ) simPulses(cfPin, n);
+				}
+			}
+		}
+	}
+	else if ( t - lastCrossing >= (unsigned long long)regs[ZXTOUT] * MODEL_ZXTOUT_US )
+	{
+		regs[STATUS] |= ZXTO;
+	}
+
+	if ( tempDue != 0 && t >= tempDue )
+	{
+		regs[TEMP] = temp;
+		regs[STATUS] |= TEMPREADY;
+		regs[MODE] &= ~TEMPSEL;
+		tempDue = 0;
+	}
+	lastUpdate = t;
+}
+
+/** === write ===
+* Register write from the SPI bus
+*/
+void Ade7753Model::write(uint8_t reg, uint32_t value) {
+	update(); // with the previous mode
+	switch ( reg )
+	{
+	case MODE:
+		if ( value & SWRST ) { reset(); return; }
+		if ( ( value & CYCMODE ) && ! ( regs[MODE] & CYCMODE ) )
+		{
+			halfCycles = 0;
+			accActive = accApparent = accReactive = 0;
+		}
+		if ( value & TEMPSEL ) tempDue = simNow() + MODEL_TEMP_US;
+		regs[MODE] = value;
+		break;
+	case LINECYC:
+		regs[LINECYC] = value;
+		halfCycles = 0;
+		accActive = accApparent = accReactive = 0;
+		break;
+	case STATUS: case RSTSTATUS: case PERIOD: case TEMP: case DIEREV:
+		break; // read only
+	case WGAIN: case VAGAIN: case IRMSOS: case VRMSOS:
+	case CFNUM: case CFDEN: case ZXTOUT:
+		regs[reg] = value & 0x0FFF; // 12-bit
+		break;
+	case CH2OS: case PHCAL:
+		regs[reg] = value & 0x3F;   // 6-bit
+		break;
+	default:
+		regs[reg] = value;
+	}
+}
+
+
+/*****************************
+*
+*     public functions
+*
+*****************************/
+
+/** === width ===
+* @return width in bytes of a register, as shifted on the SPI bus
+*/
+uint8_t Ade7753Model::width(uint8_t reg) {
+	if ( reg >= WAVEFORM && reg <= LVARENERGY ) return 3;
+	if ( reg >= IRMS && reg <= VRMS ) return 3;
+	if ( reg >= IPEAK && reg <= RSTVPEAK ) return 3;
+	switch ( reg )
+	{
+	case MODE: case IRQEN: case STATUS: case RSTSTATUS:
+	case APOS: case WGAIN: case CFNUM: case CFDEN:
+	case IRMSOS: case VRMSOS: case VAGAIN: case LINECYC:
+	case ZXTOUT: case PERIOD:
+		return 2;
+	}
+	return 1;
+}
+
+/** === get ===
+* Content of a register as the driver would read it, with the side effects of the read
+*/
+uint32_t Ade7753Model::get(uint8_t reg) {
+	uint32_t v;
+	update();
+	switch ( reg )
+	{
+	case RSTSTATUS:
+		v = regs[STATUS];
+		regs[STATUS] = 0;
+		return v;
+	case VRMS:     return mains ? vrms : 0;
+	case IRMS:     return mains ? irms : 0;
+	case VPEAK: case RSTVPEAK: return mains ? vpeak : 0;
+	case IPEAK: case RSTIPEAK: return mains ? ipeak : 0;
+	case PERIOD:   return mains ? CLKIN / 4 / frequency : 0;
+	}
+	return regs[reg & ( MODEL_REGISTERS - 1 )];
+}
+
+/** === corrupt ===
+* Overwrite a register behind the back of the driver, as a glitch on the SPI lines would
+*/
+void Ade7753Model::corrupt(uint8_t reg, uint32_t value) {
+	regs[reg & ( MODEL_REGISTERS - 1 )] = value;
+}
+
+void Ade7753Model::select(boolean on) {
+	if ( ! on && writing && count > 1 ) write(address, shift);
+	count = 0;
+	writing = false;
+}
+
+uint8_t Ade7753Model::transfer(uint8_t data) {
+	uint8_t out = 0;
+	if ( count == 0 )
+	{
+		address = data & 0x3F;
+		writing = ( data & 0x80 ) != 0;
+		shift = writing ? 0 : get(address);
+	}
+	else if ( writing )
+	{
+		shift = ( shift << 8 ) | data;
+	}
+	else if ( count <= width(address) )
+	{
+		out = shift >> ( 8 * ( width(address) - count ) );
+	}
+	count++;
+	return out;
+}
@@ -0,0 +1,96 @@
+/* Ade7753Model.h = Register level model of the ADE7753 on the simulated SPI bus (see HostSim.h)
+==============================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Enough of the ADE7753 for ADE7753.cpp to run unchanged: the register file with the width
+of each register, the SPI framing (address byte with bit 7 set for a write, then the data
+MSB first), and the flags of the status register driven by the simulated time:
+
+	ZX        at each zero crossing of the voltage, ie. every 10 ms at 50 Hz
+	CYCEND    every LINECYC zero crossings in line cycle accumulation mode (CYCMODE),
+	          when the LAENERGY / LVAENERGY / LVARENERGY registers are latched
+	PPOS      when the active energy of a half cycle turns positive, PNEG negative, in CYCMODE
+	TEMPREADY 26 us after TEMPSEL is set in MODE
+	ZXTO      when no zero crossing was seen for ZXTOUT x 32 us (no mains)
+	RESET     at power up and after SWRST
+
+No flag is raised while the A/D converters are off (ASUSPEND), and the time spent so is
+counted in suspendedUs.
+
+Reading RSTSTATUS clears the flags, reading RSTIPEAK / RSTVPEAK clears the peaks.
+The unused bits of the 12-bit and 6-bit registers are dropped on write, and corrupt()
+overwrites a register to exercise the health check of GridMeter.
+The measured values are fixed and can be set through the public members, and so is the
+delay of the zero crossings (phaseUs), to simulate the three phases of a supply. The line
+cycle energies are summed half cycle by half cycle, and a load profile (load) can change
+the energies of the next half cycle at each zero crossing, for the load events of
+GridEvents.h.
+
+CF: while DISCF is clear and the A/D converters are on, the magnitude of the active energy
+of each half cycle is given out as (CFNUM+1)/(CFDEN+1) pulses per LSB, with or without
+line cycle accumulation, on the pin cfPin (simPulses(), see HostSim.h). The fractions of a
+pulse are carried over to the next half cycle, cfPulses counts the pulses given out.
+
+	http://www.analog.com/static/imported-files/data_sheets/ADE7753.pdf
+
+*/
+
+#ifndef ADE7753MODEL_H
+#define ADE7753MODEL_H
+
+#include "HostSim.h"
+
+#define MODEL_REGISTERS  0x40
+#define MODEL_TEMP_US    26      // temperature conversion time
+#define MODEL_ZXTOUT_US  32      // ZXTOUT unit, 128 / CLKIN
+
+class Ade7753Model : public SpiDevice {
+   public:
+      Ade7753Model();
+      void select(boolean on);
+      uint8_t transfer(uint8_t data);
+
+      uint32_t get(uint8_t reg);        // register content, as the driver would read it
+      void reset(void);                 // power up
+      void corrupt(uint8_t reg, uint32_t value);  // register overwritten by a glitch
+      static uint8_t width(uint8_t reg); // in bytes, as shifted on the SPI bus
+
+      boolean mains;                    // a voltage is applied to channel 2
+      unsigned int frequency;           // in Hz, of the mains
+      unsigned long phaseUs;            // delay of the zero crossings after those of phase A, a phase B lags by a third of a period
+      uint32_t vrms, irms, vpeak, ipeak;
+      int32_t  activePerHalfCycle;      // LAENERGY increment per half line cycle
+      uint32_t apparentPerHalfCycle;
+      int32_t  reactivePerHalfCycle;
+      void (*load)(Ade7753Model *model, unsigned long long us); // called at each zero crossing in CYCMODE with its time, 0 for fixed energies
+      uint8_t  temp;
+      uint8_t  cfPin;                   // pin CF is wired to, 0 if none
+      unsigned long long cfPulses;      // given out on CF since the model was built
+      unsigned long long suspendedUs;   // simulated time with ASUSPEND set
+
+   private:
+      void update(void);
+      void write(uint8_t reg, uint32_t value);
+
+      uint32_t regs[MODEL_REGISTERS];
+      unsigned long long lastUpdate;    // simulated time of the last update()
+      unsigned long long lastCrossing;
+      unsigned long long tempDue;       // end of the temperature conversion, 0 if none
+      unsigned long halfCycles;         // zero crossings since the start of the accumulation
+      int64_t  accActive, accApparent, accReactive;  // energies since the start of the accumulation
+      uint32_t cfPart;                  // LSB x (CFNUM+1) not yet given out as a pulse
+      int32_t  lastActive;              // last non zero active energy of a half cycle, for PPOS and PNEG
+      uint8_t  address;                 // register of the current transaction
+      boolean  writing;
+      uint8_t  count;                   // data bytes of the current transaction
+      uint32_t shift;                   // data being shifted in or out
+};
+
+#endif
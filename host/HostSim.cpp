@@ -0,0 +1,254 @@
+/* HostSim.cpp = Simulated time, pins and SPI bus for running ArduGrid7753 modules on a PC
+========================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+See HostSim.h for the timing model.
+
+*/
+
+#include <SPI.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include "HostSim.h"
+
+HardwareSerial Serial;
+SPIClass SPI;
+
+static unsigned long long now;             // simulated time in us
+static SimStats stats;
+static SpiDevice *devices[SIM_PINS];
+static uint8_t pins[SIM_PINS];
+static unsigned long long selectedSince;
+static SpiDevice *selected;
+static unsigned int spiByteUs = 16;
+static boolean quiet;
+static FILE *serialFile;                   // 0 for stderr
+static unsigned long long lastFeed;        // simulated time of the last wdt_reset()
+static unsigned long long feedGap;         // longest time without wdt_reset()
+
+volatile uint8_t ADCSRA = 1<<ADEN;
+volatile uint8_t SREG = 1<<SREG_I;
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+SimFlags TIFR1;
+volatile uint16_t TCNT1;
+
+uint8_t simEeprom[SIM_EEPROM_SIZE];
+unsigned long simEepromWrites;
+static struct SimErased { SimErased() { memset(simEeprom, 0xFF, sizeof(simEeprom)); } } erased; // an erased EEPROM reads 0xFF
+
+void TIMER1_OVF_vect(void) __attribute__((weak)); // ISR of GridPulse.cpp, when it is linked
+
+
+/*****************************
+*
+*     simulation
+*
+*****************************/
+
+void simAttach(uint8_t csPin, SpiDevice *device) {
+	devices[csPin] = device;
+	pins[csPin] = HIGH;
+}
+
+void simAdvance(unsigned long long us) {
+	now += us;
+	stats.us = now;
+}
+
+unsigned long long simNow(void) {
+	return now;
+}
+
+/** === simSleep ===
+* The CPU sleeps until the next Timer0 overflow, every 1024 us
+*/
+void simSleep(void) {
+	unsigned long long wake = ( now / SIM_TIMER0_US + 1 ) * SIM_TIMER0_US;
+	stats.sleepUs += wake - now;
+	simAdvance(wake - now);
+}
+
+void simQuiet(boolean q) {
+	quiet = q;
+}
+
+void simSerialFile(FILE *f) {
+	serialFile = f;
+}
+
+/** === simWatchdogGap ===
+* @return longest simulated time in us without a wdt_reset() since the last call, the
+* measure then restarts as if the watchdog had just been fed
+*/
+unsigned long long simWatchdogGap(void) {
+	unsigned long long gap = ( now - lastFeed > feedGap ) ? now - lastFeed : feedGap;
+	lastFeed = now;
+	feedGap = 0;
+	return gap;
+}
+
+/** === simPulses ===
+* Rising edges on an input pin. On T1 they clock Timer1 when its clock select is the external
+* clock (CS12 and CS11 set): each wrap raises TOV1, and the overflow ISR is called at once if
+* it is enabled and linked, with the interrupts on, as the hardware would do.
+* @param pin: digital pin
+* @param count: rising edges
+*/
+void simPulses(uint8_t pin, unsigned long count) {
+	if ( pin != SIM_T1_PIN || ( TCCR1B & ( _BV(CS12) | _BV(CS11) ) ) != ( _BV(CS12) | _BV(CS11) ) ) return;
+	while ( count > 0 )
+	{
+		unsigned long step = 0x10000UL - TCNT1;
+		if ( count < step )
+		{
+			TCNT1 += count;
+			return;
+		}
+		count -= step;
+		TCNT1 = 0;
+		TIFR1.bits |= _BV(TOV1);
+		if ( ( TIMSK1 & _BV(TOIE1) ) && ( SREG & _BV(SREG_I) ) && TIMER1_OVF_vect != 0 )
+		{
+			TIFR1.bits &= ~_BV(TOV1); // cleared when the vector is taken
+			TIMER1_OVF_vect();
+		}
+	}
+}
+
+SimStats simStats(void) {
+	SimStats s = stats;
+	if ( selected ) s.busUs += now - selectedSince;
+	return s;
+}
+
+
+/*****************************
+*
+*     Arduino core
+*
+*****************************/
+
+unsigned long millis(void) {
+	simAdvance(SIM_MILLIS_US);
+	return (unsigned long)( now / 1000 );
+}
+
+unsigned long micros(void) {
+	simAdvance(SIM_MILLIS_US);
+	return (unsigned long)now;
+}
+
+void delay(unsigned long ms) {
+	simAdvance(ms * 1000ULL);
+}
+
+void delayMicroseconds(unsigned int us) {
+	simAdvance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+	(void)pin; (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+	simAdvance(SIM_DIGITALWRITE_US);
+	if ( pin >= SIM_PINS || pins[pin] == value ) return;
+	pins[pin] = value;
+	if ( devices[pin] == 0 ) return;
+	if ( value == LOW )
+	{
+		selected = devices[pin];
+		selectedSince = now;
+		stats.transactions++;
+		selected->select(true);
+	}
+	else if ( selected == devices[pin] )
+	{
+		stats.busUs += now - selectedSince;
+		selected->select(false);
+		selected = 0;
+	}
+}
+
+int digitalRead(uint8_t pin) {
+	return pin < SIM_PINS ? pins[pin] : LOW;
+}
+
+void wdt_reset(void) {
+	if ( now - lastFeed > feedGap ) feedGap = now - lastFeed;
+	lastFeed = now;
+}
+
+long random(long howsmall, long howbig) {
+	if ( howbig <= howsmall ) return howsmall;
+	return howsmall + rand() % ( howbig - howsmall );
+}
+
+long random(long howbig) {
+	return random(0, howbig);
+}
+
+size_t Print::print(long v, int base) {
+	char t[40];
+	if ( base == DEC ) snprintf(t, sizeof(t), "%ld", v);
+	else snprintf(t, sizeof(t), base == HEX ? "%lX" : "%lo", (unsigned long)v);
+	return write(t);
+}
+
+size_t Print::print(unsigned long v, int base) {
+	char t[40];
+	snprintf(t, sizeof(t), base == HEX ? "%lX" : base == OCT ? "%lo" : "%lu", v);
+	return write(t);
+}
+
+size_t Print::print(double v, int digits) {
+	char t[48];
+	snprintf(t, sizeof(t), "%.*f", digits, v);
+	return write(t);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+	if ( ! quiet ) fputc(c, serialFile ? serialFile : stderr);
+	return 1;
+}
+
+
+/*****************************
+*
+*     SPI
+*
+*****************************/
+
+uint8_t SPIClass::transfer(uint8_t data) {
+	simAdvance(spiByteUs);
+	stats.bytes++;
+	if ( selected == 0 ) return 0xFF;
+	return selected->transfer(data);
+}
+
+void SPIClass::begin(void) {
+}
+
+void SPIClass::end(void) {
+}
+
+void SPIClass::setBitOrder(uint8_t order) {
+	(void)order;
+}
+
+void SPIClass::setDataMode(uint8_t mode) {
+	(void)mode;
+}
+
+void SPIClass::setClockDivider(uint8_t divider) {
+	static const unsigned int div[8] = { 4, 16, 64, 128, 2, 8, 32, 64 };
+	spiByteUs = 8 * div[divider & 7] / 16; // 8 bits at 16 MHz / div
+	if ( spiByteUs == 0 ) spiByteUs = 1;
+}
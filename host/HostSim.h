@@ -0,0 +1,75 @@
+/* HostSim.h = Simulated time, pins and SPI bus for running ArduGrid7753 modules on a PC
+======================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+The stand-ins of host/mock (Arduino.h, SPI.h, avr/...) are implemented here over a
+simulated clock in microseconds. Nothing sleeps: delay() and delayMicroseconds() advance
+the clock, and so does every call that takes a noticeable time on the ATmega328 at 16 MHz:
+
+	SPI.transfer()     8 bits at 16 MHz / clock divider, ie. 16 us at SPI_CLOCK_DIV32
+	digitalWrite()     4 us
+	millis(), micros() 1 us, so that polling loops always progress
+	sleep_cpu()        until the next Timer0 overflow interrupt, every 1024 us
+
+wdt_reset() does not reset anything, simWatchdogGap() gives the longest simulated time
+without a wdt_reset(), to be compared with the 8 s of the watchdog of the Nanode.
+
+Timer1 counts the rising edges given to simPulses() on T1 (digital pin 5) when it is set
+to its external clock, and calls the overflow ISR (TIMER1_OVF_vect, see GridPulse.cpp) at
+each wrap: the CF output of Ade7753Model is wired so (see host/pulsesim.cpp).
+
+The EEPROM is an array of 1024 bytes, erased (0xFF) at start, the bytes written are counted
+in simEepromWrites (see avr/eeprom.h).
+
+SPI devices are attached to their chip select pin, and receive the bytes while their pin
+is LOW. The time spent with a chip select LOW is counted as bus time, and each LOW period
+as one SPI transaction.
+
+Serial goes to stderr, or to the file given to simSerialFile(), or nowhere with
+simQuiet(true), so that stdout is left to the program output (ie. the JSON of bench.cpp).
+
+*/
+
+#ifndef HOSTSIM_H
+#define HOSTSIM_H
+
+#include <Arduino.h>
+
+#define SIM_DIGITALWRITE_US  4
+#define SIM_MILLIS_US        1
+#define SIM_TIMER0_US        1024
+#define SIM_PINS             20
+#define SIM_T1_PIN           5     // PD5, external clock of Timer1
+
+class SpiDevice {
+   public:
+      virtual ~SpiDevice() {}
+      virtual void select(boolean on) = 0;       // chip select went LOW (true) or HIGH (false)
+      virtual uint8_t transfer(uint8_t data) = 0;
+};
+
+struct SimStats {
+	unsigned long long us;            // simulated time
+	unsigned long long busUs;         // simulated time with a chip select LOW
+	unsigned long transactions;       // chip select LOW periods
+	unsigned long bytes;              // SPI bytes transferred
+	unsigned long long sleepUs;       // simulated time with the CPU asleep
+};
+
+void simAttach(uint8_t csPin, SpiDevice *device);
+void simAdvance(unsigned long long us);
+unsigned long long simNow(void);
+void simQuiet(boolean quiet);
+void simSerialFile(FILE *f);
+void simPulses(uint8_t pin, unsigned long count);
+unsigned long long simWatchdogGap(void);
+SimStats simStats(void);
+
+#endif
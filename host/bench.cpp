@@ -0,0 +1,659 @@
+/* bench.cpp = Benchmark of the ADE7753 driver and of the measurement cycle on a PC
+================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+ADE7753.cpp and GridMeter.cpp are compiled unchanged against the stand-ins of host/mock,
+with a simulated ADE7753 (Ade7753Model) on a simulated SPI bus and clock (HostSim).
+For each operation the mean over several runs is reported of:
+
+	sim_us            simulated time on the Nanode, in microseconds
+	bus_us            simulated time with the ADE7753 chip select LOW
+	spi_transactions  register accesses (chip select LOW periods)
+	spi_bytes         bytes shifted on the SPI bus
+	wall_us           time taken on the PC, to spot a simulation that got slow
+	wdt_gap_ms        longest simulated time without a wdt_reset(), must stay under the 8 s of
+	                  the watchdog (see GridWatchdog.h), the run fails otherwise
+
+The bring-up and the health check of GridMeter are timed last, healthy and with a register
+corrupted or the chip reset behind the back of the driver, which must be repaired.
+
+Several ADE7753 are then run side by side by GridScheduler, one simulated chip per chip
+select pin, each with its own measured values that must come back in the record of its
+meter. For 1 to SCHED_METERS meters, staggered or all started at once:
+
+	sim_us            simulated time of one cycle of all the meters, run() then read()
+	bus_us            simulated time with a chip select LOW
+	peak_per_half     SPI transactions other than the status polls in the busiest half line
+	                  cycle (10 ms): the energy, period and RMS reads and the mode writes
+	mean_per_half     the same, averaged over the half line cycles of the run
+
+Three-phase sources are then measured with aligned windows and combined by GridPhases,
+balanced and unbalanced, at unity and lagging power factors, in both phase sequences:
+the sequence found from the zero crossings, the spread of the CYCENDs of the three meters,
+the total active energy, the neutral current and the voltage and current imbalance, next
+to the figures computed in floating point from the values of the simulated chips. A
+figure out of tolerance fails the run.
+
+Load profiles are then played on the simulated ADE7753, half cycle by half cycle, between
+and during the measurement cycles of the update period, for the load events of GridEvents.h
+watched on short windows. The events found are matched to the switches of the profile:
+
+	switches, found   switches of the profile, and the ones found by an event of the same sign
+	                  within EVENT_MATCH ms and within EVENT_MATCH_PCT % of the step, or within
+	                  the noise of the load and EVENT_MATCH_WATTS for the small steps
+	false_positives   events matching no switch, and per hour of watching
+	latency_ms        from the switch to the event, mean and worst: the confirmation and the
+	                  settling, and the measurement cycles when the switch falls in one
+	time_error_ms     of the date of the event, mean and worst
+	step_error_pct    of the step of P, worst
+
+A missed switch or a false positive fails the run.
+
+The power modes of GridPower.h are then compared over a few update periods: fraction of
+the time with the CPU awake, with the ADE7753 A/D converters on, with the ENC28J60 out of
+power save mode, and the resulting mean current. The currents are typical figures of the
+datasheets and the ENC28J60 awake time is an assumption (BENCH_NET_AWAKE), to be checked
+with a meter on a real board.
+
+The result is printed as JSON on stdout, so that two runs can be compared to catch a
+regression. The timing model is described in HostSim.h.
+
+Build and run from the sketch folder (ARDUINO=100 is what the Arduino 1.0 IDE defines,
+add -DGRIDTRACE to include the timing counters in the measurements):
+
+	g++ -O2 -DARDUINO=100 -DGRIDEVENTS -DGRIDPHASES -Ihost/mock -Ihost -I. host/bench.cpp host/HostSim.cpp \
+	    host/Ade7753Model.cpp ADE7753.cpp GridMeter.cpp GridScheduler.cpp GridPhases.cpp GridEvents.cpp \
+	    GridPower.cpp GridWatchdog.cpp GridLog.cpp -o host/bench7753
+	host/bench7753 > bench.json
+
+*/
+
+#include <chrono>
+#include <cmath>
+#include <avr/wdt.h>
+#include <functional>
+#include <map>
+#include "HostSim.h"
+#include "Ade7753Model.h"
+#include "ADE7753.h"
+#include "GridMeter.h"
+#include "GridScheduler.h"
+#include "GridPhases.h"
+#include "GridEvents.h"
+#include "GridPower.h"
+#include "GridWatchdog.h"
+
+#ifndef GRIDEVENTS
+#error "build with -DGRIDEVENTS"
+#endif
+#ifndef GRIDPHASES
+#error "build with -DGRIDPHASES"
+#endif
+
+#define BENCH_PERIOD       10000   // in milliseconds - REQUEST_RATE of ArduGrid7753.ino
+#define BENCH_NET_AWAKE    1500    // in milliseconds - ENC28J60 awake per period in POWER_SAVE: ping, DHCP, upload
+#define BENCH_LOOP         100     // in milliseconds - a pass of the loop of ArduGrid7753.ino, power.idle(100)
+#define EVENT_MATCH        6000    // in milliseconds - an event matches a switch dated within, the measurement cycles included
+#define EVENT_MATCH_PCT    15      // ... with a step of P within this % of the switch
+#define EVENT_MATCH_WATTS  10      // ... or within the noise of the profile and this
+
+// Typical currents in mA at 5 V
+#define MA_MCU_ACTIVE      9.0     // ATmega328P at 16 MHz
+#define MA_MCU_IDLE        3.0     // ATmega328P at 16 MHz, IDLE sleep mode
+#define MA_ADE_ON          7.0     // ADE7753 AIDD + DIDD
+#define MA_ADE_SUSPEND     4.0     // ADE7753 with ASUSPEND, the digital part is still clocked
+#define MA_ENC_ON          120.0   // ENC28J60
+#define MA_ENC_POWERSAVE   1.2     // ENC28J60 in power save mode
+
+// Shield table of a board with SCHED_METERS ADE7753, the first row is shield #1 as in ArduGrid7753.ino
+static const MeterConfig shields[SCHED_METERS] PROGMEM = {
+	{ CS, -3,   -5,   -2000, +2000,  12498.65, 167623.8, 141.0,   234565.0,  1.0,    34.8,     30.4,       0.60 },
+	{ 9,  -6,   -1,   -2000, -2048,  12225.0,  169192.0, 138.39,  233518.20, 1.0,    67.28,    58.57,      1.40 },
+	{ 7,  -3,   -5,   -2000, +2000,  12498.65, 167623.8, 141.0,   234565.0,  1.0,    34.8,     30.4,       0.60 }
+};
+
+static Ade7753Model ade;               // on CS, the single meter benchmarks
+static Ade7753Model ades[SCHED_METERS];  // ades[0] replaces ade on CS for the scheduler
+static boolean first = true;
+static unsigned long long worstGap;    // longest time without wdt_reset() over all the runs
+
+/** === BusProbe ===
+* Passes the SPI traffic through to a chip and counts its transactions per half line cycle,
+* the status polls apart
+*/
+class BusProbe : public SpiDevice {
+   public:
+      void attach(uint8_t csPin, SpiDevice *device) {
+         this->device = device;
+         simAttach(csPin, this);
+      }
+      void select(boolean on) {
+         address = on;
+         device->select(on);
+      }
+      uint8_t transfer(uint8_t data) {
+         if ( counting && address && ( data & 0x3F ) != STATUS && ( data & 0x3F ) != RSTSTATUS ) perHalf[simNow() / 10000]++;
+         address = false;
+         return device->transfer(data);
+      }
+      static std::map<unsigned long long, unsigned int> perHalf;  // transactions per half line cycle at 50 Hz
+      static boolean counting;         // during GridScheduler::run() only
+
+   private:
+      SpiDevice *device;
+      boolean address;                 // the next byte is the address of a transaction
+};
+
+std::map<unsigned long long, unsigned int> BusProbe::perHalf;
+boolean BusProbe::counting = false;
+static BusProbe probes[SCHED_METERS];
+
+/** === run ===
+* Run an operation several times and print its mean costs as a JSON object
+* @param name: of the operation
+* @param reps: number of runs
+* @param op: operation
+*/
+static void run(const char *name, unsigned int reps, std::function<void(void)> op) {
+	SimStats before = simStats();
+	unsigned long long gap;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	simWatchdogGap();
+	for (unsigned int i = 0; i < reps; i++)
+	{
+		wdt_reset(); // fed by the main loop before each operation
+		op();
+	}
+	gap = simWatchdogGap();
+	double wall = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	SimStats after = simStats();
+
+	printf("%s    {\"name\": \"%s\", \"reps\": %u, \"sim_us\": %.1f, \"bus_us\": %.1f, "
+	       "\"spi_transactions\": %.1f, \"spi_bytes\": %.1f, \"wall_us\": %.2f, \"wdt_gap_ms\": %.1f}",
+	       first ? "" : ",\n", name, reps,
+	       (double)( after.us - before.us ) / reps,
+	       (double)( after.busUs - before.busUs ) / reps,
+	       (double)( after.transactions - before.transactions ) / reps,
+	       (double)( after.bytes - before.bytes ) / reps,
+	       wall / reps, gap / 1000.0);
+	first = false;
+	if ( gap > worstGap ) worstGap = gap;
+}
+
+/** === runPower ===
+* Run the measurement loop for a few update periods in a power mode, print the duty cycles
+* and mean current as a JSON object
+*/
+static void runPower(const char *name, byte mode, GridMeter &gridMeter) {
+	GridPower power;
+	GridRecord rec;
+	const unsigned int periods = 3;
+
+	power.begin(mode);
+	SimStats before = simStats();
+	unsigned long long suspendedBefore = ade.suspendedUs;
+	for (unsigned int i = 0; i <= periods; i++)
+	{
+		unsigned long start = millis();
+		if ( i == 1 ) // the first period is a warm up, the ADE7753 was not suspended before it
+		{
+			before = simStats();
+			suspendedBefore = ade.suspendedUs;
+		}
+		gridMeter.startCycle();
+		gridMeter.waitCycleEnd();
+		gridMeter.read(rec);
+		if ( mode == POWER_SAVE ) gridMeter.suspend();
+		gridMeter.close();
+		while ( ( millis() - start ) < BENCH_PERIOD ) power.idle(100);
+		power.endCycle();
+	}
+	SimStats after = simStats();
+
+	double total = (double)( after.us - before.us );
+	double cpu = 1.0 - (double)( after.sleepUs - before.sleepUs ) / total;
+	double adeOn = 1.0 - (double)( ade.suspendedUs - suspendedBefore ) / total;
+	double enc = ( mode == POWER_SAVE ) ? (double)BENCH_NET_AWAKE / BENCH_PERIOD : 1.0;
+	double ma = cpu * MA_MCU_ACTIVE + ( 1.0 - cpu ) * MA_MCU_IDLE
+	          + adeOn * MA_ADE_ON + ( 1.0 - adeOn ) * MA_ADE_SUSPEND
+	          + enc * MA_ENC_ON + ( 1.0 - enc ) * MA_ENC_POWERSAVE;
+
+	printf("%s    {\"mode\": \"%s\", \"periods\": %u, \"cpu_awake_pct\": %.1f, \"ade_on_pct\": %.1f, "
+	       "\"enc_on_pct\": %.1f, \"duty_reported_pct\": %u, \"current_ma\": %.1f}",
+	       mode == POWER_NORMAL ? "" : ",\n", name, periods, cpu * 100, adeOn * 100, enc * 100,
+	       power.getDuty(), ma);
+}
+
+/** === runMeters ===
+* Run a few cycles of several meters with GridScheduler and print the mean cost of a cycle
+* and the SPI load per half line cycle as a JSON object
+* @return boolean false if a record does not hold the values of the chip of its meter
+*/
+static boolean runMeters(byte count, unsigned int stagger) {
+	GridMeter meters[SCHED_METERS];
+	GridScheduler scheduler;
+	GridRecord rec;
+	boolean ok = true;
+	const unsigned int cycles = 3;
+	unsigned int peak = 0;
+	unsigned long total = 0;
+
+	for (byte i = 0; i < count; i++) meters[i].begin(&shields[i]);
+	scheduler.begin(meters, count);
+	scheduler.setStagger(stagger);
+	BusProbe::perHalf.clear();
+	SimStats before = simStats();
+	unsigned long long first = before.us / 10000, last;
+	for (unsigned int c = 0; c < cycles; c++)
+	{
+		wdt_reset();
+		BusProbe::counting = true;
+		scheduler.run();
+		BusProbe::counting = false;
+		for (byte i = 0; i < count; i++)
+		{
+			scheduler.read(i, rec);
+			if ( rec.meter != i || ! meters[i].hasMains() || rec.vrms != (long)ades[i].vrms || rec.irms != (long)ades[i].irms
+			     || rec.activeEnergy != ades[i].activePerHalfCycle * METER_LINECYC )
+			{
+				fprintf(stderr, "\n%u meters: record of meter %u wrong, vrms %ld irms %ld\n", count, i, rec.vrms, rec.irms);
+				ok = false;
+			}
+		}
+		meters[0].close();
+	}
+	SimStats after = simStats();
+	last = after.us / 10000;
+	for (std::map<unsigned long long, unsigned int>::iterator it = BusProbe::perHalf.begin(); it != BusProbe::perHalf.end(); ++it)
+	{
+		if ( it->second > peak ) peak = it->second;
+		total += it->second;
+	}
+
+	printf("%s    {\"meters\": %u, \"stagger_ms\": %u, \"cycles\": %u, \"sim_us\": %.1f, \"bus_us\": %.1f, "
+	       "\"peak_per_half\": %u, \"mean_per_half\": %.2f, \"ok\": %s}",
+	       count == 1 && stagger == SCHED_STAGGER ? "" : ",\n", count, stagger, cycles,
+	       (double)( after.us - before.us ) / cycles,
+	       (double)( after.busUs - before.busUs ) / cycles,
+	       peak, (double)total / ( last - first + 1 ), ok ? "true" : "false");
+	return ok;
+}
+
+/** === PhaseSource ===
+* One phase of a simulated three-phase source
+*/
+struct PhaseSource {
+	double volts;       // V
+	double amps;        // A
+	double pf;          // power factor, lagging
+};
+
+/** === runPhases ===
+* Measure a three-phase source with aligned windows and GridPhases, check the figures against
+* the ones computed in floating point from the values of the chips, and print them as a JSON object
+* @param name: of the source
+* @param order: PHASE_ABC or PHASE_ACB, the order in which the phases cross zero
+* @param src: the three phases
+* @return boolean false if a figure is out of tolerance
+*/
+static boolean runPhases(const char *name, byte order, const PhaseSource *src) {
+	GridMeter meters[PHASES];
+	GridScheduler scheduler;
+	GridPhases phases;
+	GridRecord rec;
+	double p[PHASES], q[PHASES], v[PHASES], a[PHASES];
+	double x = 0, y = 0, totalP = 0, meanV = 0, meanA = 0, imbV = 0, imbA = 0;
+	unsigned long cycleEnd[PHASES];
+
+	for (byte k = 0; k < PHASES; k++)
+	{   // raw register values of each chip, through the calibration of its shield row
+		const MeterConfig *c = &shields[k];
+		double phi = acos(src[k].pf);
+		double units = src[k].volts * src[k].amps / 2; // datastream 4-6 units, arbitrary here
+		ades[k].vrms = lround(src[k].volts * pgm_read_float(&c->calVrms));
+		ades[k].irms = lround(src[k].amps * pgm_read_float(&c->calIrms));
+		ades[k].activePerHalfCycle   = lround(units * cos(phi) * pgm_read_float(&c->calActiveEnergy) / METER_LINECYC);
+		ades[k].reactivePerHalfCycle = lround(units * sin(phi) * pgm_read_float(&c->calReactiveEnergy) / METER_LINECYC);
+		ades[k].apparentPerHalfCycle = lround(units * pgm_read_float(&c->calApparentEnergy) / METER_LINECYC);
+		// phase k lags A by k x 120 degrees in ABC, by k x 240 degrees in ACB
+		ades[k].phaseUs = ( order == PHASE_ABC ? k : ( PHASES - k ) % PHASES ) * 20000UL / PHASES;
+
+		// reference figures from what the chip will read, in floating point
+		v[k] = ades[k].vrms / pgm_read_float(&c->calVrms);
+		a[k] = ades[k].irms / pgm_read_float(&c->calIrms);
+		p[k] = ades[k].activePerHalfCycle * METER_LINECYC / pgm_read_float(&c->calActiveEnergy);
+		q[k] = ades[k].reactivePerHalfCycle * METER_LINECYC / pgm_read_float(&c->calReactiveEnergy);
+		double theta = ( order == PHASE_ABC ? -1 : 1 ) * k * 2 * M_PI / PHASES;
+		x += a[k] * cos(theta - atan2(q[k], p[k]));
+		y += a[k] * sin(theta - atan2(q[k], p[k]));
+		totalP += p[k];
+		meanV += v[k] / PHASES;
+		meanA += a[k] / PHASES;
+	}
+	for (byte k = 0; k < PHASES; k++)
+	{
+		imbV = fmax(imbV, fabs(v[k] - meanV) * 1000 / meanV);
+		imbA = fmax(imbA, fabs(a[k] - meanA) * 1000 / meanA);
+	}
+	double neutral = hypot(x, y) * 100;
+
+	for (byte k = 0; k < PHASES; k++) meters[k].begin(&shields[k]);
+	scheduler.begin(meters, PHASES);
+	scheduler.setStagger(0);
+	phases.begin(meters);
+	wdt_reset();
+	scheduler.run();
+	for (byte k = 0; k < PHASES; k++)
+	{
+		scheduler.read(k, rec);
+		cycleEnd[k] = meters[k].getCycleEnd();
+		phases.add(rec);
+	}
+	byte sequence = phases.detectSequence(rec.period);
+	phases.compute();
+	meters[0].close();
+	unsigned long spread = max(max(cycleEnd[0], cycleEnd[1]), cycleEnd[2]) - min(min(cycleEnd[0], cycleEnd[1]), cycleEnd[2]);
+
+	boolean ok = sequence == order
+	          && spread <= 12   // the windows end within a half cycle of each other, plus the polling
+	          && fabs(phases.getActive() - totalP) <= 2
+	          && fabs(phases.getNeutral() - neutral) <= 2 + neutral / 100
+	          && fabs(phases.getVoltageImbalance() - imbV) <= 2
+	          && fabs(phases.getCurrentImbalance() - imbA) <= 2;
+	printf("%s    {\"source\": \"%s\", \"sequence\": %u, \"expected_sequence\": %u, \"cycend_spread_ms\": %lu, "
+	       "\"p_total\": %ld, \"expected_p_total\": %.1f, \"neutral_a\": %.2f, \"expected_neutral_a\": %.2f, "
+	       "\"v_imbalance_pct\": %.1f, \"expected_v_imbalance_pct\": %.2f, \"i_imbalance_pct\": %.1f, \"expected_i_imbalance_pct\": %.2f, "
+	       "\"ok\": %s}",
+	       strcmp(name, "balanced") == 0 ? "" : ",\n", name, sequence, order, spread,
+	       phases.getActive(), totalP, phases.getNeutral() / 100.0, neutral / 100,
+	       phases.getVoltageImbalance() / 10.0, imbV / 10, phases.getCurrentImbalance() / 10.0, imbA / 10,
+	       ok ? "true" : "false");
+	return ok;
+}
+
+/** === LoadSwitch ===
+* A load switched on (positive steps) or off in a load profile
+*/
+struct LoadSwitch {
+	unsigned long at;   // in milliseconds from the start of the profile
+	int watts;          // step of P, in the unit of datastream 4
+	int vars;           // step of Q, in the unit of datastream 6
+	int inrush;         // more P for inrushMs after the switch
+	unsigned int inrushMs;
+};
+
+/** === LoadProfile ===
+* The load on the simulated ADE7753, in the units of the datastreams
+*/
+struct LoadProfile {
+	int watts, vars;          // at the start
+	int noise;                // P wanders within +/- noise, at random every noiseMs
+	unsigned int noiseMs;
+	unsigned long rampFrom, rampTo;  // in milliseconds, P goes up by ramp in between
+	int ramp;
+	const LoadSwitch *switches;
+	byte count;
+	unsigned long length;     // in milliseconds
+};
+
+static const LoadProfile *profile;  // played by loadAt()
+static unsigned long long profileStart;
+static double carryP, carryQ;       // fractions of the register units left by the last half cycles
+
+/** === loadAt ===
+* Ade7753Model::load: the energies of the next half cycle from the profile
+*/
+static void loadAt(Ade7753Model *model, unsigned long long us) {
+	double t = ( us - profileStart ) / 1000.0; // in ms
+	double watts = profile->watts, vars = profile->vars;
+	if ( profile->noise != 0 )
+	{   // a hash of the noise period, so that the profile is the same at each run
+		uint32_t h = (uint32_t)( t / profile->noiseMs ) * 2654435761u;
+		h ^= h >> 15;
+		watts += (int)( h % ( 2 * profile->noise + 1 ) ) - profile->noise;
+	}
+	if ( profile->ramp != 0 && t > profile->rampFrom ) watts += profile->ramp * ( fmin(t, profile->rampTo) - profile->rampFrom ) / ( profile->rampTo - profile->rampFrom );
+	for (byte i = 0; i < profile->count; i++)
+	{
+		const LoadSwitch &s = profile->switches[i];
+		if ( t < s.at ) continue;
+		watts += s.watts;
+		vars += s.vars;
+		if ( t < s.at + s.inrushMs ) watts += s.inrush;
+	}
+	// register units per half cycle, the fractions carried over to keep the sums exact
+	double p = watts * pgm_read_float(&shields[0].calActiveEnergy) / METER_LINECYC + carryP;
+	double q = vars * pgm_read_float(&shields[0].calReactiveEnergy) / METER_LINECYC + carryQ;
+	model->activePerHalfCycle = floor(p);
+	model->reactivePerHalfCycle = floor(q);
+	carryP = p - floor(p);
+	carryQ = q - floor(q);
+}
+
+/** === runEvents ===
+* Play a load profile with the loop of ArduGrid7753.ino: a measurement cycle every update
+* period, the windows polled in between. Match the events to the switches and print the
+* figures as a JSON object.
+* @param name: of the profile
+* @param prof: the profile
+* @param gridMeter: on the simulated ADE7753 ade
+* @return boolean false if a switch was missed or an event matches no switch
+*/
+static boolean runEvents(const char *name, const LoadProfile *prof, GridMeter &gridMeter) {
+	GridEvents events;
+	GridRecord rec;
+	boolean found[16] = { false };
+	unsigned int matched = 0, falsePositives = 0, queued = 0;
+	double latency = 0, worstLatency = 0, timeError = 0, worstTimeError = 0, worstStep = 0;
+
+	profile = prof;
+	profileStart = simNow();
+	carryP = carryQ = 0;
+	ade.load = loadAt;
+	events.begin(&gridMeter, 1);
+	gridMeter.open();
+	gridMeter.watch(EVENT_LINECYC);
+	gridMeter.close();
+	unsigned long long end = profileStart + prof->length * 1000ULL;
+	unsigned long long nextCycle = profileStart + BENCH_PERIOD * 1000ULL;
+	while ( simNow() < end )
+	{
+		wdt_reset();
+		if ( simNow() >= nextCycle )
+		{   // the measurement of the update period, then back to the windows
+			gridMeter.startCycle();
+			gridMeter.waitCycleEnd();
+			gridMeter.read(rec);
+			if ( gridMeter.hasMains() ) events.add(0, rec.activeEnergy, rec.reactiveEnergy, METER_LINECYC, gridMeter.getCycleEnd());
+			gridMeter.watch(EVENT_LINECYC);
+			gridMeter.close();
+			nextCycle += BENCH_PERIOD * 1000ULL;
+		}
+		if ( events.due() )
+		{
+			long p, q;
+			gridMeter.open();
+			boolean window = gridMeter.pollWindow(p, q);
+			gridMeter.close();
+			if ( window && events.add(0, p, q, EVENT_LINECYC, millis()) )
+			{
+				LoadEvent *e = events.peek();
+				double at = e->at - profileStart / 1000.0;  // in ms from the start of the profile
+				int best = -1;
+				queued++;
+				for (byte i = 0; i < prof->count; i++)
+				{
+					const LoadSwitch &s = prof->switches[i];
+					if ( found[i] || fabs(at - s.at) > EVENT_MATCH || ( e->active > 0 ) != ( s.watts > 0 ) ) continue;
+					if ( abs(e->active - s.watts) * 100 > abs(s.watts) * EVENT_MATCH_PCT
+					     && abs(e->active - s.watts) > prof->noise + EVENT_MATCH_WATTS ) continue;
+					best = i;
+					break;
+				}
+				if ( best < 0 ) falsePositives++;
+				else
+				{
+					const LoadSwitch &s = prof->switches[best];
+					double l = simNow() / 1000.0 - profileStart / 1000.0 - s.at;
+					found[best] = true;
+					matched++;
+					latency += l;
+					worstLatency = fmax(worstLatency, l);
+					timeError += fabs(at - s.at);
+					worstTimeError = fmax(worstTimeError, fabs(at - s.at));
+					worstStep = fmax(worstStep, fabs(e->active - s.watts) * 100.0 / abs(s.watts));
+				}
+				events.pop();
+			}
+		}
+		simAdvance(BENCH_LOOP * 1000ULL);
+	}
+	ade.load = 0;
+	ade.activePerHalfCycle = 105; // back to the values of the constructor
+	ade.reactivePerHalfCycle = 2;
+
+	boolean ok = matched == prof->count && falsePositives == 0;
+	printf("%s    {\"profile\": \"%s\", \"length_s\": %lu, \"switches\": %u, \"found\": %u, \"events\": %u, "
+	       "\"false_positives\": %u, \"false_positives_per_h\": %.1f, \"latency_ms\": %.0f, \"worst_latency_ms\": %.0f, "
+	       "\"time_error_ms\": %.0f, \"worst_time_error_ms\": %.0f, \"worst_step_error_pct\": %.1f, \"ok\": %s}",
+	       strcmp(name, "appliances") == 0 ? "" : ",\n", name, prof->length / 1000, prof->count, matched, queued,
+	       falsePositives, falsePositives * 3600000.0 / prof->length, matched ? latency / matched : 0, worstLatency,
+	       matched ? timeError / matched : 0, worstTimeError, worstStep, ok ? "true" : "false");
+	return ok;
+}
+
+int main(void) {
+	ADE7753 meter;
+	GridMeter gridMeter;
+	GridRecord rec;
+
+	simQuiet(true);
+	simAttach(CS, &ade);
+	gridMeter.begin(&shields[0]); // shield #1, as setup() does
+
+	printf("{\n  \"bench\": \"ArduGrid7753\",\n  \"linecyc\": %d,\n  \"results\": [\n", METER_LINECYC);
+
+	run("read16", 1000, [&]() { meter.getPeriod(); });
+	run("read24", 1000, [&]() { meter.getVpeakReset(); });
+	run("getVRMS", 100, [&]() { meter.getVRMS(); });
+	run("vrms", 5, [&]() { meter.vrms(); });
+	run("getTemp", 100, [&]() { meter.getTemp(); });
+	run("cycend_wait", 5, [&]() { gridMeter.startCycle(); gridMeter.waitCycleEnd(); });
+	run("update_cycle", 5, [&]() {
+		gridMeter.startCycle();
+		gridMeter.waitCycleEnd();
+		gridMeter.read(rec);
+		gridMeter.close();
+	});
+
+	run("mains_loss_detect", 5, [&]() {
+		gridMeter.startCycle();
+		ade.mains = false;
+		gridMeter.waitCycleEnd();
+		ade.mains = true;
+	});
+
+	ade.mains = false;
+	run("update_cycle_no_mains", 5, [&]() {
+		gridMeter.startCycle();
+		gridMeter.waitCycleEnd();
+		gridMeter.read(rec);
+		gridMeter.close();
+	});
+	if ( gridWatchdog.getOverruns() != 0 )
+	{
+		fprintf(stderr, "\nno mains: %u steps over budget, last %u\n", gridWatchdog.getOverruns(), gridWatchdog.getLastOverrun());
+		return 1;
+	}
+
+	ade.mains = true;
+	run("bring_up", 5, [&]() { gridMeter.begin(&shields[0]); });
+	run("health_check", 100, [&]() { gridMeter.check(); });
+	run("health_repair_register", 5, [&]() { ade.corrupt(VRMSOS, 0); gridMeter.check(); });
+	run("health_repair_reset", 5, [&]() { ade.reset(); gridMeter.check(); });
+	if ( gridMeter.getRepairs() != 10 || gridMeter.check() != METER_OK )
+	{
+		fprintf(stderr, "\nhealth check: %u repairs instead of 10\n", gridMeter.getRepairs());
+		return 1;
+	}
+
+	printf("\n  ],\n  \"meters\": [\n");
+	for (byte i = 0; i < SCHED_METERS; i++)
+	{   // a different load on each chip, to catch a record taken from the wrong one
+		ades[i].vrms += i * 1000;
+		ades[i].irms += i * 50000;
+		ades[i].activePerHalfCycle += i * 10;
+		probes[i].attach(pgm_read_byte(&shields[i].cs), &ades[i]);
+	}
+	boolean metersOk = true;
+	for (byte n = 1; n <= SCHED_METERS; n++)
+	{
+		metersOk &= runMeters(n, SCHED_STAGGER);
+		if ( n > 1 ) metersOk &= runMeters(n, 0);
+	}
+	if ( ! metersOk || gridWatchdog.getOverruns() != 0 )
+	{
+		fprintf(stderr, "\nmeters: records mixed up or %u steps over budget\n", gridWatchdog.getOverruns());
+		return 1;
+	}
+
+	printf("\n  ],\n  \"phases\": [\n");
+	const PhaseSource balanced[PHASES]  = { { 230, 5, 1.0 }, { 230, 5, 1.0 }, { 230, 5, 1.0 } };
+	const PhaseSource unbalanced[PHASES] = { { 230, 5, 1.0 }, { 225, 4, 1.0 }, { 235, 6, 1.0 } };  // In = 1.73 A, 20 % current imbalance
+	const PhaseSource lagging[PHASES]   = { { 230, 5, 0.8 }, { 230, 4, 0.9 }, { 230, 6, 1.0 } };
+	boolean phasesOk = runPhases("balanced", PHASE_ABC, balanced);
+	phasesOk &= runPhases("unbalanced_abc", PHASE_ABC, unbalanced);
+	phasesOk &= runPhases("unbalanced_acb", PHASE_ACB, unbalanced);
+	phasesOk &= runPhases("lagging_abc", PHASE_ABC, lagging);
+	phasesOk &= runPhases("lagging_acb", PHASE_ACB, lagging);
+	simAttach(CS, &ade);
+	if ( ! phasesOk || gridWatchdog.getOverruns() != 0 )
+	{
+		fprintf(stderr, "\nphases: figures out of tolerance or %u steps over budget\n", gridWatchdog.getOverruns());
+		return 1;
+	}
+
+	printf("\n  ],\n  \"events\": [\n");
+	// kettle, fridge with its compressor inrush, LED lamp, washing machine motor switched
+	// during a measurement cycle (at 122 s), on a quiet base load
+	static const LoadSwitch appliances[] = {
+		{ 15000, 2000, 0, 0, 0 }, { 45000, 150, 90, 600, 400 }, { 75000, -2000, 0, 0, 0 },
+		{ 105000, 40, 0, 0, 0 }, { 122000, 500, 300, 1500, 600 }, { 166000, -150, -90, 0, 0 }
+	};
+	// a computer wandering by +/- 80 W
+	static const LoadSwitch noisy[] = { { 36000, 1000, 0, 0, 0 }, { 96000, -1000, 0, 0, 0 }, { 146000, 300, 200, 0, 0 } };
+	// a heater ramping up by 400 W over 80 s, then a kettle
+	static const LoadSwitch ramp[] = { { 125000, 1500, 0, 0, 0 }, { 165000, -1500, 0, 0, 0 } };
+	static const LoadProfile profiles[] = {
+		{ 300, 50, 5, 300, 0, 0, 0, appliances, 6, 180000 },
+		{ 400, 50, 80, 300, 0, 0, 0, noisy, 3, 180000 },
+		{ 100, 50, 5, 300, 30000, 110000, 400, ramp, 2, 180000 }
+	};
+	boolean eventsOk = runEvents("appliances", &profiles[0], gridMeter);
+	eventsOk &= runEvents("noisy", &profiles[1], gridMeter);
+	eventsOk &= runEvents("ramp", &profiles[2], gridMeter);
+	if ( ! eventsOk || gridWatchdog.getOverruns() != 0 )
+	{
+		fprintf(stderr, "\nevents: switches missed or false positives, or %u steps over budget\n", gridWatchdog.getOverruns());
+		return 1;
+	}
+
+	printf("\n  ],\n  \"power\": [\n");
+	runPower("normal", POWER_NORMAL, gridMeter);
+	runPower("save", POWER_SAVE, gridMeter);
+
+	printf("\n  ]\n}\n");
+	if ( worstGap >= WATCHDOG_PERIOD * 1000ULL )
+	{
+		fprintf(stderr, "watchdog not fed for %.1f ms\n", worstGap / 1000.0);
+		return 1;
+	}
+	return 0;
+}
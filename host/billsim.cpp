@@ -0,0 +1,339 @@
+/* billsim.cpp = Simulation of the billing registers of GridBilling on a PC
+========================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+GridBilling.cpp and GridMeter.cpp are compiled unchanged with GRIDBILLING, against a
+simulated ADE7753 (Ade7753Model) and the EEPROM of host/mock/avr/eeprom.h. Load profiles
+of several days are played half cycle by half cycle with the loop of ArduGrid7753.ino: a
+measurement cycle every update period, the windows of the load events in between when
+built with GRIDEVENTS, and tick() at each pass with the UTC time of a synchronised clock.
+Without GRIDEVENTS, as in PROFILE_BILLING, the registers are fed by the cycles only and
+their errors come close to sampled_error_pct. The profiles start on
+Friday 16 Oct 2026 at 00:00 CET, with the schedule of ArduGrid7753.ino: off-peak (0) and
+peak (1, 06:00-22:00) on weekdays, week-end (2).
+
+The exact registers are taken from the half cycles played, with a tariff computed apart
+from the schedule table. For each profile and tariff:
+
+	import_wh, export_wh      of GridBilling, and their error against the exact energy
+	sampled_error_pct         of the import estimated from the records only (the mean power
+	                          of each 2 s cycle taken for the update period), as the
+	                          datastreams allowed so far
+	max_demand_w              of GridBilling, against the exact maximum of the sliding
+	                          windows of 15 minutes ending at each minute of the tariff
+
+The profiles:
+
+	switching         48 h of loads switched at random times between 0 and BILL_SIM_WATTS,
+	                  with an appliance of BILL_SIM_BLOCK W for 45 minutes three times
+	export            24 h from the Monday, the same with a PV output of up to BILL_SIM_PV W
+	                  between 08:00 and 18:00: the power changes sign, reversals are counted
+
+Then the EEPROM: the registers are saved twice, the newer copy is corrupted, and begin()
+must restore the older one; an erased EEPROM must give cleared registers. The bytes
+written per save are reported, and the size of a copy (68 bytes on the ATmega328, more on
+a PC with 8-byte longs).
+
+An energy error over BILL_SIM_ERROR %, a demand error over BILL_SIM_DEMAND %, no
+reversal on the export profile or a bad restore fails the run.
+
+Build and run from the sketch folder:
+
+	g++ -O2 -DARDUINO=100 -DGRIDEVENTS -DGRIDBILLING -Ihost/mock -Ihost -I. host/billsim.cpp host/HostSim.cpp \
+	    host/Ade7753Model.cpp ADE7753.cpp GridMeter.cpp GridWatchdog.cpp GridLog.cpp GridBilling.cpp \
+	    -o host/billsim
+	host/billsim > billing.json
+
+and without -DGRIDEVENTS for the registers of PROFILE_BILLING.
+
+*/
+
+#include <cmath>
+#include <vector>
+#include <avr/wdt.h>
+#include <avr/eeprom.h>
+#include "HostSim.h"
+#include "Ade7753Model.h"
+#include "ADE7753.h"
+#include "GridMeter.h"
+#include "GridEvents.h"
+#include "GridBilling.h"
+
+#ifndef GRIDBILLING
+#error "build with -DGRIDBILLING"
+#endif
+
+#define BILL_SIM_EPOCH     1792105200UL // Friday 16 Oct 2026 00:00 CET, in UTC seconds
+#define BILL_SIM_PERIOD    10000   // in milliseconds - REQUEST_RATE of ArduGrid7753.ino
+#define BILL_SIM_LOOP      100     // in milliseconds - a pass of the loop of ArduGrid7753.ino
+#define BILL_SIM_WATTS     2500    // largest switched load
+#define BILL_SIM_BLOCK     4000    // appliance on for 45 minutes
+#define BILL_SIM_PV        3000    // peak of the PV output
+#ifdef GRIDEVENTS
+#define BILL_SIM_ERROR     0.5     // in % - largest error of an energy register
+#define BILL_SIM_DEMAND    1.0     // in % - largest error of a maximum demand
+#else
+#define BILL_SIM_ERROR     3.0     // the same, from the measurement cycles only
+#define BILL_SIM_DEMAND    5.0
+#endif
+
+// Shield #1 as in ArduGrid7753.ino
+static const MeterConfig shield[1] PROGMEM = {
+	{ CS, -3,   -5,   -2000, +2000,  12498.65, 167623.8, 141.0,   234565.0,  1.0,    34.8,     30.4,       0.60 }
+};
+
+// Schedule as in ArduGrid7753.ino
+static const TariffSlot tariffs[] PROGMEM = {
+	{ BILL_WEEKDAYS, 0,       0 },
+	{ BILL_WEEKDAYS, 6 * 60,  1 },
+	{ BILL_WEEKDAYS, 22 * 60, 0 },
+	{ BILL_WEEKEND,  0,       2 }
+};
+
+struct BillProfile {
+	const char *name;
+	unsigned long start;      // in hours from BILL_SIM_EPOCH
+	unsigned long length;     // in seconds
+	boolean pv;               // with a PV output in the day
+	unsigned long blocks[3];  // starts of the appliance, in seconds from the start of the profile, 0 for none
+};
+
+static const BillProfile profiles[] = {
+	{ "switching", 0,  48 * 3600UL, false, { 19 * 3600UL, 23 * 3600UL + 1800, 34 * 3600UL } }, // Friday 19:00, 23:30, Saturday 10:00
+	{ "export",    72, 24 * 3600UL, true,  { 12 * 3600UL, 20 * 3600UL, 0 } }                 // Monday 12:00 with the PV, 20:00
+};
+
+static Ade7753Model ade;
+static const BillProfile *profile;   // played by loadAt()
+static unsigned long long profileStart;
+static unsigned long startSec;       // UTC of profileStart
+static double carry;                 // fraction of a register unit left by the last half cycles
+static std::vector<unsigned long> switchAt; // in ms from the start of the profile
+static std::vector<int> switchWatts;
+static size_t switched;              // switches played
+static double exactImport[BILL_TARIFFS], exactExport[BILL_TARIFFS]; // in Wh
+static std::vector<double> minuteImport; // in Wh, of each UTC minute from the one of profileStart
+
+/** === utcAt ===
+* @return unsigned long with the UTC seconds of a simulated time, the clock being synchronised
+*/
+static unsigned long utcAt(unsigned long long us) {
+	return BILL_SIM_EPOCH + us / 1000000ULL;
+}
+
+/** === tariffAt ===
+* @return byte with the tariff of a UTC time, without the schedule table
+*/
+static byte tariffAt(unsigned long utc) {
+	unsigned long local = utc + BILL_UTC_OFFSET * 60L;
+	byte day = ( local / 86400UL + 4 ) % 7;
+	unsigned int minute = local % 86400UL / 60;
+	if ( day == 0 || day == 6 ) return 2;
+	return minute >= 6 * 60 && minute < 22 * 60 ? 1 : 0;
+}
+
+/** === wattsAt ===
+* @return double with the power of the profile at t ms from its start
+*/
+static double wattsAt(unsigned long t) {
+	while ( switched + 1 < switchAt.size() && switchAt[switched + 1] <= t ) switched++;
+	double w = switchWatts[switched];
+	for (byte i = 0; i < 3; i++)
+		if ( profile->blocks[i] != 0 && t >= profile->blocks[i] * 1000 && t < ( profile->blocks[i] + 2700 ) * 1000 ) w += BILL_SIM_BLOCK;
+	if ( profile->pv )
+	{   // a half sine from 08:00 to 18:00 local
+		double hour = fmod(( startSec + BILL_UTC_OFFSET * 60L + t / 1000.0 ) / 3600.0, 24.0);
+		if ( hour > 8 && hour < 18 ) w -= BILL_SIM_PV * sin(M_PI * ( hour - 8 ) / 10);
+	}
+	return w;
+}
+
+/** === loadAt ===
+* Ade7753Model::load: the active energy of the next half cycle, into the exact registers
+*/
+static void loadAt(Ade7753Model *model, unsigned long long us) {
+	unsigned long t = us > profileStart ? ( us - profileStart ) / 1000 : 0; // the crossings are played late, at the next SPI access
+	double p = wattsAt(t) * pgm_read_float(&shield[0].calActiveEnergy) / METER_LINECYC + carry;
+	model->activePerHalfCycle = floor(p);
+	carry = p - floor(p);
+	if ( us < profileStart ) return;
+	double wh = model->activePerHalfCycle * METER_LINECYC / 100.0 / 3600.0 / pgm_read_float(&shield[0].calActiveEnergy);
+	unsigned long utc = utcAt(us);
+	if ( wh > 0 )
+	{
+		exactImport[tariffAt(utc)] += wh;
+		size_t m = utc / 60 - startSec / 60;
+		if ( m >= minuteImport.size() ) minuteImport.resize(m + 1, 0);
+		minuteImport[m] += wh;
+	}
+	else exactExport[tariffAt(utc)] -= wh;
+}
+
+/** === pct ===
+* @return double with the error of a value against the exact one, in %
+*/
+static double pct(double value, double exact) {
+	return exact == 0 ? ( value == 0 ? 0 : 100.0 ) : 100.0 * ( value - exact ) / exact;
+}
+
+/** === runProfile ===
+* Play a profile, print its figures as a JSON object
+* @param p: the profile
+* @param gridMeter: on the simulated ADE7753 ade
+* @return boolean false if the run fails, see the comments above
+*/
+static boolean runProfile(const BillProfile *p, GridMeter &gridMeter) {
+	GridRecord rec;
+	double sampled[BILL_TARIFFS];
+	double exactDemand[BILL_TARIFFS];
+	boolean ok = true;
+
+	profile = p;
+	if ( simNow() < p->start * 3600000000ULL ) simAdvance(p->start * 3600000000ULL - simNow());
+	profileStart = simNow();
+	startSec = utcAt(profileStart);
+	carry = 0;
+	switchAt.clear();
+	switchWatts.clear();
+	switched = 0;
+	minuteImport.clear();
+	for (byte t = 0; t < BILL_TARIFFS; t++) exactImport[t] = exactExport[t] = sampled[t] = exactDemand[t] = 0;
+	srand(7753);
+	for (unsigned long t = 0; t < p->length * 1000; t += 500 + rand() % 7500)
+	{   // a load every 0.5 to 8 s, the same at each run
+		switchAt.push_back(t);
+		switchWatts.push_back(rand() % ( BILL_SIM_WATTS + 1 ));
+	}
+	ade.load = loadAt;
+	memset(simEeprom, 0xFF, sizeof(simEeprom)); // cleared registers
+	gridBilling.begin(&gridMeter, 1, tariffs, sizeof(tariffs) / sizeof(tariffs[0]));
+	unsigned long long end = profileStart + p->length * 1000000ULL;
+	unsigned long long nextCycle = profileStart;
+	gridMeter.startCycle(); // as setup(): the windows run until the first cycle
+	gridMeter.waitCycleEnd();
+	gridMeter.watch(EVENT_LINECYC);
+	gridMeter.close();
+	while ( simNow() < end )
+	{
+		wdt_reset();
+		gridBilling.tick(utcAt(simNow()));
+		if ( simNow() >= nextCycle )
+		{   // the measurement of the update period, as in the loop of ArduGrid7753.ino
+			gridMeter.startCycle();
+			gridMeter.waitCycleEnd();
+			gridMeter.read(rec);
+			if ( gridMeter.hasMains() )
+			{
+				gridBilling.add(0, rec.activeEnergy, METER_LINECYC, gridMeter.getSigns(), gridMeter.getCycleEnd());
+				long e = rec.activeEnergy & 0x800000L ? rec.activeEnergy - 0x1000000L : rec.activeEnergy;
+				double w = e / pgm_read_float(&shield[0].calActiveEnergy);
+				if ( w > 0 ) sampled[tariffAt(utcAt(simNow()))] += w * BILL_SIM_PERIOD / 3600000.0;
+			}
+			gridMeter.watch(EVENT_LINECYC);
+			gridMeter.close();
+			nextCycle += BILL_SIM_PERIOD * 1000ULL;
+		}
+#ifdef GRIDEVENTS
+		else
+		{
+			long a, r;
+			gridMeter.open();
+			if ( gridMeter.pollWindow(a, r) ) gridBilling.add(0, a, EVENT_LINECYC, gridMeter.getSigns(), millis());
+			gridMeter.close();
+		}
+#endif
+		simAdvance(BILL_SIM_LOOP * 1000ULL);
+	}
+	ade.load = 0;
+	ade.activePerHalfCycle = 105; // back to the values of the constructor
+
+	// exact maximum demand: the windows of 15 whole minutes, by the tariff at their end
+	for (size_t m = 1 + BILL_SUBS; m < minuteImport.size(); m++)
+	{   // minute 0 is partial, minute m is the one the window ends at
+		double wh = 0;
+		for (size_t k = m - BILL_SUBS; k < m; k++) wh += minuteImport[k];
+		double w = wh * 60 / BILL_SUBS;
+		byte t = tariffAt(( startSec / 60 + m ) * 60);
+		if ( w > exactDemand[t] ) exactDemand[t] = w;
+	}
+
+	const BillRegisters *b = gridBilling.getRegisters();
+	printf("%s    {\"profile\": \"%s\", \"length_h\": %lu, \"reversals\": %u, \"tariffs\": [", p == profiles ? "" : ",\n",
+	       p->name, p->length / 3600, b->reversals);
+	for (byte t = 0; t < BILL_TARIFFS; t++)
+	{
+		if ( exactImport[t] == 0 && exactExport[t] == 0 ) continue;
+		double importError = pct(b->importWh[t], exactImport[t]);
+		double exportError = pct(b->exportWh[t], exactExport[t]);
+		double demandError = pct(b->maxDemand[t], exactDemand[t]);
+		boolean tariffOk = fabs(importError) <= BILL_SIM_ERROR && fabs(demandError) <= BILL_SIM_DEMAND
+		                   && ( exactExport[t] < 100 || fabs(exportError) <= BILL_SIM_ERROR ); // at least 100 Wh, the register is in Wh
+		ok = ok && tariffOk;
+		printf("%s\n      {\"tariff\": %u, \"import_wh\": %lu, \"exact_import_wh\": %.1f, \"import_error_pct\": %.3f, "
+		       "\"sampled_error_pct\": %.3f, \"export_wh\": %lu, \"exact_export_wh\": %.1f, \"export_error_pct\": %.3f, "
+		       "\"max_demand_w\": %lu, \"exact_max_demand_w\": %.1f, \"demand_error_pct\": %.3f, \"ok\": %s}",
+		       t == 0 ? "" : ",", t, b->importWh[t], exactImport[t], importError, pct(sampled[t], exactImport[t]),
+		       b->exportWh[t], exactExport[t], exportError, b->maxDemand[t], exactDemand[t], demandError,
+		       tariffOk ? "true" : "false");
+	}
+	if ( p->pv ) ok = ok && b->reversals > 0;
+	printf("\n    ], \"ok\": %s}", ok ? "true" : "false");
+	return ok;
+}
+
+/** === persistence ===
+* Save twice, corrupt the newer copy, restore; then restore from an erased EEPROM
+* @return boolean false if a restore is wrong
+*/
+static boolean persistence(GridMeter &gridMeter) {
+	BillRegisters first;
+	unsigned long writes = simEepromWrites;
+	gridBilling.save();
+	unsigned long perSave = simEepromWrites - writes;
+	first = *gridBilling.getRegisters();
+	gridBilling.tick(utcAt(simNow()));
+	gridBilling.add(0, 200000, METER_LINECYC, 0, millis()); // some more energy in the newer copy
+	simAdvance(60000000ULL);
+	gridBilling.add(0, 200000, METER_LINECYC, 0, millis());
+	gridBilling.save();
+	boolean differ = gridBilling.getRegisters()->importWh[0] + gridBilling.getRegisters()->importWh[1]
+	                 + gridBilling.getRegisters()->importWh[2] != first.importWh[0] + first.importWh[1] + first.importWh[2];
+	simEeprom[BILL_EEPROM_START + ( gridBilling.getRegisters()->sequence & 1 ) * sizeof(BillRegisters) + 3] ^= 0x10; // a bit of importWh flipped
+
+	gridBilling.begin(&gridMeter, 1, tariffs, sizeof(tariffs) / sizeof(tariffs[0]));
+	boolean olderOk = differ && gridBilling.isRestored() && memcmp(&first, gridBilling.getRegisters(), sizeof(first)) == 0;
+
+	memset(simEeprom, 0xFF, sizeof(simEeprom));
+	gridBilling.begin(&gridMeter, 1, tariffs, sizeof(tariffs) / sizeof(tariffs[0]));
+	const BillRegisters *b = gridBilling.getRegisters();
+	boolean erasedOk = ! gridBilling.isRestored() && b->importWh[0] == 0 && b->maxDemand[1] == 0 && b->reversals == 0;
+
+	printf("  \"eeprom\": {\"copy_bytes\": %u, \"bytes_written_per_save\": %lu, \"older_copy_restored\": %s, "
+	       "\"erased_cleared\": %s},\n", (unsigned int)sizeof(BillRegisters), perSave, olderOk ? "true" : "false",
+	       erasedOk ? "true" : "false");
+	return olderOk && erasedOk;
+}
+
+int main(void) {
+	GridMeter gridMeter;
+	boolean ok = true;
+
+	simQuiet(true);
+	simAttach(CS, &ade);
+	gridMeter.begin(&shield[0]);
+
+	printf("{\n  \"window_min\": %u, \"utc_offset_min\": %d, \"profiles\": [\n", BILL_SUBS, BILL_UTC_OFFSET);
+	for (byte i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++)
+		if ( ! runProfile(&profiles[i], gridMeter) ) ok = false;
+	printf("\n  ],\n");
+	if ( ! persistence(gridMeter) ) ok = false;
+	printf("  \"ok\": %s\n}\n", ok ? "true" : "false");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+/* clocksim.cpp = Simulation of the SNTP synchronisation of GridClock on a PC
+==========================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+GridClock.cpp is compiled unchanged against the EtherCard stand-in of host/mock, whose
+SNTP exchange is answered here by a simulated server. The simulated time of HostSim.cpp is
+the time of the Nanode crystal: millis() runs fast or slow by the ppm of the profile, the
+server keeps the true time. Each one-way trip of the network takes CLOCK_SIM_DELAY ms plus
+a random jitter of up to CLOCK_SIM_JITTER ms, drawn for each direction, so that the trips
+are not symmetric. An ARP request arrives now and then during the wait for the answer and
+must go to packetLoop().
+
+The loop of ArduGrid7753.ino is played for CLOCK_SIM_HOURS: a synchronisation at boot (up
+to 5 attempts) and every NTP_SYNC_RATE records, now() at every pass of the loop. For each
+profile:
+
+	syncs, failures     synchronisations done, and lost (no answer within NTP_TIMEOUT)
+	drift_ppm           GridClock::getDrift() at the end, must cancel the ppm of the crystal
+	drift_error_ppm     drift_ppm + ppm
+	max_offset_ms       largest GridClock::getOffset() after CLOCK_SIM_SETTLE syncs
+	max_error_ms        largest |now() - true time| after CLOCK_SIM_SETTLE syncs, between
+	                    the synchronisations included, the held values left out
+	held_s              time during which now() was held after a negative correction
+	backward            now() going back in time, must be 0
+	arp                 packets other than the answer handed over to packetLoop()
+
+The profiles:
+
+	fast300           a crystal 300 ppm fast, every synchronisation corrects backward
+	slow150           150 ppm slow
+	lossy             300 ppm fast, a third of the answers lost
+	step              300 ppm fast, the server time stepped back CLOCK_SIM_STEP ms at
+	                  half the run: the clock is stepped without refining the drift,
+	                  and held until the true time has caught up
+
+A drift error over CLOCK_SIM_DRIFT ppm, an error over CLOCK_SIM_ERROR ms or a backward step
+of now() fails the run.
+
+Build and run from the sketch folder:
+
+	g++ -O2 -DARDUINO=100 -Ihost/mock -Ihost -I. host/clocksim.cpp host/HostSim.cpp GridClock.cpp \
+	    -o host/clocksim
+	host/clocksim > clock.json
+
+*/
+
+#include <math.h>
+#include <EtherCard.h>
+#include <avr/wdt.h>
+#include "HostSim.h"
+#include "GridClock.h"
+
+#define CLOCK_SIM_HOURS    24
+#define CLOCK_SIM_LOOP     100        // in milliseconds - a pass of the loop of ArduGrid7753.ino
+#define CLOCK_SIM_RATE     600        // in seconds - NTP_SYNC_RATE records of 10 s
+#define CLOCK_SIM_DELAY    3          // in milliseconds - one-way trip to the server
+#define CLOCK_SIM_JITTER   15         // in milliseconds - largest random addition to a trip
+#define CLOCK_SIM_SERVER   80         // in microseconds - T3 - T2
+#define CLOCK_SIM_POLL     20         // in microseconds - a packetReceive() without packet, SPI reads
+#define CLOCK_SIM_SETTLE   10         // synchronisations before the drift is expected to be found
+#define CLOCK_SIM_STEP     1500       // in milliseconds - server step of the step profile
+#define CLOCK_SIM_DRIFT    20         // in ppm - largest drift error
+#define CLOCK_SIM_ERROR    50         // in milliseconds - largest error of now()
+#define CLOCK_SIM_EPOCH    1792368000ULL  // true time at boot, 19 Oct 2026 00:00:00 UTC
+
+struct ClockProfile {
+	const char *name;
+	double ppm;               // of the Nanode crystal, > 0 fast
+	int loss;                 // in % of the answers
+	boolean step;             // server stepped back at half the run
+};
+
+static const ClockProfile profiles[] = {
+	{ "fast300", +300.0, 0,  false },
+	{ "slow150", -150.0, 0,  false },
+	{ "lossy",   +300.0, 33, false },
+	{ "step",    +300.0, 0,  true }
+};
+
+uint8_t Ethernet::buffer[128];
+EtherCard ether;
+
+static const ClockProfile *profile;
+static unsigned long long bootUs;      // simNow() at the start of the profile
+static long long serverStepUs;         // added to the true time by the server
+static boolean answering;              // an answer is on its way
+static unsigned long long answerAt;    // simNow() at which it arrives
+static unsigned long long arpAt;       // simNow() at which an ARP request arrives, 0 none
+static unsigned long long t2Us, t3Us;  // server time stamps of the answer
+static boolean ntpReceived;            // the packet received is the answer
+static unsigned long arp;              // packets handed over to packetLoop()
+
+/** === trueUs ===
+* @return unsigned long long with the true time in us since the Unix epoch at the simulated time local
+*/
+static unsigned long long trueUs(unsigned long long local) {
+	return CLOCK_SIM_EPOCH * 1000000ULL + (unsigned long long)( ( local - bootUs ) / ( 1.0 + profile->ppm * 1e-6 ) );
+}
+
+/** === localUs ===
+* @return unsigned long long with the simulated time at the true time t, see trueUs()
+*/
+static unsigned long long localUs(unsigned long long t) {
+	return bootUs + (unsigned long long)( ( t - CLOCK_SIM_EPOCH * 1000000ULL ) * ( 1.0 + profile->ppm * 1e-6 ) );
+}
+
+/** === trip ===
+* @return unsigned long long with a one-way trip in us
+*/
+static unsigned long long trip(void) {
+	return CLOCK_SIM_DELAY * 1000ULL + rand() % ( CLOCK_SIM_JITTER * 1000 + 1 );
+}
+
+/** === putStamp ===
+* Write the NTP time stamp of the Unix time t (in us) at pos in the Ethernet buffer, big endian
+*/
+static void putStamp(word pos, unsigned long long t) {
+	uint32_t sec = (uint32_t)( t / 1000000ULL + NTP_UNIX_OFFSET );
+	uint32_t frac = (uint32_t)( ( ( t % 1000000ULL ) << 32 ) / 1000000ULL );
+	for (byte i = 0; i < 4; i++)
+	{
+		Ethernet::buffer[pos + i] = sec >> ( 24 - 8 * i );
+		Ethernet::buffer[pos + 4 + i] = frac >> ( 24 - 8 * i );
+	}
+}
+
+void EtherCard::ntpRequest(uint8_t *ntpip, uint8_t srcport) {
+	unsigned long long t1 = trueUs(simNow());
+	answering = rand() % 100 >= profile->loss;
+	t2Us = t1 + trip() + serverStepUs;
+	t3Us = t2Us + CLOCK_SIM_SERVER;
+	answerAt = localUs(t3Us - serverStepUs + trip());
+	arpAt = rand() % 4 == 0 ? simNow() + rand() % ( ( 2 * CLOCK_SIM_DELAY + CLOCK_SIM_JITTER ) * 1000UL ) : 0; // within the wait, mostly
+}
+
+uint16_t ENC28J60::packetReceive() {
+	simAdvance(CLOCK_SIM_POLL);
+	ntpReceived = false;
+	if ( arpAt != 0 && simNow() >= arpAt && ( ! answering || arpAt < answerAt ) )
+	{
+		arpAt = 0;
+		return 60;
+	}
+	if ( answering && simNow() >= answerAt )
+	{
+		answering = false;
+		putStamp(0x4A, t2Us);
+		putStamp(0x52, t3Us);
+		ntpReceived = true;
+		return 90;
+	}
+	return 0;
+}
+
+uint8_t EtherCard::ntpProcessAnswer(uint32_t *time, uint8_t dstport_l) {
+	if ( ! ntpReceived ) return 0;
+	*time = (uint32_t)( t3Us / 1000000ULL + NTP_UNIX_OFFSET );
+	return 1;
+}
+
+uint16_t EtherCard::packetLoop(uint16_t plen) {
+	arp++;
+	return 0;
+}
+
+/** === runProfile ===
+* Play a profile, print its figures as a JSON object
+* @param p: the profile
+* @return boolean false if the run fails, see the comments above
+*/
+static boolean runProfile(const ClockProfile *p) {
+	GridClock clock;
+	unsigned long syncs = 0, failures = 0, backward = 0, samples = 0;
+	unsigned long long held = 0;
+	long maxOffset = 0;
+	double maxError = 0, sumDelay = 0;
+	unsigned long lastSec = 0;
+	unsigned int lastMs = 0;
+
+	profile = p;
+	bootUs = simNow();
+	serverStepUs = 0;
+	answering = false;
+	arpAt = 0;
+	arp = 0;
+	srand(7753);
+
+	clock.begin();
+	for (int i = 0; i < 5 && ! clock.sync(0); i++) failures++;
+	unsigned long long end = bootUs + CLOCK_SIM_HOURS * 3600000000ULL;
+	unsigned long long nextSync = simNow() + CLOCK_SIM_RATE * 1000000ULL;
+	while ( simNow() < end )
+	{
+		wdt_reset();
+		if ( simNow() >= nextSync )
+		{
+			if ( p->step && serverStepUs == 0 && simNow() >= bootUs + CLOCK_SIM_HOURS * 1800000000ULL )
+				serverStepUs = -CLOCK_SIM_STEP * 1000LL;
+			if ( clock.sync(0) )
+			{
+				syncs++;
+				sumDelay += clock.getDelay();
+				if ( syncs > CLOCK_SIM_SETTLE && labs(clock.getOffset()) > labs(maxOffset) && labs(clock.getOffset()) < NTP_STEP_LIMIT )
+					maxOffset = clock.getOffset();
+			}
+			else failures++;
+			nextSync += CLOCK_SIM_RATE * 1000000ULL;
+		}
+
+		unsigned long sec;
+		unsigned int ms;
+		clock.now(&sec, &ms);
+		long long t = (long long)( trueUs(simNow()) / 1000ULL ) + serverStepUs / 1000;
+		long long stamp = (long long)sec * 1000 + ms;
+		if ( samples++ > 0 )
+		{
+			if ( sec < lastSec || ( sec == lastSec && ms < lastMs ) ) backward++;
+			if ( sec == lastSec && ms == lastMs ) held += CLOCK_SIM_LOOP;  // held, left out of the error
+			else if ( syncs > CLOCK_SIM_SETTLE && fabs((double)( stamp - t )) > maxError ) maxError = fabs((double)( stamp - t ));
+		}
+		lastSec = sec;
+		lastMs = ms;
+		simAdvance(CLOCK_SIM_LOOP * 1000ULL);
+	}
+
+	double driftError = clock.getDrift() + p->ppm;
+	boolean ok = backward == 0 && fabs(driftError) <= CLOCK_SIM_DRIFT && maxError <= CLOCK_SIM_ERROR;
+
+	printf("%s    {\"profile\": \"%s\", \"ppm\": %.0f, \"loss_pct\": %d, \"syncs\": %lu, \"failures\": %lu, "
+	       "\"mean_delay_ms\": %.1f, \"drift_ppm\": %ld, \"drift_error_ppm\": %.1f, \"last_offset_ms\": %ld, "
+	       "\"max_offset_ms\": %ld, \"max_error_ms\": %.0f, \"held_s\": %.1f, \"backward\": %lu, \"arp\": %lu, \"ok\": %s}",
+	       p == profiles ? "" : ",\n", p->name, p->ppm, p->loss, syncs, failures, syncs ? sumDelay / syncs : 0.0,
+	       clock.getDrift(), driftError, clock.getOffset(), maxOffset, maxError, held / 1000.0, backward, arp,
+	       ok ? "true" : "false");
+	return ok;
+}
+
+int main(void) {
+	boolean ok = true;
+
+	simQuiet(true);
+	printf("{\n  \"hours\": %d, \"sync_rate_s\": %d, \"delay_ms\": %d, \"jitter_ms\": %d,\n  \"profiles\": [\n",
+	       CLOCK_SIM_HOURS, CLOCK_SIM_RATE, CLOCK_SIM_DELAY, CLOCK_SIM_JITTER);
+	for (byte i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++)
+		if ( ! runProfile(&profiles[i]) ) ok = false;
+	printf("\n  ],\n  \"ok\": %s\n}\n", ok ? "true" : "false");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,281 @@
+/* deadbandsim.cpp = Simulation of the report by exception of GridDeadband on a PC
+==============================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+GridDeadband.cpp is compiled unchanged with the rules of deadbands[] in ArduGrid7753.ino,
+and a day of updates is played on a Nanode of two meters: meter 0 on a house supply (a
+base load, appliances switched at random, the voltage following the daily load of the
+grid), meter 1 on a circuit off most of the day. Every DEADSIM_PERIOD the datastreams go
+through pass() as sendRecord() hands them, and the Stash lines are measured as sendRecord()
+prints them: "id,2026-10-19T10:20:30.123Z,value" for the measurements, "id,value" for the
+health, the floats with 2 decimals. One request in DEADSIM_FAIL fails and is retried, one
+in DEADSIM_REJECT is rejected for good and its record dropped, as PachubeClient does on a
+4xx: the values of a request are only taken as held by Pachube once it is delivered, and
+resend() is called as printUpload() does, with true for any status but 2xx.
+
+For each datastream:
+
+	sent, suppressed          values through pass(), the retries included
+	max_error                 largest gap between the value and the one Pachube holds, the
+	                          value last delivered, to be within the band
+	max_silence_s             longest time without a value sent, to be within the heartbeat
+
+Then the bytes of the Stash with and without the rules, the requests left out as empty,
+and the counters of GridDeadband against the values played. Without the rules, the bytes
+are the ones of the sketch before GridDeadband: every datastream of every request, and no
+datastreams 30 and 31. A value beyond its band, a silence beyond its heartbeat, a request
+after one not delivered not sent in full, counters that do not add up or a saving under
+DEADSIM_SAVING % fails the run.
+
+Build and run from the sketch folder:
+
+	g++ -O2 -DARDUINO=100 -Ihost/mock -Ihost -I. host/deadbandsim.cpp host/HostSim.cpp GridDeadband.cpp \
+	    -o host/deadbandsim
+	host/deadbandsim > deadband.json
+
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "HostSim.h"
+#include "GridDeadband.h"
+
+#ifndef GRIDDEADBAND
+#error "build with -DGRIDDEADBAND"
+#endif
+
+#define DEADSIM_PERIOD   10      // in seconds - REQUEST_RATE of ArduGrid7753.ino
+#define DEADSIM_LENGTH   86400   // in seconds - a day
+#define DEADSIM_METERS   2
+#define DEADSIM_FAIL     50      // one request in 50 fails and is retried
+#define DEADSIM_REJECT   97      // one request in 97 is rejected for good, its record dropped
+#define DEADSIM_SAVING   40      // in % - smallest saving of Stash bytes
+#define DEADSIM_STAMP    24      // length of the time stamp printed by GridClock::printIso()
+#define DEADSIM_STREAMS  32      // datastreams 0-31 of a meter
+
+// Rules as in ArduGrid7753.ino
+static const DeadbandRule deadbands[] PROGMEM = {
+	{ 0.5,    300 },   // 0  - Vrms in V
+	{ 0.05,   300 },   // 1  - Irms in A
+	{ 2.0,    300 },   // 2  - Vpeak
+	{ 0.1,    300 },   // 3  - Ipeak
+	{ 5.0,    300 },   // 4  - Active energy
+	{ 5.0,    300 },   // 5  - Apparent energy
+	{ 5.0,    300 },   // 6  - Reactive energy
+	{ 1.5,    900 },   // 7  - Temperature, a change of 2 degrees
+	{ 0.05,   300 },   // 8  - Frequency in Hz
+	{ 0,      3600 },  // 9  - SNTP offset, changes at each synchronisation only
+	{ -1,     0 },     // 10 - Nanode health, every update: the Nanode is alive
+	{ 0,      3600 },  // 11 - Reboots
+	{ 0,      3600 },  // 12 - Watchdog timeouts
+	{ 100,    600 },   // 13 - Pachube response time in ms
+	{ 0,      600 },   // 14 - Records waiting for upload
+	{ 30,     600 },   // 15 - Age in s of the oldest record waiting
+	{ 0,      3600 },  // 16 - Records dropped
+	{ 0,      900 },   // 17 - Time in the traced phases in ms (GRIDTRACE)
+	{ 0,      3600 },  // 18 - Minimum free SRAM
+	{ 5,      900 }    // 19 - CPU awake in %
+};
+
+static const char *names[DEADBAND_STREAMS] = { "vrms", "irms", "vpeak", "ipeak", "active", "apparent", "reactive",
+	"temp", "freq", "sntp_offset", "updates", "reboots", "timeouts", "response_ms", "buffered", "oldest_s",
+	"dropped", "trace_ms", "free", "duty" };
+
+struct Channel {
+	unsigned long sent, suppressed;
+	float held;                    // value last delivered, the one Pachube shows
+	float staged;                  // value of the request in flight
+	boolean inFlight;              // staged is in the request in flight
+	boolean any;                   // a value was delivered
+	double maxError;
+	unsigned long lastAt;          // in seconds, when the value was last sent
+	unsigned long maxSilence;      // in seconds
+};
+
+static GridDeadband deadband;
+static Channel channels[DEADSIM_METERS][DEADBAND_STREAMS];
+static unsigned long played;       // values through pass()
+
+/** === deliver ===
+* The outcome of a request: the values staged are held by Pachube if it was delivered
+* @param delivered: 2xx
+*/
+static void deliver(boolean delivered) {
+	for (byte m = 0; m < DEADSIM_METERS; m++)
+		for (byte id = 0; id < DEADBAND_STREAMS; id++)
+		{
+			Channel &c = channels[m][id];
+			if ( ! c.inFlight ) continue;
+			c.inFlight = false;
+			if ( ! delivered ) continue;
+			c.held = c.staged;
+			c.any = true;
+		}
+}
+
+/** === noise ===
+* @return double with a uniform value in [-a, a]
+*/
+static double noise(double a) {
+	return a * ( 2.0 * rand() / RAND_MAX - 1.0 );
+}
+
+/** === lineBytes ===
+* @return unsigned int with the length of a Stash line as sendRecord() prints it
+*/
+static unsigned int lineBytes(byte meter, byte id, float value, boolean integer) {
+	char s[48];
+	int n = integer ? snprintf(s, sizeof(s), "%u,%ld\r\n", meter * 100 + id, (long)value)
+	                : snprintf(s, sizeof(s), "%u,%.2f\r\n", meter * 100 + id, value);
+	return n + ( id < DEADBAND_MEASURES ? DEADSIM_STAMP + 1 : 0 );
+}
+
+/** === play ===
+* One value through pass(), and the value Pachube holds after it
+* @param retry: the request is a retry, every value must go
+* @return unsigned int with the bytes of the line, 0 if left out
+*/
+static unsigned int play(byte meter, byte id, float value, boolean integer, unsigned long t, boolean retry, boolean &ok) {
+	Channel &c = channels[meter][id];
+	played++;
+	if ( deadband.pass(meter, id, value) )
+	{
+		if ( c.sent != 0 && t - c.lastAt > c.maxSilence ) c.maxSilence = t - c.lastAt;
+		c.sent++;
+		c.lastAt = t;
+		c.staged = value;
+		c.inFlight = true;
+		return lineBytes(meter, id, value, integer);
+	}
+	c.suppressed++;
+	if ( retry ) ok = false;
+	double e = fabs(value - c.held);
+	if ( e > c.maxError ) c.maxError = e;
+	return 0;
+}
+
+/** === loadAt ===
+* @return double with the current in A of meter 0 at t seconds: a base load and appliances switched at random
+*/
+static double loadAt(unsigned long t) {
+	static double appliances = 0;
+	static unsigned long next = 0;
+	if ( t >= next )
+	{
+		appliances = ( rand() % 3 == 0 ) ? ( rand() % 5 ) * 2.5 : 0;
+		next = t + 300 + rand() % 3600;
+	}
+	double evening = ( t % 86400 >= 18 * 3600 && t % 86400 < 23 * 3600 ) ? 4.0 : 0;
+	return 0.8 + evening + appliances + noise(0.02);
+}
+
+int main(void) {
+	boolean ok = true, retryOk = true;
+	unsigned long filtered = 0, unfiltered = 0, requests = 0, skipped = 0, retries = 0, rejections = 0;
+	boolean undelivered = false;
+	long offset = 12;
+	unsigned int depth = 0;
+	double temp = 28;
+
+	srand(7753);
+	simQuiet(true);
+	deadband.begin(deadbands, sizeof(deadbands) / sizeof(deadbands[0]));
+
+	for (unsigned long t = 0, j = 1; t < DEADSIM_LENGTH; t += DEADSIM_PERIOD, j++)
+	{
+		simAdvance(DEADSIM_PERIOD * 1000000ULL);
+		double dayLoad = sin(2 * M_PI * ( t % 86400 ) / 86400.0 - M_PI / 2);
+		double vrms = 231.5 - 2.5 * dayLoad + noise(0.2);
+		double freq = 50.0 + noise(0.015) + ( t % 7200 < 60 ? -0.1 : 0 ); // a dip every 2 hours
+		temp += noise(0.05) + ( 30 + 4 * dayLoad - temp ) * 0.002;
+		if ( j % 60 == 0 ) offset = (long)noise(30);                          // SNTP every 10 minutes
+		if ( t >= 14 * 3600 && t < 14 * 3600 + 900 ) depth++;                 // Pachube out for 15 minutes
+		else if ( depth > 0 ) depth--;
+
+		for (byte m = 0; m < DEADSIM_METERS; m++)
+		{
+			double irms = m == 0 ? loadAt(t) : ( t % 86400 >= 7 * 3600 && t % 86400 < 8 * 3600 ? 8.2 + noise(0.1) : 0 );
+			double pf = 0.92 + noise(0.01);
+			float v[DEADBAND_MEASURES] = { (float)vrms, (float)irms, (float)( vrms * 1.414 + noise(0.5) ),
+				(float)( irms * 1.45 + noise(0.02) ), (float)( vrms * irms * pf ), (float)( vrms * irms ),
+				(float)( vrms * irms * sqrt(1 - pf * pf) ), (float)(int)temp, (float)freq };
+			for (byte attempt = 0; ; attempt++)
+			{
+				boolean retry = undelivered, retried = true; // a retry, or the record after a rejection
+				unsigned int bytes = 0;
+				for (byte id = 0; id < DEADBAND_MEASURES; id++)
+				{
+					bytes += play(m, id, v[id], id == 7, t, retry, retried);
+					unfiltered += lineBytes(m, id, v[id], id == 7);
+				}
+				if ( m == 0 )
+				{
+					float health[DEADBAND_HEALTH] = { (float)offset, (float)j, 3, 1, (float)( 350 + rand() % 200 ),
+						(float)depth, (float)( depth * DEADSIM_PERIOD ), 0, 0, 1012, 100 };
+					for (byte id = DEADBAND_MEASURES; id < DEADBAND_STREAMS; id++)
+					{
+						if ( id == 17 ) continue; // without GRIDTRACE
+						bytes += play(m, id, health[id - DEADBAND_MEASURES], true, t, retry, retried);
+						unfiltered += lineBytes(m, id, health[id - DEADBAND_MEASURES], true);
+					}
+					bytes += lineBytes(m, 30, deadband.getSent(), true) + lineBytes(m, 31, deadband.getSuppressed(), true);
+				}
+				retryOk = retryOk && retried;
+				filtered += bytes;
+				if ( bytes == 0 )
+				{
+					skipped++; // PachubeClient::skip(), no answer and no resend()
+					break;
+				}
+				requests++;
+				boolean failed = attempt == 0 && rand() % DEADSIM_FAIL == 0;
+				boolean rejected = ! failed && rand() % DEADSIM_REJECT == 0;
+				deliver(! failed && ! rejected);
+				undelivered = failed || rejected;
+				deadband.resend(undelivered);
+				if ( rejected ) rejections++;
+				if ( ! failed ) break;
+				retries++;
+			}
+		}
+	}
+
+	printf("{\n  \"length_h\": %u, \"period_s\": %u, \"meters\": %u, \"streams\": [\n", DEADSIM_LENGTH / 3600,
+	       DEADSIM_PERIOD, DEADSIM_METERS);
+	unsigned long sent = 0, suppressed = 0;
+	boolean first = true;
+	for (byte m = 0; m < DEADSIM_METERS; m++)
+		for (byte id = 0; id < DEADBAND_STREAMS; id++)
+		{
+			Channel &c = channels[m][id];
+			if ( c.sent + c.suppressed == 0 ) continue;
+			float band = pgm_read_float(&deadbands[id].band);
+			unsigned int heartbeat = pgm_read_word(&deadbands[id].heartbeat);
+			boolean streamOk = ( band < 0 || c.maxError <= band + 1e-3 ) && c.maxSilence <= heartbeat + DEADSIM_PERIOD;
+			ok = ok && streamOk;
+			sent += c.sent;
+			suppressed += c.suppressed;
+			printf("%s    {\"id\": %u, \"name\": \"%s\", \"band\": %g, \"heartbeat_s\": %u, \"sent\": %lu, \"suppressed\": %lu, "
+			       "\"max_error\": %.3f, \"max_silence_s\": %lu, \"ok\": %s}", first ? "" : ",\n", m * 100 + id, names[id], band,
+			       heartbeat, c.sent, c.suppressed, c.maxError, c.maxSilence, streamOk ? "true" : "false");
+			first = false;
+		}
+	double saving = 100.0 * ( 1.0 - (double)filtered / unfiltered );
+	boolean countersOk = deadband.getSent() == sent && deadband.getSuppressed() == suppressed && sent + suppressed == played;
+	ok = ok && retryOk && countersOk && saving >= DEADSIM_SAVING;
+	printf("\n  ],\n  \"requests\": %lu, \"retries\": %lu, \"rejected\": %lu, \"skipped\": %lu, \"resent_in_full\": %s,\n",
+	       requests, retries, rejections, skipped, retryOk ? "true" : "false");
+	printf("  \"values_sent\": %lu, \"values_suppressed\": %lu, \"counters_ok\": %s,\n", sent, suppressed,
+	       countersOk ? "true" : "false");
+	printf("  \"stash_bytes\": %lu, \"stash_bytes_unfiltered\": %lu, \"saving_pct\": %.1f,\n", filtered, unfiltered, saving);
+	printf("  \"ok\": %s\n}\n", ok ? "true" : "false");
+	return ok ? 0 : 1;
+}
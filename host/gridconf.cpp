@@ -0,0 +1,439 @@
+/* gridconf.cpp = Remote configuration client for ArduGrid7753
+============================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Reads and changes the configuration of a Nanode built with GRIDCONFIG (see GridConfig.h):
+
+	gridconf host                            GET /config, the parameters in use
+	gridconf -a mac host parameter value [meter]
+	                                         GET /set, one parameter changed: the value is
+	                                         given in its unit (a float for the calibration,
+	                                         0x.. accepted for the gain), it is signed with
+	                                         the key for the MAC address of the Nanode, and
+	                                         the answer printed
+	gridconf -a mac host defaults            every change dropped, back to the tables in flash
+
+The nonce is the UTC time in seconds unless given with -n: one command per second at most,
+from a PC with a clock set. The key is CONFIG_KEY of GridConfig.h unless given with -k, as
+32 hexadecimal digits. The MAC address is the one of the node table of ArduGrid7753.ino,
+as 00:04:A3:2C:2B:D6: a command signed for one Nanode is denied by the others. The status
+of the answer is the exit code: 0 if accepted.
+
+With -l, GridConfig and GridHttp are served on the PC (127.0.0.1) from a thread, with the
+EEPROM of host/mock and a simulated ADE7753 on meter 0, and the commands are checked as
+JSON on stdout: accepted, applied between two cycles (offsets and gain read back from the
+ADE7753, energies of a longer line cycle count scaled to METER_LINECYC), replayed, forged
+or signed for another Nanode commands denied, values out of range refused, the list full, a value set back to the one
+of flash freeing its entry, and the list restored after a reboot, after a corrupted copy,
+and dropped by p=defaults.
+
+	gridconf [-k key] [-n nonce] [-t timeout_ms] [-a mac] host [port] [parameter value [meter]]
+	gridconf -l
+
+Build from the sketch folder:
+
+	g++ -O2 -std=c++11 -pthread -DARDUINO=100 -DGRIDSNAPSHOT -DGRIDHTTP -DGRIDCONFIG -Ihost/mock -Ihost -I. host/gridconf.cpp \
+	    host/HostSim.cpp host/Ade7753Model.cpp ADE7753.cpp GridMeter.cpp GridWatchdog.cpp GridLog.cpp \
+	    GridConfig.cpp GridSnapshot.cpp GridHttp.cpp -o host/gridconf
+	host/gridconf -l && host/gridconf -a 00:04:A3:2C:2B:D6 192.168.1.20 calActiveEnergy 35.1 0
+
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <avr/eeprom.h>
+#include "HostSim.h"
+#include "Ade7753Model.h"
+#include "GridMeter.h"
+#include "GridHttp.h"
+#include "GridConfig.h"
+
+#ifndef GRIDCONFIG
+#error "build with -DGRIDCONFIG"
+#endif
+
+#define CONF_TIMEOUT     2000      // in milliseconds - connect and answer
+#define CONF_PACKET      646       // TCP payload of the 700 bytes Ethernet buffer of the Nanode
+#define CONF_PERIOD      10000     // in milliseconds - REQUEST_RATE of ArduGrid7753.ino
+
+// Rows 0, 1 and 0 of the shield table of ArduGrid7753.ino, a node of 3 meters
+static const MeterConfig shields[3] PROGMEM = {
+	{ CS, -3,   -5,   -2000, +2000,  12498.65, 167623.8, 141.0,   234565.0,  1.0,    34.8,     30.4,       0.60 },
+	{ 9,  -6,   -1,   -2000, -2048,  12225.0,  169192.0, 138.39,  233518.20, 1.0,    67.28,    58.57,      1.40 },
+	{ 8,  -3,   -5,   -2000, +2000,  12498.65, 167623.8, 141.0,   234565.0,  1.0,    34.8,     30.4,       0.60 }
+};
+
+static const byte defaultKey[16] = { CONFIG_KEY };
+static const byte localNode[6] = { 0x00, 0x04, 0xA3, 0x2C, 0x2B, 0xD6 }; // node 1 of ArduGrid7753.ino, served by -l
+static const byte otherNode[6] = { 0x00, 0x04, 0xA3, 0x2C, 0x30, 0xC2 }; // node 2
+
+struct Answer {
+	int status;                // of the status line, 0 if none
+	std::string body;          // after the headers
+};
+
+/** === get ===
+* One request on a connection of its own
+*/
+static Answer get(const sockaddr_in &to, const std::string &path, int timeout) {
+	Answer a = { 0, "" };
+	std::string all;
+	int s = socket(AF_INET, SOCK_STREAM, 0);
+	timeval tv = { timeout / 1000, ( timeout % 1000 ) * 1000 };
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	if ( connect(s, (const sockaddr *)&to, sizeof(to)) == 0 )
+	{
+		std::string request = "GET " + path + " HTTP/1.0\r\nHost: nanode\r\n\r\n";
+		if ( send(s, request.data(), request.size(), 0) == (ssize_t)request.size() )
+		{
+			char chunk[1024];
+			ssize_t got;
+			while ( ( got = recv(s, chunk, sizeof(chunk), 0) ) > 0 ) all.append(chunk, got);
+		}
+	}
+	close(s);
+	if ( all.compare(0, 7, "HTTP/1.") == 0 && all.size() > 12 ) a.status = atoi(all.c_str() + 9);
+	size_t b = all.find("\r\n\r\n");
+	if ( b != std::string::npos ) a.body = all.substr(b + 4);
+	return a;
+}
+
+/** === setPath ===
+* @return std::string with the path of GET /set of a command, signed with the key
+*/
+static std::string setPath(const char *param, const ConfigCommand &c, const byte *key) {
+	byte mac[8];
+	char path[128];
+	GridConfig::sign(c, key, mac);
+	int n = snprintf(path, sizeof(path), "/set?p=%s&m=%u&v=%08lX&n=%lu&h=", param, c.meter,
+	                 (unsigned long)( c.value & 0xFFFFFFFFUL ), c.nonce);
+	for (byte i = 0; i < sizeof(mac); i++) n += snprintf(path + n, sizeof(path) - n, "%02X", mac[i]);
+	return path;
+}
+
+/** === command ===
+* Build a command from the text of the value in its unit
+* @return boolean false if the parameter or the value is not understood
+*/
+static boolean command(ConfigCommand &c, const char *param, const char *value, byte meter, unsigned long nonce,
+                       const byte *node) {
+	c.nonce = nonce;
+	c.meter = meter;
+	memcpy(c.node, node, sizeof(c.node));
+	c.param = GridConfig::find(param);
+	c.value = 0;
+	if ( c.param == CONFIG_NONE ) return false;
+	if ( c.param == CONFIG_DEFAULTS ) return true;
+	char *end;
+	if ( GridConfig::getType(c.param) == CONFIG_REAL )
+	{
+		float f = strtof(value, &end);
+		int32_t bits;
+		memcpy(&bits, &f, sizeof(bits));
+		c.value = bits;
+	}
+	else c.value = strtol(value, &end, 0);
+	return end != value && *end == 0;
+}
+
+/** === sendCommand ===
+* Sign and send a command
+* @return Answer of the Nanode
+*/
+static Answer sendCommand(const sockaddr_in &to, const char *param, const char *value, byte meter, unsigned long nonce,
+                          const byte *key, const byte *node) {
+	ConfigCommand c;
+	if ( ! command(c, param, value, meter, nonce, node) ) return Answer();
+	return get(to, setPath(param, c, key), CONF_TIMEOUT);
+}
+
+/** === serve ===
+* GridHttp on a listening socket, as ArduGrid7753.ino does on the ENC28J60
+*/
+static void serve(int listener, GridHttp *http, std::atomic<bool> *stop) {
+	while ( ! *stop )
+	{
+		int c = accept(listener, 0, 0);
+		if ( c < 0 ) continue;
+		char request[CONF_PACKET + 1];
+		ssize_t n = recv(c, request, CONF_PACKET, 0);
+		if ( n > 0 )
+		{
+			byte packet[CONF_PACKET];
+			request[n] = 0;
+			http->open(request);
+			while ( http->more() )
+			{
+				unsigned int len = http->fill(packet, sizeof(packet));
+				send(c, packet, len, MSG_NOSIGNAL);
+			}
+		}
+		close(c);
+	}
+}
+
+/** === cycle ===
+* The measurement cycle of the loop of ArduGrid7753.ino on meter 0: the changes applied
+* first, then one line cycle accumulation
+* @return unsigned long with the duration of the accumulation in ms
+*/
+static unsigned long cycle(GridMeter &gridMeter, GridRecord &rec, byte &status) {
+	status = METER_OK;
+	if ( gridConfig.apply() ) status = gridMeter.reconfigure();
+	if ( gridMeter.check() != METER_OK ) status = METER_MISMATCH;
+	unsigned long start = millis();
+	gridMeter.startCycle();
+	gridMeter.waitCycleEnd();
+	gridMeter.read(rec);
+	gridMeter.close();
+	return gridMeter.getCycleEnd() - start;
+}
+
+/** === check ===
+* Print a check as a JSON member
+* @return boolean ok
+*/
+static boolean check(const char *name, boolean ok) {
+	static boolean first = true;
+	printf("%s    \"%s\": %s", first ? "" : ",\n", name, ok ? "true" : "false");
+	first = false;
+	return ok;
+}
+
+/** === local ===
+* Serve GridConfig on the PC and check the commands, see the comments above
+* @return boolean true if every check passes
+*/
+static boolean local(void) {
+	Ade7753Model ade;
+	GridMeter gridMeter;
+	MeterConfig rows[3];
+	GridSnapshot snapshot;
+	GridHttp http;
+	GridRecord rec;
+	std::atomic<bool> stop(false);
+	sockaddr_in to;
+	socklen_t len = sizeof(to);
+	unsigned long nonce = 1000;
+	byte status;
+	boolean ok = true;
+	char text[32];
+
+	simQuiet(true);
+	simAttach(CS, &ade);
+	memset(simEeprom, 0xFF, sizeof(simEeprom));
+	gridConfig.begin(shields, rows, 3, CONF_PERIOD, localNode);
+	gridMeter.begin(&rows[0]);
+	snapshot.begin(3);
+	http.begin(&snapshot);
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	if ( bind(listener, (const sockaddr *)&to, sizeof(to)) != 0 || listen(listener, 4) != 0 ) { perror("listen"); return false; }
+	getsockname(listener, (sockaddr *)&to, &len);
+	std::thread server(serve, listener, &http, &stop);
+
+	printf("{\n  \"eeprom_block_bytes\": %u,\n  \"checks\": {\n", (unsigned int)sizeof(ConfigBlock));
+	Answer a = get(to, "/config", CONF_TIMEOUT);
+	ok &= check("config_page", a.status == 200 && a.body.find("\"period\":10000,\"linecyc\":200") != std::string::npos
+	            && a.body.find("{\"meter\":2,\"ch1os\":-3") != std::string::npos && a.body.find("}]}\r\n") != std::string::npos);
+	ok &= check("not_restored", ! gridConfig.isRestored());
+
+	// accepted, not applied before the next cycle
+	a = sendCommand(to, "calActiveEnergy", "40.5", 1, ++nonce, defaultKey, localNode);
+	ok &= check("accepted", a.status == 200 && a.body.find("\"ok\"") != std::string::npos && gridConfig.isPending());
+	ok &= check("not_applied_yet", rows[1].calActiveEnergy == pgm_read_float(&shields[1].calActiveEnergy));
+	a = sendCommand(to, "ch1os", "-7", 0, ++nonce, defaultKey, localNode);
+	a = sendCommand(to, "gain", "0x21", 0, ++nonce, defaultKey, localNode); // PGA2 x2, 0.5 V, PGA1 x2 instead of x4
+	ok &= check("accepted_offsets_gain", a.status == 200);
+	cycle(gridMeter, rec, status);
+	ok &= check("applied", rows[1].calActiveEnergy == 40.5f && ! gridConfig.isPending() && gridConfig.getChanged() == 3);
+	ok &= check("registers_written", status == METER_OK && ade.get(CH1OS) == ( 0x20 | 7 ) && ade.get(GAIN) == 0x21
+	            && gridMeter.getRepairs() == 0);
+
+	// denied and refused
+	a = sendCommand(to, "calActiveEnergy", "41", 1, nonce, defaultKey, localNode);
+	ok &= check("replay_denied", a.status == 403);
+	a = sendCommand(to, "calActiveEnergy", "41", 1, ++nonce, defaultKey, otherNode); // seen on the LAN, for node 2
+	ok &= check("other_node_denied", a.status == 403 && gridConfig.getRejected() == 2);
+	byte forged[16];
+	memcpy(forged, defaultKey, sizeof(forged));
+	forged[5] ^= 0x01;
+	a = sendCommand(to, "calActiveEnergy", "41", 1, ++nonce, forged, localNode);
+	ok &= check("forged_denied", a.status == 403 && gridConfig.getRejected() == 3);
+	a = sendCommand(to, "ch2os", "32", 0, ++nonce, defaultKey, localNode);
+	Answer b = sendCommand(to, "irmsos", "-2049", 0, ++nonce, defaultKey, localNode);
+	Answer c = sendCommand(to, "calIrms", "-1", 0, ++nonce, defaultKey, localNode);
+	Answer d = sendCommand(to, "gain", "0x05", 0, ++nonce, defaultKey, localNode);
+	ok &= check("out_of_range", a.status == 400 && b.status == 400 && c.status == 400 && d.status == 400
+	            && d.body.find("bad_value") != std::string::npos);
+	a = sendCommand(to, "linecyc", "800", 0, ++nonce, defaultKey, localNode);
+	b = sendCommand(to, "period", "5500", 0, ++nonce, defaultKey, localNode);
+	ok &= check("period_too_short", a.status == 400 && b.status == 400); // 800 half cycles need 12 s, 200 need 6 s
+	a = sendCommand(to, "calVrms", "1", 3, ++nonce, defaultKey, localNode);
+	ok &= check("no_such_meter", a.status == 400 && a.body.find("bad_param") != std::string::npos);
+	a = get(to, "/set?p=nothing&m=0&v=00000001&n=99999&h=0000000000000000", CONF_TIMEOUT);
+	b = get(to, "/set?p=ch1os&v=00000001", CONF_TIMEOUT);
+	ok &= check("malformed", a.status == 400 && b.status == 400 && gridConfig.getRejected() == 3);
+
+	// a longer line cycle count, the energies scaled to METER_LINECYC half cycles
+	a = sendCommand(to, "period", "20000", 0, ++nonce, defaultKey, localNode);
+	b = sendCommand(to, "linecyc", "400", 0, ++nonce, defaultKey, localNode);
+	unsigned long ms = cycle(gridMeter, rec, status);
+	ok &= check("linecyc_applied", a.status == 200 && b.status == 200 && gridConfig.getPeriod() == 20000
+	            && ade.get(LINECYC) == 400 && ms >= 3990 && ms <= 4030);
+	ok &= check("energy_scaled", rec.activeEnergy == ade.activePerHalfCycle * METER_LINECYC
+	            && rec.reactiveEnergy == ( ade.reactivePerHalfCycle * METER_LINECYC & 0xFFFFFFL )
+	            && rec.apparentEnergy == (long)ade.apparentPerHalfCycle * METER_LINECYC);
+
+	// the list full, and an entry freed
+	for (byte i = 0; i < 3; i++)
+	{
+		snprintf(text, sizeof(text), "%d", 100 + i);
+		a = sendCommand(to, "calVrms", text, i, ++nonce, defaultKey, localNode);
+	}
+	ok &= check("eight_changes", a.status == 200 && gridConfig.isPending());
+	cycle(gridMeter, rec, status);
+	a = sendCommand(to, "calTemp", "2", 0, ++nonce, defaultKey, localNode);
+	ok &= check("list_full", a.status == 400 && a.body.find("full") != std::string::npos && gridConfig.getChanged() == 8);
+	a = sendCommand(to, "ch1os", "-3", 0, ++nonce, defaultKey, localNode);
+	b = sendCommand(to, "calTemp", "2", 0, ++nonce, defaultKey, localNode);
+	cycle(gridMeter, rec, status);
+	ok &= check("entry_freed", a.status == 200 && b.status == 200 && rows[0].ch1os == -3 && rows[0].calTemp == 2.0f
+	            && ade.get(CH1OS) == ( 0x20 | 3 ));
+
+	// reboots
+	MeterConfig before[3];
+	memcpy(before, rows, sizeof(rows));
+	gridConfig.begin(shields, rows, 3, CONF_PERIOD, localNode);
+	ok &= check("restored", gridConfig.isRestored() && memcmp(before, rows, sizeof(rows)) == 0
+	            && gridConfig.getLineCyc() == 400 && gridConfig.getGain() == 0x21);
+	a = sendCommand(to, "calTemp", "3", 0, nonce, defaultKey, localNode);
+	ok &= check("nonce_kept", a.status == 403);
+	a = sendCommand(to, "calTemp", "3", 0, ++nonce, defaultKey, localNode);
+	ConfigBlock k[2];
+	for (byte i = 0; i < 2; i++)
+		eeprom_read_block(&k[i], (const void *)( CONFIG_EEPROM_START + i * sizeof(ConfigBlock) ), sizeof(ConfigBlock));
+	byte newer = (byte)( k[1].sequence - k[0].sequence ) < 0x80 ? 1 : 0; // the copy of the last save
+	simEeprom[CONFIG_EEPROM_START + newer * sizeof(ConfigBlock) + offsetof(ConfigBlock, nonce)] ^= 0x10; // a bit flipped
+	gridConfig.begin(shields, rows, 3, CONF_PERIOD, localNode);
+	ok &= check("older_copy_restored", gridConfig.isRestored() && rows[0].calTemp == 2.0f);
+	a = sendCommand(to, "defaults", "", 0, ++nonce, defaultKey, localNode);
+	cycle(gridMeter, rec, status);
+	ok &= check("defaults", a.status == 200 && gridConfig.getChanged() == 0 && gridConfig.getLineCyc() == METER_LINECYC
+	            && memcmp(rows, shields, sizeof(rows)) == 0 && ade.get(GAIN) == METER_GAIN && ade.get(LINECYC) == METER_LINECYC);
+	memset(simEeprom, 0xFF, sizeof(simEeprom));
+	gridConfig.begin(shields, rows, 3, CONF_PERIOD, localNode);
+	ok &= check("erased_flash_tables", ! gridConfig.isRestored() && memcmp(rows, shields, sizeof(rows)) == 0);
+	printf("\n  },\n  \"ok\": %s\n}\n", ok ? "true" : "false");
+
+	stop = true;
+	shutdown(listener, SHUT_RDWR);
+	close(listener);
+	server.join();
+	return ok;
+}
+
+/** === macAddress ===
+* Read a MAC address written as 6 hexadecimal bytes separated by ':' or '-'
+* @return boolean false if malformed
+*/
+static boolean macAddress(const char *text, byte *mac) {
+	for (byte i = 0; i < 6; i++)
+	{
+		char *end;
+		unsigned long b = strtoul(text, &end, 16);
+		if ( end == text || end - text > 2 || b > 0xFF || ( i < 5 ? *end != ':' && *end != '-' : *end != 0 ) ) return false;
+		mac[i] = b;
+		text = end + 1;
+	}
+	return true;
+}
+
+int main(int argc, char **argv) {
+	byte key[16];
+	byte node[6];
+	boolean addressed = false;
+	unsigned long nonce = time(0);
+	int timeout = CONF_TIMEOUT;
+	const char *args[5];
+	int n = 0;
+
+	memcpy(key, defaultKey, sizeof(key));
+	for (int i = 1; i < argc; i++)
+	{
+		if ( strcmp(argv[i], "-l") == 0 ) return local() ? 0 : 1;
+		else if ( strcmp(argv[i], "-n") == 0 && i + 1 < argc ) nonce = strtoul(argv[++i], 0, 10);
+		else if ( strcmp(argv[i], "-t") == 0 && i + 1 < argc ) timeout = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-a") == 0 && i + 1 < argc )
+		{
+			addressed = macAddress(argv[++i], node);
+			if ( ! addressed ) { fprintf(stderr, "MAC address as 00:04:A3:2C:2B:D6: %s\n", argv[i]); return 2; }
+		}
+		else if ( strcmp(argv[i], "-k") == 0 && i + 1 < argc && strlen(argv[i + 1]) == 32 )
+		{
+			const char *h = argv[++i];
+			for (byte j = 0; j < 16; j++)
+			{
+				char two[3] = { h[2 * j], h[2 * j + 1], 0 };
+				key[j] = strtoul(two, 0, 16);
+			}
+		}
+		else if ( n < 5 ) args[n++] = argv[i];
+	}
+	if ( n == 0 )
+	{
+		fprintf(stderr, "usage: gridconf [-k key] [-n nonce] [-t timeout_ms] [-a mac] host [port] [parameter value [meter]]\n"
+		                "       gridconf -a mac host [port] defaults\n"
+		                "       gridconf -l\n");
+		return 2;
+	}
+	sockaddr_in to;
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_port = htons(80);
+	if ( inet_pton(AF_INET, args[0], &to.sin_addr) != 1 ) { fprintf(stderr, "host must be an IPv4 address\n"); return 2; }
+	int next = 1;
+	if ( n > 1 && args[1][0] >= '0' && args[1][0] <= '9' ) to.sin_port = htons(atoi(args[next++]));
+
+	Answer a;
+	if ( next == n ) a = get(to, "/config", timeout);
+	else
+	{
+		ConfigCommand c;
+		const char *value = next + 1 < n ? args[next + 1] : "";
+		byte meter = next + 2 < n ? atoi(args[next + 2]) : 0;
+		if ( ! addressed )
+		{
+			fprintf(stderr, "a change needs the MAC address of the Nanode, with -a\n");
+			return 2;
+		}
+		if ( ! command(c, args[next], value, meter, nonce, node) )
+		{
+			fprintf(stderr, "unknown parameter or value: %s %s\n", args[next], value);
+			return 2;
+		}
+		a = get(to, setPath(args[next], c, key), timeout);
+	}
+	if ( a.status == 0 ) { fprintf(stderr, "no answer\n"); return 1; }
+	printf("%s", a.body.c_str());
+	return a.status == 200 ? 0 : 1;
+}
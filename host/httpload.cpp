@@ -0,0 +1,268 @@
+/* httpload.cpp = Load generator for the local HTTP endpoint of ArduGrid7753
+=========================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Sends GET requests to a Nanode on the LAN (see GridHttp.h), each on a connection of its
+own as EtherCard closes it after the answer, and prints as JSON on stdout:
+
+	requests, ok, errors   requests sent, answers with the status expected, and timeouts,
+	                       refused connections or other status lines
+	requests_per_s         answers per second of wall time, all clients together
+	latency_ms             from connect() to the end of the answer: mean, p50, p95, max
+	bytes                  of the last answer, headers included
+	reply_us               the time the Nanode took for the previous answer, given in the
+	                       JSON page (open() to the last part, the packets sent included)
+
+EtherCard answers one connection at a time: with -c above 1 the clients compete, which
+shows how the node copes with several dashboards (the lost SYN are retried by the TCP
+stack of the PC and show up in the latency).
+
+With -l, GridHttp is served on the PC (127.0.0.1) from a thread, with the readings of a
+synthetic record, and the pages are checked: the JSON and CSV answers must be complete,
+an unknown path must answer 404. It checks the load generator and the pages, not the
+timing of the Nanode: the clock of host/HostSim.cpp is simulated, so that reply_us is not
+the time of an ATmega328.
+
+	httpload [-n requests] [-c clients] [-p path] [-t timeout_ms] [-s status] host [port]
+	httpload -l [-n requests] [-c clients] [-p path]
+
+Build from the sketch folder:
+
+	g++ -O2 -std=c++11 -pthread -DARDUINO=100 -DGRIDSNAPSHOT -DGRIDHTTP -Ihost/mock -Ihost -I. \
+	    host/httpload.cpp host/HostSim.cpp GridSnapshot.cpp GridHttp.cpp -o host/httpload
+	host/httpload -l && host/httpload -n 500 192.168.1.20 > http.json
+
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "HostSim.h"
+#include "GridHttp.h"
+
+#ifndef GRIDHTTP
+#error "build with -DGRIDSNAPSHOT -DGRIDHTTP"
+#endif
+
+#define LOAD_REQUESTS    200
+#define LOAD_TIMEOUT     2000      // in milliseconds - connect and answer
+#define LOAD_ANSWER      4096      // bytes of an answer kept, the rest is counted only
+#define LOAD_PACKET      646       // TCP payload of the 700 bytes Ethernet buffer of the Nanode
+
+// Row 0 of the shield table of ArduGrid7753.ino
+static const MeterConfig shield = { 10, -3, -5, -2000, +2000, 12498.65, 167623.8, 141.0, 234565.0, 1.0, 34.8, 30.4, 0.60 };
+
+struct Answer {
+	int status;                // of the status line, 0 if none
+	double ms;                 // from connect() to the end of the answer
+	std::vector<char> body;    // headers included
+};
+
+/** === get ===
+* One request on a connection of its own
+*/
+static Answer get(const sockaddr_in &to, const char *path, int timeout) {
+	Answer a = { 0, 0, std::vector<char>() };
+	auto t0 = std::chrono::steady_clock::now();
+	int s = socket(AF_INET, SOCK_STREAM, 0);
+	timeval tv = { timeout / 1000, ( timeout % 1000 ) * 1000 };
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	if ( connect(s, (const sockaddr *)&to, sizeof(to)) == 0 )
+	{
+		char request[256];
+		int n = snprintf(request, sizeof(request), "GET %s HTTP/1.0\r\nHost: nanode\r\n\r\n", path);
+		if ( send(s, request, n, 0) == n )
+		{
+			char chunk[1024];
+			ssize_t got;
+			while ( ( got = recv(s, chunk, sizeof(chunk), 0) ) > 0 )
+			{
+				a.body.insert(a.body.end(), chunk, chunk + min((size_t)got, LOAD_ANSWER - a.body.size()));
+				if ( a.body.size() >= LOAD_ANSWER ) break;
+			}
+			if ( got < 0 ) a.body.clear(); // timeout, the answer is not complete
+		}
+	}
+	close(s);
+	a.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	a.body.push_back(0);
+	if ( strncmp(&a.body[0], "HTTP/1.", 7) == 0 ) a.status = atoi(&a.body[9]);
+	return a;
+}
+
+/** === bodyOf ===
+* @return const char* to the body of an answer, after the headers
+*/
+static const char *bodyOf(const Answer &a) {
+	const char *b = strstr(&a.body[0], "\r\n\r\n");
+	return b == 0 ? "" : b + 4;
+}
+
+/** === serve ===
+* GridHttp on a listening socket, as ArduGrid7753.ino does on the ENC28J60: the request is
+* read, then each part is sent as a TCP packet would be
+*/
+static void serve(int listener, GridHttp *http, std::atomic<bool> *stop) {
+	while ( ! *stop )
+	{
+		int c = accept(listener, 0, 0);
+		if ( c < 0 ) continue;
+		char request[LOAD_PACKET + 1];
+		ssize_t n = recv(c, request, LOAD_PACKET, 0);
+		if ( n > 0 )
+		{
+			byte packet[LOAD_PACKET];
+			request[n] = 0;
+			http->open(request);
+			while ( http->more() )
+			{
+				unsigned int len = http->fill(packet, sizeof(packet));
+				send(c, packet, len, MSG_NOSIGNAL);
+			}
+		}
+		close(c);
+	}
+}
+
+/** === check ===
+* @return boolean true if the pages served by -l are complete
+*/
+static boolean check(const sockaddr_in &to, byte meters) {
+	Answer json = get(to, "/json", LOAD_TIMEOUT);
+	Answer csv = get(to, "/csv", LOAD_TIMEOUT);
+	Answer root = get(to, "/", LOAD_TIMEOUT);
+	Answer none = get(to, "/nothing", LOAD_TIMEOUT);
+	const char *b = bodyOf(json);
+	boolean ok = json.status == 200 && root.status == 200 && csv.status == 200 && none.status == 404;
+	ok = ok && b[0] == '{' && strstr(b, "}]}\r\n") != 0 && strstr(b, "\"vrms\":230.") != 0;
+	for (byte m = 0; m < meters; m++)
+	{
+		char key[32];
+		snprintf(key, sizeof(key), "{\"meter\":%d,", m);
+		ok = ok && strstr(b, key) != 0;
+		snprintf(key, sizeof(key), "\n%d,", m * 100 + 8);
+		ok = ok && strstr(bodyOf(csv), key) != 0;
+	}
+	ok = ok && strstr(bodyOf(csv), "\n18,") != 0;
+	if ( ! ok ) fprintf(stderr, "pages not as expected:\n%s\n%s\n%s\n", &json.body[0], &csv.body[0], &none.body[0]);
+	return ok;
+}
+
+int main(int argc, char **argv) {
+	unsigned int requests = LOAD_REQUESTS, clients = 1;
+	int timeout = LOAD_TIMEOUT, expected = 200;
+	const char *path = "/json", *host = 0;
+	int port = 80;
+	boolean local = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if ( strcmp(argv[i], "-n") == 0 && i + 1 < argc ) requests = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-c") == 0 && i + 1 < argc ) clients = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-p") == 0 && i + 1 < argc ) path = argv[++i];
+		else if ( strcmp(argv[i], "-t") == 0 && i + 1 < argc ) timeout = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-s") == 0 && i + 1 < argc ) expected = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-l") == 0 ) local = true;
+		else if ( host == 0 ) host = argv[i];
+		else port = atoi(argv[i]);
+	}
+	if ( ( host == 0 && ! local ) || requests == 0 || clients == 0 )
+	{
+		fprintf(stderr, "usage: httpload [-n requests] [-c clients] [-p path] [-t timeout_ms] [-s status] host [port]\n"
+		                "       httpload -l [-n requests] [-c clients] [-p path]\n");
+		return 2;
+	}
+	simQuiet(true);
+
+	sockaddr_in to;
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	GridSnapshot snapshot;
+	GridHttp http;
+	std::atomic<bool> stop(false);
+	std::thread server;
+	int listener = -1;
+	if ( local )
+	{   // the readings of a record of each meter, 230 V, 5 A, 50 Hz
+		socklen_t len = sizeof(to);
+		snapshot.begin(SCHED_METERS);
+		for (byte m = 0; m < SCHED_METERS; m++)
+		{
+			GridRecord rec = { 1791234567UL, 123, 2875 * 1000L, 838 * 1000L, 0, 0, 80040, 80040, 7000, 20000, 25, m };
+			snapshot.update(rec, &shield, 1000);
+		}
+		snapshot.setHealth(SNAP_UPDATES, 42);
+		snapshot.setHealth(SNAP_FREE, 312);
+		http.begin(&snapshot);
+		listener = socket(AF_INET, SOCK_STREAM, 0);
+		to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		to.sin_port = 0;
+		if ( bind(listener, (const sockaddr *)&to, sizeof(to)) != 0 || listen(listener, 16) != 0 ) { perror("listen"); return 2; }
+		getsockname(listener, (sockaddr *)&to, &len);
+		server = std::thread(serve, listener, &http, &stop);
+	}
+	else
+	{
+		to.sin_port = htons(port);
+		if ( inet_pton(AF_INET, host, &to.sin_addr) != 1 ) { fprintf(stderr, "host must be an IPv4 address\n"); return 2; }
+	}
+
+	boolean pagesOk = ! local || check(to, SCHED_METERS);
+	std::vector<Answer> answers(requests);
+	std::vector<std::thread> threads;
+	auto t0 = std::chrono::steady_clock::now();
+	for (unsigned int c = 0; c < clients; c++)
+	{
+		threads.push_back(std::thread([&, c]() {
+			for (unsigned int i = c; i < requests; i += clients) answers[i] = get(to, path, timeout);
+		}));
+	}
+	for (auto &t : threads) t.join();
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+	std::vector<double> ms;
+	unsigned int ok = 0;
+	for (auto &a : answers)
+	{
+		ms.push_back(a.ms);
+		if ( a.status == expected ) ok++;
+	}
+	std::sort(ms.begin(), ms.end());
+	double sum = 0;
+	for (double x : ms) sum += x;
+	const Answer &last = answers[requests - 1];
+	const char *reply = strstr(&last.body[0], "\"reply_us\":");
+	printf("{\n  \"target\": \"%s:%d\", \"path\": \"%s\", \"clients\": %u,\n", local ? "127.0.0.1" : host,
+	       ntohs(to.sin_port), path, clients);
+	printf("  \"requests\": %u, \"ok\": %u, \"errors\": %u, \"requests_per_s\": %.1f,\n", requests, ok, requests - ok, ok / wall);
+	printf("  \"latency_ms\": {\"mean\": %.2f, \"p50\": %.2f, \"p95\": %.2f, \"max\": %.2f},\n", sum / ms.size(),
+	       ms[ms.size() / 2], ms[ms.size() * 95 / 100], ms.back());
+	printf("  \"bytes\": %u, \"reply_us\": %ld, \"pages_ok\": %s\n}\n", (unsigned int)last.body.size() - 1,
+	       reply == 0 ? -1L : atol(reply + 11), pagesOk ? "true" : "false");
+
+	if ( local )
+	{
+		stop = true;
+		shutdown(listener, SHUT_RDWR);
+		close(listener);
+		server.join();
+	}
+	return ( ok == requests && pagesOk ) ? 0 : 1;
+}
@@ -0,0 +1,1088 @@
+/* ingest.cpp = Ingest server of the datastreams of a fleet of ArduGrid7753 Nanodes
+=================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Stands in for Pachube on a Linux server: the Nanodes keep sending their unmodified request
+(see sendRecord() in ArduGrid7753.ino) to the host of their row of the node table.
+
+	PUT /v2/feeds/<feed>.csv    the body of the Stash, one "id,value" or "id,time,value" line
+	                            per datastream, time as printed by GridClock::printIso(). The
+	                            absolute form of the firmware, PUT http://host/v2/..., is accepted
+	PUT /v2/feeds/<feed>.bin    record frames of GRIDLOG_BINARY (see GridLog.h), ie. the Serial
+	                            capture of a Nanode forwarded by a gateway: the raw registers of
+	                            meter m go to datastreams m * 100 + 40 (vrms) ... 48 (temp), in
+	                            the order of the frame
+	GET /v2/feeds/<feed>.csv?stream=<id>&start=<t>&end=<t>
+	                            the values of a datastream from start included to end excluded,
+	                            "time,value" lines, t in seconds since 1970 or as ISO 8601
+	GET /stats                  the counters below, as JSON
+
+A value without time stamp (the health datastreams, or the clock of the Nanode not yet
+synchronised) is stamped with the time of arrival. A line that does not parse is counted and
+skipped, the others are kept: 200 as long as one value was kept, 400 otherwise, so that the
+PachubeClient of the Nanode drops a record that would never be accepted.
+
+Threads: each of the -t workers blocks in accept() on the listening socket, reads a whole
+request into a buffer of its own (INGEST_REQUEST bytes, a Nanode sends less than 700) and
+parses it in place: the lines and frames are scanned in the receive buffer, numbers and time
+stamps are converted on the fly, nothing is copied before the append.
+
+Store: one directory per feed, under -d. Each column is a file mapped in memory: the time
+(int64, ms since 1970), the datastream (uint16) and the value (double), plus a meta page
+with the row count, written after the columns (a row past the count is not there). A column
+is grown by doubling (ftruncate + mremap). The appends of a feed and its queries take the
+lock of the feed; the feeds are found in INGEST_SHARDS maps of their own lock. A query scans
+the datastream column, then the time of its rows only: the blocks of INGEST_BLOCK rows keep
+their min and max time, a block out of the range is skipped (the records replayed after an
+outage come out of order, so that the time column is not sorted).
+
+With -l, the server is run on 127.0.0.1 with a store in a temporary directory, and a fleet
+of simulated Nanodes sends its requests, byte for byte as sendRecord() prints them, a request
+of record frames one time in FLEET_BINARY. Then:
+
+	requests_per_s, points_per_s   ingest rate, all clients together
+	latency_ms                     from connect() to the end of the answer: mean, p50, p99, max
+	check                          every value sent is stored once, the range queries of a sample
+	                               of the feeds give the values of their range, a malformed
+	                               request gets 400, and the store reopened gives the same rows
+
+	ingest [-p port] [-t threads] [-d dir]
+	ingest -l [-n nodes] [-u updates] [-c clients] [-t threads] [-d dir]
+
+Build from the sketch folder:
+
+	g++ -O2 -std=c++11 -pthread -DARDUINO=100 -Ihost/mock -Ihost -I. host/ingest.cpp -o host/ingest
+	host/ingest -l && host/ingest -p 80 -d /var/lib/ardugrid
+
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "GridLog.h"
+#undef min                    // of the Arduino.h of the mock, for std::min and std::max
+#undef max
+
+#define INGEST_PORT       8080
+#define INGEST_THREADS    8
+#define INGEST_REQUEST    8192      // bytes of a request, headers and body
+#define INGEST_TIMEOUT    5000      // in milliseconds - receive and send on a connection
+#define INGEST_BACKLOG    1024      // connections waiting for a worker
+#define INGEST_SHARDS     16        // maps of the feeds, each with its lock
+#define INGEST_BLOCK      4096      // rows per block of the time index
+#define INGEST_ROWS       65536     // rows of a new column, doubled as needed
+#define INGEST_RAW        40        // datastream of the raw VRMS of a record frame, then IRMS... TEMP
+#define INGEST_MAGIC      "AG7753TS"
+#define INGEST_VERSION    1
+
+#define FLEET_NODES       2000
+#define FLEET_UPDATES     5
+#define FLEET_CLIENTS     64
+#define FLEET_FEED        10000     // feed of the first simulated Nanode
+#define FLEET_BINARY      10        // one request in 10 of a node carries record frames
+#define FLEET_UTC         1791234560LL // UTC of the first update, 10 s apart
+#define FLEET_SAMPLE      20        // feeds queried by the check
+
+struct Point {
+	int64_t ms;                // since 1 Jan 1970
+	uint16_t stream;           // datastream
+	double value;
+};
+
+struct FeedMeta {              // first page of the meta file
+	char magic[8];             // INGEST_MAGIC
+	uint32_t version;          // INGEST_VERSION
+	uint32_t feed;
+	uint64_t rows;             // committed, written after the columns
+};
+
+struct Column {                // one column file, mapped whole
+	int fd;
+	char *base;
+	size_t size;               // of an element
+};
+
+struct Stats {
+	std::atomic<unsigned long> requests, points, frames, badLines, badFrames, queries, rejected;
+};
+
+static Stats stats;
+
+
+/*****************************
+*
+*   time stamps and numbers
+*
+*****************************/
+
+/** === daysFromCivil ===
+* Days since 1 Jan 1970 of a date, the reverse of the civil_from_days of GridClock::printIso():
+*	http://howardhinnant.github.io/date_algorithms.html
+*/
+static int64_t daysFromCivil(int y, unsigned int m, unsigned int d) {
+	y -= m <= 2;
+	int64_t era = ( y >= 0 ? y : y - 399 ) / 400;
+	unsigned int yoe = (unsigned int)( y - era * 400 );
+	unsigned int doy = ( 153 * ( m > 2 ? m - 3 : m + 9 ) + 2 ) / 5 + d - 1;
+	unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + (int64_t)doe - 719468;
+}
+
+/** === isoTime ===
+* Print ms since 1970 as GridClock::printIso() does, ie. 2026-10-19T10:20:30.123Z
+* @return int with the length printed
+*/
+static int isoTime(char *out, int64_t ms) {
+	int64_t sec = ms / 1000, days = sec / 86400, tod = sec % 86400;
+	int64_t z = days + 719468, era = z / 146097;
+	unsigned int doe = (unsigned int)( z - era * 146097 );
+	unsigned int yoe = ( doe - doe / 1460 + doe / 36524 - doe / 146096 ) / 365;
+	unsigned int doy = doe - ( 365 * yoe + yoe / 4 - yoe / 100 );
+	unsigned int mp = ( 5 * doy + 2 ) / 153;
+	unsigned int d = doy - ( 153 * mp + 2 ) / 5 + 1;
+	unsigned int m = mp < 10 ? mp + 3 : mp - 9;
+	int y = (int)( yoe + era * 400 + ( m <= 2 ) );
+	return sprintf(out, "%04d-%02u-%02uT%02u:%02u:%02u.%03uZ", y, m, d, (unsigned int)( tod / 3600 ),
+		(unsigned int)( tod / 60 % 60 ), (unsigned int)( tod % 60 ), (unsigned int)( ms % 1000 ));
+}
+
+/** === digits ===
+* Read n decimal digits at p
+* @return bool false if one is not a digit
+*/
+static bool digits(const char *&p, const char *end, int n, unsigned int &v) {
+	v = 0;
+	for (int i = 0; i < n; i++, p++)
+	{
+		if ( p == end || *p < '0' || *p > '9' ) return false;
+		v = v * 10 + ( *p - '0' );
+	}
+	return true;
+}
+
+/** === parseIso ===
+* An ISO 8601 UTC time stamp, with or without milliseconds, ie. 2026-10-19T10:20:30.123Z
+* @return bool false if it is not one, p left after it
+*/
+static bool parseIso(const char *&p, const char *end, int64_t &ms) {
+	unsigned int y, mo, d, h, mi, s, frac = 0;
+	if ( ! digits(p, end, 4, y) || p == end || *p++ != '-' || ! digits(p, end, 2, mo) || p == end || *p++ != '-'
+		|| ! digits(p, end, 2, d) || p == end || *p++ != 'T' || ! digits(p, end, 2, h) || p == end || *p++ != ':'
+		|| ! digits(p, end, 2, mi) || p == end || *p++ != ':' || ! digits(p, end, 2, s) ) return false;
+	if ( p != end && *p == '.' )
+	{
+		p++;
+		if ( ! digits(p, end, 3, frac) ) return false;
+	}
+	if ( p != end && *p == 'Z' ) p++;
+	if ( mo < 1 || mo > 12 || d < 1 || d > 31 || h > 23 || mi > 59 || s > 60 ) return false;
+	ms = ( daysFromCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s ) * 1000 + frac;
+	return true;
+}
+
+/** === parseNumber ===
+* A decimal number as Print prints it, ie. -12, 230.12 - no exponent, "nan" or "ovf" fail
+* @return bool false if there is none, p left after it
+*/
+static bool parseNumber(const char *&p, const char *end, double &v) {
+	bool negative = false;
+	int64_t mantissa = 0;
+	double scale = 1;
+	const char *start;
+	if ( p != end && ( *p == '-' || *p == '+' ) ) negative = *p++ == '-';
+	start = p;
+	for ( ; p != end && *p >= '0' && *p <= '9'; p++) mantissa = mantissa * 10 + ( *p - '0' );
+	if ( p != end && *p == '.' )
+	{
+		for (p++; p != end && *p >= '0' && *p <= '9'; p++)
+		{
+			mantissa = mantissa * 10 + ( *p - '0' );
+			scale *= 10;
+		}
+	}
+	if ( p == start || p - start > 18 ) return false;
+	v = ( negative ? -mantissa : mantissa ) / scale;
+	return true;
+}
+
+/** === parseTime ===
+* A time of a query, seconds since 1970 or ISO 8601
+*/
+static bool parseTime(const char *p, const char *end, int64_t &ms) {
+	double sec;
+	if ( end - p > 4 && p[4] == '-' ) return parseIso(p, end, ms) && p == end;
+	if ( ! parseNumber(p, end, sec) || p != end ) return false;
+	ms = (int64_t)( sec * 1000 + ( sec < 0 ? -0.5 : 0.5 ) );
+	return true;
+}
+
+/** === nowMs ===
+* @return int64_t with the UTC time of the server, in ms since 1970
+*/
+static int64_t nowMs(void) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+/*****************************
+*
+*     store of a feed
+*
+*****************************/
+
+class FeedStore {
+   public:
+      bool open(const std::string &dir, unsigned long feed);
+      void close(void);
+      void append(const Point *points, size_t n);
+      size_t query(unsigned int stream, int64_t from, int64_t to, std::string *csv);
+      uint64_t getRows(void);
+
+   private:
+      bool map(Column &c, const std::string &path, size_t size, uint64_t rows);
+      bool grow(uint64_t rows);
+      void index(uint64_t row, int64_t ms);
+
+      std::mutex lock;
+      FeedMeta *meta;
+      int metaFd;
+      Column time, stream, value;
+      uint64_t capacity;                // rows mapped
+      std::vector<int64_t> blockMin, blockMax; // time range of each block of INGEST_BLOCK rows
+};
+
+/** === map ===
+* Open a column file and map it, for rows rows at least
+*/
+bool FeedStore::map(Column &c, const std::string &path, size_t size, uint64_t rows) {
+	struct stat st;
+	c.size = size;
+	c.fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if ( c.fd < 0 || fstat(c.fd, &st) != 0 ) return false;
+	if ( (uint64_t)st.st_size < rows * size && ftruncate(c.fd, rows * size) != 0 ) return false;
+	c.base = (char *)mmap(0, rows * size, PROT_READ | PROT_WRITE, MAP_SHARED, c.fd, 0);
+	return c.base != MAP_FAILED;
+}
+
+/** === open ===
+* Open the store of a feed, created if needed, and rebuild the time index of its blocks
+*/
+bool FeedStore::open(const std::string &dir, unsigned long feed) {
+	std::string path = dir + "/feed-" + std::to_string(feed);
+	mkdir(path.c_str(), 0755);
+	metaFd = ::open(( path + "/meta" ).c_str(), O_RDWR | O_CREAT, 0644);
+	if ( metaFd < 0 || ftruncate(metaFd, 4096) != 0 ) return false;
+	meta = (FeedMeta *)mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, metaFd, 0);
+	if ( meta == MAP_FAILED ) return false;
+	if ( memcmp(meta->magic, INGEST_MAGIC, 8) != 0 )
+	{
+		memcpy(meta->magic, INGEST_MAGIC, 8);
+		meta->version = INGEST_VERSION;
+		meta->feed = feed;
+		meta->rows = 0;
+	}
+	else if ( meta->version != INGEST_VERSION || meta->feed != feed ) return false;
+	for (capacity = INGEST_ROWS; capacity < meta->rows; capacity *= 2) ;
+	if ( ! map(time, path + "/time", sizeof(int64_t), capacity) || ! map(stream, path + "/stream", sizeof(uint16_t), capacity)
+		|| ! map(value, path + "/value", sizeof(double), capacity) ) return false;
+	const int64_t *t = (const int64_t *)time.base;
+	for (uint64_t r = 0; r < meta->rows; r++) index(r, t[r]);
+	return true;
+}
+
+/** === close ===
+* Flush the columns and the row count to their files
+*/
+void FeedStore::close(void) {
+	Column *columns[] = { &time, &stream, &value };
+	for (Column *c : columns)
+	{
+		msync(c->base, capacity * c->size, MS_SYNC);
+		munmap(c->base, capacity * c->size);
+		::close(c->fd);
+	}
+	msync(meta, 4096, MS_SYNC);
+	munmap(meta, 4096);
+	::close(metaFd);
+}
+
+/** === grow ===
+* Double the columns until rows fit
+*/
+bool FeedStore::grow(uint64_t rows) {
+	uint64_t doubled = capacity;
+	while ( doubled < rows ) doubled *= 2;
+	Column *columns[] = { &time, &stream, &value };
+	for (Column *c : columns)
+	{
+		if ( ftruncate(c->fd, doubled * c->size) != 0 ) return false;
+		void *p = mremap(c->base, capacity * c->size, doubled * c->size, MREMAP_MAYMOVE);
+		if ( p == MAP_FAILED ) return false;
+		c->base = (char *)p;
+	}
+	capacity = doubled;
+	return true;
+}
+
+/** === index ===
+* Widen the time range of the block of a row
+*/
+void FeedStore::index(uint64_t row, int64_t ms) {
+	size_t b = row / INGEST_BLOCK;
+	if ( b == blockMin.size() )
+	{
+		blockMin.push_back(ms);
+		blockMax.push_back(ms);
+	}
+	blockMin[b] = std::min(blockMin[b], ms);
+	blockMax[b] = std::max(blockMax[b], ms);
+}
+
+/** === append ===
+* Append the points of a request, the row count last
+*/
+void FeedStore::append(const Point *points, size_t n) {
+	std::lock_guard<std::mutex> g(lock);
+	uint64_t rows = meta->rows;
+	if ( rows + n > capacity && ! grow(rows + n) ) return;
+	int64_t *t = (int64_t *)time.base;
+	uint16_t *s = (uint16_t *)stream.base;
+	double *v = (double *)value.base;
+	for (size_t i = 0; i < n; i++, rows++)
+	{
+		t[rows] = points[i].ms;
+		s[rows] = points[i].stream;
+		v[rows] = points[i].value;
+		index(rows, points[i].ms);
+	}
+	meta->rows = rows;
+}
+
+/** === query ===
+* The values of a datastream from from included to to excluded, in the order of arrival
+* @param csv: "time,value" lines appended, or 0 to count only
+* @return size_t with the number of values
+*/
+size_t FeedStore::query(unsigned int id, int64_t from, int64_t to, std::string *csv) {
+	std::lock_guard<std::mutex> g(lock);
+	const int64_t *t = (const int64_t *)time.base;
+	const uint16_t *s = (const uint16_t *)stream.base;
+	const double *v = (const double *)value.base;
+	uint64_t rows = meta->rows;
+	size_t found = 0;
+	char line[64];
+	for (size_t b = 0; b < blockMin.size(); b++)
+	{
+		if ( blockMax[b] < from || blockMin[b] >= to ) continue;
+		uint64_t last = std::min(rows, (uint64_t)( b + 1 ) * INGEST_BLOCK);
+		for (uint64_t r = (uint64_t)b * INGEST_BLOCK; r < last; r++)
+		{
+			if ( s[r] != id || t[r] < from || t[r] >= to ) continue;
+			found++;
+			if ( csv == 0 ) continue;
+			int n = isoTime(line, t[r]);
+			n += snprintf(line + n, sizeof(line) - n, ",%.2f\r\n", v[r]);
+			csv->append(line, n);
+		}
+	}
+	return found;
+}
+
+/** === getRows ===
+* @return uint64_t with the rows of the feed
+*/
+uint64_t FeedStore::getRows(void) {
+	std::lock_guard<std::mutex> g(lock);
+	return meta->rows;
+}
+
+
+/*****************************
+*
+*    feeds of the server
+*
+*****************************/
+
+class Store {
+   public:
+      Store(const std::string &dir) : dir(dir) {}
+      ~Store();
+      FeedStore *feed(unsigned long id, bool create);
+      unsigned long getFeeds(void);
+      uint64_t getRows(void);
+
+   private:
+      std::string dir;
+      std::mutex lock[INGEST_SHARDS];
+      std::unordered_map<unsigned long, FeedStore *> feeds[INGEST_SHARDS];
+};
+
+Store::~Store() {
+	for (auto &shard : feeds)
+		for (auto &f : shard)
+		{
+			f.second->close();
+			delete f.second;
+		}
+}
+
+/** === feed ===
+* The store of a feed, opened at its first request
+* @param create: false for a query, a feed never written is not created
+* @return FeedStore* or 0
+*/
+FeedStore *Store::feed(unsigned long id, bool create) {
+	unsigned int k = id % INGEST_SHARDS;
+	std::lock_guard<std::mutex> g(lock[k]);
+	auto f = feeds[k].find(id);
+	if ( f != feeds[k].end() ) return f->second;
+	struct stat st;
+	if ( ! create && stat(( dir + "/feed-" + std::to_string(id) ).c_str(), &st) != 0 ) return 0;
+	FeedStore *s = new FeedStore();
+	if ( ! s->open(dir, id) )
+	{
+		fprintf(stderr, "cannot open the store of feed %lu in %s\n", id, dir.c_str());
+		delete s;
+		return 0;
+	}
+	feeds[k][id] = s;
+	return s;
+}
+
+/** === getFeeds ===
+* @return unsigned long with the feeds open
+*/
+unsigned long Store::getFeeds(void) {
+	unsigned long n = 0;
+	for (int k = 0; k < INGEST_SHARDS; k++)
+	{
+		std::lock_guard<std::mutex> g(lock[k]);
+		n += feeds[k].size();
+	}
+	return n;
+}
+
+/** === getRows ===
+* @return uint64_t with the rows of the feeds open
+*/
+uint64_t Store::getRows(void) {
+	uint64_t n = 0;
+	for (int k = 0; k < INGEST_SHARDS; k++)
+	{
+		std::lock_guard<std::mutex> g(lock[k]);
+		for (auto &f : feeds[k]) n += f.second->getRows();
+	}
+	return n;
+}
+
+
+/*****************************
+*
+*      request parsing
+*
+*****************************/
+
+struct Request {
+	bool put;                  // PUT, or GET
+	const char *path, *pathEnd; // after the host of an absolute URI
+	const char *body, *end;
+};
+
+/** === header ===
+* @return const char* to the value of a header, case insensitive, or 0
+*/
+static const char *header(const char *head, const char *headEnd, const char *name) {
+	size_t n = strlen(name);
+	for (const char *p = head; p + n < headEnd; p++)
+		if ( p[-1] == '\n' && strncasecmp(p, name, n) == 0 && p[n] == ':' ) return p + n + 1;
+	return 0;
+}
+
+/** === receive ===
+* Read a whole request: the headers, then Content-Length bytes of body
+* @return int with the bytes read, 0 if the connection closed early, -1 if it does not fit
+*/
+static int receive(int c, char *buf, int size, Request &r) {
+	int got = 0;
+	const char *headEnd = 0;
+	long length = -1;
+	for (;;)
+	{
+		ssize_t n = recv(c, buf + got, size - 1 - got, 0);
+		if ( n <= 0 && ( headEnd == 0 || length >= 0 ) ) return 0;
+		if ( n <= 0 ) // no Content-Length: the body ends at close
+		{
+			r.end = buf + got;
+			return got;
+		}
+		got += n;
+		buf[got] = 0;
+		if ( headEnd == 0 && ( headEnd = strstr(buf, "\r\n\r\n") ) != 0 )
+		{
+			const char *cl = header(buf, headEnd + 2, "content-length");
+			length = cl ? atol(cl) : ( strncmp(buf, "GET ", 4) == 0 ? 0 : -1 );
+			r.body = headEnd + 4;
+		}
+		if ( headEnd != 0 && length >= 0 && buf + got >= r.body + length )
+		{
+			r.end = r.body + length;
+			return got;
+		}
+		if ( got == size - 1 ) return -1;
+	}
+}
+
+/** === parseLine ===
+* The request line: method, and the path without the scheme and host of an absolute URI
+*/
+static bool parseLine(const char *buf, Request &r) {
+	const char *p;
+	if ( strncmp(buf, "PUT ", 4) == 0 ) { r.put = true; p = buf + 4; }
+	else if ( strncmp(buf, "GET ", 4) == 0 ) { r.put = false; p = buf + 4; }
+	else return false;
+	if ( strncmp(p, "http://", 7) == 0 )
+	{
+		p = strchr(p + 7, '/');
+		if ( p == 0 ) return false;
+	}
+	r.path = p;
+	r.pathEnd = p + strcspn(p, " \r\n");
+	return true;
+}
+
+/** === parseCsv ===
+* The lines of the Stash of a Nanode, "id,value" or "id,time,value"
+* @param now: time of the values without time stamp
+* @return unsigned int with the lines that do not parse
+*/
+static unsigned int parseCsv(const char *p, const char *end, int64_t now, std::vector<Point> &out) {
+	unsigned int bad = 0;
+	while ( p < end )
+	{
+		const char *eol = (const char *)memchr(p, '\n', end - p);
+		const char *next = eol ? eol + 1 : end;
+		if ( eol == 0 ) eol = end;
+		if ( eol > p && eol[-1] == '\r' ) eol--;
+		if ( eol == p ) { p = next; continue; }
+		Point pt;
+		double id;
+		pt.ms = now;
+		bool ok = parseNumber(p, eol, id) && id >= 0 && id < 65536 && id == (int)id && p < eol && *p++ == ',';
+		if ( ok && eol - p > 4 && p[4] == '-' ) ok = parseIso(p, eol, pt.ms) && p < eol && *p++ == ',';
+		ok = ok && parseNumber(p, eol, pt.value) && p == eol;
+		if ( ok )
+		{
+			pt.stream = (uint16_t)id;
+			out.push_back(pt);
+		}
+		else bad++;
+		p = next;
+	}
+	return bad;
+}
+
+/** === le ===
+* @return uint32_t with a little endian value of a frame
+*/
+static uint32_t le(const unsigned char *p, int bytes) {
+	uint32_t v = 0;
+	for (int i = bytes; i > 0; i--) v = v << 8 | p[i - 1];
+	return v;
+}
+
+/** === parseFrames ===
+* The record frames of GridLog::record(), resynchronised on LOG_SYNC after a bad checksum
+* as host/logdecode.cpp does
+* @return unsigned int with the frames with a bad checksum or cut
+*/
+static unsigned int parseFrames(const unsigned char *p, const unsigned char *end, std::vector<Point> &out) {
+	unsigned int bad = 0;
+	while ( p < end )
+	{
+		if ( *p != LOG_SYNC ) { p++; continue; }
+		if ( end - p < 4 || end - p < 4 + p[2] ) { bad++; break; }
+		unsigned char tag = p[1], length = p[2], sum = tag + length;
+		for (int k = 0; k < length; k++) sum += p[3 + k];
+		if ( sum != p[3 + length] ) { bad++; p++; continue; }
+		if ( tag == LOG_FRAME_RECORD && length == LOG_RECORD_BYTES )
+		{
+			const unsigned char *f = p + 3;
+			int64_t ms = (int64_t)le(f, 4) * 1000 + le(f + 4, 2);
+			unsigned int base = f[37] * 100 + INGEST_RAW;
+			double raw[] = { (double)le(f + 6, 4), (double)le(f + 10, 4), (double)le(f + 14, 4), (double)le(f + 18, 4),
+				(double)(int32_t)le(f + 22, 4), (double)le(f + 26, 4), (double)(int32_t)le(f + 30, 4),
+				(double)le(f + 34, 2), (double)(int8_t)f[36] };
+			for (unsigned int i = 0; i < sizeof(raw) / sizeof(raw[0]); i++)
+			{
+				Point pt = { ms, (uint16_t)( base + i ), raw[i] };
+				out.push_back(pt);
+			}
+			stats.frames++;
+		}
+		p += 4 + length;
+	}
+	return bad;
+}
+
+/** === param ===
+* @return const char* to the value of a query parameter, its end in end, or 0
+*/
+static const char *param(const char *query, const char *queryEnd, const char *name, const char *&end) {
+	size_t n = strlen(name);
+	for (const char *p = query; p + n < queryEnd; p++)
+	{
+		if ( ( p[-1] == '?' || p[-1] == '&' ) && strncmp(p, name, n) == 0 && p[n] == '=' )
+		{
+			end = p + n + 1;
+			while ( end < queryEnd && *end != '&' ) end++;
+			return p + n + 1;
+		}
+	}
+	return 0;
+}
+
+
+/*****************************
+*
+*          server
+*
+*****************************/
+
+/** === reply ===
+* Send a status line with a body, then the connection is closed by the caller
+*/
+static void reply(int c, const char *status, const char *type, const std::string &body) {
+	char head[160];
+	int n = snprintf(head, sizeof(head), "HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n\r\n", status, type,
+		(unsigned int)body.size());
+	std::string out(head, n);
+	out += body;
+	for (size_t sent = 0; sent < out.size(); )
+	{
+		ssize_t k = send(c, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+		if ( k <= 0 ) break;
+		sent += k;
+	}
+}
+
+/** === statsJson ===
+* @return std::string with the counters of the server
+*/
+static std::string statsJson(Store &store) {
+	char s[512];
+	snprintf(s, sizeof(s), "{\"requests\":%lu,\"points\":%lu,\"frames\":%lu,\"bad_lines\":%lu,\"bad_frames\":%lu,"
+		"\"queries\":%lu,\"rejected\":%lu,\"feeds\":%lu,\"rows\":%llu}\r\n", stats.requests.load(), stats.points.load(),
+		stats.frames.load(), stats.badLines.load(), stats.badFrames.load(), stats.queries.load(), stats.rejected.load(),
+		store.getFeeds(), (unsigned long long)store.getRows());
+	return s;
+}
+
+/** === handle ===
+* One request of a connection
+*/
+static void handle(int c, Store &store, std::vector<Point> &points) {
+	char buf[INGEST_REQUEST];
+	Request r = { false, 0, 0, 0, 0 };
+	int got = receive(c, buf, sizeof(buf), r);
+	stats.requests++;
+	if ( got == 0 ) return;
+	if ( got < 0 ) { stats.rejected++; reply(c, "413 Request Entity Too Large", "text/plain", ""); return; }
+	if ( ! parseLine(buf, r) ) { stats.rejected++; reply(c, "400 Bad Request", "text/plain", ""); return; }
+
+	const char *query = (const char *)memchr(r.path, '?', r.pathEnd - r.path);
+	const char *pathEnd = query ? query : r.pathEnd;
+	if ( ! r.put && pathEnd - r.path == 6 && strncmp(r.path, "/stats", 6) == 0 )
+	{
+		reply(c, "200 OK", "application/json", statsJson(store));
+		return;
+	}
+	const char *p = r.path;
+	double feed;
+	bool csv = pathEnd - p > 14 && strncmp(pathEnd - 4, ".csv", 4) == 0;
+	bool bin = pathEnd - p > 14 && strncmp(pathEnd - 4, ".bin", 4) == 0;
+	if ( strncmp(p, "/v2/feeds/", 10) != 0 || ! ( csv || ( bin && r.put ) ) ) { stats.rejected++; reply(c, "404 Not Found", "text/plain", ""); return; }
+	p += 10;
+	if ( ! parseNumber(p, pathEnd - 4, feed) || p != pathEnd - 4 || feed < 0 || feed != (unsigned long)feed )
+	{
+		stats.rejected++;
+		reply(c, "404 Not Found", "text/plain", "");
+		return;
+	}
+
+	if ( r.put )
+	{
+		points.clear();
+		if ( csv ) stats.badLines += parseCsv(r.body, r.end, nowMs(), points);
+		else stats.badFrames += parseFrames((const unsigned char *)r.body, (const unsigned char *)r.end, points);
+		FeedStore *f = points.empty() ? 0 : store.feed((unsigned long)feed, true);
+		if ( f == 0 ) { stats.rejected++; reply(c, "400 Bad Request", "text/plain", ""); return; }
+		f->append(points.data(), points.size());
+		stats.points += points.size();
+		reply(c, "200 OK", "text/plain", "");
+		return;
+	}
+
+	// GET /v2/feeds/<feed>.csv?stream=..&start=..&end=..
+	const char *v, *vEnd;
+	double id = -1;
+	int64_t from = INT64_MIN, to = INT64_MAX;
+	bool ok = query != 0 && ( v = param(query, r.pathEnd, "stream", vEnd) ) != 0 && parseNumber(v, vEnd, id) && v == vEnd;
+	if ( ok && ( v = param(query, r.pathEnd, "start", vEnd) ) != 0 ) ok = parseTime(v, vEnd, from);
+	if ( ok && ( v = param(query, r.pathEnd, "end", vEnd) ) != 0 ) ok = parseTime(v, vEnd, to);
+	if ( ! ok || id < 0 || id >= 65536 ) { stats.rejected++; reply(c, "400 Bad Request", "text/plain", ""); return; }
+	FeedStore *f = store.feed((unsigned long)feed, false);
+	if ( f == 0 ) { stats.rejected++; reply(c, "404 Not Found", "text/plain", ""); return; }
+	std::string body;
+	f->query((unsigned int)id, from, to, &body);
+	stats.queries++;
+	reply(c, "200 OK", "text/csv", body);
+}
+
+/** === worker ===
+* Accept and answer connections until the listening socket is shut down
+*/
+static void worker(int listener, Store *store) {
+	std::vector<Point> points;
+	for (;;)
+	{
+		int c = accept(listener, 0, 0);
+		if ( c < 0 )
+		{
+			if ( errno == EINTR || errno == ECONNABORTED ) continue;
+			return;
+		}
+		timeval tv = { INGEST_TIMEOUT / 1000, ( INGEST_TIMEOUT % 1000 ) * 1000 };
+		setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		setsockopt(c, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+		handle(c, *store, points);
+		close(c);
+	}
+}
+
+/** === listenOn ===
+* @return int with a listening socket, port 0 for any free port of 127.0.0.1
+*/
+static int listenOn(int port, sockaddr_in &at) {
+	int one = 1;
+	socklen_t len = sizeof(at);
+	int s = socket(AF_INET, SOCK_STREAM, 0);
+	memset(&at, 0, sizeof(at));
+	at.sin_family = AF_INET;
+	at.sin_addr.s_addr = htonl(port == 0 ? INADDR_LOOPBACK : INADDR_ANY);
+	at.sin_port = htons(port);
+	setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if ( bind(s, (const sockaddr *)&at, sizeof(at)) != 0 || listen(s, INGEST_BACKLOG) != 0 ) return -1;
+	getsockname(s, (sockaddr *)&at, &len);
+	if ( port == 0 ) at.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return s;
+}
+
+
+/*****************************
+*
+*      simulated fleet
+*
+*****************************/
+
+struct Exchange {
+	int status;                // of the status line, 0 if none
+	double ms;                 // from connect() to the end of the answer
+	std::string body;
+};
+
+/** === exchange ===
+* One request on a connection of its own, as the Nanode sends it
+*/
+static Exchange exchange(const sockaddr_in &to, const std::string &request) {
+	Exchange e = { 0, 0, std::string() };
+	auto t0 = std::chrono::steady_clock::now();
+	int s = socket(AF_INET, SOCK_STREAM, 0);
+	timeval tv = { INGEST_TIMEOUT / 1000, ( INGEST_TIMEOUT % 1000 ) * 1000 };
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	if ( connect(s, (const sockaddr *)&to, sizeof(to)) == 0 && send(s, request.data(), request.size(), MSG_NOSIGNAL) == (ssize_t)request.size() )
+	{
+		char chunk[4096];
+		ssize_t got;
+		while ( ( got = recv(s, chunk, sizeof(chunk), 0) ) > 0 ) e.body.append(chunk, got);
+	}
+	close(s);
+	e.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	if ( e.body.compare(0, 7, "HTTP/1.") == 0 && e.body.size() > 12 ) e.status = atoi(e.body.c_str() + 9);
+	size_t b = e.body.find("\r\n\r\n");
+	e.body = b == std::string::npos ? std::string() : e.body.substr(b + 4);
+	return e;
+}
+
+/** === stamped ===
+* The start of a datastream line with a time stamp, as stashDatastream() prints it
+*/
+static void stamped(std::string &out, unsigned int id, int64_t ms) {
+	char t[40];
+	isoTime(t, ms);
+	out += std::to_string(id) + "," + t + ",";
+}
+
+/** === fleetCsv ===
+* The request of update u of node n, meter 0, as sendRecord() prints it: 9 measurements time
+* stamped at CYCEND, then the health of the Nanode
+* @return unsigned int with the values of the body
+*/
+static unsigned int fleetCsv(std::string &out, unsigned int n, unsigned int u) {
+	static const char *measures[] = { "230.12", "5.03", "325.40", "7.11", "1157.42", "1166.67", "-12.50", "34", "50.01" };
+	std::string body;
+	char line[64];
+	int64_t ms = ( FLEET_UTC + u * 10 ) * 1000 + n % 1000;
+	for (unsigned int i = 0; i < 9; i++)
+	{
+		stamped(body, i, ms);
+		body += measures[i];
+		body += "\r\n";
+	}
+	unsigned int health[][2] = { { 9, 3 }, { 10, u + 1 }, { 11, n % 7 }, { 12, n % 3 }, { 13, 420 }, { 14, 0 },
+		{ 15, 0 }, { 16, 0 }, { 18, 312 }, { 19, 100 } };
+	for (auto &h : health)
+	{
+		snprintf(line, sizeof(line), "%u,%u\r\n", h[0], h[1]);
+		body += line;
+	}
+	snprintf(line, sizeof(line), "%u", FLEET_FEED + n);
+	out = std::string("PUT http://ingest.local/v2/feeds/") + line + ".csv HTTP/1.0\r\nHost: ingest.local\r\n"
+		"X-PachubeApiKey: k\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+	return 9 + sizeof(health) / sizeof(health[0]);
+}
+
+/** === frame ===
+* A record frame of GridLog::record()
+*/
+static void frame(std::string &out, int64_t sec, unsigned int ms, unsigned char meter) {
+	unsigned char f[LOG_RECORD_BYTES + 4];
+	uint32_t fields[] = { (uint32_t)sec, ms, 662316, 291, 8123, 300, (uint32_t)-238, 1234, 12, 4000, (uint32_t)-13, meter };
+	int widths[] = { 4, 2, 4, 4, 4, 4, 4, 4, 4, 2, 1, 1 };
+	unsigned char sum = LOG_FRAME_RECORD + LOG_RECORD_BYTES;
+	int k = 3;
+	f[0] = LOG_SYNC; f[1] = LOG_FRAME_RECORD; f[2] = LOG_RECORD_BYTES;
+	for (int i = 0; i < 12; i++)
+		for (int b = 0; b < widths[i]; b++, k++) sum += f[k] = (unsigned char)( fields[i] >> ( 8 * b ) );
+	f[k] = sum;
+	out.append((const char *)f, sizeof(f));
+}
+
+/** === fleetBin ===
+* A request of the record frames of the meters of node n
+* @return unsigned int with the values of the body
+*/
+static unsigned int fleetBin(std::string &out, unsigned int n, unsigned int u) {
+	std::string body;
+	unsigned char meters = 1 + n % 3;
+	for (unsigned char m = 0; m < meters; m++) frame(body, FLEET_UTC + u * 10, n % 1000, m);
+	out = "PUT /v2/feeds/" + std::to_string(FLEET_FEED + n) + ".bin HTTP/1.0\r\nContent-Length: "
+		+ std::to_string(body.size()) + "\r\n\r\n" + body;
+	return meters * 9;
+}
+
+/** === binaryUpdate ===
+* @return bool true if update u of node n sends record frames
+*/
+static bool binaryUpdate(unsigned int n, unsigned int u) {
+	return ( n + u ) % FLEET_BINARY == 0;
+}
+
+/** === lines ===
+* @return size_t with the lines of a CSV answer
+*/
+static size_t lines(const std::string &body) {
+	return std::count(body.begin(), body.end(), '\n');
+}
+
+/** === check ===
+* Range queries of a sample of the feeds, a malformed request, and the counts of the store
+*/
+static bool check(const sockaddr_in &to, unsigned int nodes, unsigned int updates, unsigned long sent) {
+	bool ok = true;
+	for (unsigned int i = 0; i < FLEET_SAMPLE && i < nodes; i++)
+	{
+		unsigned int n = i * nodes / FLEET_SAMPLE, csv = 0, bin = 0;
+		for (unsigned int u = 0; u < updates; u++) ( binaryUpdate(n, u) ? bin : csv )++;
+		std::string feed = "/v2/feeds/" + std::to_string(FLEET_FEED + n) + ".csv?stream=";
+		char range[96];
+		char t0[40];
+		isoTime(t0, ( FLEET_UTC + 10 ) * 1000);
+		snprintf(range, sizeof(range), "&start=%s&end=%lld", t0, FLEET_UTC + 30);
+		unsigned int inRange = 0;
+		for (unsigned int u = 1; u < 3 && u < updates; u++) inRange += ! binaryUpdate(n, u);
+		Exchange all = exchange(to, "GET " + feed + "0 HTTP/1.0\r\n\r\n");
+		Exchange part = exchange(to, "GET " + feed + "4" + range + " HTTP/1.0\r\n\r\n");
+		Exchange health = exchange(to, "GET " + feed + "10 HTTP/1.0\r\n\r\n");
+		Exchange raw = exchange(to, "GET " + feed + std::to_string(INGEST_RAW) + " HTTP/1.0\r\n\r\n");
+		ok = ok && all.status == 200 && lines(all.body) == csv && part.status == 200 && lines(part.body) == inRange
+			&& health.status == 200 && lines(health.body) == csv && raw.status == 200 && lines(raw.body) == bin;
+		if ( csv > 0 && all.body.compare(0, 24, "2026-10-05T") != 0 && all.body.find(",230.12\r\n") == std::string::npos ) ok = false;
+		if ( ! ok ) { fprintf(stderr, "queries of feed %u not as expected:\n%s\n", FLEET_FEED + n, all.body.c_str()); break; }
+	}
+	Exchange garbage = exchange(to, "PUT /v2/feeds/1.csv HTTP/1.0\r\nContent-Length: 9\r\n\r\n0,nan\r\nx\n");
+	Exchange unknown = exchange(to, "GET /v1/anything HTTP/1.0\r\n\r\n");
+	Exchange none = exchange(to, "GET /v2/feeds/2.csv?stream=0 HTTP/1.0\r\n\r\n");
+	Exchange mixed = exchange(to, "PUT /v2/feeds/3.csv HTTP/1.0\r\nContent-Length: 21\r\n\r\n4,1.5\r\nbad\r\n5,-2.25\r\n");
+	Exchange st = exchange(to, "GET /stats HTTP/1.0\r\n\r\n");
+	ok = ok && garbage.status == 400 && unknown.status == 404 && none.status == 404 && mixed.status == 200;
+	ok = ok && st.status == 200 && st.body.find("\"points\":" + std::to_string(sent + 2) + ",") != std::string::npos;
+	if ( ! ok ) fprintf(stderr, "malformed requests or stats not as expected: %d %d %d %d\n%s\n", garbage.status,
+		unknown.status, none.status, mixed.status, st.body.c_str());
+	return ok;
+}
+
+/** === removeStore ===
+* Remove the temporary store of -l
+*/
+static void removeStore(const std::string &dir) {
+	DIR *d = opendir(dir.c_str());
+	if ( d == 0 ) return;
+	for (dirent *e; ( e = readdir(d) ) != 0; )
+	{
+		std::string name = e->d_name;
+		if ( name == "." || name == ".." ) continue;
+		std::string path = dir + "/" + name;
+		const char *files[] = { "meta", "time", "stream", "value" };
+		for (const char *f : files) unlink(( path + "/" + f ).c_str());
+		rmdir(path.c_str());
+	}
+	closedir(d);
+	rmdir(dir.c_str());
+}
+
+/** === fleet ===
+* Serve on 127.0.0.1 and send the requests of a simulated fleet
+*/
+static int fleet(unsigned int nodes, unsigned int updates, unsigned int clients, unsigned int threads, std::string dir) {
+	bool temporary = dir.empty();
+	if ( temporary )
+	{
+		char tmpl[] = "/tmp/ingestXXXXXX";
+		if ( mkdtemp(tmpl) == 0 ) { perror("mkdtemp"); return 2; }
+		dir = tmpl;
+	}
+	sockaddr_in to;
+	int listener = listenOn(0, to);
+	if ( listener < 0 ) { perror("listen"); return 2; }
+	Store *store = new Store(dir);
+	std::vector<std::thread> workers;
+	for (unsigned int t = 0; t < threads; t++) workers.push_back(std::thread(worker, listener, store));
+
+	unsigned long requests = (unsigned long)nodes * updates;
+	std::vector<double> ms(requests);
+	std::atomic<unsigned long> ok(0), values(0), bytes(0);
+	std::vector<std::thread> senders;
+	auto t0 = std::chrono::steady_clock::now();
+	for (unsigned int c = 0; c < clients; c++)
+	{
+		senders.push_back(std::thread([&, c]() {
+			std::string request;
+			for (unsigned int u = 0; u < updates; u++)
+				for (unsigned int n = c; n < nodes; n += clients)
+				{
+					unsigned int v = binaryUpdate(n, u) ? fleetBin(request, n, u) : fleetCsv(request, n, u);
+					Exchange e = exchange(to, request);
+					ms[(unsigned long)u * nodes + n] = e.ms;
+					bytes += request.size();
+					if ( e.status == 200 ) { ok++; values += v; }
+				}
+		}));
+	}
+	for (auto &t : senders) t.join();
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+	bool checked = ok == requests && stats.points == values && check(to, nodes, updates, values);
+	shutdown(listener, SHUT_RDWR);
+	close(listener);
+	for (auto &t : workers) t.join();
+	uint64_t rows = store->getRows();
+	unsigned long feeds = store->getFeeds();
+	delete store;
+
+	Store reopened(dir); // the rows are read back from the files
+	uint64_t again = 0;
+	for (unsigned int n = 0; n < nodes; n++)
+	{
+		FeedStore *f = reopened.feed(FLEET_FEED + n, false);
+		if ( f ) again += f->getRows();
+	}
+	FeedStore *mixed = reopened.feed(3, false);
+	checked = checked && rows == values + 2 && again == values && mixed != 0 && mixed->getRows() == 2
+		&& reopened.feed(1, false) == 0;
+	if ( again != values ) fprintf(stderr, "%llu rows read back, %lu values sent\n", (unsigned long long)again, values.load());
+
+	std::sort(ms.begin(), ms.end());
+	double sum = 0;
+	for (double x : ms) sum += x;
+	printf("{\n  \"nodes\": %u, \"updates\": %u, \"clients\": %u, \"threads\": %u, \"feeds\": %lu,\n", nodes, updates,
+		clients, threads, feeds);
+	printf("  \"requests\": %lu, \"ok\": %lu, \"frames\": %lu, \"points\": %lu, \"bytes\": %lu,\n", requests, ok.load(),
+		stats.frames.load(), values.load(), bytes.load());
+	printf("  \"requests_per_s\": %.0f, \"points_per_s\": %.0f,\n", ok / wall, values / wall);
+	printf("  \"latency_ms\": {\"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n", sum / ms.size(),
+		ms[ms.size() / 2], ms[ms.size() * 99 / 100], ms.back());
+	printf("  \"check\": %s\n}\n", checked ? "true" : "false");
+	if ( temporary ) removeStore(dir);
+	return checked ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+	unsigned int nodes = FLEET_NODES, updates = FLEET_UPDATES, clients = FLEET_CLIENTS, threads = INGEST_THREADS;
+	int port = INGEST_PORT;
+	std::string dir;
+	bool local = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if ( strcmp(argv[i], "-p") == 0 && i + 1 < argc ) port = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-t") == 0 && i + 1 < argc ) threads = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-d") == 0 && i + 1 < argc ) dir = argv[++i];
+		else if ( strcmp(argv[i], "-n") == 0 && i + 1 < argc ) nodes = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-u") == 0 && i + 1 < argc ) updates = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-c") == 0 && i + 1 < argc ) clients = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-l") == 0 ) local = true;
+		else
+		{
+			fprintf(stderr, "usage: ingest [-p port] [-t threads] [-d dir]\n"
+			                "       ingest -l [-n nodes] [-u updates] [-c clients] [-t threads] [-d dir]\n");
+			return 2;
+		}
+	}
+	if ( threads == 0 || clients == 0 || nodes == 0 || updates == 0 ) return 2;
+	if ( local ) return fleet(nodes, updates, clients, threads, dir);
+
+	if ( dir.empty() ) dir = ".";
+	sockaddr_in at;
+	int listener = listenOn(port, at);
+	if ( listener < 0 ) { perror("listen"); return 2; }
+	Store store(dir);
+	fprintf(stderr, "ingest on port %d, %u threads, store in %s\n", port, threads, dir.c_str());
+	std::vector<std::thread> workers;
+	for (unsigned int t = 0; t < threads; t++) workers.push_back(std::thread(worker, listener, &store));
+	for (auto &t : workers) t.join();
+	return 0;
+}
@@ -0,0 +1,259 @@
+/* logdecode.cpp = Decoder of the binary log frames of ArduGrid7753
+=================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+With GRIDLOG_BINARY (see GridLog.h), the Nanode sends the raw registers of each record as
+a binary frame among the text of its log. Capture the Serial port to a file, then:
+
+	logdecode [-c] [capture]
+
+prints the capture on stdout, the text as it is and each record frame as a line of
+decimal values:
+
+	--> record 0 utc 1791234567.123 V 662316 I 291 Vp 8123 Ip 300 P -238 S 1234 Q 12 PER 4000 T -13
+
+With -c, only the records are printed, as CSV with a header line. The capture is read from
+stdin when no file is given. A frame with a bad checksum (a byte lost on the line) is
+counted and skipped from its LOG_SYNC byte on, the bytes after it are decoded again as
+text or frames. The counts of frames, bad frames and text bytes go to stderr.
+
+With -l, GridLog is run on the PC (built with GRIDLOG_BINARY, its output to a temporary
+file through host/HostSim.cpp), with records of random values between lines of text and
+one corrupted frame, the file is decoded and each record is compared with the one logged.
+The JSON on stdout gives the size of a frame and its time on the line at 115200 baud.
+
+	logdecode [-c] [capture]
+	logdecode -l [-n records]
+
+Build from the sketch folder:
+
+	g++ -O2 -DARDUINO=100 -DGRIDLOG_BINARY -Ihost/mock -Ihost -I. host/logdecode.cpp \
+	    host/HostSim.cpp GridLog.cpp -o host/logdecode
+	host/logdecode -l && host/logdecode serial.log > log.txt
+
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include "HostSim.h"
+#include "GridLog.h"
+
+#define DECODE_RECORDS   1000
+#define DECODE_BAUD      115200
+#define DECODE_FRAME     ( LOG_RECORD_BYTES + 4 )   // sync, tag, length, payload, checksum
+
+struct Decoded {
+	std::vector<GridRecord> records;
+	std::string text;          // bytes outside the frames
+	unsigned long frames;      // with a good checksum
+	unsigned long bad;         // with a bad checksum, or cut at the end of the capture
+};
+
+/** === le ===
+* @return unsigned long with a little endian value of a frame
+*/
+static unsigned long le(const byte *p, byte bytes) {
+	unsigned long v = 0;
+	for (byte i = bytes; i > 0; i--) v = v << 8 | p[i - 1];
+	return v;
+}
+
+/** === unpack ===
+* The GridRecord of the payload of a LOG_FRAME_RECORD frame, see GridLog::record()
+*/
+static GridRecord unpack(const byte *p) {
+	GridRecord rec;
+	rec.utcSec = le(p, 4);
+	rec.utcMs = le(p + 4, 2);
+	rec.vrms = (int32_t)le(p + 6, 4);
+	rec.irms = (int32_t)le(p + 10, 4);
+	rec.vpeak = (int32_t)le(p + 14, 4);
+	rec.ipeak = (int32_t)le(p + 18, 4);
+	rec.activeEnergy = (int32_t)le(p + 22, 4);
+	rec.apparentEnergy = (int32_t)le(p + 26, 4);
+	rec.reactiveEnergy = (int32_t)le(p + 30, 4);
+	rec.period = (uint16_t)le(p + 34, 2);
+	rec.temp = (int8_t)p[36];
+	rec.meter = p[37];
+	return rec;
+}
+
+/** === print ===
+* A record as a line of decimal values, or as CSV
+*/
+static void print(const GridRecord &r, bool csv) {
+	if ( csv ) printf("%u,%lu.%03u,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%u,%d\n", r.meter, (unsigned long)r.utcSec, r.utcMs,
+		(long)r.vrms, (long)r.irms, (long)r.vpeak, (long)r.ipeak, (long)r.activeEnergy, (long)r.apparentEnergy,
+		(long)r.reactiveEnergy, (unsigned int)(uint16_t)r.period, r.temp);
+	else printf("--> record %u utc %lu.%03u V %ld I %ld Vp %ld Ip %ld P %ld S %ld Q %ld PER %u T %d\n", r.meter,
+		(unsigned long)r.utcSec, r.utcMs, (long)r.vrms, (long)r.irms, (long)r.vpeak, (long)r.ipeak,
+		(long)r.activeEnergy, (long)r.apparentEnergy, (long)r.reactiveEnergy, (unsigned int)(uint16_t)r.period, r.temp);
+}
+
+/** === decode ===
+* Split a capture into its text and its record frames
+* @param show: print the text and the records on stdout, in the order of the capture
+* @param csv: print the records only, as CSV
+*/
+static Decoded decode(const std::vector<byte> &in, bool show, bool csv) {
+	Decoded d;
+	d.frames = d.bad = 0;
+	size_t i = 0;
+	while ( i < in.size() )
+	{
+		if ( in[i] != LOG_SYNC )
+		{
+			if ( show && ! csv ) putchar(in[i]);
+			d.text += (char)in[i++];
+			continue;
+		}
+		if ( i + 3 > in.size() || i + 4 + in[i + 2] > in.size() )
+		{
+			d.bad++; // cut at the end of the capture
+			break;
+		}
+		byte tag = in[i + 1], length = in[i + 2], sum = tag + length;
+		for (byte k = 0; k < length; k++) sum += in[i + 3 + k];
+		if ( sum != in[i + 3 + length] )
+		{
+			d.bad++;
+			i++; // resynchronise on the next LOG_SYNC
+			continue;
+		}
+		if ( tag == LOG_FRAME_RECORD && length == LOG_RECORD_BYTES )
+		{
+			d.records.push_back(unpack(&in[i + 3]));
+			if ( show ) print(d.records.back(), csv);
+		}
+		d.frames++;
+		i += 4 + length;
+	}
+	return d;
+}
+
+/** === same ===
+* @return bool true if two records hold the same values
+*/
+static bool same(const GridRecord &a, const GridRecord &b) {
+	return a.utcSec == b.utcSec && a.utcMs == b.utcMs && a.vrms == b.vrms && a.irms == b.irms
+		&& a.vpeak == b.vpeak && a.ipeak == b.ipeak && a.activeEnergy == b.activeEnergy
+		&& a.apparentEnergy == b.apparentEnergy && a.reactiveEnergy == b.reactiveEnergy
+		&& a.period == b.period && a.temp == b.temp && a.meter == b.meter;
+}
+
+/** === signed24 ===
+* @return long with a random 24-bit signed register value
+*/
+static long signed24(void) {
+	return (long)( rand() & 0xFFFFFF ) - 0x800000;
+}
+
+/** === local ===
+* Log records and text through GridLog into a temporary file, decode it and compare
+*/
+static int local(unsigned int n) {
+	FILE *f = tmpfile();
+	if ( f == 0 ) { perror("tmpfile"); return 2; }
+	simSerialFile(f);
+	gridLog.begin(DECODE_BAUD);
+	srand(7753);
+	std::vector<GridRecord> logged;
+	std::string text;
+	for (unsigned int i = 0; i < n; i++)
+	{
+		GridRecord rec;
+		rec.utcSec = 1791234567UL + i * 10;
+		rec.utcMs = rand() % 1000;
+		rec.vrms = rand() & 0xFFFFFF;
+		rec.irms = rand() & 0xFFFFFF;
+		rec.vpeak = rand() & 0xFFFFFF;
+		rec.ipeak = rand() & 0xFFFFFF;
+		rec.activeEnergy = signed24();
+		rec.apparentEnergy = rand() & 0xFFFFFF;
+		rec.reactiveEnergy = signed24();
+		rec.period = rand() & 0xFFFF;
+		rec.temp = (char)( rand() % 256 - 128 );
+		rec.meter = i % 3;
+		if ( i % 4 == 0 )
+		{
+			gridLog.text(PSTR("-> buffered "));
+			gridLog.println(i);
+			char t[32];
+			snprintf(t, sizeof(t), "-> buffered %u\r\n", i);
+			text += t;
+		}
+		gridLog.record(rec);
+		logged.push_back(rec);
+		if ( i == n / 2 )
+		{   // a frame with a byte lost on the line: skipped, the next one decoded
+			byte cut[] = { LOG_SYNC, LOG_FRAME_RECORD, LOG_RECORD_BYTES, 1, 2, 3 };
+			for (byte k = 0; k < sizeof(cut); k++) gridLog.write(cut[k]);
+			text += (char)LOG_FRAME_RECORD; // its tag and length come out as text
+			text += (char)LOG_RECORD_BYTES;
+		}
+	}
+	fflush(f);
+	std::vector<byte> in;
+	rewind(f);
+	for (int c; ( c = fgetc(f) ) != EOF; ) in.push_back((byte)c);
+	fclose(f);
+	simSerialFile(0);
+
+	Decoded d = decode(in, false, false);
+	bool ok = d.records.size() == logged.size() && d.bad >= 1;
+	for (size_t i = 0; ok && i < logged.size(); i++) ok = same(d.records[i], logged[i]);
+	std::string seen;
+	for (size_t i = 0; i < d.text.size(); i++)
+		if ( d.text[i] >= ' ' || d.text[i] == '\r' || d.text[i] == '\n' ) seen += d.text[i]; // without the payload of the cut frame
+	ok = ok && seen == text;
+	if ( ! ok ) fprintf(stderr, "decoded records or text not as logged\n");
+
+	printf("{\n  \"records\": %u, \"decoded\": %u, \"bad_frames\": %lu, \"capture_bytes\": %u,\n",
+		n, (unsigned int)d.records.size(), d.bad, (unsigned int)in.size());
+	printf("  \"frame_bytes\": %u, \"frame_line_us\": %.0f, \"dropped\": %u,\n", DECODE_FRAME,
+		DECODE_FRAME * 10 * 1e6 / DECODE_BAUD, gridLog.getDropped());
+	printf("  \"decode_ok\": %s\n}\n", ok ? "true" : "false");
+	return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+	unsigned int n = DECODE_RECORDS;
+	bool csv = false, test = false;
+	const char *path = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if ( strcmp(argv[i], "-n") == 0 && i + 1 < argc ) n = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-c") == 0 ) csv = true;
+		else if ( strcmp(argv[i], "-l") == 0 ) test = true;
+		else if ( path == 0 && argv[i][0] != '-' ) path = argv[i];
+		else
+		{
+			fprintf(stderr, "usage: logdecode [-c] [capture]\n"
+			                "       logdecode -l [-n records]\n");
+			return 2;
+		}
+	}
+	if ( test ) return local(n == 0 ? 1 : n);
+
+	FILE *f = path ? fopen(path, "rb") : stdin;
+	if ( f == 0 ) { perror(path); return 2; }
+	std::vector<byte> in;
+	for (int c; ( c = fgetc(f) ) != EOF; ) in.push_back((byte)c);
+	if ( path ) fclose(f);
+
+	if ( csv ) printf("meter,utc,vrms,irms,vpeak,ipeak,active,apparent,reactive,period,temp\n");
+	Decoded d = decode(in, true, csv);
+	fprintf(stderr, "frames %lu, bad frames %lu, text bytes %u\n", d.frames, d.bad, (unsigned int)d.text.size());
+	return 0;
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+# memmap.sh = Static SRAM allocations of each module of ArduGrid7753, from the Arduino build folder
+# ===============================================================================================
+# V1.2 - MercinatLabs / MERCINAT SARL France - Created: 19 Oct 2026
+#
+# The Arduino IDE builds in a temporary folder, shown in the output window when
+# "Show verbose output during compilation" is ticked in File > Preferences, ie.
+# /tmp/build4712587231.tmp - the sketch, library and core objects are found there.
+#
+# usage: host/memmap.sh <build folder>
+#
+# .data is copied from flash and .bss is zeroed at reset, both stay in SRAM for good.
+# What is left of the 2048 bytes is shared by the heap and the stack, see MemWatch.h.
+
+BUILD=${1:?usage: $0 <Arduino build folder>}
+
+echo "module                     data    bss  total"
+find "$BUILD" -name '*.o' | while read o; do
+	avr-size -A "$o" | awk -v m="$(basename "$o" .o)" '
+		$1 == ".data" { d += $2 }
+		$1 == ".bss"  { b += $2 }
+		END { if ( d + b > 0 ) printf "%-24s %6d %6d %6d\n", m, d, b, d + b }'
+done | sort -k4 -n -r
+
+ELF=$(ls "$BUILD"/*.elf 2>/dev/null | head -1)
+[ -n "$ELF" ] || exit 0
+echo
+avr-size -C --mcu=atmega328p "$ELF" | grep -i data
+echo
+echo "largest static variables (bytes)"
+avr-nm -C -S --size-sort -t d "$ELF" | awk 'tolower($3) == "b" || tolower($3) == "d" { printf "%6d  %s\n", $2, $4 }' | tail -15
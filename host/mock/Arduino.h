@@ -0,0 +1,82 @@
+/* Arduino.h = Arduino core stand-in for compiling ArduGrid7753 modules on a PC (see host/HostSim.h)
+*/
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <avr/pgmspace.h>
+
+#ifndef ARDUINO
+#define ARDUINO 100
+#endif
+
+typedef uint8_t byte;
+typedef bool    boolean;
+typedef uint16_t word;
+
+#define HIGH    1
+#define LOW     0
+#define INPUT   0
+#define OUTPUT  1
+#define DEC     10
+#define HEX     16
+#define OCT     8
+#define BIN     2
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define abs(x)   ((x)>0?(x):-(x))
+#define constrain(x,lo,hi) ((x)<(lo)?(lo):((x)>(hi)?(hi):(x)))
+#define lowByte(w)  ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+
+// Simulated time, see HostSim.cpp
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int  digitalRead(uint8_t pin);
+long random(long howsmall, long howbig);
+long random(long howbig);
+
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper *)(s))
+
+class Print {
+   public:
+      virtual size_t write(uint8_t c) = 0;
+      size_t write(const char *s) { size_t n = 0; while ( *s ) n += write((uint8_t)*s++); return n; }
+      size_t write(const uint8_t *b, size_t len) { for (size_t i = 0; i < len; i++) write(b[i]); return len; }
+
+      size_t print(const char *s) { return write(s); }
+      size_t print(const __FlashStringHelper *s) { return write((const char *)s); }
+      size_t print(char c) { return write((uint8_t)c); }
+      size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+      size_t print(int v, int base = DEC) { return print((long)v, base); }
+      size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+      size_t print(long v, int base = DEC);
+      size_t print(unsigned long v, int base = DEC);
+      size_t print(double v, int digits = 2);
+      size_t println(void) { return write("\r\n"); }
+      template <class T> size_t println(T v) { size_t n = print(v); return n + println(); }
+      template <class T> size_t println(T v, int f) { size_t n = print(v, f); return n + println(); }
+};
+
+class HardwareSerial : public Print {
+   public:
+      void begin(unsigned long baud) { (void)baud; }
+      size_t write(uint8_t c);
+      int available(void) { return 0; }
+      int read(void) { return -1; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,26 @@
+/* EtherCard.h = EtherCard library stand-in, only the SNTP exchange of GridClock (see host/clocksim.cpp)
+*/
+
+#ifndef ETHERCARD_H
+#define ETHERCARD_H
+
+#include <Arduino.h>
+
+class ENC28J60 {
+   public:
+      static uint8_t buffer[];          // the last packet received, defined by the host program
+      static uint16_t packetReceive();  // length of the packet received, 0 if none
+};
+
+typedef ENC28J60 Ethernet;
+
+class EtherCard : public Ethernet {
+   public:
+      static void ntpRequest(uint8_t *ntpip, uint8_t srcport);
+      static uint8_t ntpProcessAnswer(uint32_t *time, uint8_t dstport_l);
+      static uint16_t packetLoop(uint16_t plen);
+};
+
+extern EtherCard ether;
+
+#endif
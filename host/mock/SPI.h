@@ -0,0 +1,37 @@
+/* SPI.h = Arduino SPI library stand-in, the bytes go to the simulated device selected by its CS pin
+*/
+
+#ifndef SPI_H
+#define SPI_H
+
+#include <Arduino.h>
+
+#define SPI_CLOCK_DIV4   0x00
+#define SPI_CLOCK_DIV16  0x01
+#define SPI_CLOCK_DIV64  0x02
+#define SPI_CLOCK_DIV128 0x03
+#define SPI_CLOCK_DIV2   0x04
+#define SPI_CLOCK_DIV8   0x05
+#define SPI_CLOCK_DIV32  0x06
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+class SPIClass {
+   public:
+      static uint8_t transfer(uint8_t data);
+      static void begin(void);
+      static void end(void);
+      static void setBitOrder(uint8_t order);
+      static void setDataMode(uint8_t mode);
+      static void setClockDivider(uint8_t divider);
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,21 @@
+/* avr/eeprom.h = the 1024 bytes of EEPROM of the ATmega328 are an array of HostSim.cpp
+*/
+
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define SIM_EEPROM_SIZE  1024
+
+extern uint8_t simEeprom[SIM_EEPROM_SIZE];
+extern unsigned long simEepromWrites;  // bytes written, eeprom_update_*() only counts the ones that changed
+
+inline uint8_t eeprom_read_byte(const uint8_t *p) { return simEeprom[(uintptr_t)p % SIM_EEPROM_SIZE]; }
+inline void eeprom_write_byte(uint8_t *p, uint8_t v) { simEeprom[(uintptr_t)p % SIM_EEPROM_SIZE] = v; simEepromWrites++; }
+inline void eeprom_update_byte(uint8_t *p, uint8_t v) { if ( eeprom_read_byte(p) != v ) eeprom_write_byte(p, v); }
+inline void eeprom_read_block(void *d, const void *s, size_t n) { for (size_t i = 0; i < n; i++) ((uint8_t *)d)[i] = eeprom_read_byte((const uint8_t *)s + i); }
+inline void eeprom_update_block(const void *s, void *d, size_t n) { for (size_t i = 0; i < n; i++) eeprom_update_byte((uint8_t *)d + i, ((const uint8_t *)s)[i]); }
+
+#endif
@@ -0,0 +1,14 @@
+/* avr/interrupt.h = an ISR is a plain function, called by HostSim.cpp when its interrupt fires
+*/
+
+#ifndef INTERRUPT_H
+#define INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector) void vector(void)
+
+inline void cli(void) { SREG &= ~_BV(SREG_I); }
+inline void sei(void) { SREG |= _BV(SREG_I); }
+
+#endif
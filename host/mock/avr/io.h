@@ -0,0 +1,40 @@
+/* avr/io.h = the ATmega328 registers used by ArduGrid7753, as plain variables (see HostSim.cpp)
+*/
+
+#ifndef IO_H
+#define IO_H
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t ADCSRA;
+
+#define ADEN 7
+
+// Status register, the I bit is cleared by cli() and set by sei() (see avr/interrupt.h)
+extern volatile uint8_t SREG;
+
+#define SREG_I 7
+
+// An interrupt flag register: writing a one clears the flag, as on the ATmega328
+struct SimFlags {
+	volatile uint8_t bits;   // set by HostSim.cpp
+	operator uint8_t() const { return bits; }
+	SimFlags &operator=(uint8_t value) { bits &= ~value; return *this; }
+};
+
+// Timer1, clocked by the pulses given to simPulses() on T1 (see HostSim.h)
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+extern volatile uint16_t TCNT1;
+extern SimFlags TIFR1;
+
+#define CS10  0
+#define CS11  1
+#define CS12  2
+#define TOIE1 0
+#define TOV1  0
+
+#define TIMER1_OVF_vect simTimer1Overflow  // called by simPulses() as the interrupt would be
+
+#endif
@@ -0,0 +1,26 @@
+/* avr/pgmspace.h = flash is plain memory on a PC
+*/
+
+#ifndef PGMSPACE_H
+#define PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+typedef const char *PGM_P;
+typedef char prog_char;
+
+// Through memcpy(): the fields read are often of another type (int, long...) than the one of the macro
+inline uint8_t  pgm_read_byte(const void *p)  { uint8_t v;  memcpy(&v, p, sizeof(v)); return v; }
+inline uint16_t pgm_read_word(const void *p)  { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+inline uint32_t pgm_read_dword(const void *p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+inline float    pgm_read_float(const void *p) { float v;    memcpy(&v, p, sizeof(v)); return v; }
+#define memcpy_P  memcpy
+#define memcmp_P  memcmp
+#define strlen_P  strlen
+#define strcpy_P  strcpy
+#define strncmp_P strncmp
+
+#endif
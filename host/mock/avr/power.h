@@ -0,0 +1,12 @@
+/* avr/power.h = no power reduction register on a PC
+*/
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <avr/io.h>
+
+inline void power_adc_disable(void) {}
+inline void power_twi_disable(void) {}
+
+#endif
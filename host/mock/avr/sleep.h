@@ -0,0 +1,17 @@
+/* avr/sleep.h = sleep_cpu() waits for the next Timer0 interrupt of the simulated clock (see HostSim.cpp)
+*/
+
+#ifndef SLEEP_H
+#define SLEEP_H
+
+#define SLEEP_MODE_IDLE       0
+#define SLEEP_MODE_PWR_DOWN   2
+
+void simSleep(void);
+
+inline void set_sleep_mode(int mode) { (void)mode; }
+inline void sleep_enable(void) {}
+inline void sleep_disable(void) {}
+inline void sleep_cpu(void) { simSleep(); }
+
+#endif
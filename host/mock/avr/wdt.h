@@ -0,0 +1,10 @@
+/* avr/wdt.h = no watchdog on a PC, the time between two wdt_reset() is measured by HostSim
+*/
+
+#ifndef WDT_H
+#define WDT_H
+
+void wdt_reset(void);
+inline void wdt_disable(void) {}
+
+#endif
@@ -0,0 +1,21 @@
+/* util/crc16.h = the CRC updates of avr-libc, as documented in <util/crc16.h>
+*/
+
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+
+inline uint8_t _crc_ibutton_update(uint8_t crc, uint8_t data) {
+	crc ^= data;
+	for (uint8_t i = 0; i < 8; i++) crc = ( crc & 0x01 ) ? ( crc >> 1 ) ^ 0x8C : crc >> 1;
+	return crc;
+}
+
+inline uint16_t _crc16_update(uint16_t crc, uint8_t data) {
+	crc ^= data;
+	for (uint8_t i = 0; i < 8; i++) crc = ( crc & 0x01 ) ? ( crc >> 1 ) ^ 0xA001 : crc >> 1;
+	return crc;
+}
+
+#endif
@@ -0,0 +1,260 @@
+/* modbuspoll.cpp = Modbus/TCP client polling the register table of ArduGrid7753
+==============================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Polls a Nanode (see GridModbus.h) as a SCADA does: one TCP connection kept open, one Read
+Holding Registers (or Read Input Registers with -4) request at a time, and prints as JSON
+on stdout:
+
+	polls, ok, errors      requests sent, answers with the transaction identifier and the
+	                       byte count expected, and timeouts, exceptions or bad frames
+	polls_per_s            answers per second of wall time
+	latency_ms             from send() of the request to the end of the answer: mean, p50,
+	                       p95, max
+	values                 the registers of the last answer, as 32-bit pairs when the range
+	                       starts on an even address
+
+With -l, GridModbus is served on the PC (127.0.0.1) from a thread, with two records of
+each meter 10 s apart, and the table is checked: the values of meter 0 and the energy
+total, both function codes, and exceptions 1, 2 and 3. It checks the client and the
+table, not the timing of the Nanode.
+
+	modbuspoll [-n polls] [-a address] [-q quantity] [-4] [-t timeout_ms] host [port]
+	modbuspoll -l [-n polls] [-a address] [-q quantity] [-4]
+
+Build from the sketch folder:
+
+	g++ -O2 -std=c++11 -pthread -DARDUINO=100 -DGRIDSNAPSHOT -DGRIDMODBUS -Ihost/mock -Ihost -I. \
+	    host/modbuspoll.cpp host/HostSim.cpp GridSnapshot.cpp GridModbus.cpp -o host/modbuspoll
+	host/modbuspoll -l && host/modbuspoll -n 1000 -q 20 192.168.1.20 > modbus.json
+
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "HostSim.h"
+#include "GridModbus.h"
+
+#ifndef GRIDMODBUS
+#error "build with -DGRIDSNAPSHOT -DGRIDMODBUS"
+#endif
+
+#define POLL_COUNT       1000
+#define POLL_TIMEOUT     2000      // in milliseconds - connect and answer
+#define POLL_PACKET      646       // TCP payload of the 700 bytes Ethernet buffer of the Nanode
+
+// Row 0 of the shield table of ArduGrid7753.ino
+static const MeterConfig shield = { 10, -3, -5, -2000, +2000, 12498.65, 167623.8, 141.0, 234565.0, 1.0, 34.8, 30.4, 0.60 };
+
+/** === request ===
+* @return int with the answer length, the exception code negated, or 0 on a timeout or a bad frame
+*/
+static int request(int s, word id, byte function, word start, word count, byte *answer) {
+	byte q[12] = { (byte)( id >> 8 ), (byte)id, 0, 0, 0, 6, 1, function,
+	               (byte)( start >> 8 ), (byte)start, (byte)( count >> 8 ), (byte)count };
+	if ( send(s, q, sizeof(q), MSG_NOSIGNAL) != (ssize_t)sizeof(q) ) return 0;
+	int got = 0, need = MODBUS_MBAP + 2;
+	while ( got < need )
+	{
+		ssize_t n = recv(s, answer + got, POLL_PACKET - got, 0);
+		if ( n <= 0 ) return 0;
+		got += n;
+		if ( got >= 6 ) need = 6 + ( answer[4] << 8 | answer[5] );
+	}
+	if ( ( answer[0] << 8 | answer[1] ) != id || answer[6] != 1 ) return 0;
+	if ( answer[7] == ( function | 0x80 ) ) return -answer[8];
+	if ( answer[7] != function || answer[8] != 2 * count ) return 0;
+	return got;
+}
+
+/** === pair ===
+* @return long with the 32-bit value of two registers of an answer, high word first
+*/
+static long pair(const byte *answer, word i) {
+	const byte *d = answer + MODBUS_MBAP + 2 + 2 * i;
+	return (int32_t)( (uint32_t)d[0] << 24 | (uint32_t)d[1] << 16 | d[2] << 8 | d[3] );
+}
+
+/** === serve ===
+* GridModbus on a listening socket, as ArduGrid7753.ino does on the ENC28J60: each
+* request is answered in place, on a connection kept open
+*/
+static void serve(int listener, GridModbus *modbus, std::atomic<bool> *stop) {
+	while ( ! *stop )
+	{
+		int c = accept(listener, 0, 0);
+		if ( c < 0 ) continue;
+		byte packet[POLL_PACKET];
+		ssize_t n;
+		while ( ( n = recv(c, packet, sizeof(packet), 0) ) > 0 )
+		{
+			word len = modbus->reply(packet, n, packet, sizeof(packet));
+			if ( len != 0 ) send(c, packet, len, MSG_NOSIGNAL);
+		}
+		close(c);
+	}
+}
+
+/** === connectTo ===
+* @return int with a connected socket, -1 on failure
+*/
+static int connectTo(const sockaddr_in &to, int timeout) {
+	int s = socket(AF_INET, SOCK_STREAM, 0);
+	int one = 1;
+	timeval tv = { timeout / 1000, ( timeout % 1000 ) * 1000 };
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if ( connect(s, (const sockaddr *)&to, sizeof(to)) == 0 ) return s;
+	close(s);
+	return -1;
+}
+
+/** === check ===
+* @return boolean true if the table served by -l is as the records given
+*/
+static boolean check(int s) {
+	byte a[POLL_PACKET];
+	boolean ok = true;
+	ok = ok && request(s, 1, MODBUS_READ_HOLDING, 0, MODBUS_METER, a) > 0;
+	ok = ok && pair(a, 0) == 23002 && pair(a, 2) == 500 && pair(a, 4) == 230000 && pair(a, 12) == 5000;
+	ok = ok && pair(a, 14) == 6 && pair(a, 16) == 0 && pair(a, 18) == 1791234577L;
+	ok = ok && request(s, 2, MODBUS_READ_INPUT, MODBUS_METER + 10, 2, a) > 0 && pair(a, 0) == -3;
+	ok = ok && request(s, 3, MODBUS_READ_HOLDING, MODBUS_HEALTH, 16, a) > 0 && pair(a, 0) == 42 && pair(a, 12) == 312;
+	ok = ok && request(s, 4, 6, 0, 1, a) == -MODBUS_ILLEGAL_FUNCTION;
+	ok = ok && request(s, 5, MODBUS_READ_HOLDING, SCHED_METERS * MODBUS_METER, 1, a) == -MODBUS_ILLEGAL_ADDRESS;
+	ok = ok && request(s, 6, MODBUS_READ_HOLDING, MODBUS_HEALTH + 14, 4, a) == -MODBUS_ILLEGAL_ADDRESS;
+	ok = ok && request(s, 7, MODBUS_READ_HOLDING, 0, MODBUS_MAX_READ + 1, a) == -MODBUS_ILLEGAL_VALUE;
+	if ( ! ok ) fprintf(stderr, "register table not as expected\n");
+	return ok;
+}
+
+int main(int argc, char **argv) {
+	unsigned int polls = POLL_COUNT;
+	int timeout = POLL_TIMEOUT, port = MODBUS_PORT;
+	word start = 0, count = MODBUS_METER;
+	byte function = MODBUS_READ_HOLDING;
+	const char *host = 0;
+	boolean local = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if ( strcmp(argv[i], "-n") == 0 && i + 1 < argc ) polls = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-a") == 0 && i + 1 < argc ) start = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-q") == 0 && i + 1 < argc ) count = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-t") == 0 && i + 1 < argc ) timeout = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-4") == 0 ) function = MODBUS_READ_INPUT;
+		else if ( strcmp(argv[i], "-l") == 0 ) local = true;
+		else if ( host == 0 ) host = argv[i];
+		else port = atoi(argv[i]);
+	}
+	if ( ( host == 0 && ! local ) || polls == 0 || count == 0 || count > MODBUS_MAX_READ )
+	{
+		fprintf(stderr, "usage: modbuspoll [-n polls] [-a address] [-q quantity] [-4] [-t timeout_ms] host [port]\n"
+		                "       modbuspoll -l [-n polls] [-a address] [-q quantity] [-4]\n");
+		return 2;
+	}
+	simQuiet(true);
+
+	sockaddr_in to;
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	GridSnapshot snapshot;
+	GridModbus modbus;
+	std::atomic<bool> stop(false);
+	std::thread server;
+	int listener = -1;
+	if ( local )
+	{   // two records of each meter 10 s apart, 230 V, 5 A, 2300 W, 50 Hz: 6.39 Wh imported
+		socklen_t len = sizeof(to);
+		snapshot.begin(SCHED_METERS);
+		for (byte m = 0; m < SCHED_METERS; m++)
+		{
+			GridRecord rec = { 1791234567UL, 123, 2875 * 1000L, 838 * 1000L, 0, 0, 80040, 80040, 7000, 20000, -3, m };
+			snapshot.update(rec, &shield, 1000);
+			rec.utcSec += 10;
+			snapshot.update(rec, &shield, 11000);
+		}
+		snapshot.setHealth(SNAP_UPDATES, 42);
+		snapshot.setHealth(SNAP_FREE, 312);
+		modbus.begin(&snapshot);
+		listener = socket(AF_INET, SOCK_STREAM, 0);
+		to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		to.sin_port = 0;
+		if ( bind(listener, (const sockaddr *)&to, sizeof(to)) != 0 || listen(listener, 4) != 0 ) { perror("listen"); return 2; }
+		getsockname(listener, (sockaddr *)&to, &len);
+		server = std::thread(serve, listener, &modbus, &stop);
+	}
+	else
+	{
+		to.sin_port = htons(port);
+		if ( inet_pton(AF_INET, host, &to.sin_addr) != 1 ) { fprintf(stderr, "host must be an IPv4 address\n"); return 2; }
+	}
+
+	int s = connectTo(to, timeout);
+	if ( s < 0 ) { perror("connect"); return 1; }
+	boolean tableOk = ! local || check(s);
+	std::vector<double> ms;
+	byte answer[POLL_PACKET];
+	unsigned int ok = 0;
+	auto t0 = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < polls; i++)
+	{
+		auto p0 = std::chrono::steady_clock::now();
+		int got = request(s, (word)( 100 + i ), function, start, count, answer);
+		ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - p0).count());
+		if ( got > 0 ) ok++;
+		else if ( got == 0 )
+		{   // timeout or bad frame, the connection is out of step
+			close(s);
+			s = connectTo(to, timeout);
+			if ( s < 0 ) break;
+		}
+	}
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	if ( s >= 0 ) close(s);
+
+	std::sort(ms.begin(), ms.end());
+	double sum = 0;
+	for (double x : ms) sum += x;
+	printf("{\n  \"target\": \"%s:%d\", \"function\": %d, \"address\": %u, \"quantity\": %u,\n", local ? "127.0.0.1" : host,
+	       ntohs(to.sin_port), function, start, count);
+	printf("  \"polls\": %u, \"ok\": %u, \"errors\": %u, \"polls_per_s\": %.1f,\n", polls, ok, polls - ok, ok / wall);
+	printf("  \"latency_ms\": {\"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"max\": %.3f},\n", sum / ms.size(),
+	       ms[ms.size() / 2], ms[ms.size() * 95 / 100], ms.back());
+	printf("  \"values\": [");
+	for (word i = 0; ok > 0 && i < count; i += ( start & 1 ) ? 1 : 2)
+	{
+		if ( i != 0 ) printf(", ");
+		if ( ( start & 1 ) || i + 1 == count ) printf("%u", answer[MODBUS_MBAP + 2 + 2 * i] << 8 | answer[MODBUS_MBAP + 3 + 2 * i]);
+		else printf("%ld", pair(answer, i));
+	}
+	printf("], \"table_ok\": %s\n}\n", tableOk ? "true" : "false");
+
+	if ( local )
+	{
+		stop = true;
+		shutdown(listener, SHUT_RDWR);
+		close(listener);
+		server.join();
+	}
+	return ( ok == polls && tableOk ) ? 0 : 1;
+}
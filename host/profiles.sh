@@ -0,0 +1,39 @@
+#!/bin/sh
+# profiles.sh = Flash and SRAM of each build profile of ArduGrid7753 (see GridFeatures.h)
+# ======================================================================================
+# V1.2 - MercinatLabs / MERCINAT SARL France - Created: 19 Oct 2026
+#
+# The Arduino 1.0 IDE builds one profile at a time, the one of GRIDPROFILE in GridFeatures.h.
+# This script builds them all with arduino-cli (https://arduino.github.io/arduino-cli), the
+# profile given with -DGRIDPROFILE=n to every source file, libraries EtherCard and NanodeUNIO
+# installed, and gives the size of each from avr-size:
+#
+#	flash   .text + .data, of the 32256 bytes left by the bootloader
+#	SRAM    .data + .bss, static allocation of the 2048 bytes, the core and the libraries included
+#	left    the rest, shared by the heap and the stack: a profile leaving less than STACK_MIN
+#	        bytes is marked, the stack needs about 150 bytes at its deepest (see GridFeatures.h)
+#
+# usage: host/profiles.sh [sketch folder, named ArduGrid7753 as the IDE wants] [fqbn]
+#
+# The share of each module in a profile is given by host/memmap.sh on its build folder,
+# kept here in /tmp/ArduGrid7753-<profile>.
+
+SKETCH=${1:-$(dirname "$0")/..}
+FQBN=${2:-arduino:avr:uno}
+STACK_MIN=150
+
+echo "profile              flash   SRAM   left"
+for p in 0:FIELD 1:LEAN 2:BILLING 3:COMMISSIONING 4:DEBUG; do
+	n=${p%%:*}; name=${p#*:}
+	BUILD=/tmp/ArduGrid7753-$name
+	if ! arduino-cli compile --fqbn "$FQBN" --build-path "$BUILD" \
+		--build-property "compiler.cpp.extra_flags=-DGRIDPROFILE=$n" "$SKETCH" > "$BUILD.log" 2>&1; then
+		printf "%-18s  build failed, see %s\n" "$name" "$BUILD.log"
+		continue
+	fi
+	avr-size -A "$BUILD"/*.elf | awk -v m="$name" -v min=$STACK_MIN '
+		$1 == ".text" { t = $2 }
+		$1 == ".data" { d = $2 }
+		$1 == ".bss"  { b = $2 }
+		END { printf "%-18s %7d %6d %6d%s\n", m, t + d, d + b, 2048 - d - b, 2048 - d - b < min ? "  too little for the stack" : "" }'
+done
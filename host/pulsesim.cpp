@@ -0,0 +1,298 @@
+/* pulsesim.cpp = Simulation of the CF pulse train counted by GridPulse on a PC
+============================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+GridPulse.cpp, GridMeter.cpp and GridSnapshot.cpp are compiled unchanged with GRIDPULSE
+and GRIDSNAPSHOT, against a simulated ADE7753 (Ade7753Model) whose CF output is wired to
+T1: HostSim.cpp clocks the simulated Timer1 with its pulses and calls the overflow ISR at
+each wrap. Load profiles are played half cycle by half cycle with the loop of ArduGrid7753.ino: a
+measurement cycle every update period, short windows in between.
+
+For each profile:
+
+	pulses_given      CF pulses of the simulated ADE7753 over the profile
+	pulses_counted    by GridPulse::getCount(), must be equal (count_ok)
+	overflows         Timer1 wraps, ie. overflow interrupts, the only CPU time of the count
+	true_wh           energy of the profile (import - export), from the half cycles played
+	pulse_wh          from the pulses, GridSnapshot::addEnergy() at each record (GridPulse.h)
+	integrated_wh     from the mean power of each line cycle accumulation, as GridSnapshot
+	                  does without GRIDPULSE
+	pulse_error_pct   and integrated_error_pct, of the totals against true_wh
+	true_import_wh    and true_export_wh, the half cycles played of each sign
+	import_error_pct  and export_error_pct, of the import and export totals from the pulses
+	                  against them, and the same of the integrated totals
+	checks            line cycle accumulations cross-checked with their LAENERGY, and the
+	mismatches        ones out of PULSE_TOLERANCE
+
+The energies are taken over the same span, from the first record of the profile to its
+last one. The profiles:
+
+	steady            constant load
+	switching         loads switched at random times between 0 and PULSE_SIM_WATTS
+	export            the same with a PV export down to -PULSE_SIM_WATTS / 2: CF has no sign,
+	                  the pulses of the records in which the power changed sign are shared
+	                  out between the import and the export by the windows and cycles given
+	                  to GridPulse::add(), and these cycles are not cross-checked
+	unwired           the switching profile with CF disconnected after a third of it: the
+	                  cross-check must see it
+
+A count that differs, an import or an export total from the pulses off by more than
+PULSE_SIM_ERROR % of the energy played (import + export), PULSE_SIM_SPLIT % with an export,
+or a mismatch, or no mismatch on the unwired profile fails the run. The pulses keep the
+import plus the export exact, the error of the share is the one of the windows: a change of
+sign between the end of a cycle and the first window after it (the RMS reads) is not seen.
+
+Build and run from the sketch folder:
+
+	g++ -O2 -DARDUINO=100 -DGRIDPULSE -DGRIDSNAPSHOT -Ihost/mock -Ihost -I. host/pulsesim.cpp host/HostSim.cpp \
+	    host/Ade7753Model.cpp ADE7753.cpp GridMeter.cpp GridWatchdog.cpp GridLog.cpp GridPulse.cpp \
+	    GridSnapshot.cpp -o host/pulsesim
+	host/pulsesim > pulses.json
+
+*/
+
+#include <cmath>
+#include <vector>
+#include <avr/wdt.h>
+#include "HostSim.h"
+#include "Ade7753Model.h"
+#include "ADE7753.h"
+#include "GridMeter.h"
+#include "GridPulse.h"
+#include "GridSnapshot.h"
+
+#if !defined(GRIDPULSE) || !defined(GRIDSNAPSHOT)
+#error "build with -DGRIDPULSE -DGRIDSNAPSHOT"
+#endif
+
+#define PULSE_SIM_PERIOD   10000   // in milliseconds - REQUEST_RATE of ArduGrid7753.ino
+#define PULSE_SIM_LOOP     100     // in milliseconds - a pass of the loop of ArduGrid7753.ino
+#define PULSE_SIM_WINDOW   10      // half cycles of the windows between the cycles, EVENT_LINECYC
+#define PULSE_SIM_WATTS    3000    // largest load of the switching profiles
+#define PULSE_SIM_ERROR    0.1     // in % - largest error of the totals from the pulses, of the energy played (import + export)
+#define PULSE_SIM_SPLIT    1.0     // in % - the same with an export, the pulses are shared out by sampled windows
+
+// Shield #1 as in ArduGrid7753.ino
+static const MeterConfig shield[1] PROGMEM = {
+	{ CS, -3,   -5,   -2000, +2000,  12498.65, 167623.8, 141.0,   234565.0,  1.0,    34.8,     30.4,       0.60 }
+};
+
+struct PulseProfile {
+	const char *name;
+	unsigned long length;     // in seconds
+	int low, high;            // in W, range of the switched loads, the same for a steady load
+	boolean unwire;           // CF disconnected after a third of the profile
+};
+
+static const PulseProfile profiles[] = {
+	{ "steady",    600,  1500,  1500,  false },  // switched to the same load
+	{ "switching", 3600, 0,     PULSE_SIM_WATTS, false },
+	{ "export",    3600, -PULSE_SIM_WATTS / 2, PULSE_SIM_WATTS, false },
+	{ "unwired",   1200, 0,     PULSE_SIM_WATTS, true }
+};
+
+static Ade7753Model ade;
+static const PulseProfile *profile;  // played by loadAt()
+static unsigned long long profileStart;
+static double carry;                 // fraction of a register unit left by the last half cycles
+static double played;                // LSB of active energy played since the start of the profile
+static double playedImport;          // of the positive half cycles
+static double playedExport;          // of the negative ones, as a positive value
+static std::vector<unsigned long> switchAt; // in ms from the start of the profile
+static std::vector<int> switchWatts;
+static size_t switched;              // switches played
+
+/** === loadAt ===
+* Ade7753Model::load: the active energy of the next half cycle, from the switches of the profile
+*/
+static void loadAt(Ade7753Model *model, unsigned long long us) {
+	unsigned long t = us > profileStart ? ( us - profileStart ) / 1000 : 0; // the crossings are played late, at the next SPI access
+	while ( switched + 1 < switchAt.size() && switchAt[switched + 1] <= t ) switched++;
+	double p = switchWatts[switched] * pgm_read_float(&shield[0].calActiveEnergy) / METER_LINECYC + carry;
+	model->activePerHalfCycle = floor(p);
+	carry = p - floor(p);
+	played += model->activePerHalfCycle;
+	if ( model->activePerHalfCycle > 0 ) playedImport += model->activePerHalfCycle;
+	else playedExport -= model->activePerHalfCycle;
+}
+
+/** === lsbToWh ===
+* @return double with the Wh of LSB of active energy, with the calibration of datastream 4
+*/
+static double lsbToWh(double lsb) {
+	return lsb * METER_LINECYC / 100.0 / 3600.0 / pgm_read_float(&shield[0].calActiveEnergy);
+}
+
+/** === imported ===
+* @return double with the import total of a snapshot, in Wh
+*/
+static double imported(GridSnapshot &s) {
+	const SnapReading *r = s.getReading(0);
+	return r->importWh + r->importPart;
+}
+
+/** === exported ===
+* @return double with the export total of a snapshot, in Wh
+*/
+static double exported(GridSnapshot &s) {
+	const SnapReading *r = s.getReading(0);
+	return r->exportWh + r->exportPart;
+}
+
+/** === net ===
+* @return double with the import minus the export total of a snapshot, in Wh
+*/
+static double net(GridSnapshot &s) {
+	return imported(s) - exported(s);
+}
+
+/** === runProfile ===
+* Play a profile, print its figures as a JSON object
+* @param p: the profile
+* @param gridMeter: on the simulated ADE7753 ade
+* @return boolean false if the run fails, see the comments above
+*/
+static boolean runProfile(const PulseProfile *p, GridMeter &gridMeter) {
+	GridSnapshot pulsed, integrated;
+	GridRecord rec;
+	unsigned long records = 0;
+	unsigned long given = 0, counted = 0, overflows = 0;
+	double playedFirst = 0, pulsedFirst = 0, integratedFirst = 0, playedLast = 0;
+	double importFirst = 0, exportFirst = 0, importLast = 0, exportLast = 0;
+	double pulsedImportFirst = 0, pulsedExportFirst = 0, integratedImportFirst = 0, integratedExportFirst = 0;
+
+	profile = p;
+	profileStart = simNow();
+	carry = 0;
+	played = 0;
+	playedImport = 0;
+	playedExport = 0;
+	switchAt.clear();
+	switchWatts.clear();
+	switched = 0;
+	srand(7753);
+	for (unsigned long t = 0; t < p->length * 1000; t += 500 + rand() % 7500)
+	{   // a load every 0.5 to 8 s, the same at each run
+		switchAt.push_back(t);
+		switchWatts.push_back(p->low + rand() % ( p->high - p->low + 1 ));
+	}
+	ade.load = loadAt;
+	ade.cfPin = SIM_T1_PIN;
+	gridPulse.begin();
+	pulsed.begin(1);
+	pulsed.setCounted(0);
+	integrated.begin(1);
+	unsigned long long unwireAt = p->unwire ? profileStart + p->length * 1000000ULL / 3 : 0;
+	unsigned long long end = profileStart + p->length * 1000000ULL;
+	unsigned long long nextCycle = profileStart;
+	unsigned long long givenFrom = ade.cfPulses;
+	while ( simNow() < end )
+	{
+		wdt_reset();
+		if ( unwireAt != 0 && simNow() >= unwireAt ) ade.cfPin = 0;
+		if ( simNow() >= nextCycle )
+		{   // the measurement of the update period, as in the loop of ArduGrid7753.ino
+			gridMeter.startCycle();
+			gridMeter.waitCycleEnd();
+			gridMeter.read(rec);
+			rec.meter = 0;
+			pulsed.update(rec, shield, gridMeter.getCycleEnd());
+			integrated.update(rec, shield, gridMeter.getCycleEnd());
+			if ( gridMeter.hasMains() )
+			{
+				gridPulse.add(rec.activeEnergy, METER_LINECYC, gridMeter.getSigns(), gridMeter.getCyclePulses(), gridMeter.getCycleEnd());
+				gridPulse.check(rec, gridMeter.getCyclePulses(), gridMeter.getSigns());
+			}
+			float pulseImport, pulseExport;
+			gridPulse.take(rec, shield, pulseImport, pulseExport);
+			pulsed.addEnergy(0, pulseImport);
+			pulsed.addEnergy(0, -pulseExport);
+			if ( records++ == 0 )
+			{   // the totals are compared from the first record on
+				playedFirst = played;
+				importFirst = playedImport;
+				exportFirst = playedExport;
+				pulsedFirst = net(pulsed);
+				pulsedImportFirst = imported(pulsed);
+				pulsedExportFirst = exported(pulsed);
+				integratedFirst = net(integrated);
+				integratedImportFirst = imported(integrated);
+				integratedExportFirst = exported(integrated);
+			}
+			playedLast = played; // ... to the last one
+			importLast = playedImport;
+			exportLast = playedExport;
+			gridMeter.watch(PULSE_SIM_WINDOW);
+			gridMeter.close();
+			nextCycle += PULSE_SIM_PERIOD * 1000ULL;
+		}
+		else
+		{
+			long a, r;
+			gridMeter.open();
+			if ( gridMeter.pollWindow(a, r) ) gridPulse.add(a, PULSE_SIM_WINDOW, gridMeter.getSigns(), 0, millis());
+			gridMeter.close();
+		}
+		simAdvance(PULSE_SIM_LOOP * 1000ULL);
+	}
+	given = ade.cfPulses - givenFrom;
+	counted = gridPulse.getCount();
+	overflows = counted >> 16;
+	ade.load = 0;
+	ade.cfPin = 0;
+	ade.activePerHalfCycle = 105; // back to the values of the constructor
+
+	double trueWh = lsbToWh(playedLast - playedFirst);
+	double pulseWh = net(pulsed) - pulsedFirst;
+	double integratedWh = net(integrated) - integratedFirst;
+	double pulseError = 100.0 * ( pulseWh - trueWh ) / trueWh;
+	double integratedError = 100.0 * ( integratedWh - trueWh ) / trueWh;
+	double trueImport = lsbToWh(importLast - importFirst);
+	double trueExport = lsbToWh(exportLast - exportFirst);
+	double importError = 100.0 * ( imported(pulsed) - pulsedImportFirst - trueImport ) / ( trueImport + trueExport );
+	double exportError = 100.0 * ( exported(pulsed) - pulsedExportFirst - trueExport ) / ( trueImport + trueExport );
+	double integratedImportError = 100.0 * ( imported(integrated) - integratedImportFirst - trueImport ) / ( trueImport + trueExport );
+	double integratedExportError = 100.0 * ( exported(integrated) - integratedExportFirst - trueExport ) / ( trueImport + trueExport );
+	boolean countOk = p->unwire || given == counted;
+	boolean ok = countOk;
+	if ( p->unwire ) ok = ok && gridPulse.getMismatches() > 0;
+	else
+	{
+		double limit = p->low < 0 ? PULSE_SIM_SPLIT : PULSE_SIM_ERROR;
+		ok = ok && gridPulse.getMismatches() == 0 && fabs(importError) <= limit && fabs(exportError) <= limit;
+	}
+
+	printf("%s    {\"profile\": \"%s\", \"length_s\": %lu, \"records\": %lu, \"pulses_given\": %lu, \"pulses_counted\": %lu, "
+	       "\"overflows\": %lu, \"count_ok\": %s, \"true_wh\": %.2f, \"pulse_wh\": %.2f, \"integrated_wh\": %.2f, "
+	       "\"pulse_error_pct\": %.3f, \"integrated_error_pct\": %.3f, \"true_import_wh\": %.2f, \"true_export_wh\": %.2f, "
+	       "\"import_error_pct\": %.3f, \"export_error_pct\": %.3f, \"integrated_import_error_pct\": %.3f, "
+	       "\"integrated_export_error_pct\": %.3f, \"checks\": %u, \"mismatches\": %u, \"last_deviation_permille\": %d, \"ok\": %s}",
+	       p == profiles ? "" : ",\n", p->name, p->length, records, given, counted, overflows, countOk ? "true" : "false",
+	       trueWh, pulseWh, integratedWh, pulseError, integratedError, trueImport, trueExport, importError, exportError,
+	       integratedImportError, integratedExportError, gridPulse.getChecks(), gridPulse.getMismatches(),
+	       gridPulse.getDeviation(), ok ? "true" : "false");
+	return ok;
+}
+
+int main(void) {
+	GridMeter gridMeter;
+	boolean ok = true;
+
+	simQuiet(true);
+	simAttach(CS, &ade);
+	gridMeter.begin(&shield[0]);
+
+	printf("{\n  \"cfnum\": %u, \"cfden\": %u, \"tolerance_permille\": %u,\n  \"profiles\": [\n",
+	       METER_CFNUM, METER_CFDEN, PULSE_TOLERANCE);
+	for (byte i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++)
+		if ( ! runProfile(&profiles[i], gridMeter) ) ok = false;
+	printf("\n  ],\n  \"ok\": %s\n}\n", ok ? "true" : "false");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+/* queuebench.cpp = Two thread stress test and throughput of SpscQueue on a PC
+============================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+On the Nanode the producer of an SpscQueue is an ISR and the consumer the main loop.
+Here they are two threads, on two cores when the PC has them, which interleave far more
+than an ISR ever will: the producer pushes QUEUE_ITEMS numbered records, retrying while
+the queue is full, and the consumer checks that it gets every one of them, in order and
+intact.
+
+For each item type and capacity, the result is printed as JSON on stdout:
+
+	items             records passed through the queue
+	full              push() calls that found the queue full (retried)
+	ns_per_item       wall time on the PC per record
+	items_per_s       throughput
+
+The run fails (exit code 1) on the first record lost, duplicated, out of order or torn.
+
+Build and run from the sketch folder:
+
+	g++ -O2 -std=c++11 -pthread -DARDUINO=100 -Ihost/mock -I. host/queuebench.cpp -o host/queuebench
+	host/queuebench > queue.json
+
+*/
+
+#include <chrono>
+#include <thread>
+#include "SpscQueue.h"
+#include "GridRecord.h"
+
+#define QUEUE_ITEMS  1000000UL
+
+static boolean first = true;
+
+/** === fill ===
+* Number a record and derive all its fields from the number, so that a torn copy shows
+*/
+static void fill(GridRecord &rec, unsigned long n) {
+	rec.utcSec = n;
+	rec.utcMs = n % 1000;
+	rec.vrms = n * 3;
+	rec.irms = n * 5;
+	rec.vpeak = n ^ 0x55AA55;
+	rec.ipeak = ~n;
+	rec.activeEnergy = n * 7;
+	rec.apparentEnergy = n * 11;
+	rec.reactiveEnergy = -(long)n;
+	rec.period = n & 0x7FFF;
+	rec.temp = n & 0x7F;
+	rec.meter = n % 3;
+}
+
+static boolean intact(const GridRecord &rec, unsigned long n) {
+	GridRecord ref;
+	fill(ref, n);
+	return rec.utcSec == ref.utcSec && rec.utcMs == ref.utcMs && rec.vrms == ref.vrms
+	    && rec.irms == ref.irms && rec.vpeak == ref.vpeak && rec.ipeak == ref.ipeak
+	    && rec.activeEnergy == ref.activeEnergy && rec.apparentEnergy == ref.apparentEnergy
+	    && rec.reactiveEnergy == ref.reactiveEnergy && rec.period == ref.period && rec.temp == ref.temp
+	    && rec.meter == ref.meter;
+}
+
+static void fill(byte &b, unsigned long n) {
+	b = n & 0xFF;
+}
+
+static boolean intact(const byte &b, unsigned long n) {
+	return b == ( n & 0xFF );
+}
+
+/** === run ===
+* Pass QUEUE_ITEMS items from a producer thread to a consumer thread
+* @return boolean false if an item was lost, duplicated, out of order or torn
+*/
+template <class T, byte N>
+static boolean run(const char *type) {
+	static SpscQueue<T, N> queue;
+	unsigned long full = 0;
+	boolean ok = true;
+	volatile boolean finished = false;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::thread producer([&]() {
+		T item;
+		for (unsigned long n = 0; n < QUEUE_ITEMS; n++)
+		{
+			fill(item, n);
+			while ( ! queue.push(item) )
+			{
+				full++;
+				std::this_thread::yield(); // let the consumer run when there is a single core
+			}
+		}
+		finished = true;
+	});
+	for (unsigned long n = 0; n < QUEUE_ITEMS && ok; )
+	{
+		T *item = queue.peek();
+		if ( item == 0 )
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		if ( ! intact(*item, n) )
+		{
+			fprintf(stderr, "%s x %u: item %lu wrong\n", type, N, n);
+			ok = false;
+		}
+		queue.pop();
+		n++;
+	}
+	if ( ! ok ) while ( ! finished ) queue.pop(); // let the producer finish
+	producer.join();
+	double wall = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	if ( queue.count() != 0 ) ok = false;
+
+	printf("%s    {\"type\": \"%s\", \"capacity\": %u, \"items\": %lu, \"full\": %lu, "
+	       "\"ns_per_item\": %.1f, \"items_per_s\": %.0f, \"ok\": %s}",
+	       first ? "" : ",\n", type, N, QUEUE_ITEMS, full,
+	       wall / QUEUE_ITEMS, QUEUE_ITEMS / wall * 1e9, ok ? "true" : "false");
+	first = false;
+	return ok;
+}
+
+int main(void) {
+	boolean ok = true;
+
+	printf("{\n  \"bench\": \"SpscQueue\",\n  \"results\": [\n");
+	ok &= run<byte, 2>("byte");
+	ok &= run<byte, 128>("byte");
+	ok &= run<GridRecord, 2>("GridRecord");
+	ok &= run<GridRecord, 4>("GridRecord");
+	ok &= run<GridRecord, 128>("GridRecord");
+	printf("\n  ]\n}\n");
+	return ok ? 0 : 1;
+}
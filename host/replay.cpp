@@ -0,0 +1,483 @@
+/* replay.cpp = Replay of a captured ADE7753 session through the acquisition code on a PC
+======================================================================================
+V1.2
+MercinatLabs / MERCINAT SARL France
+http://www.mercinat.com
+Created:     19 Oct 2026
+
+Project hosted at: http://code.google.com/p/ardugrid7753 - Repository type: Subversion
+
+Comments
+--------
+Takes the register transactions recorded by GridCapture (see GridCapture.h), ie. a Serial
+log of the Nanode with its '@' lines, and plays them back through ADE7753.cpp, GridMeter,
+GridScheduler and GridPhases compiled unchanged, on the simulated SPI bus and clock of
+HostSim. The replay runs the measurement part of setup() and of each update of
+ArduGrid7753.ino: begin() of each meter, then check(), GridScheduler::run() and read() of
+each meter, the phase sequence on a three-phase board, suspend() in POWER_SAVE.
+
+Each transaction of the code is checked against the next one of the trace: same chip
+select pin, same register, same direction, and for a write the same value. A read returns
+the value recorded. The first difference stops the replay with exit status 1: the code no
+longer asks the chip what it asked in the field. The simulated clock is brought forward to
+the time of each transaction in the trace when the replay is ahead, so that the decisions
+taken on millis() and micros() (the stagger of GridScheduler, the budgets of GridWatchdog,
+the zero crossings of GridPhases) fall as in the field. The records computed from the trace are
+printed with the timing of the acquisition as JSON on stdout:
+
+	events, transactions   of the trace, and the transactions replayed
+	recorded_us            time between the transactions of the trace, the idle gaps of the
+	                       loop (CAPTURE_GAP) left out
+	replay_us              the same, between the same transactions of the replay
+	records                per update and meter: mains, VRMS, IRMS, LAENERGY, PERIOD
+
+so that a trace of the field becomes a regression test and a benchmark of the acquisition
+path. A trace with lost events (ring mode) is replayed from its last contiguous part, which
+rarely starts at a cycle boundary: decode it with -d instead.
+
+The shield table below must hold the rows of the Nanode the trace was taken on, as in
+ArduGrid7753.ino: the configuration written by begin() and check() is compared.
+
+	replay [-m meters] [-r row] [-3] [-s] trace.log     replay, JSON on stdout
+	replay -d trace.log                                 decode the events, one per line
+	replay -g trace.log [-u updates] [-m meters] [-3]   write a session trace taken from the
+	                                                    simulated ADE7753 of host/bench.cpp,
+	                                                    with a register corrupted at the second
+	                                                    update and the mains lost at the third
+
+	-m   ADE7753 on the board, 1 to SCHED_METERS (node column meters)
+	-r   first row of the shield table (node column shield)
+	-3   the meters are the phases of one supply (WIRING_3PHASE)
+	-s   POWER_SAVE, the meters are suspended after each update
+
+The -g trace replayed with the same options must give the same records and no difference.
+
+Build from the sketch folder (the capture must be compiled in, in session mode):
+
+	g++ -O2 -DARDUINO=100 -DGRIDCAPTURE -DCAPTURE_SESSION -DGRIDPHASES -Ihost/mock -Ihost -I. host/replay.cpp \
+	    host/HostSim.cpp host/Ade7753Model.cpp ADE7753.cpp GridMeter.cpp GridScheduler.cpp GridPhases.cpp \
+	    GridWatchdog.cpp GridCapture.cpp GridLog.cpp -o host/replay7753
+	host/replay7753 -g session.log && host/replay7753 session.log > replay.json
+
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <vector>
+#include <avr/wdt.h>
+#include "HostSim.h"
+#include "Ade7753Model.h"
+#include "ADE7753.h"
+#include "GridMeter.h"
+#include "GridScheduler.h"
+#include "GridPhases.h"
+#include "GridWatchdog.h"
+#include "GridCapture.h"
+
+#ifndef GRIDPHASES
+#error "build with -DGRIDPHASES"
+#endif
+
+#define REPLAY_ROWS      4
+#define REPLAY_UPDATES   4         // updates of the -g session
+
+// Shield table: the three rows of the board of host/bench.cpp, then shield #2 on CS alone
+static const MeterConfig shields[REPLAY_ROWS] PROGMEM = {
+	{ CS, -3,   -5,   -2000, +2000,  12498.65, 167623.8, 141.0,   234565.0,  1.0,    34.8,     30.4,       0.60 },
+	{ 9,  -6,   -1,   -2000, -2048,  12225.0,  169192.0, 138.39,  233518.20, 1.0,    67.28,    58.57,      1.40 },
+	{ 7,  -3,   -5,   -2000, +2000,  12498.65, 167623.8, 141.0,   234565.0,  1.0,    34.8,     30.4,       0.60 },
+	{ CS, -6,   -1,   -2000, -2048,  12225.0,  169192.0, 138.39,  233518.20, 1.0,    67.28,    58.57,      1.40 }
+};
+
+// Register names for -d
+static const struct { uint8_t reg; const char *name; } names[] = {
+	{ WAVEFORM, "WAVEFORM" }, { AENERGY, "AENERGY" }, { RAENERGY, "RAENERGY" }, { LAENERGY, "LAENERGY" },
+	{ VAENERGY, "VAENERGY" }, { RVAENERGY, "RVAENERGY" }, { LVAENERGY, "LVAENERGY" }, { LVARENERGY, "LVARENERGY" },
+	{ MODE, "MODE" }, { IRQEN, "IRQEN" }, { STATUS, "STATUS" }, { RSTSTATUS, "RSTSTATUS" },
+	{ CH1OS, "CH1OS" }, { CH2OS, "CH2OS" }, { GAIN, "GAIN" }, { PHCAL, "PHCAL" }, { APOS, "APOS" },
+	{ WGAIN, "WGAIN" }, { WDIV, "WDIV" }, { CFNUM, "CFNUM" }, { CFDEN, "CFDEN" }, { IRMS, "IRMS" },
+	{ VRMS, "VRMS" }, { IRMSOS, "IRMSOS" }, { VRMSOS, "VRMSOS" }, { VAGAIN, "VAGAIN" }, { VADIV, "VADIV" },
+	{ LINECYC, "LINECYC" }, { ZXTOUT, "ZXTOUT" }, { SAGCYC, "SAGCYC" }, { SAGLVL, "SAGLVL" },
+	{ IPKLVL, "IPKLVL" }, { VPKLVL, "VPKLVL" }, { IPEAK, "IPEAK" }, { RSTIPEAK, "RSTIPEAK" },
+	{ VPEAK, "VPEAK" }, { RSTVPEAK, "RSTVPEAK" }, { TEMP, "TEMP" }, { PERIOD, "PERIOD" },
+	{ TMODE, "TMODE" }, { CHKSUM, "CHKSUM" }, { DIEREV, "DIEREV" }
+};
+
+/** === Event ===
+* One transaction of the trace: the repeats and rounds of the CaptureEvent are unfolded,
+* with the chip select pin of its CAPTURE_CHIP and the CAPTURE_GAP before it folded in
+*/
+struct Event {
+	uint8_t cs;
+	uint8_t op;                        // register | CAPTURE_WRITE
+	uint8_t repeat;                    // of the CaptureEvent, while its round is unfolded
+	unsigned long ticks;               // since the previous transaction, in CAPTURE_TICK_US
+	boolean gap;                       // after an idle gap of the loop, or first of the trace
+	uint32_t value;
+};
+
+/** === Replay ===
+* The ADE7753 of every chip select pin of the trace: checks each transaction of the code
+* against the next event and answers the reads with the recorded value
+*/
+class Replay {
+   public:
+      std::vector<Event> events;
+      size_t next;                     // transaction expected
+      size_t transactions;             // replayed
+      boolean diverged;
+      boolean exhausted;               // the code went on after the end of the trace
+      unsigned long long recordedUs, replayUs;
+
+      void start(void) {
+         next = 0;
+         transactions = 0;
+         diverged = exhausted = false;
+         recordedUs = replayUs = 0;
+         recordedAt = 0;
+         complete = false;
+      }
+
+      boolean finished(void) {
+         return diverged || next >= events.size();
+      }
+
+      void select(uint8_t pin, boolean on) {
+         if ( on )
+         {
+            count = 0;
+            return;
+         }
+         if ( writing && count > 1 ) expect(pin, reg | CAPTURE_WRITE, &shift);
+         if ( complete )
+         {   // time the transaction against the trace
+            unsigned long long now = simNow();
+            if ( ! timed.gap )
+            {
+               recordedUs += (unsigned long long)timed.ticks * CAPTURE_TICK_US;
+               replayUs += now - lastEnd;
+            }
+            // then bring the clock to the time of the event in the field, so that the
+            // decisions taken on millis() and micros() (stagger, budgets) fall the same way
+            recordedAt += (unsigned long long)timed.ticks * CAPTURE_TICK_US;
+            if ( next == 1 ) origin = now - recordedAt;
+            if ( now < origin + recordedAt ) simAdvance(origin + recordedAt - now);
+            lastEnd = simNow();
+            complete = false;
+         }
+         writing = false;
+         count = 0;
+      }
+
+      uint8_t transfer(uint8_t pin, uint8_t data) {
+         uint8_t out = 0;
+         if ( count == 0 )
+         {
+            writing = ( data & WRITE ) != 0;
+            reg = data & 0x3F;
+            width = Ade7753Model::width(reg);
+            shift = 0;
+            if ( ! writing && ! expect(pin, reg, &shift) ) shift = 0;
+         }
+         else if ( writing ) shift = ( shift << 8 ) | data;
+         else if ( count <= width ) out = shift >> ( 8 * ( width - count ) );
+         count++;
+         return out;
+      }
+
+   private:
+      /** === expect ===
+      * Check a transaction against the next event
+      * @param value: written, or the recorded value of a read on return
+      * @return boolean false when the code does something else than the trace
+      */
+      boolean expect(uint8_t pin, uint8_t op, uint32_t *value) {
+         if ( diverged ) return false;
+         if ( next >= events.size() )
+         {
+            exhausted = true;
+            return false;
+         }
+         Event &e = events[next];
+         if ( e.cs != pin || e.op != op || ( ( op & CAPTURE_WRITE ) && *value != e.value ) )
+         {
+            fprintf(stderr, "replay: event %zu expected %s 0x%02X = 0x%06X on pin %u, got %s 0x%02X = 0x%06X on pin %u\n",
+                    next, ( e.op & CAPTURE_WRITE ) ? "write" : "read", e.op & 0x3F, e.value, e.cs,
+                    ( op & CAPTURE_WRITE ) ? "write" : "read", op & 0x3F, ( op & CAPTURE_WRITE ) ? *value : 0, pin);
+            diverged = true;
+            return false;
+         }
+         *value = e.value;
+         transactions++;
+         timed = e;
+         complete = true;
+         next++;
+         return true;
+      }
+
+      uint8_t reg, width, count;       // current transaction
+      boolean writing;
+      uint32_t shift;
+      boolean complete;                // the current transaction was checked
+      Event timed;                     // ... against
+      unsigned long long lastEnd;      // simNow() at the end of the last event
+      unsigned long long recordedAt;   // time of the last event in the trace, from the first one
+      unsigned long long origin;       // simNow() of the start of the trace
+};
+
+static Replay replay;
+
+/** === ReplayPin ===
+* Attaches the replay to one chip select pin
+*/
+class ReplayPin : public SpiDevice {
+   public:
+      uint8_t pin;
+      void select(boolean on) { replay.select(pin, on); }
+      uint8_t transfer(uint8_t data) { return replay.transfer(pin, data); }
+};
+
+/** === FilePrint ===
+* Print to a file, for the trace written by GridCapture with -g
+*/
+class FilePrint : public Print {
+   public:
+      FILE *f;
+      size_t write(uint8_t c) { return fputc(c, f) == EOF ? 0 : 1; }
+};
+
+/** === unfold ===
+* Append the transactions of a round to replay.events, pass after pass. The idle gap before
+* the round goes to its first transaction, the dt of its events to its last one.
+* @param round: events of the round, emptied
+* @param idle: ticks of the CAPTURE_GAP before the round
+* @param gap: the round follows an idle gap or starts the trace
+*/
+static void unfold(std::vector<Event> &round, unsigned long idle, boolean gap) {
+	size_t first = replay.events.size();
+	unsigned long ticks = 0;
+	for (size_t i = 0; i < round.size(); i++) ticks += round[i].ticks;
+	for (unsigned int pass = 0; pass <= CAPTURE_REPEATS; pass++)
+	{
+		for (size_t i = 0; i < round.size(); i++)
+		{
+			if ( round[i].repeat < pass ) continue;
+			Event e = round[i];
+			e.repeat = 0;
+			e.ticks = 0;
+			e.gap = false;
+			replay.events.push_back(e);
+		}
+	}
+	if ( replay.events.size() > first )
+	{
+		replay.events[first].ticks = idle;
+		replay.events[first].gap = gap;
+		replay.events.back().ticks += ticks;
+	}
+	round.clear();
+}
+
+/** === load ===
+* Read the '@' lines of a Serial log into replay.events, from the last CAPTURE_LOST on
+* @return unsigned long with the number of events read, 0 if the file cannot be read
+*/
+static unsigned long load(const char *path, boolean decode) {
+	FILE *f = fopen(path, "r");
+	char line[256];
+	uint8_t pins[CAPTURE_CHIPS] = { CS, CS, CS, CS };
+	std::vector<Event> round;
+	unsigned long idle = 0, roundIdle = 0, total = 0, events = 0;  // idle: ticks of the CAPTURE_GAP since the last round
+	boolean after = true, roundAfter = true;                         // after: an idle gap since the last round
+	if ( f == 0 ) return 0;
+	while ( fgets(line, sizeof(line), f) != 0 )
+	{
+		for (char *at = strchr(line, '@'); at != 0; at = strchr(at + 1, '@'))
+		{
+			uint8_t b[sizeof(CaptureEvent)];
+			unsigned int i;
+			for (i = 0; i < sizeof(b); i++)
+			{
+				unsigned int x;
+				if ( sscanf(at + 1 + 2 * i, "%2x", &x) != 1 || ! isxdigit(at[1 + 2 * i]) || ! isxdigit(at[2 + 2 * i]) ) break;
+				b[i] = x;
+			}
+			if ( i < sizeof(b) ) continue;
+			uint32_t value = (uint32_t)b[3] << 16 | (uint32_t)b[4] << 8 | b[5];
+			events++;
+			total += b[2];
+			if ( decode )
+			{
+				if ( b[0] == CAPTURE_CHIP ) printf("%6lu  ---  chip %u is pin %u\n", events, b[1] >> 6, value);
+				else if ( b[0] == CAPTURE_GAP ) printf("%6lu  ---  idle %.1f ms\n", events, value * CAPTURE_TICK_US / 1000.0);
+				else if ( b[0] == CAPTURE_LOST ) printf("%6lu  ---  %u events lost\n", events, value);
+				else
+				{
+					const char *name = "?";
+					for (unsigned int n = 0; n < sizeof(names) / sizeof(names[0]); n++) if ( names[n].reg == ( b[0] & 0x3F ) ) name = names[n].name;
+					printf("%6lu  %10.3f ms  pin %2u  %s %-10s 0x%06X", events, total * CAPTURE_TICK_US / 1000.0, pins[b[1] >> 6],
+					       ( b[0] & CAPTURE_WRITE ) ? "W" : "R", name, value);
+					if ( ( b[1] & CAPTURE_REPEATS ) != 0 ) printf("  x%u", ( b[1] & CAPTURE_REPEATS ) + 1);
+					if ( b[1] & CAPTURE_ROUND ) printf("  in turn with the above");
+					printf("\n");
+				}
+			}
+			if ( b[0] == CAPTURE_GAP ) total += value;
+			if ( ( b[0] & CAPTURE_MARK ) || ! ( b[1] & CAPTURE_ROUND ) || round.empty() )
+			{   // the round is complete
+				unfold(round, roundIdle, roundAfter);
+				roundIdle = idle;
+				roundAfter = after;
+				if ( ! ( b[0] & CAPTURE_MARK ) ) idle = 0, after = false;
+			}
+			if ( b[0] == CAPTURE_CHIP ) pins[b[1] >> 6] = value;
+			else if ( b[0] == CAPTURE_GAP ) { idle += value; after = true; }
+			else if ( b[0] == CAPTURE_LOST )
+			{
+				fprintf(stderr, "replay: %u events lost at event %lu, replaying from there\n", value, events);
+				replay.events.clear();
+				idle = 0;
+				after = true;
+			}
+			else
+			{
+				Event e = { pins[b[1] >> 6], b[0], (uint8_t)( b[1] & CAPTURE_REPEATS ), b[2], false, value };
+				round.push_back(e);
+			}
+		}
+	}
+	unfold(round, roundIdle, roundAfter);
+	fclose(f);
+	return events;
+}
+
+/** === setupMeters ===
+* The Energy Shield part of setup(): bring-up of each meter
+*/
+static void setupMeters(GridMeter *meters, GridScheduler &scheduler, GridPhases &phases, byte count, byte row, boolean threePhase) {
+	ADE7753 meter;
+	meter.setSPI();
+	for (byte i = 0; i < count; i++) meters[i].begin(&shields[row + i]);
+	scheduler.begin(meters, count);
+	if ( threePhase )
+	{
+		scheduler.setStagger(0);
+		phases.begin(meters);
+	}
+	meter.closeSPI();
+}
+
+/** === update ===
+* The Energy Shield part of an update of the loop, with the records printed as JSON
+*/
+static void update(unsigned int u, GridMeter *meters, GridScheduler &scheduler, GridPhases &phases, boolean threePhase, boolean powerSave) {
+	GridRecord rec;
+	wdt_reset();
+	for (byte i = 0; i < scheduler.getCount(); i++) meters[i].check();
+	scheduler.run();
+	for (byte i = 0; i < scheduler.getCount(); i++)
+	{
+		scheduler.read(i, rec);
+		if ( threePhase ) phases.add(rec);
+		printf("%s    {\"update\": %u, \"meter\": %u, \"mains\": %s, \"vrms\": %ld, \"irms\": %ld, \"active\": %ld, \"period\": %d, \"repairs\": %u}",
+		       u == 0 && i == 0 ? "" : ",\n", u, i, meters[i].hasMains() ? "true" : "false",
+		       rec.vrms, rec.irms, rec.activeEnergy, rec.period, meters[i].getRepairs());
+	}
+	if ( threePhase )
+	{
+		phases.detectSequence(rec.period);
+		phases.compute();
+		printf(",\n    {\"update\": %u, \"sequence\": %u, \"neutral\": %u}", u, phases.getSequence(), phases.getNeutral());
+	}
+	for (byte i = 0; i < scheduler.getCount(); i++)
+	{
+		if ( powerSave ) meters[i].suspend();
+	}
+	meters[0].close();
+	simAdvance(6000000ULL); // the rest of the update period, no ADE7753 transaction
+}
+
+int main(int argc, char **argv) {
+	GridMeter meters[SCHED_METERS];
+	GridScheduler scheduler;
+	GridPhases phases;
+	Ade7753Model ades[SCHED_METERS];
+	ReplayPin pins[SIM_PINS];
+	byte count = 1, row = 0;
+	boolean threePhase = false, powerSave = false, decode = false, generate = false;
+	unsigned int updates = REPLAY_UPDATES;
+	const char *path = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if ( strcmp(argv[i], "-m") == 0 && i + 1 < argc ) count = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-r") == 0 && i + 1 < argc ) row = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-u") == 0 && i + 1 < argc ) updates = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-3") == 0 ) threePhase = true;
+		else if ( strcmp(argv[i], "-s") == 0 ) powerSave = true;
+		else if ( strcmp(argv[i], "-d") == 0 ) decode = true;
+		else if ( strcmp(argv[i], "-g") == 0 ) generate = true;
+		else path = argv[i];
+	}
+	if ( threePhase ) count = PHASES;
+	if ( path == 0 || count < 1 || count > SCHED_METERS || row + count > REPLAY_ROWS )
+	{
+		fprintf(stderr, "usage: replay [-d | -g [-u updates]] [-m meters] [-r row] [-3] [-s] trace.log\n");
+		return 2;
+	}
+	simQuiet(true);
+
+	if ( decode )
+	{
+		if ( load(path, true) == 0 ) { fprintf(stderr, "replay: no event in %s\n", path); return 2; }
+		return 0;
+	}
+
+	printf("{\n  \"trace\": \"%s\",\n  \"meters\": %u,\n  \"records\": [\n", path, count);
+	if ( generate )
+	{   // a session of the simulated chips of host/bench.cpp, captured as on the Nanode
+		FilePrint out;
+		out.f = fopen(path, "w");
+		if ( out.f == 0 ) { fprintf(stderr, "replay: cannot write %s\n", path); return 2; }
+		for (byte i = 0; i < count; i++)
+		{
+			const MeterConfig *c = &shields[row + i];
+			ades[i].vrms += i * 1000;
+			ades[i].irms += i * 50000;
+			ades[i].activePerHalfCycle += i * 10;
+			if ( threePhase ) ades[i].phaseUs = i * 20000UL / PHASES;
+			simAttach(pgm_read_byte(&c->cs), &ades[i]);
+		}
+		gridCapture.begin(out);
+		setupMeters(meters, scheduler, phases, count, row, threePhase);
+		for (unsigned int u = 0; u < updates; u++)
+		{
+			if ( u == 1 ) ades[0].corrupt(VRMSOS, 0);  // repaired by check()
+			ades[0].mains = ( u != 2 );                // no mains during the third update
+			update(u, meters, scheduler, phases, threePhase, powerSave);
+		}
+		gridCapture.dump();
+		fclose(out.f);
+		printf("\n  ]\n}\n");
+		return 0;
+	}
+
+	unsigned long events = load(path, false);
+	if ( events == 0 ) { fprintf(stderr, "replay: no event in %s\n", path); return 2; }
+	for (uint8_t p = 0; p < SIM_PINS; p++)
+	{
+		pins[p].pin = p;
+		simAttach(p, &pins[p]);
+	}
+	replay.start();
+	setupMeters(meters, scheduler, phases, count, row, threePhase);
+	unsigned int u;
+	for (u = 0; ! replay.finished(); u++) update(u, meters, scheduler, phases, threePhase, powerSave);
+	printf("\n  ],\n  \"events\": %lu,\n  \"transactions\": %zu,\n  \"updates\": %u,\n  \"recorded_us\": %llu,\n"
+	       "  \"replay_us\": %llu,\n  \"diverged\": %s,\n  \"truncated\": %s\n}\n",
+	       events, replay.transactions, u, replay.recordedUs, replay.replayUs,
+	       replay.diverged ? "true" : "false", replay.exhausted ? "true" : "false");
+	return replay.diverged ? 1 : 0;
+}